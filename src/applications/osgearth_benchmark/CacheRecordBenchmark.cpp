@@ -0,0 +1,262 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include "Benchmark"
+#include <osgEarth/Cache>
+#include <osgEarth/CacheBin>
+#include <osgEarth/CacheRecordCodec>
+#include <osgEarth/Random>
+#include <osgEarth/StringUtils>
+#include <osg/Image>
+#include <osg/Shape>
+#include <osgDB/FileNameUtils>
+#include <osgDB/Registry>
+#include <iostream>
+#include <iomanip>
+
+using namespace osgEarth;
+
+namespace
+{
+    // Imagery-like tile: smooth gradients plus a little noise, so that
+    // compression has about as much to work with as it would on real data.
+    osg::Image* makeImage(unsigned index, Random& prng)
+    {
+        osg::Image* image = new osg::Image();
+        image->allocateImage(256, 256, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+        for(int t=0; t<image->t(); ++t)
+        {
+            unsigned char* p = image->data(0, t);
+            for(int s=0; s<image->s(); ++s, p += 4)
+            {
+                p[0] = (unsigned char)((s + index) & 0xff);
+                p[1] = (unsigned char)((t * 3 + index) & 0xff);
+                p[2] = (unsigned char)((s ^ t) & 0x3f) + (unsigned char)prng.next(8);
+                p[3] = 255;
+            }
+        }
+        return image;
+    }
+
+    osg::HeightField* makeHeightField(unsigned index)
+    {
+        osg::HeightField* hf = new osg::HeightField();
+        hf->allocate(257, 257);
+        hf->setXInterval(1.0f/256.0f);
+        hf->setYInterval(1.0f/256.0f);
+        for(unsigned row=0; row<hf->getNumRows(); ++row)
+            for(unsigned col=0; col<hf->getNumColumns(); ++col)
+                hf->setHeight(col, row, 100.0f + 50.0f*(float)(sin((col+index)*0.05)*cos(row*0.05)));
+        return hf;
+    }
+
+    struct Layout
+    {
+        const char* name;
+        bool        singleRecord;
+        const char* compression;
+    };
+
+    const Layout s_layouts[] = {
+        { "osgb",     false, "none" },
+        { "raw",      true,  "none" },
+        { "raw+zlib", true,  "zlib" },
+        { 0L, false, 0L }
+    };
+
+    // Encode/decode through the codec alone vs. through the osgb plugin,
+    // which is what each layout costs per tile before touching the database.
+    void runCodecSuite(const std::vector<osg::ref_ptr<osg::Object> >& objects)
+    {
+        osg::ref_ptr<osgDB::ReaderWriter> rw = osgDB::Registry::instance()->getReaderWriterForExtension("osgb");
+        if (!rw.valid())
+        {
+            std::cout << "\nosgb plugin not found; skipping the codec comparison\n";
+            return;
+        }
+
+        std::cout << "\nCodec only (" << objects.size() << " tiles)\n"
+            << std::setw(10) << "layout"
+            << std::setw(16) << "encode us/tile"
+            << std::setw(16) << "decode us/tile"
+            << std::setw(14) << "KB/tile" << "\n";
+
+        for(const Layout* layout = s_layouts; layout->name; ++layout)
+        {
+            CacheRecordCodec codec(CacheRecordCodec::parseCompression(layout->compression));
+            std::vector<std::string> encoded(objects.size());
+
+            osg::Timer_t start = osg::Timer::instance()->tick();
+            for(unsigned i=0; i<objects.size(); ++i)
+            {
+                if (layout->singleRecord)
+                {
+                    codec.encode(objects[i].get(), Config(), encoded[i]);
+                }
+                else
+                {
+                    std::stringstream buf;
+                    if (dynamic_cast<const osg::Image*>(objects[i].get()))
+                        rw->writeImage(*static_cast<const osg::Image*>(objects[i].get()), buf);
+                    else
+                        rw->writeObject(*objects[i].get(), buf);
+                    encoded[i] = buf.str();
+                }
+            }
+            double encodeTime = osg::Timer::instance()->delta_u(start, osg::Timer::instance()->tick());
+
+            double bytes = 0.0;
+            start = osg::Timer::instance()->tick();
+            for(unsigned i=0; i<encoded.size(); ++i)
+            {
+                bytes += (double)encoded[i].size();
+                if (layout->singleRecord)
+                {
+                    Config meta;
+                    osg::ref_ptr<osg::Object> object;
+                    codec.decode(encoded[i], meta, object);
+                }
+                else
+                {
+                    std::istringstream buf(encoded[i]);
+                    if (dynamic_cast<const osg::Image*>(objects[i].get()))
+                        rw->readImage(buf);
+                    else
+                        rw->readObject(buf);
+                }
+            }
+            double decodeTime = osg::Timer::instance()->delta_u(start, osg::Timer::instance()->tick());
+
+            std::cout << std::fixed << std::setprecision(1)
+                << std::setw(10) << layout->name
+                << std::setw(16) << encodeTime/(double)objects.size()
+                << std::setw(16) << decodeTime/(double)objects.size()
+                << std::setw(14) << bytes/(double)objects.size()/1024.0 << "\n";
+        }
+    }
+
+    // Write every tile to a fresh cache per layout, then time reading them
+    // back and measure the size of the database on disk.
+    void runCacheSuite(const std::string& driver, const std::string& root, const std::vector<osg::ref_ptr<osg::Object> >& objects, unsigned passes)
+    {
+        std::cout << "\n" << driver << " cache (" << objects.size() << " tiles, " << passes << " read passes)\n"
+            << std::setw(10) << "layout"
+            << std::setw(16) << "write us/tile"
+            << std::setw(16) << "read us/tile"
+            << std::setw(14) << "MB on disk" << "\n";
+
+        for(const Layout* layout = s_layouts; layout->name; ++layout)
+        {
+            Config conf;
+            conf.set("driver", driver);
+            conf.set("path", osgDB::concatPaths(root, Stringify() << driver << "_" << layout->name));
+            conf.set("single_record", layout->singleRecord);
+            conf.set("compression", layout->compression);
+
+            osg::ref_ptr<Cache> cache = CacheFactory::create(CacheOptions(ConfigOptions(conf)));
+            if (!cache.valid() || !cache->isOK())
+            {
+                std::cout << "Cache driver \"" << driver << "\" is not available; skipping\n";
+                return;
+            }
+
+            CacheBin* bin = cache->addBin("benchmark");
+            if (!bin)
+                return;
+            bin->clear();
+
+            osg::Timer_t start = osg::Timer::instance()->tick();
+            for(unsigned i=0; i<objects.size(); ++i)
+                bin->write(Stringify() << i, objects[i].get(), Config(), 0L);
+            double writeTime = osg::Timer::instance()->delta_u(start, osg::Timer::instance()->tick());
+
+            unsigned misses = 0;
+            start = osg::Timer::instance()->tick();
+            for(unsigned p=0; p<passes; ++p)
+            {
+                for(unsigned i=0; i<objects.size(); ++i)
+                {
+                    ReadResult r = dynamic_cast<const osg::Image*>(objects[i].get()) ?
+                        bin->readImage(Stringify() << i, 0L) :
+                        bin->readObject(Stringify() << i, 0L);
+                    if (!r.succeeded())
+                        ++misses;
+                }
+            }
+            double readTime = osg::Timer::instance()->delta_u(start, osg::Timer::instance()->tick());
+
+            cache->compact();
+            double size = (double)cache->getApproximateSize();
+
+            std::cout << std::fixed << std::setprecision(1)
+                << std::setw(10) << layout->name
+                << std::setw(16) << writeTime/(double)objects.size()
+                << std::setw(16) << readTime/(double)(objects.size()*passes)
+                << std::setw(14) << size/1048576.0;
+            if (misses > 0)
+                std::cout << "  (" << misses << " failed reads)";
+            std::cout << "\n";
+        }
+    }
+}
+
+int
+Benchmark::cacheRecords(osg::ArgumentParser& args)
+{
+    unsigned tiles = 500;
+    args.read("--tiles", tiles);
+
+    unsigned passes = 4;
+    args.read("--passes", passes);
+
+    std::string root = "osgearth_benchmark_cache";
+    args.read("--path", root);
+
+    std::vector<std::string> drivers;
+    std::string driver;
+    while (args.read("--driver", driver))
+        drivers.push_back(driver);
+    if (drivers.empty())
+    {
+        drivers.push_back("leveldb");
+        drivers.push_back("rocksdb");
+    }
+
+    // half imagery, half elevation:
+    Random prng(0);
+    std::vector<osg::ref_ptr<osg::Object> > objects;
+    for(unsigned i=0; i<tiles; ++i)
+    {
+        if (i % 2 == 0)
+            objects.push_back( makeImage(i, prng) );
+        else
+            objects.push_back( makeHeightField(i) );
+    }
+
+    runCodecSuite(objects);
+
+    for(unsigned i=0; i<drivers.size(); ++i)
+        runCacheSuite(drivers[i], root, objects, passes);
+
+    std::cout << std::flush;
+    return 0;
+}
@@ -0,0 +1,156 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include "Benchmark"
+#include <osgEarth/ScreenSpaceLayout>
+#include <osgEarth/Random>
+#include <iostream>
+#include <iomanip>
+
+using namespace osgEarth;
+
+namespace
+{
+    // A synthetic render leaf: a label's window-space box and the Geode it belongs to.
+    struct Leaf
+    {
+        osg::BoundingBox box;
+        const void*      parent;
+    };
+
+    // Label-sized boxes scattered over (and a little beyond) the window,
+    // two leaves (e.g. icon + text) per parent.
+    void makeLeaves(unsigned count, float width, float height, Random& prng, std::vector<Leaf>& leaves)
+    {
+        leaves.resize(count);
+        for(unsigned i=0; i<count; ++i)
+        {
+            float x = -50.0f + prng.next()*(width + 100.0f);
+            float y = -20.0f + prng.next()*(height + 40.0f);
+            float w = 20.0f + prng.next()*140.0f;
+            float h = 12.0f + prng.next()*12.0f;
+            leaves[i].box.set( floor(x), floor(y), 0.0f, ceil(x+w), ceil(y+h), 0.0f );
+            leaves[i].parent = reinterpret_cast<const void*>((size_t)(1 + i/2));
+        }
+    }
+
+    // The original declutter test: compare against every box placed so far.
+    unsigned bruteForce(const std::vector<Leaf>& leaves, std::vector<Leaf>& used)
+    {
+        used.clear();
+        for(unsigned i=0; i<leaves.size(); ++i)
+        {
+            const osg::BoundingBox& box = leaves[i].box;
+            bool visible = true;
+            for(std::vector<Leaf>::const_iterator j = used.begin(); j != used.end(); ++j)
+            {
+                bool isClear =
+                    box.xMin() > j->box.xMax() ||
+                    box.xMax() < j->box.xMin() ||
+                    box.yMin() > j->box.yMax() ||
+                    box.yMax() < j->box.yMin();
+                if (!isClear && leaves[i].parent != j->parent)
+                {
+                    visible = false;
+                    break;
+                }
+            }
+            if (visible)
+                used.push_back(leaves[i]);
+        }
+        return used.size();
+    }
+
+    unsigned grid(const std::vector<Leaf>& leaves, float width, float height, float cellSize, ScreenSpaceOccupancyGrid& used)
+    {
+        used.reset(0.0f, 0.0f, width, height, cellSize);
+        for(unsigned i=0; i<leaves.size(); ++i)
+        {
+            if (!used.overlaps(leaves[i].box, leaves[i].parent))
+                used.insert(leaves[i].box, leaves[i].parent);
+        }
+        return used.size();
+    }
+}
+
+int
+Benchmark::declutter(osg::ArgumentParser& args)
+{
+    unsigned frames = 20;
+    args.read("--frames", frames);
+
+    float width = 1920.0f, height = 1080.0f;
+    args.read("--window", width, height);
+
+    float cellSize = 64.0f;
+    args.read("--cell", cellSize);
+
+    std::vector<unsigned> counts;
+    counts.push_back(1000);
+    counts.push_back(10000);
+    counts.push_back(50000);
+
+    std::cout << "\nScreenSpaceLayout declutter test, brute force vs. occupancy grid ("
+        << width << "x" << height << " window, " << cellSize << "px cells, "
+        << frames << " frames)\n"
+        << std::setw(8)  << "leaves"
+        << std::setw(10) << "passed"
+        << std::setw(16) << "brute ms/frame"
+        << std::setw(15) << "grid ms/frame"
+        << std::setw(10) << "speedup" << "\n";
+
+    Random prng(1234);
+    std::vector<Leaf> leaves, bruteUsed;
+    ScreenSpaceOccupancyGrid gridUsed;
+
+    for(unsigned c=0; c<counts.size(); ++c)
+    {
+        makeLeaves(counts[c], width, height, prng, leaves);
+
+        unsigned brutePassed = 0, gridPassed = 0;
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        for(unsigned f=0; f<frames; ++f)
+            brutePassed = bruteForce(leaves, bruteUsed);
+        double bruteMS = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()) / frames;
+
+        start = osg::Timer::instance()->tick();
+        for(unsigned f=0; f<frames; ++f)
+            gridPassed = grid(leaves, width, height, cellSize, gridUsed);
+        double gridMS = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()) / frames;
+
+        std::cout << std::fixed << std::setprecision(3)
+            << std::setw(8)  << counts[c]
+            << std::setw(10) << gridPassed
+            << std::setw(16) << bruteMS
+            << std::setw(15) << gridMS
+            << std::setw(9)  << std::setprecision(1) << bruteMS/gridMS << "x";
+
+        if (brutePassed != gridPassed)
+            std::cout << "  MISMATCH (brute force passed " << brutePassed << ")";
+
+        std::cout << "\n";
+    }
+    std::cout << std::flush;
+
+    return 0;
+}
@@ -0,0 +1,217 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include "Benchmark"
+#include <osgEarth/Map>
+#include <osgEarth/ElevationLayer>
+#include <osgEarth/HeightFieldUtils>
+#include <osgEarth/Random>
+#include <osgEarth/Registry>
+#include <osgEarthFeatures/FeatureListSource>
+#include <osgEarthUtil/FlatteningLayer>
+#include <iostream>
+#include <iomanip>
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+using namespace osgEarth::Symbology;
+using namespace osgEarth::Util;
+
+namespace
+{
+    // Rolling synthetic terrain, so the flattening has something to flatten.
+    class HillsTileSource : public TileSource
+    {
+    public:
+        HillsTileSource() : TileSource(TileSourceOptions()) { }
+
+        Status initialize(const osgDB::Options* dbOptions)
+        {
+            setProfile( Registry::instance()->getGlobalGeodeticProfile() );
+            return STATUS_OK;
+        }
+
+        osg::HeightField* createHeightField(const TileKey& key, ProgressCallback* progress)
+        {
+            const GeoExtent& ex = key.getExtent();
+            osg::HeightField* hf = HeightFieldUtils::createReferenceHeightField(ex, 257, 257, 0u, true);
+            for(unsigned row=0; row<hf->getNumRows(); ++row)
+            {
+                double y = ex.yMin() + ex.height()*(double)row/(double)(hf->getNumRows()-1);
+                for(unsigned col=0; col<hf->getNumColumns(); ++col)
+                {
+                    double x = ex.xMin() + ex.width()*(double)col/(double)(hf->getNumColumns()-1);
+                    hf->setHeight(col, row, 100.0f + 50.0f*(float)(sin(x*500.0)*cos(y*500.0)));
+                }
+            }
+            return hf;
+        }
+    };
+
+    // A road network of "segments" segments: random-walk polylines of 50
+    // segments each, scattered over (and a little beyond) the extent.
+    void makeRoads(unsigned segments, const GeoExtent& ex, Random& prng, FeatureList& roads)
+    {
+        const unsigned segmentsPerRoad = 50;
+        double step = ex.width() / 100.0;
+
+        roads.clear();
+        for(unsigned made=0; made<segments; made += segmentsPerRoad)
+        {
+            LineString* line = new LineString();
+            double x = ex.xMin() - 0.1*ex.width()  + prng.next()*1.2*ex.width();
+            double y = ex.yMin() - 0.1*ex.height() + prng.next()*1.2*ex.height();
+            double heading = prng.next()*osg::PI*2.0;
+            line->push_back( osg::Vec3d(x, y, 0.0) );
+            for(unsigned i=0; i<segmentsPerRoad; ++i)
+            {
+                heading += (prng.next()-0.5)*0.5;
+                x += cos(heading)*step;
+                y += sin(heading)*step;
+                line->push_back( osg::Vec3d(x, y, 0.0) );
+            }
+            roads.push_back( new Feature(line, ex.getSRS()) );
+        }
+    }
+
+    // The search the flattening used to do: every sample against every segment.
+    // Distances only (no elevation sampling), so it understates the old cost.
+    unsigned bruteForceScan(const FeatureList& roads, const GeoExtent& ex, unsigned size, double radius)
+    {
+        unsigned hits = 0;
+        double radius2 = radius*radius;
+        for(unsigned row=0; row<size; ++row)
+        {
+            for(unsigned col=0; col<size; ++col)
+            {
+                osg::Vec3d P(
+                    ex.xMin() + ex.width()*(double)col/(double)(size-1),
+                    ex.yMin() + ex.height()*(double)row/(double)(size-1),
+                    0.0);
+
+                for(FeatureList::const_iterator f = roads.begin(); f != roads.end(); ++f)
+                {
+                    const Geometry* part = f->get()->getGeometry();
+                    for(unsigned i=0; i+1<part->size(); ++i)
+                    {
+                        const osg::Vec3d& A = (*part)[i];
+                        osg::Vec3d AB = (*part)[i+1] - A, AP = P - A;
+                        double L2 = AB.length2();
+                        double t = L2 > 0.0 ? osg::clampBetween((AP*AB)/L2, 0.0, 1.0) : 0.0;
+                        if ((P - (A + AB*t)).length2() <= radius2)
+                            ++hits;
+                    }
+                }
+            }
+        }
+        return hits;
+    }
+}
+
+int
+Benchmark::flattening(osg::ArgumentParser& args)
+{
+    unsigned lod = 14;
+    args.read("--lod", lod);
+
+    // the old search is quadratic; skip it above this many segments
+    unsigned bruteMax = 10000;
+    args.read("--brute-max", bruteMax);
+
+    std::vector<unsigned> counts;
+    counts.push_back(1000);
+    counts.push_back(10000);
+    counts.push_back(100000);
+
+    const Profile* profile = Registry::instance()->getGlobalGeodeticProfile();
+    TileKey key = profile->createTileKey(0.01, 0.01, lod);
+    const GeoExtent& ex = key.getExtent();
+
+    // line width 10 m + 10 m buffer on either side, in degrees at the equator
+    double radius = 15.0 / 111000.0;
+
+    std::cout << "\nFlatteningLayer over synthetic road networks (LOD " << lod
+        << " tile, 257x257 samples, " << Registry::instance()->getTaskServiceManager()->getSharedService()->getNumThreads()
+        << " shared threads)\n"
+        << std::setw(10) << "segments"
+        << std::setw(20) << "brute scan ms"
+        << std::setw(20) << "flattening ms"
+        << std::setw(10) << "speedup" << "\n";
+
+    Random prng(1234);
+
+    for(unsigned c=0; c<counts.size(); ++c)
+    {
+        osg::ref_ptr<FeatureListSource> roads = new FeatureListSource(ex);
+        makeRoads(counts[c], ex, prng, roads->getFeatures());
+        roads->open();
+
+        double bruteMS = 0.0;
+        if (counts[c] <= bruteMax)
+        {
+            osg::Timer_t start = osg::Timer::instance()->tick();
+            bruteForceScan(roads->getFeatures(), ex, 257, radius);
+            bruteMS = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+        }
+
+        osg::ref_ptr<Map> map = new Map();
+
+        ElevationLayerOptions hillsOptions("hills");
+        hillsOptions.cachePolicy() = CachePolicy::NO_CACHE;
+        map->addLayer( new ElevationLayer(hillsOptions, new HillsTileSource()) );
+
+        FlatteningLayerOptions options;
+        options.name() = "flattening";
+        options.cachePolicy() = CachePolicy::NO_CACHE;
+        options.featureSourceLayer() = "roads";
+        options.lineWidth() = NumericExpression(10.0);
+        options.bufferWidth() = NumericExpression(10.0);
+        osg::ref_ptr<FlatteningLayer> layer = new FlatteningLayer(options);
+        map->addLayer( layer.get() );
+        layer->setFeatureSource( roads.get() );
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        GeoHeightField result = layer->createHeightField(key, 0L);
+        double flattenMS = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+
+        std::cout << std::fixed << std::setprecision(1)
+            << std::setw(10) << counts[c];
+
+        if (counts[c] <= bruteMax)
+            std::cout << std::setw(20) << bruteMS;
+        else
+            std::cout << std::setw(20) << "-";
+
+        std::cout << std::setw(20) << flattenMS;
+
+        if (counts[c] <= bruteMax)
+            std::cout << std::setw(9) << bruteMS/flattenMS << "x";
+
+        if (!result.valid())
+            std::cout << "  NO RESULT";
+
+        std::cout << "\n";
+    }
+    std::cout << std::flush;
+
+    return 0;
+}
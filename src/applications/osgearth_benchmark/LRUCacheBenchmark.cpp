@@ -0,0 +1,126 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include "Benchmark"
+#include <osgEarth/Containers>
+#include <osgEarth/TileKey>
+#include <osgEarth/Registry>
+#include <osgEarth/StringUtils>
+#include <iostream>
+#include <iomanip>
+
+using namespace osgEarth;
+
+namespace
+{
+    // Same mix for both implementations: mostly reads, some writes, over
+    // a working set larger than the cache so that eviction happens too.
+    template<typename CACHE, typename KEY>
+    struct CacheJob : public Benchmark::ParallelJob
+    {
+        CACHE&                   _cache;
+        const std::vector<KEY>&  _keys;
+        unsigned                 _opsPerThread;
+
+        CacheJob(CACHE& cache, const std::vector<KEY>& keys, unsigned ops)
+            : _cache(cache), _keys(keys), _opsPerThread(ops) { }
+
+        void run(unsigned threadIndex)
+        {
+            typename CACHE::Record rec;
+            unsigned seed = 1013904223u * (threadIndex+1u);
+            for(unsigned i=0; i<_opsPerThread; ++i)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                const KEY& key = _keys[ (seed >> 8) % _keys.size() ];
+                if ( (seed & 0xff) < 51 ) // ~20% writes
+                    _cache.insert(key, i);
+                else if ( !_cache.get(key, rec) )
+                    _cache.insert(key, i);
+            }
+        }
+    };
+
+    template<typename KEY>
+    void runSuite(const std::string& label, const std::vector<KEY>& keys, const std::vector<unsigned>& threadCounts, unsigned ops, unsigned capacity)
+    {
+        typedef LRUCache<KEY, unsigned>           Serial;
+        typedef ConcurrentLRUCache<KEY, unsigned> Sharded;
+
+        std::cout << "\n" << label << " keys (" << keys.size() << " distinct, capacity " << capacity << ", " << ops << " ops/thread)\n"
+            << std::setw(8) << "threads"
+            << std::setw(16) << "LRUCache Mops/s"
+            << std::setw(20) << "Concurrent Mops/s"
+            << std::setw(10) << "speedup" << "\n";
+
+        for(unsigned t=0; t<threadCounts.size(); ++t)
+        {
+            unsigned n = threadCounts[t];
+            double total = (double)n * (double)ops / 1.0e6;
+
+            Serial serial(true, capacity);
+            CacheJob<Serial, KEY> serialJob(serial, keys, ops);
+            double serialRate = total / serialJob.execute(n);
+
+            Sharded sharded(capacity);
+            CacheJob<Sharded, KEY> shardedJob(sharded, keys, ops);
+            double shardedRate = total / shardedJob.execute(n);
+
+            std::cout << std::fixed << std::setprecision(2)
+                << std::setw(8) << n
+                << std::setw(16) << serialRate
+                << std::setw(20) << shardedRate
+                << std::setw(9) << shardedRate/serialRate << "x\n";
+        }
+        std::cout << std::flush;
+    }
+}
+
+int
+Benchmark::lruCache(osg::ArgumentParser& args)
+{
+    std::vector<unsigned> threadCounts = parseThreadCounts(args);
+
+    unsigned ops = 200000;
+    args.read("--ops", ops);
+
+    unsigned capacity = 4096;
+    args.read("--capacity", capacity);
+
+    // TileKeys spanning a few LODs, as a tile cache would see them:
+    const Profile* profile = Registry::instance()->getGlobalGeodeticProfile();
+    std::vector<TileKey> tileKeys;
+    for(unsigned lod=8; lod<=9; ++lod)
+        for(unsigned x=0; x<64; ++x)
+            for(unsigned y=0; y<64; ++y)
+                tileKeys.push_back( TileKey(lod, x, y, profile) );
+
+    // String keys, as MemCache bins see them:
+    std::vector<std::string> stringKeys;
+    for(unsigned i=0; i<tileKeys.size(); ++i)
+        stringKeys.push_back( Stringify() << "layer_" << tileKeys[i].str() );
+
+    runSuite("TileKey", tileKeys,   threadCounts, ops, capacity);
+    runSuite("string",  stringKeys, threadCounts, ops, capacity);
+
+    return 0;
+}
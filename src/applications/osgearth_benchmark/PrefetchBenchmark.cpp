@@ -0,0 +1,244 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include "Benchmark"
+#include <osgEarth/Map>
+#include <osgEarth/MapFrame>
+#include <osgEarth/ImageLayer>
+#include <osgEarth/TerrainOptions>
+#include <osgEarth/TerrainTileModelFactory>
+#include <osgEarth/TilePrefetcher>
+#include <osgEarth/GeoData>
+#include <osgEarth/Registry>
+#include <osgEarth/StringUtils>
+#include <iostream>
+#include <iomanip>
+
+using namespace osgEarth;
+
+namespace
+{
+    // Stands in for the terrain engine's tile load: builds the tile model.
+    class LoadTask : public TaskRequest
+    {
+    public:
+        LoadTask(const Map* map, TerrainTileModelFactory* factory, const TileKey& key) :
+            _map(map), _factory(factory), _key(key), _done(0)
+        {
+            _requested = osg::Timer::instance()->tick();
+        }
+
+        void operator()(ProgressCallback* progress)
+        {
+            MapFrame frame(_map.get());
+            osg::ref_ptr<TerrainTileModel> model = _factory->createTileModel(frame, _key, CreateTileModelFilter(), 0L, progress);
+            _done = osg::Timer::instance()->tick();
+        }
+
+        double latencyMS() const { return osg::Timer::instance()->delta_m(_requested, _done); }
+
+    private:
+        osg::ref_ptr<const Map>               _map;
+        osg::ref_ptr<TerrainTileModelFactory> _factory;
+        TileKey                               _key;
+        osg::Timer_t                          _requested, _done;
+    };
+
+    typedef std::map<TileKey, osg::ref_ptr<LoadTask> > Loads;
+
+    struct Settings
+    {
+        unsigned layers, latency, loaders, maxLOD;
+        double   speed, altitude, seconds, lookAhead, rangeFactor;
+    };
+
+    struct Result
+    {
+        unsigned frames, fullResFrames, tiles, prefetched, canceled;
+        double   meanLatency, maxLatency, settleMS;
+    };
+
+    Map* createMap(const Settings& s)
+    {
+        Map* map = new Map();
+        for(unsigned i=0; i<s.layers; ++i)
+        {
+            ImageLayerOptions options( Stringify() << "slow" << i );
+            options.cachePolicy() = CachePolicy::NO_CACHE;
+            options.driver()->L2CacheSize() = 4096;
+            map->addLayer( new ImageLayer(options, new Benchmark::SlowTileSource(s.latency)) );
+        }
+        return map;
+    }
+
+    // Start loading every tile in range that is not loaded or loading yet;
+    // returns true if all of them are loaded.
+    bool requestVisible(const std::set<TileKey>& visible, const Map* map, TerrainTileModelFactory* factory, TaskService* loaders, Loads& loads)
+    {
+        bool allLoaded = true;
+        for(std::set<TileKey>::const_iterator key = visible.begin(); key != visible.end(); ++key)
+        {
+            Loads::iterator i = loads.find(*key);
+            if (i == loads.end())
+            {
+                LoadTask* task = new LoadTask(map, factory, *key);
+                loads[*key] = task;
+                loaders->add(task);
+                allLoaded = false;
+            }
+            else if (!i->second->isCompleted())
+            {
+                allLoaded = false;
+            }
+        }
+        return allLoaded;
+    }
+
+    // Flies east along the equator at a fixed altitude, loading tiles as they come
+    // into range (as the engine would), then stops and waits for full resolution.
+    Result fly(const Settings& s, bool usePrefetch)
+    {
+        osg::ref_ptr<Map> map = createMap(s);
+        TerrainOptions terrainOptions;
+        osg::ref_ptr<TerrainTileModelFactory> factory = new TerrainTileModelFactory(terrainOptions);
+        osg::ref_ptr<TaskService> loaders = new TaskService("benchmark loader", s.loaders);
+
+        // same LOD ranges the rex engine derives from min_tile_range_factor:
+        const Profile* profile = map->getProfile();
+        std::vector<double> ranges;
+        for(unsigned lod=0; lod<=s.maxLOD; ++lod)
+            ranges.push_back( TileKey(lod, 0, 0, profile).getExtent().getBoundingGeoCircle().getRadius() * s.rangeFactor * 2.0 );
+
+        osg::ref_ptr<TilePrefetcher> prefetcher = new TilePrefetcher(map.get(), terrainOptions);
+        prefetcher->setRanges(ranges);
+        prefetcher->setLookAhead(s.lookAhead);
+
+        const SpatialReference* wgs84 = profile->getSRS();
+        double metersPerDegree = 111319.5;
+
+        Result r;
+        r.frames = r.fullResFrames = 0;
+
+        Loads loads;
+        std::set<TileKey> visible;
+        osg::Vec3d eye;
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        double t;
+
+        while( (t = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick())) < s.seconds )
+        {
+            GeoPoint(wgs84, s.speed*t/metersPerDegree, 0.0, s.altitude, ALTMODE_ABSOLUTE).toWorld(eye);
+
+            visible.clear();
+            prefetcher->selectKeys(eye, 0L, visible);
+
+            if (requestVisible(visible, map.get(), factory.get(), loaders.get(), loads))
+                r.fullResFrames++;
+            r.frames++;
+
+            if (usePrefetch)
+                prefetcher->update(eye, t);
+
+            OpenThreads::Thread::microSleep(16000);
+        }
+
+        // camera stops; how long until everything in view is loaded?
+        osg::Timer_t stop = osg::Timer::instance()->tick();
+        prefetcher->cancelAll();
+        while( !requestVisible(visible, map.get(), factory.get(), loaders.get(), loads) &&
+               osg::Timer::instance()->delta_s(stop, osg::Timer::instance()->tick()) < 60.0 )
+        {
+            OpenThreads::Thread::microSleep(5000);
+        }
+        r.settleMS = osg::Timer::instance()->delta_m(stop, osg::Timer::instance()->tick());
+
+        r.tiles = 0;
+        r.meanLatency = r.maxLatency = 0.0;
+        for(Loads::const_iterator i = loads.begin(); i != loads.end(); ++i)
+        {
+            if (i->second->isCompleted() && !i->second->wasCanceled())
+            {
+                double ms = i->second->latencyMS();
+                r.meanLatency += ms;
+                r.maxLatency = osg::maximum(r.maxLatency, ms);
+                r.tiles++;
+            }
+        }
+        if (r.tiles > 0)
+            r.meanLatency /= (double)r.tiles;
+
+        r.prefetched = prefetcher->getNumCompleted();
+        r.canceled = prefetcher->getNumCanceled();
+
+        loaders->cancelAll();
+        return r;
+    }
+
+    void report(const char* name, const Result& r)
+    {
+        std::cout << std::fixed << std::setprecision(1)
+            << "  " << std::left << std::setw(10) << name << std::right
+            << std::setw(8)  << r.frames
+            << std::setw(11) << (r.frames > 0 ? 100.0*(double)r.fullResFrames/(double)r.frames : 0.0)
+            << std::setw(8)  << r.tiles
+            << std::setw(12) << r.meanLatency
+            << std::setw(12) << r.maxLatency
+            << std::setw(11) << r.settleMS
+            << std::setw(12) << r.prefetched
+            << std::setw(10) << r.canceled << "\n";
+    }
+}
+
+int
+Benchmark::prefetch(osg::ArgumentParser& args)
+{
+    Settings s;
+    s.layers = 2;       args.read("--layers", s.layers);
+    s.latency = 20;     args.read("--latency", s.latency);
+    s.loaders = 4;      args.read("--loaders", s.loaders);
+    s.maxLOD = 10;      args.read("--maxlod", s.maxLOD);
+    s.speed = 5000.0;   args.read("--speed", s.speed);
+    s.altitude = 5000.0; args.read("--altitude", s.altitude);
+    s.seconds = 10.0;   args.read("--seconds", s.seconds);
+    s.lookAhead = 2.0;  args.read("--lookahead", s.lookAhead);
+    s.rangeFactor = 2.0; args.read("--range-factor", s.rangeFactor);
+
+    std::cout << "\nTilePrefetcher test: " << s.seconds << " s flight at " << s.speed << " m/s, "
+        << s.altitude << " m altitude, LOD 0-" << s.maxLOD << ", "
+        << s.layers << " layers x " << s.latency << " ms, " << s.loaders << " loader threads, "
+        << s.lookAhead << " s look-ahead\n"
+        << "  " << std::left << std::setw(10) << "mode" << std::right
+        << std::setw(8)  << "frames"
+        << std::setw(11) << "full-res %"
+        << std::setw(8)  << "tiles"
+        << std::setw(12) << "mean ms"
+        << std::setw(12) << "max ms"
+        << std::setw(11) << "settle ms"
+        << std::setw(12) << "prefetched"
+        << std::setw(10) << "canceled" << "\n";
+
+    report("off", fly(s, false));
+    report("prefetch", fly(s, true));
+
+    std::cout << "  (latency = time from a tile coming into range until its data is loaded)\n" << std::flush;
+    return 0;
+}
@@ -0,0 +1,132 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include "Benchmark"
+#include <osgEarth/SpatialReference>
+#include <osgEarth/AnalyticTransform>
+#include <osgEarth/Random>
+#include <iostream>
+#include <iomanip>
+
+using namespace osgEarth;
+
+namespace
+{
+    struct Case
+    {
+        const char* name;
+        const char* from;
+        const char* to;
+        double      xmin, ymin, xmax, ymax;  // input range, in "from" units
+    };
+
+    const Case s_cases[] = {
+        { "wgs84 -> utm33n",   "wgs84", "+proj=utm +zone=33 +datum=WGS84",   12.0, -80.0, 18.0, 84.0 },
+        { "utm33n -> wgs84",   "+proj=utm +zone=33 +datum=WGS84", "wgs84",   200000.0, 0.0, 800000.0, 9000000.0 },
+        { "wgs84 -> tmerc",    "wgs84", "+proj=tmerc +lon_0=9 +lat_0=45 +k=0.9996 +datum=WGS84", 0.0, 35.0, 18.0, 55.0 },
+        { "wgs84 -> merc",     "wgs84", "+proj=merc +datum=WGS84",           -180.0, -85.0, 180.0, 85.0 },
+        { "merc -> wgs84",     "+proj=merc +datum=WGS84", "wgs84",           -2.0e7, -1.9e7, 2.0e7, 1.9e7 },
+        { "wgs84 -> eqc",      "wgs84", "+proj=eqc +datum=WGS84",            -180.0, -90.0, 180.0, 90.0 },
+        { "wgs84 -> ecef",     "wgs84", "",                                  -180.0, -90.0, 180.0, 90.0 },
+        { 0L, 0L, 0L, 0, 0, 0, 0 }
+    };
+
+    // points per second through SpatialReference::transform
+    double rate(const SpatialReference* from, const SpatialReference* to,
+                const std::vector<osg::Vec3d>& input, unsigned batch, std::vector<osg::Vec3d>& output)
+    {
+        output = input;
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        for(unsigned i=0; i<output.size(); i += batch)
+        {
+            unsigned n = osg::minimum(batch, (unsigned)output.size()-i);
+            std::vector<osg::Vec3d> chunk(output.begin()+i, output.begin()+i+n);
+            from->transform(chunk, to);
+            std::copy(chunk.begin(), chunk.end(), output.begin()+i);
+        }
+        double seconds = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+        return (double)output.size() / seconds;
+    }
+}
+
+int
+Benchmark::srsTransforms(osg::ArgumentParser& args)
+{
+    unsigned points = 1000000;
+    args.read("--points", points);
+
+    unsigned batch = 1024;
+    args.read("--batch", batch);
+
+    std::cout << "\nSpatialReference::transform, analytic vs. OGR ("
+        << points << " points, batches of " << batch << ")\n"
+        << std::setw(18) << "pair"
+        << std::setw(14) << "OGR Mpts/s"
+        << std::setw(16) << "analytic Mpts/s"
+        << std::setw(10) << "speedup"
+        << std::setw(14) << "max diff" << "\n";
+
+    Random prng(1234);
+
+    for(const Case* c = s_cases; c->name; ++c)
+    {
+        osg::ref_ptr<const SpatialReference> from = SpatialReference::create(c->from);
+        osg::ref_ptr<const SpatialReference> to = *c->to ? SpatialReference::create(c->to) : from->getECEF();
+        if (!from.valid() || !to.valid())
+        {
+            std::cout << std::setw(18) << c->name << "  (SRS not available)\n";
+            continue;
+        }
+
+        std::vector<osg::Vec3d> input(points);
+        for(unsigned i=0; i<points; ++i)
+        {
+            input[i].set(
+                c->xmin + prng.next()*(c->xmax - c->xmin),
+                c->ymin + prng.next()*(c->ymax - c->ymin),
+                prng.next()*1000.0);
+        }
+
+        std::vector<osg::Vec3d> ogrOut, fastOut;
+
+        AnalyticTransform::setEnabled(false);
+        double ogrRate = rate(from.get(), to.get(), input, batch, ogrOut);
+
+        AnalyticTransform::setEnabled(true);
+        double fastRate = rate(from.get(), to.get(), input, batch, fastOut);
+
+        double maxDiff = 0.0;
+        for(unsigned i=0; i<points; ++i)
+            maxDiff = osg::maximum(maxDiff, (ogrOut[i] - fastOut[i]).length());
+
+        std::cout << std::fixed
+            << std::setw(18) << c->name
+            << std::setprecision(2)
+            << std::setw(14) << ogrRate/1e6
+            << std::setw(16) << fastRate/1e6
+            << std::setw(9) << fastRate/ogrRate << "x"
+            << std::setw(14) << std::scientific << std::setprecision(2) << maxDiff << "\n";
+    }
+    std::cout << "(max diff is in output units: meters for projected/ECEF, degrees for geographic)\n" << std::flush;
+
+    return 0;
+}
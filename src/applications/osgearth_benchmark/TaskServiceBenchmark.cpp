@@ -0,0 +1,108 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include "Benchmark"
+#include <osgEarth/TaskService>
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+
+using namespace osgEarth;
+
+namespace
+{
+    // A small CPU-bound task, roughly the size of a cheap tile operation.
+    struct SpinTask : public TaskRequest
+    {
+        SpinTask(Threading::MultiEvent* done, unsigned work, float priority)
+            : TaskRequest(priority), _done(done), _work(work) { }
+
+        void operator()(ProgressCallback* progress)
+        {
+            double x = 0.0;
+            for(unsigned i=0; i<_work && !progress->isCanceled(); ++i)
+                x += std::sqrt((double)i);
+            _sink = x;
+            _done->notify();
+        }
+
+        Threading::MultiEvent* _done;
+        unsigned               _work;
+        volatile double        _sink;
+    };
+
+    double run(TaskService::Scheduler scheduler, unsigned numThreads, unsigned numTasks, unsigned work)
+    {
+        osg::ref_ptr<TaskService> service = new TaskService("benchmark", numThreads, 0, scheduler);
+
+        Threading::MultiEvent done(numTasks);
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+
+        for(unsigned i=0; i<numTasks; ++i)
+            service->add( new SpinTask(&done, work, (float)(i%3) - 1.0f) );
+
+        done.wait();
+
+        double seconds = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+        service->add( new PoisonPill() );
+        while(service->areThreadsRunning())
+            OpenThreads::Thread::microSleep(1000);
+
+        return (double)numTasks / seconds;
+    }
+}
+
+int
+Benchmark::taskService(osg::ArgumentParser& args)
+{
+    std::vector<unsigned> threadCounts = parseThreadCounts(args, 64u);
+
+    unsigned tasks = 200000;
+    args.read("--tasks", tasks);
+
+    unsigned work = 500;
+    args.read("--work", work);
+
+    std::cout << "\nTaskService throughput (" << tasks << " tasks, " << work << " iterations each)\n"
+        << std::setw(8) << "threads"
+        << std::setw(18) << "queue Ktasks/s"
+        << std::setw(18) << "stealing Ktasks/s"
+        << std::setw(10) << "speedup" << "\n";
+
+    for(unsigned t=0; t<threadCounts.size(); ++t)
+    {
+        unsigned n = threadCounts[t];
+        double queueRate = run(TaskService::SCHEDULER_PRIORITY_QUEUE, n, tasks, work) / 1000.0;
+        double stealRate = run(TaskService::SCHEDULER_WORK_STEALING, n, tasks, work) / 1000.0;
+
+        std::cout << std::fixed << std::setprecision(1)
+            << std::setw(8) << n
+            << std::setw(18) << queueRate
+            << std::setw(18) << stealRate
+            << std::setw(9) << std::setprecision(2) << stealRate/queueRate << "x\n";
+    }
+    std::cout << std::flush;
+
+    return 0;
+}
@@ -0,0 +1,163 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include "Benchmark"
+#include <osgEarth/TileKey>
+#include <osgEarth/Profile>
+#include <osgEarth/Containers>
+#include <osgEarth/Random>
+#include <iostream>
+#include <iomanip>
+#include <map>
+
+using namespace osgEarth;
+
+namespace
+{
+    // Random keys at the given LOD of the profile.
+    void makeKeys(unsigned count, unsigned lod, const Profile* profile, Random& prng, std::vector<TileKey>& keys)
+    {
+        unsigned tx, ty;
+        profile->getNumTiles(lod, tx, ty);
+        keys.clear();
+        keys.reserve(count);
+        for(unsigned i=0; i<count; ++i)
+            keys.push_back( TileKey(lod, prng.next(tx), prng.next(ty), profile) );
+    }
+
+    void report(const char* name, unsigned ops, double ms, unsigned checksum)
+    {
+        std::cout << std::fixed << std::setprecision(3)
+            << "  " << std::left << std::setw(34) << name << std::right
+            << std::setw(10) << ms << " ms"
+            << std::setw(10) << std::setprecision(1) << (ms > 0.0 ? ((double)ops/ms)/1000.0 : 0.0) << " M/s"
+            << "   (" << checksum << ")\n";
+    }
+}
+
+int
+Benchmark::tileKeys(osg::ArgumentParser& args)
+{
+    unsigned count = 500000;
+    args.read("--keys", count);
+
+    unsigned lod = 14;
+    args.read("--lod", lod);
+
+    osg::ref_ptr<const Profile> profile = Profile::create("global-geodetic");
+    if ( !profile.valid() )
+    {
+        OE_WARN << "Failed to create the global-geodetic profile" << std::endl;
+        return -1;
+    }
+
+    std::cout << "\nTileKey test, " << count << " keys at LOD " << lod
+        << " (throughput in millions of operations per second)\n";
+
+    Random prng(1234);
+    std::vector<TileKey> keys;
+    unsigned checksum = 0;
+
+    // key creation:
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    makeKeys(count, lod, profile.get(), prng, keys);
+    report("create", count, osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()), keys.size());
+
+    // parent and child keys:
+    checksum = 0;
+    start = osg::Timer::instance()->tick();
+    for(unsigned i=0; i<keys.size(); ++i)
+        checksum += keys[i].createParentKey().getTileX();
+    report("createParentKey", count, osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()), checksum);
+
+    checksum = 0;
+    start = osg::Timer::instance()->tick();
+    for(unsigned i=0; i<keys.size(); ++i)
+        checksum += keys[i].createChildKey(i&3).getTileY();
+    report("createChildKey", count, osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()), checksum);
+
+    checksum = 0;
+    start = osg::Timer::instance()->tick();
+    for(unsigned i=0; i<keys.size(); ++i)
+        checksum += keys[i].str().size();
+    report("str", count, osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()), checksum);
+
+    // lookups; half the probes are fresh random keys (mostly misses).
+    std::vector<TileKey> probes;
+    makeKeys(count/2, lod, profile.get(), prng, probes);
+    for(unsigned i=0; i<count/2; ++i)
+        probes.push_back( keys[prng.next(keys.size())] );
+
+    {
+        std::map<TileKey, unsigned> index;
+        for(unsigned i=0; i<keys.size(); ++i)
+            index[keys[i]] = i;
+
+        checksum = 0;
+        start = osg::Timer::instance()->tick();
+        for(unsigned i=0; i<probes.size(); ++i)
+            checksum += index.find(probes[i]) != index.end() ? 1u : 0u;
+        report("std::map<TileKey> find", probes.size(), osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()), checksum);
+    }
+
+    {
+        // what a string-keyed index costs, including building the string:
+        std::map<std::string, unsigned> index;
+        for(unsigned i=0; i<keys.size(); ++i)
+            index[keys[i].str()] = i;
+
+        checksum = 0;
+        start = osg::Timer::instance()->tick();
+        for(unsigned i=0; i<probes.size(); ++i)
+            checksum += index.find(probes[i].str()) != index.end() ? 1u : 0u;
+        report("std::map<string> find", probes.size(), osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()), checksum);
+    }
+
+    {
+        // open-addressed table on Hash<TileKey>, the same hash ConcurrentLRUCache uses:
+        unsigned buckets = 1;
+        while(buckets < keys.size()*2) buckets <<= 1;
+        std::vector<unsigned long long> table(buckets, ~0ULL);
+        Hash<TileKey> hasher;
+        for(unsigned i=0; i<keys.size(); ++i)
+        {
+            unsigned b = hasher(keys[i]) & (buckets-1);
+            while(table[b] != ~0ULL && table[b] != keys[i].getCode())
+                b = (b+1) & (buckets-1);
+            table[b] = keys[i].getCode();
+        }
+
+        checksum = 0;
+        start = osg::Timer::instance()->tick();
+        for(unsigned i=0; i<probes.size(); ++i)
+        {
+            unsigned b = hasher(probes[i]) & (buckets-1);
+            while(table[b] != ~0ULL && table[b] != probes[i].getCode())
+                b = (b+1) & (buckets-1);
+            checksum += table[b] == probes[i].getCode() ? 1u : 0u;
+        }
+        report("Hash<TileKey> table find", probes.size(), osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()), checksum);
+    }
+
+    std::cout << std::flush;
+    return 0;
+}
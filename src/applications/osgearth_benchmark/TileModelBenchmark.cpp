@@ -0,0 +1,117 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include "Benchmark"
+#include <osgEarth/Map>
+#include <osgEarth/MapFrame>
+#include <osgEarth/ImageLayer>
+#include <osgEarth/TerrainOptions>
+#include <osgEarth/TerrainTileModelFactory>
+#include <osgEarth/Registry>
+#include <osgEarth/StringUtils>
+#include <iostream>
+#include <iomanip>
+
+using namespace osgEarth;
+
+namespace
+{
+    // Builds every tile and returns the average milliseconds per tile.
+    double run(TerrainTileModelFactory* factory, const MapFrame& frame, const std::vector<TileKey>& keys,
+               const ImageLayerVector& layers, bool& orderOK)
+    {
+        orderOK = true;
+        CreateTileModelFilter filter;
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        for(unsigned k=0; k<keys.size(); ++k)
+        {
+            osg::ref_ptr<ProgressCallback> progress = new ProgressCallback();
+            osg::ref_ptr<TerrainTileModel> model = factory->createTileModel(frame, keys[k], filter, 0L, progress.get());
+
+            if (!model.valid() || model->colorLayers().size() != layers.size())
+            {
+                orderOK = false;
+                continue;
+            }
+            for(unsigned i=0; i<layers.size(); ++i)
+                if (model->colorLayers()[i]->getImageLayer() != layers[i].get())
+                    orderOK = false;
+        }
+        return osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()) / (double)keys.size();
+    }
+}
+
+int
+Benchmark::tileModel(osg::ArgumentParser& args)
+{
+    unsigned numLayers = 8;
+    args.read("--layers", numLayers);
+
+    unsigned latency = 20;
+    args.read("--latency", latency);
+
+    unsigned lod = 3;
+    args.read("--lod", lod);
+
+    osg::ref_ptr<Map> map = new Map();
+    for(unsigned i=0; i<numLayers; ++i)
+    {
+        ImageLayerOptions options( Stringify() << "slow" << i );
+        options.cachePolicy() = CachePolicy::NO_CACHE;
+        map->addLayer( new ImageLayer(options, new Benchmark::SlowTileSource(latency)) );
+    }
+
+    MapFrame frame(map.get());
+    ImageLayerVector layers;
+    frame.getLayers(layers);
+
+    // one quadrant of tiles at the requested LOD
+    const Profile* profile = Registry::instance()->getGlobalGeodeticProfile();
+    std::vector<TileKey> keys;
+    unsigned cols, rows;
+    profile->getNumTiles(lod, cols, rows);
+    for(unsigned y=0; y<osg::minimum(rows, 4u); ++y)
+        for(unsigned x=0; x<osg::minimum(cols, 4u); ++x)
+            keys.push_back( TileKey(lod, x, y, profile) );
+
+    std::cout << "\nTerrainTileModelFactory::createTileModel, serial vs. parallel layer fetch ("
+        << numLayers << " layers, " << latency << " ms per fetch, " << keys.size() << " tiles)\n";
+
+    TerrainOptions serialOptions;
+    osg::ref_ptr<TerrainTileModelFactory> serial = new TerrainTileModelFactory(serialOptions);
+    bool serialOK;
+    double serialMS = run(serial.get(), frame, keys, layers, serialOK);
+
+    TerrainOptions parallelOptions;
+    parallelOptions.parallelLayerFetch() = true;
+    osg::ref_ptr<TerrainTileModelFactory> parallel = new TerrainTileModelFactory(parallelOptions);
+    bool parallelOK;
+    double parallelMS = run(parallel.get(), frame, keys, layers, parallelOK);
+
+    std::cout << std::fixed << std::setprecision(1)
+        << "    serial:   " << std::setw(8) << serialMS << " ms/tile" << (serialOK ? "" : "  (LAYER MISMATCH)") << "\n"
+        << "    parallel: " << std::setw(8) << parallelMS << " ms/tile" << (parallelOK ? "" : "  (LAYER MISMATCH)") << "\n"
+        << "    speedup:  " << std::setw(8) << serialMS/parallelMS << "x\n" << std::flush;
+
+    return 0;
+}
@@ -0,0 +1,91 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include "Benchmark"
+#include <osgEarth/Registry>
+#include <iostream>
+
+#define LC "[benchmark] "
+
+using namespace osgEarth;
+
+namespace
+{
+    typedef int (*BenchmarkFunc)(osg::ArgumentParser&);
+
+    struct Entry {
+        const char*   name;
+        BenchmarkFunc func;
+        const char*   description;
+    };
+
+    const Entry s_benchmarks[] = {
+        { "lru",   Benchmark::lruCache,    "LRUCache vs. ConcurrentLRUCache thread scaling" },
+        { "tasks", Benchmark::taskService, "TaskService priority queue vs. work stealing, 1-64 threads" },
+        { "srs",   Benchmark::srsTransforms, "SpatialReference analytic transforms vs. OGR, points per second" },
+        { "declutter", Benchmark::declutter, "ScreenSpaceLayout declutter grid vs. brute force, 1k/10k/50k leaves" },
+        { "tilemodel", Benchmark::tileModel, "TerrainTileModelFactory serial vs. parallel layer fetch over slow sources" },
+        { "tilekey", Benchmark::tileKeys, "TileKey creation, parent/child keys and map vs. hash lookups" },
+        { "prefetch", Benchmark::prefetch, "Time to full resolution along a camera path, with and without TilePrefetcher" },
+        { "flattening", Benchmark::flattening, "FlatteningLayer tile time over 1k/10k/100k-segment synthetic road networks" },
+        { "cacherecords", Benchmark::cacheRecords, "LevelDB/RocksDB read latency and size on disk, osgb vs. raw single-record layout" },
+        { 0L, 0L, 0L }
+    };
+
+    int usage(const char* name)
+    {
+        std::cout
+            << "\nUsage: " << name << " <benchmark> [options]\n"
+            << "\nBenchmarks:\n";
+
+        for(const Entry* e = s_benchmarks; e->name; ++e)
+            std::cout << "    " << e->name << "\t" << e->description << "\n";
+
+        std::cout
+            << "\nCommon options:\n"
+            << "    --threads a,b,c  \tThread counts to test (default 1,2,4,...)\n"
+            << std::endl;
+        return 0;
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser args(&argc, argv);
+
+    if (argc < 2 || args.read("--help"))
+        return usage(argv[0]);
+
+    std::string name(argv[1]);
+    for(const Entry* e = s_benchmarks; e->name; ++e)
+    {
+        if (name == e->name)
+        {
+            args.remove(1);
+            return e->func(args);
+        }
+    }
+
+    OE_WARN << LC << "Unknown benchmark \"" << name << "\"" << std::endl;
+    return usage(argv[0]);
+}
@@ -28,11 +28,25 @@
 #include <osgEarth/TileVisitor>
 #include <osgEarth/ImageLayer>
 #include <osgEarth/ElevationLayer>
+#include <osgEarth/CacheEstimator>
+#include <osgEarth/EncodedImage>
+#include <osgEarth/ImageUtils>
+#include <osgEarth/StringUtils>
+#include <osgEarth/TaskService>
+#include <osgEarth/ThreadingUtils>
 #include <osg/ArgumentParser>
 #include <osg/Timer>
+#include <osgDB/FileUtils>
+#include <osgDB/Registry>
+#include <OpenThreads/Condition>
+#include <OpenThreads/Thread>
 #include <iomanip>
 #include <algorithm>
 #include <iterator>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <set>
 
 using namespace osgEarth;
 
@@ -50,31 +64,71 @@ int usage(char** argv)
         << "\n    --max-level [int]                   : maximum level of detail"
         << "\n    --osg-options [OSG options string]  : options to pass to OSG readers/writers"
         << "\n    --extents [minLat] [minLong] [maxLat] [maxLong] : Lat/Long extends to copy"
+        << "\n    --no-passthrough                    : always decode and re-encode image tiles"
+        << "\n    --threads [n]                       : number of threads reading tiles (default = 1)"
+        << "\n    --queue-size [n]                    : max number of tiles in flight (default = 256)"
+        << "\n    --checkpoint [file]                 : record converted tiles in a file, and skip the"
+        << "\n                                          tiles it already lists (to resume a conversion)"
+        << "\n    --order [depth|morton|hilbert]      : order in which to visit the tiles (default = depth)"
         << std::endl;
 
     return 0;
 }
 
 
-// TileHandler that copies images from an ImageLayer to a TileSource.
-// This will automatically handle any mosaicing and reprojection that is
-// necessary to translate from one Profile/SRS to another.
-struct ImageLayerToTileSource : public TileHandler
+// One tile on its way from a read worker to the writer.
+struct ConvertedTile : public osg::Referenced
 {
-    ImageLayerToTileSource(ImageLayer* source, TileSource* dest)
-        : _source(source), _dest(dest)
+    TileKey                        _key;
+    osg::ref_ptr<EncodedImage>     _encoded;
+    osg::ref_ptr<osg::Image>       _image;
+    osg::ref_ptr<osg::HeightField> _heightField;
+
+    bool empty() const { return !_encoded.valid() && !_image.valid() && !_heightField.valid(); }
+};
+
+
+// Reads tiles from the input for the conversion pipeline. read() runs on
+// several worker threads at once, so it must never touch the output.
+struct TileReader : public osg::Referenced
+{
+    virtual void read(ConvertedTile& tile) = 0;
+
+    virtual bool hasData(const TileKey& key) const = 0;
+};
+
+
+// Reads images from an ImageLayer. This will automatically handle any
+// mosaicing and reprojection that is necessary to translate from one
+// Profile/SRS to another.
+//
+// When the input delivers encoded tiles and no reprojection is needed, the
+// encoded bytes are forwarded as is; they are only decoded (and re-encoded)
+// if the output stores a different format.
+struct ImageLayerReader : public TileReader
+{
+    ImageLayerReader(ImageLayer* source, const std::string& destFormat, bool passthrough)
+        : _source(source), _destFormat(destFormat), _passthrough(passthrough)
     {
         //nop
     }
 
-    bool handleTile(const TileKey& key, const TileVisitor& tv)
+    void read(ConvertedTile& tile)
     {
-        bool ok = false;
-        GeoImage image = _source->createImage(key);
-        if (image.valid())
-            ok = _dest->storeImage(key, image.getImage(), 0L);
+        if (_passthrough && _source->canCreateEncodedImage(tile._key))
+        {
+            tile._encoded = _source->createEncodedImage(tile._key, 0L);
+            if (tile._encoded.valid() && !tile._encoded->isFormat(_destFormat))
+            {
+                tile._image = tile._encoded->decode(_source->getReadOptions());
+                tile._encoded = 0L;
+            }
+            return;
+        }
 
-        return ok;
+        GeoImage image = _source->createImage(tile._key);
+        if (image.valid())
+            tile._image = image.getImage();
     }
 
     bool hasData(const TileKey& key) const
@@ -83,28 +137,27 @@ struct ImageLayerToTileSource : public TileHandler
     }
 
     osg::ref_ptr<ImageLayer> _source;
-    TileSource*              _dest;
+    std::string              _destFormat;
+    bool                     _passthrough;
 };
 
 
-// TileHandler that copies images from an ElevationLayer to a TileSource.
-// This will automatically handle any mosaicing and reprojection that is
-// necessary to translate from one Profile/SRS to another.
-struct ElevationLayerToTileSource : public TileHandler
+// Reads heightfields from an ElevationLayer. This will automatically handle
+// any mosaicing and reprojection that is necessary to translate from one
+// Profile/SRS to another.
+struct ElevationLayerReader : public TileReader
 {
-    ElevationLayerToTileSource(ElevationLayer* source, TileSource* dest)
-        : _source(source), _dest(dest)
+    ElevationLayerReader(ElevationLayer* source)
+        : _source(source)
     {
         //nop
     }
 
-    bool handleTile(const TileKey& key, const TileVisitor& tv)
+    void read(ConvertedTile& tile)
     {
-        bool ok = false;
-        GeoHeightField hf = _source->createHeightField(key, 0L);
-        if ( hf.valid() )
-            ok = _dest->storeHeightField(key, hf.getHeightField(), 0L);
-        return ok;
+        GeoHeightField hf = _source->createHeightField(tile._key, 0L);
+        if (hf.valid())
+            tile._heightField = hf.getHeightField();
     }
 
     bool hasData(const TileKey& key) const
@@ -113,39 +166,381 @@ struct ElevationLayerToTileSource : public TileHandler
     }
 
     osg::ref_ptr<ElevationLayer> _source;
-    TileSource*                  _dest;
 };
 
 
-// Custom progress reporter
-struct ProgressReporter : public osgEarth::ProgressCallback
+// Converts tiles in two stages. Worker threads read (and, for images,
+// encode) tiles in parallel; a single writer thread stores them in the
+// output in the order they were submitted, since output drivers are not
+// safe to write from several threads. At most "queueSize" tiles are in
+// flight at once; submit() blocks until the writer catches up.
+//
+// With a checkpoint file, every tile the writer completes is appended to it
+// (after the output has committed it), and tiles already listed there are
+// skipped, so an interrupted conversion can be resumed.
+class ConversionPipeline : public osg::Referenced
 {
-    bool reportProgress(double             current,
-                        double             total,
-                        unsigned           currentStage,
-                        unsigned           totalStages,
-                        const std::string& msg )
+public:
+    ConversionPipeline(TileReader* reader, TileSource* dest, const osgDB::Options* writeOptions,
+                       unsigned numWorkers, unsigned queueSize) :
+    _reader      ( reader ),
+    _dest        ( dest ),
+    _writeOptions( writeOptions ),
+    _encode      ( 0u ),
+    _queueSize   ( std::max(queueSize, 1u) ),
+    _nextSeq     ( 0u ),
+    _nextToWrite ( 0u ),
+    _finished    ( false ),
+    _total       ( 0u ),
+    _written     ( 0u ),
+    _empty       ( 0u ),
+    _failed      ( 0u ),
+    _skipped     ( 0u )
     {
-        _mutex.lock();
+        _format = toLower(dest->getExtension());
+        if (_format == "jpeg")
+            _format = "jpg";
+
+        // pre-encode images on the workers when the output stores encoded tiles.
+        _rw = osgDB::Registry::instance()->getReaderWriterForMimeType(_format);
+        if (!_rw.valid())
+            _rw = osgDB::Registry::instance()->getReaderWriterForExtension(_format);
+        _encode.exchange(_rw.valid() ? 1u : 0u);
+
+        _tasks = new TaskService("osgearth_conv", std::max(numWorkers, 1u));
+        _writer = new WriterThread(this);
+    }
 
-        float percentage = current/total*100.0f;
-        std::cout
-            << std::fixed
-            << std::setprecision(1) << "\r"
-            << (int)current << "/" << (int)total
-            << " (" << percentage << "%)"
-            << "                        "
-            << std::flush;
-
-        if ( percentage >= 100.0f )
+    // Loads the tiles completed by a previous run and opens the
+    // checkpoint file to append the tiles this run completes.
+    bool openCheckpoint(const std::string& filename, const Profile* profile)
+    {
+        if (osgDB::fileExists(filename))
+        {
+            TaskList completed(profile);
+            completed.load(filename);
+            _completed.insert(completed.getKeys().begin(), completed.getKeys().end());
+            OE_NOTICE << LC << "Resuming; " << _completed.size() << " tiles already converted" << std::endl;
+        }
+
+        _checkpoint.open(filename.c_str(), std::ios::out | std::ios::app);
+        return _checkpoint.is_open();
+    }
+
+    // Total number of tiles, for progress reporting.
+    void setTotal(unsigned total) { _total = total; }
+
+    void start()
+    {
+        _t0 = osg::Timer::instance()->tick();
+        _lastReport = _t0;
+        _lastCheckpoint = _t0;
+        _writer->start();
+    }
+
+    // Queues a tile for conversion. Call from one thread, in the order
+    // tiles should be written.
+    void submit(const TileKey& key)
+    {
+        if (_completed.find(key) != _completed.end())
+        {
+            ++_skipped;
+            return;
+        }
+
+        unsigned seq;
+        {
+            Threading::ScopedMutexLock lock(_mutex);
+            while (_nextSeq - _nextToWrite >= _queueSize)
+                _notFull.wait(&_mutex);
+            seq = _nextSeq++;
+        }
+
+        _tasks->add(new ReadTileTask(this, seq, key));
+    }
+
+    bool hasData(const TileKey& key) const
+    {
+        return _reader->hasData(key);
+    }
+
+    // Waits for every submitted tile to be written.
+    void finish()
+    {
+        {
+            Threading::ScopedMutexLock lock(_mutex);
+            _finished = true;
+            _ready.signal();
+        }
+        _writer->join();
+        _checkpoint.close();
+
+        if (_failed > 0u)
+        {
+            OE_WARN << LC << (unsigned)_failed << " tiles failed to convert" << std::endl;
+        }
+    }
+
+protected:
+    virtual ~ConversionPipeline()
+    {
+        delete _writer;
+    }
+
+    // Runs the read stage for one tile on a worker thread.
+    struct ReadTileTask : public TaskRequest
+    {
+        ReadTileTask(ConversionPipeline* pipeline, unsigned seq, const TileKey& key)
+            : _pipeline(pipeline), _seq(seq), _key(key) { }
+
+        void operator()(ProgressCallback* progress)
+        {
+            _pipeline->read(_seq, _key);
+        }
+
+        ConversionPipeline* _pipeline;
+        unsigned            _seq;
+        TileKey             _key;
+    };
+
+    struct WriterThread : public OpenThreads::Thread
+    {
+        WriterThread(ConversionPipeline* pipeline) : _pipeline(pipeline) { }
+
+        void run() { _pipeline->runWriter(); }
+
+        ConversionPipeline* _pipeline;
+    };
+
+    void read(unsigned seq, const TileKey& key)
+    {
+        osg::ref_ptr<ConvertedTile> tile = new ConvertedTile();
+        tile->_key = key;
+        _reader->read(*tile.get());
+
+        if (tile->_image.valid() && !tile->_encoded.valid() && _encode == 1u)
+            tile->_encoded = encode(tile->_image.get());
+
+        Threading::ScopedMutexLock lock(_mutex);
+        _done[seq] = tile.get();
+        if (seq == _nextToWrite)
+            _ready.signal();
+    }
+
+    EncodedImage* encode(const osg::Image* image) const
+    {
+        // JPEG cannot store an alpha channel.
+        osg::ref_ptr<const osg::Image> source = image;
+        if (_format == "jpg" && ImageUtils::hasAlphaChannel(image))
+            source = ImageUtils::convertToRGB8(image);
+
+        std::stringstream buf;
+        osgDB::ReaderWriter::WriteResult wr = _rw->writeImage(*source.get(), buf, _writeOptions.get());
+        if (!wr.success())
+            return 0L;
+
+        return new EncodedImage(buf.str());
+    }
+
+    void runWriter()
+    {
+        for(;;)
+        {
+            osg::ref_ptr<ConvertedTile> tile;
+            {
+                Threading::ScopedMutexLock lock(_mutex);
+                for(;;)
+                {
+                    std::map<unsigned, osg::ref_ptr<ConvertedTile> >::iterator i = _done.find(_nextToWrite);
+                    if (i != _done.end())
+                    {
+                        tile = i->second.get();
+                        _done.erase(i);
+                        break;
+                    }
+                    if (_finished && _nextToWrite == _nextSeq)
+                        break;
+                    _ready.wait(&_mutex);
+                }
+            }
+
+            if (!tile.valid())
+                break;
+
+            write(*tile.get());
+
+            {
+                Threading::ScopedMutexLock lock(_mutex);
+                ++_nextToWrite;
+                _notFull.signal();
+            }
+
+            osg::Timer_t now = osg::Timer::instance()->tick();
+            if (osg::Timer::instance()->delta_s(_lastCheckpoint, now) >= 10.0 || _pending.size() >= 1024u)
+                checkpoint();
+            if (osg::Timer::instance()->delta_s(_lastReport, now) >= 0.5)
+                report(false);
+        }
+
+        checkpoint();
+        report(true);
+    }
+
+    void write(ConvertedTile& tile)
+    {
+        if (tile.empty())
+        {
+            ++_empty;
+            _pending.push_back(tile._key);
+            return;
+        }
+
+        bool ok = false;
+
+        if (tile._encoded.valid())
+        {
+            ok = _dest->storeEncodedImage(tile._key, tile._encoded.get(), 0L);
+
+            if (!ok && tile._image.valid())
+            {
+                // the output won't take our encoding, so stop producing it.
+                _encode.exchange(0u);
+            }
+            else if (!ok && !tile._image.valid())
+            {
+                tile._image = tile._encoded->decode(_writeOptions.get());
+            }
+        }
+
+        if (!ok && tile._image.valid())
+            ok = _dest->storeImage(tile._key, tile._image.get(), 0L);
+
+        else if (!ok && tile._heightField.valid())
+            ok = _dest->storeHeightField(tile._key, tile._heightField.get(), 0L);
+
+        if (ok)
+        {
+            ++_written;
+            _pending.push_back(tile._key);
+        }
+        else
+        {
+            ++_failed;
+            OE_WARN << LC << "Failed to store tile " << tile._key.str() << std::endl;
+        }
+    }
+
+    // Records the completed tiles, once the output has committed them.
+    void checkpoint()
+    {
+        _lastCheckpoint = osg::Timer::instance()->tick();
+
+        if (!_checkpoint.is_open() || _pending.empty())
+        {
+            _pending.clear();
+            return;
+        }
+
+        if (!_dest->flush())
+        {
+            OE_WARN << LC << "Output failed to commit tiles; checkpoint not updated" << std::endl;
+            return;
+        }
+
+        for (TileKeyList::const_iterator i = _pending.begin(); i != _pending.end(); ++i)
+        {
+            _checkpoint << i->getLevelOfDetail() << ", " << i->getTileX() << ", " << i->getTileY() << "\n";
+        }
+        _checkpoint.flush();
+        _pending.clear();
+    }
+
+    void report(bool final)
+    {
+        _lastReport = osg::Timer::instance()->tick();
+
+        unsigned converted = _written + _empty + _failed;
+        unsigned processed = converted + _skipped;
+        double   seconds   = osg::Timer::instance()->delta_s(_t0, _lastReport);
+        double   rate      = seconds > 0.0 ? (double)converted / seconds : 0.0;
+
+        std::cout << std::fixed << std::setprecision(1) << "\r" << processed;
+        if (_total > 0u)
+            std::cout << "/" << _total << " (" << std::min(100.0, 100.0*(double)processed/(double)_total) << "%)";
+        std::cout << ", " << rate << " tiles/s";
+
+        if (!final && rate > 0.0 && _total > processed)
+        {
+            unsigned eta = (unsigned)((double)(_total - processed) / rate);
+            std::cout << ", ETA "
+                << eta/3600u << ":"
+                << std::setfill('0') << std::setw(2) << (eta/60u)%60u << ":"
+                << std::setw(2) << eta%60u << std::setfill(' ');
+        }
+
+        std::cout << "                " << std::flush;
+
+        if (final)
             std::cout << std::endl;
+    }
+
+    osg::ref_ptr<TileReader>             _reader;
+    TileSource*                          _dest;
+    osg::ref_ptr<const osgDB::Options>   _writeOptions;
+    std::string                          _format;
+    osg::ref_ptr<osgDB::ReaderWriter>    _rw;
+    OpenThreads::Atomic                  _encode;
+
+    osg::ref_ptr<TaskService>            _tasks;
+    WriterThread*                        _writer;
+
+    // reorder buffer; guarded by _mutex
+    Threading::Mutex                     _mutex;
+    OpenThreads::Condition               _ready;
+    OpenThreads::Condition               _notFull;
+    std::map<unsigned, osg::ref_ptr<ConvertedTile> > _done;
+    unsigned                             _queueSize;
+    unsigned                             _nextSeq;
+    unsigned                             _nextToWrite;
+    bool                                 _finished;
+
+    // checkpointing; the completed set is only read by the submitting thread
+    std::set<TileKey>                    _completed;
+    std::ofstream                        _checkpoint;
+    TileKeyList                          _pending;
+    osg::Timer_t                         _lastCheckpoint;
+
+    // progress
+    unsigned                             _total;
+    OpenThreads::Atomic                  _written, _empty, _failed, _skipped;
+    osg::Timer_t                         _t0, _lastReport;
+};
 
-        _mutex.unlock();
 
-        return false;
+// TileHandler that feeds the visited tiles to a ConversionPipeline.
+struct PipelineTileHandler : public TileHandler
+{
+    PipelineTileHandler(ConversionPipeline* pipeline)
+        : _pipeline(pipeline)
+    {
+        //nop
+    }
+
+    bool handleTile(const TileKey& key, const TileVisitor& tv)
+    {
+        _pipeline->submit(key);
+
+        // the tile is read later, so there is no telling yet whether it
+        // has data; always visit the children.
+        return true;
+    }
+
+    bool hasData(const TileKey& key) const
+    {
+        return _pipeline->hasData(key);
     }
 
-    Threading::Mutex _mutex;
+    osg::ref_ptr<ConversionPipeline> _pipeline;
 };
 
 
@@ -173,7 +568,15 @@ struct ProgressReporter : public osgEarth::ProgressCallback
  *      --profile [profile]   : reproject to the target profile, e.g. "wgs84"
  *      --min-level [int]     : min level of detail to copy
  *      --max-level [int]     : max level of detail to copy
- *      --threads [n]         : threads to use (may crash. Careful.)
+ *      --threads [n]         : number of threads reading tiles; a single
+ *                              thread writes them, in order
+ *      --queue-size [n]      : max number of tiles read but not yet written
+ *      --checkpoint [file]   : append each converted tile to a file, and skip
+ *                              the tiles it already lists (resumes a conversion)
+ *      --order [order]       : "depth" (default), or "morton"/"hilbert" to
+ *                              convert one level at a time, neighbours together
+ *      --no-passthrough      : decode and re-encode image tiles even when the
+ *                              input's encoded tiles could be copied as is
  *
  *      --extents [minLat] [minLong] [maxLat] [maxLong] : Lat/Long extends to copy (*)
  *
@@ -296,20 +699,8 @@ main(int argc, char** argv)
         << outConf.toJSON(true)
         << std::endl;
 
-    // create the visitor.
-    osg::ref_ptr<TileVisitor> visitor;
-
-    unsigned numThreads = 1;
-    if (args.read("--threads", numThreads))
-    {
-        MultithreadedTileVisitor* mtv = new MultithreadedTileVisitor();
-        mtv->setNumThreads( numThreads < 1 ? 1 : numThreads );
-        visitor = mtv;
-    }
-    else
-    {
-        visitor = new TileVisitor();
-    }
+    // create the reader for the input layer.
+    osg::ref_ptr<TileReader> reader;
 
     if (heightFields)
     {
@@ -325,7 +716,7 @@ main(int argc, char** argv)
             OE_WARN << LC << "Input profile is not valid" << std::endl;
             return -1;
         }
-        visitor->setTileHandler( new ElevationLayerToTileSource(layer, output.get()) );
+        reader = new ElevationLayerReader(layer);
     }
 
     else // image layers
@@ -342,7 +733,44 @@ main(int argc, char** argv)
             OE_WARN << LC << "Input profile is not valid" << std::endl;
             return -1;
         }
-        visitor->setTileHandler( new ImageLayerToTileSource(layer, output.get()) );
+        bool passthrough = !args.read("--no-passthrough");
+        reader = new ImageLayerReader(layer, output->getExtension(), passthrough);
+    }
+
+    // The visitor runs on this thread and feeds the pipeline, which reads
+    // tiles on worker threads and writes them on a single writer thread.
+    unsigned numThreads = 1;
+    args.read("--threads", numThreads);
+
+    unsigned queueSize = 256;
+    args.read("--queue-size", queueSize);
+
+    osg::ref_ptr<ConversionPipeline> pipeline = new ConversionPipeline(
+        reader.get(), output.get(), dbo.get(), numThreads, queueSize);
+
+    std::string checkpoint;
+    if ( args.read("--checkpoint", checkpoint) )
+    {
+        if ( !pipeline->openCheckpoint(checkpoint, outputProfile.get()) )
+        {
+            OE_WARN << LC << "Failed to open checkpoint file " << checkpoint << std::endl;
+            return -1;
+        }
+    }
+
+    osg::ref_ptr<TileVisitor> visitor = new TileVisitor();
+    visitor->setTileHandler( new PipelineTileHandler(pipeline.get()) );
+
+    std::string order;
+    if ( args.read("--order", order) )
+    {
+        TileVisitor::TraversalOrder traversalOrder;
+        if ( !TileVisitor::parseTraversalOrder(order, traversalOrder) )
+        {
+            OE_WARN << LC << "Unknown traversal order \"" << order << "\"" << std::endl;
+            return -1;
+        }
+        visitor->setTraversalOrder( traversalOrder );
     }
 
     // Set the level limits:
@@ -386,14 +814,23 @@ main(int argc, char** argv)
         visitor->addExtent( extent );
     }
 
+    // estimate the number of tiles for progress reporting:
+    CacheEstimator est;
+    est.setMinLevel( visitor->getMinLevel() );
+    est.setMaxLevel( visitor->getMaxLevel() );
+    est.setProfile( outputProfile.get() );
+    for (unsigned i = 0; i < visitor->getExtents().size(); ++i)
+        est.addExtent( visitor->getExtents()[i] );
+    pipeline->setTotal( est.getNumTiles() );
+
     // Ready!!!
     std::cout << "Working..." << std::endl;
 
-    visitor->setProgressCallback( new ProgressReporter() );
-
     osg::Timer_t t0 = osg::Timer::instance()->tick();
 
+    pipeline->start();
     visitor->run( outputProfile.get() );
+    pipeline->finish();
 
     osg::Timer_t t1 = osg::Timer::instance()->tick();
 
@@ -404,5 +841,18 @@ main(int argc, char** argv)
         << osg::Timer::instance()->delta_s(t0, t1)
         << " seconds." << std::endl;
 
+    // tiles read through the input's L2 cache (reprojection reads each
+    // source tile several times, so traversal order matters here):
+    TileSource::ReadStats readStats = input->getReadStats();
+    if ( readStats._reads > 0 )
+    {
+        std::cout
+            << "Source reads = " << readStats._reads
+            << ", L2 cache hits = " << readStats._memCacheHits
+            << " (" << std::fixed << std::setprecision(1)
+            << 100.0*(double)readStats._memCacheHits/(double)readStats._reads << "%)"
+            << std::endl;
+    }
+
     return 0;
 }
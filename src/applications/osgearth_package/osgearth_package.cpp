@@ -74,6 +74,8 @@ usage( const std::string& msg = "" )
         << "            [--mp]                          ; Use multiprocessing to process the tiles.  Useful for GDAL sources as this avoids the global GDAL lock" << std::endl
         << "            [--mt]                          ; Use multithreading to process the tiles." << std::endl
         << "            [--concurrency]                 ; The number of threads or processes to use if --mp or --mt are provided." << std::endl
+        << "            [--batchsize]                   ; The number of tiles handed to a thread or process at once with --mt or --mp." << std::endl
+        << "            [--order depth|morton|hilbert]  ; Order in which to visit the tiles. morton and hilbert package one level at a time, neighbouring tiles together (default=depth)" << std::endl
         << "            [--alpha-mask]                  ; Mask out imagery that isn't in the provided extents." << std::endl
         << std::endl
         << "            [--verbose]                     ; Displays progress of the operation" << std::endl;
@@ -148,6 +150,10 @@ makeTMS( osg::ArgumentParser& args )
     args.read("-c", concurrency);
     args.read("--concurrency", concurrency);
 
+    // Read the traversal order
+    std::string order;
+    args.read("--order", order);
+
     bool applyAlphaMask = args.read("--alpha-mask");
 
     bool writeXML = true;
@@ -264,6 +270,11 @@ makeTMS( osg::ArgumentParser& args )
             {
                 v->setNumThreads(concurrency);
             }
+
+            if (batchSize > 0)
+            {
+                v->setBatchSize(batchSize);
+            }
             visitor = v;            
         }
         else if (args.read("--mp"))
@@ -304,6 +315,16 @@ makeTMS( osg::ArgumentParser& args )
         }        
     }
 
+    if (!order.empty())
+    {
+        TileVisitor::TraversalOrder traversalOrder;
+        if (!TileVisitor::parseTraversalOrder(order, traversalOrder))
+        {
+            return usage("Unknown traversal order: " + order);
+        }
+        visitor->setTraversalOrder(traversalOrder);
+    }
+
     osg::ref_ptr< ProgressCallback > progress = new ConsoleProgressCallback();
 
     if (verbose)
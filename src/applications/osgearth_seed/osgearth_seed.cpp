@@ -92,6 +92,8 @@ int
         << "        [--mp]                          ; Use multiprocessing to process the tiles.  Useful for GDAL sources as this avoids the global GDAL lock" << std::endl
         << "        [--mt]                          ; Use multithreading to process the tiles." << std::endl
         << "        [--concurrency]                 ; The number of threads or processes to use if --mp or --mt are provided." << std::endl
+        << "        [--batchsize]                   ; The number of tiles handed to a thread or process at once with --mt or --mp." << std::endl
+        << "        [--order depth|morton|hilbert]  ; Order in which to visit the tiles. morton and hilbert seed one level at a time, neighbouring tiles together (default=depth)" << std::endl
         << "        [--verbose]                     ; Displays progress of the seed operation" << std::endl
         << std::endl
         << "    --purge file.earth                  ; Purges a layer cache in a .earth file (interactive)" << std::endl
@@ -150,6 +152,10 @@ seed( osg::ArgumentParser& args )
     args.read("-c", concurrency);
     args.read("--concurrency", concurrency);
 
+    // Read the traversal order
+    std::string order;
+    args.read("--order", order);
+
     int imageLayerIndex = -1;
     args.read("--image", imageLayerIndex);
 
@@ -251,6 +257,11 @@ seed( osg::ArgumentParser& args )
             {
                 v->setNumThreads(concurrency);
             }
+
+            if (batchSize > 0)
+            {
+                v->setBatchSize(batchSize);
+            }
             visitor = v;            
         }
         else if (args.read("--mp"))
@@ -287,6 +298,16 @@ seed( osg::ArgumentParser& args )
         }        
     }
 
+    if (!order.empty())
+    {
+        TileVisitor::TraversalOrder traversalOrder;
+        if (!TileVisitor::parseTraversalOrder(order, traversalOrder))
+        {
+            return usage("Unknown traversal order: " + order);
+        }
+        visitor->setTraversalOrder(traversalOrder);
+    }
+
     osg::ref_ptr< ProgressCallback > progress = new ConsoleProgressCallback();
     
     if (verbose)
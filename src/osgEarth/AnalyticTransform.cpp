@@ -0,0 +1,526 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/AnalyticTransform>
+#include <osgEarth/SpatialReference>
+#include <osgEarth/Registry>
+#include <osg/Math>
+#include <ogr_srs_api.h>
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string>
+
+#define LC "[AnalyticTransform] "
+
+using namespace osgEarth;
+
+namespace
+{
+    static bool s_enabled = (::getenv("OSGEARTH_NO_ANALYTIC_TRANSFORMS") == 0L);
+
+    const double D2R = osg::PI / 180.0;
+    const double R2D = 180.0 / osg::PI;
+    const double TWO_PI = 2.0 * osg::PI;
+
+    // widest longitude offset from the central meridian (radians) that
+    // the Transverse Mercator series handles to the advertised accuracy
+    const double MAX_TM_LAMBDA = 10.0 * D2R;
+
+    // C++03 has no atanh.
+    inline double atanh_(double x)
+    {
+        return 0.5 * log((1.0 + x) / (1.0 - x));
+    }
+
+    // wraps a longitude offset (radians) into [-PI, PI)
+    inline double wrapRadians(double lam)
+    {
+        return lam - TWO_PI * floor((lam + osg::PI) / TWO_PI);
+    }
+
+    // isometric latitude (radians) for geodetic latitude phi
+    inline double isometricLatitude(double phi, double e)
+    {
+        double s = sin(phi);
+        return atanh_(s) - e * atanh_(e * s);
+    }
+
+    // true if every value is finite.
+    inline bool allFinite(const double* x, const double* y, unsigned count)
+    {
+        bool ok = true;
+        for (unsigned i = 0; i < count; ++i)
+            ok &= (fabs(x[i]) <= DBL_MAX) & (fabs(y[i]) <= DBL_MAX);
+        return ok;
+    }
+
+    // Ellipsoid constants shared by the projections below.
+    struct Ellipsoid
+    {
+        Ellipsoid(double a, double b)
+        {
+            _a = a;
+            double f = (a - b) / a;
+            _e2 = f * (2.0 - f);
+            _e = sqrt(_e2);
+            _n = f / (2.0 - f);
+
+            // conformal latitude -> geodetic latitude (Krueger)
+            double n = _n, n2 = n*n, n3 = n2*n;
+            _delta[0] = 2.0*n - 2.0*n2/3.0 - 2.0*n3;
+            _delta[1] = 7.0*n2/3.0 - 8.0*n3/5.0;
+            _delta[2] = 56.0*n3/15.0;
+        }
+
+        inline double conformalToGeodetic(double chi) const
+        {
+            return chi
+                + _delta[0] * sin(2.0*chi)
+                + _delta[1] * sin(4.0*chi)
+                + _delta[2] * sin(6.0*chi);
+        }
+
+        double _a, _e2, _e, _n;
+        double _delta[3];
+    };
+
+    /**
+     * Transverse Mercator (including UTM), after Krueger's n-series
+     * to third order. Sub-millimeter within a UTM zone; the error grows
+     * quickly past about 10 degrees from the central meridian, so points
+     * outside that band are left to OGR.
+     */
+    class TransverseMercator : public AnalyticTransform
+    {
+    public:
+        TransverseMercator(const Ellipsoid& ell, double lon0, double lat0, double k0,
+                           double x0, double y0, bool forward) :
+            _ell(ell), _lon0(lon0), _k0(k0), _x0(x0), _y0(y0), _forward(forward)
+        {
+            double n = ell._n, n2 = n*n, n3 = n2*n, n4 = n3*n;
+            _A = ell._a / (1.0 + n) * (1.0 + n2/4.0 + n4/64.0);
+            _kA = _k0 * _A;
+
+            _alpha[0] = n/2.0 - 2.0*n2/3.0 + 5.0*n3/16.0;
+            _alpha[1] = 13.0*n2/48.0 - 3.0*n3/5.0;
+            _alpha[2] = 61.0*n3/240.0;
+
+            _beta[0] = n/2.0 - 2.0*n2/3.0 + 37.0*n3/96.0;
+            _beta[1] = n2/48.0 + n3/15.0;
+            _beta[2] = 17.0*n3/480.0;
+
+            // northing of the latitude of origin on the central meridian:
+            double xi0 = atan(sinh(isometricLatitude(lat0*D2R, ell._e)));
+            _M0 = _kA * (xi0
+                + _alpha[0] * sin(2.0*xi0)
+                + _alpha[1] * sin(4.0*xi0)
+                + _alpha[2] * sin(6.0*xi0));
+
+            // easting limit equivalent to the longitude limit at the equator
+            _maxEasting = _kA * atanh_(sin(MAX_TM_LAMBDA));
+        }
+
+        bool isInDomain(const double* x, const double* y, unsigned count) const
+        {
+            if (_forward)
+            {
+                for (unsigned i = 0; i < count; ++i)
+                {
+                    if (fabs(wrapRadians((x[i] - _lon0) * D2R)) > MAX_TM_LAMBDA)
+                        return false;
+                }
+            }
+            else
+            {
+                for (unsigned i = 0; i < count; ++i)
+                {
+                    if (fabs(x[i] - _x0) > _maxEasting)
+                        return false;
+                }
+            }
+            return true;
+        }
+
+        bool transform(double* x, double* y, unsigned count) const
+        {
+            if (_forward)
+            {
+                for (unsigned i = 0; i < count; ++i)
+                {
+                    double lam = wrapRadians((x[i] - _lon0) * D2R);
+                    double t = sinh(isometricLatitude(y[i] * D2R, _ell._e));
+                    double xip = atan2(t, cos(lam));
+                    double etap = atanh_(sin(lam) / sqrt(1.0 + t*t));
+
+                    double xi = xip
+                        + _alpha[0] * sin(2.0*xip) * cosh(2.0*etap)
+                        + _alpha[1] * sin(4.0*xip) * cosh(4.0*etap)
+                        + _alpha[2] * sin(6.0*xip) * cosh(6.0*etap);
+
+                    double eta = etap
+                        + _alpha[0] * cos(2.0*xip) * sinh(2.0*etap)
+                        + _alpha[1] * cos(4.0*xip) * sinh(4.0*etap)
+                        + _alpha[2] * cos(6.0*xip) * sinh(6.0*etap);
+
+                    x[i] = _x0 + _kA * eta;
+                    y[i] = _y0 + _kA * xi - _M0;
+                }
+            }
+            else
+            {
+                for (unsigned i = 0; i < count; ++i)
+                {
+                    double xi = (y[i] - _y0 + _M0) / _kA;
+                    double eta = (x[i] - _x0) / _kA;
+
+                    double xip = xi
+                        - _beta[0] * sin(2.0*xi) * cosh(2.0*eta)
+                        - _beta[1] * sin(4.0*xi) * cosh(4.0*eta)
+                        - _beta[2] * sin(6.0*xi) * cosh(6.0*eta);
+
+                    double etap = eta
+                        - _beta[0] * cos(2.0*xi) * sinh(2.0*eta)
+                        - _beta[1] * cos(4.0*xi) * sinh(4.0*eta)
+                        - _beta[2] * cos(6.0*xi) * sinh(6.0*eta);
+
+                    double chi = asin(sin(xip) / cosh(etap));
+
+                    x[i] = _lon0 + atan2(sinh(etap), cos(xip)) * R2D;
+                    y[i] = _ell.conformalToGeodetic(chi) * R2D;
+                }
+            }
+            return allFinite(x, y, count);
+        }
+
+    private:
+        Ellipsoid _ell;
+        double _lon0, _k0, _x0, _y0;
+        double _A, _kA, _M0, _maxEasting;
+        double _alpha[3], _beta[3];
+        bool _forward;
+    };
+
+    /**
+     * Ellipsoidal Mercator (EPSG 1SP/2SP variants).
+     */
+    class Mercator : public AnalyticTransform
+    {
+    public:
+        Mercator(const Ellipsoid& ell, double lon0, double k0, double x0, double y0, bool forward) :
+            _ell(ell), _lon0(lon0), _x0(x0), _y0(y0), _forward(forward)
+        {
+            _ak0 = ell._a * k0;
+        }
+
+        bool transform(double* x, double* y, unsigned count) const
+        {
+            if (_forward)
+            {
+                for (unsigned i = 0; i < count; ++i)
+                {
+                    double lam = wrapRadians((x[i] - _lon0) * D2R);
+                    x[i] = _x0 + _ak0 * lam;
+                    y[i] = _y0 + _ak0 * isometricLatitude(y[i] * D2R, _ell._e);
+                }
+            }
+            else
+            {
+                for (unsigned i = 0; i < count; ++i)
+                {
+                    double chi = atan(sinh((y[i] - _y0) / _ak0));
+                    x[i] = _lon0 + ((x[i] - _x0) / _ak0) * R2D;
+                    y[i] = _ell.conformalToGeodetic(chi) * R2D;
+                }
+            }
+            return allFinite(x, y, count);
+        }
+
+    private:
+        Ellipsoid _ell;
+        double _lon0, _x0, _y0, _ak0;
+        bool _forward;
+    };
+
+    /**
+     * Equirectangular / plate carree. Like PROJ's "eqc", this uses the
+     * spherical formulas with the semi-major axis as the radius.
+     */
+    class Equirectangular : public AnalyticTransform
+    {
+    public:
+        Equirectangular(double a, double lon0, double lat0, double latTS, double x0, double y0, bool forward) :
+            _lon0(lon0), _lat0(lat0), _x0(x0), _y0(y0), _forward(forward)
+        {
+            _ax = a * cos(latTS * D2R) * D2R;
+            _ay = a * D2R;
+        }
+
+        bool transform(double* x, double* y, unsigned count) const
+        {
+            if (_forward)
+            {
+                for (unsigned i = 0; i < count; ++i)
+                {
+                    double lam = wrapRadians((x[i] - _lon0) * D2R) * R2D;
+                    x[i] = _x0 + _ax * lam;
+                    y[i] = _y0 + _ay * (y[i] - _lat0);
+                }
+            }
+            else
+            {
+                for (unsigned i = 0; i < count; ++i)
+                {
+                    x[i] = _lon0 + (x[i] - _x0) / _ax;
+                    y[i] = _lat0 + (y[i] - _y0) / _ay;
+                }
+            }
+            return allFinite(x, y, count);
+        }
+
+    private:
+        double _lon0, _lat0, _x0, _y0, _ax, _ay;
+        bool _forward;
+    };
+
+    inline double getParam(void* handle, const char* name, double defaultValue)
+    {
+        OGRErr err = OGRERR_NONE;
+        double value = OSRGetNormProjParm(handle, name, defaultValue, &err);
+        return err == OGRERR_NONE ? value : defaultValue;
+    }
+
+    inline void geodeticToECEFPoint(double& x, double& y, double& z, double a, double e2)
+    {
+        double lam = x * D2R, phi = y * D2R, h = z;
+        double sphi = sin(phi), cphi = cos(phi);
+        double N = a / sqrt(1.0 - e2*sphi*sphi);
+        x = (N + h) * cphi * cos(lam);
+        y = (N + h) * cphi * sin(lam);
+        z = (N * (1.0 - e2) + h) * sphi;
+    }
+
+    // Bowring's method; one step is accurate to well under a millimeter
+    // for points near the surface.
+    inline void ECEFToGeodeticPoint(double& x, double& y, double& z, double a, double b, double e2)
+    {
+        double ep2 = (a*a - b*b) / (b*b);
+        double p = sqrt(x*x + y*y);
+        double theta = atan2(z*a, p*b);
+        double st = sin(theta), ct = cos(theta);
+        double phi = atan2(z + ep2*b*st*st*st, p - e2*a*ct*ct*ct);
+        double lam = atan2(y, x);
+        double sphi = sin(phi);
+        double h = p*cos(phi) + z*sphi - a*sqrt(1.0 - e2*sphi*sphi);
+        x = lam * R2D;
+        y = phi * R2D;
+        z = h;
+    }
+
+    // true if the PROJ4 definition of the SRS applies a datum shift or grid.
+    // A +towgs84 of all zeros is a no-op and is allowed.
+    inline bool hasDatumShift(void* handle)
+    {
+        char* buf = 0L;
+        if ( OSRExportToProj4(handle, &buf) != OGRERR_NONE || !buf )
+            return false;
+
+        std::string proj4(buf);
+        OGRFree(buf);
+
+        if ( proj4.find("+nadgrids") != std::string::npos )
+            return true;
+
+        std::string::size_type p = proj4.find("+towgs84=");
+        if ( p != std::string::npos )
+        {
+            std::string::size_type end = proj4.find(' ', p);
+            std::string values = proj4.substr(p + 9, end == std::string::npos ? std::string::npos : end - p - 9);
+            for (unsigned i = 0; i < values.size(); ++i)
+                if ( values[i] != '0' && values[i] != ',' && values[i] != '.' )
+                    return true;
+        }
+        return false;
+    }
+
+    inline bool hasProj4Extension(const SpatialReference* srs)
+    {
+        return srs->getWKT().find("EXTENSION") != std::string::npos;
+    }
+
+    inline double eccentricitySquared(const osg::EllipsoidModel* em)
+    {
+        double a = em->getRadiusEquator(), b = em->getRadiusPolar();
+        return (a*a - b*b) / (a*a);
+    }
+}
+
+void
+AnalyticTransform::setEnabled(bool value)
+{
+    s_enabled = value;
+}
+
+bool
+AnalyticTransform::isEnabled()
+{
+    return s_enabled;
+}
+
+AnalyticTransform*
+AnalyticTransform::create(const SpatialReference* from,
+                          const SpatialReference* to)
+{
+    if ( !from || !to )
+        return 0L;
+
+    const SpatialReference* geo;
+    const SpatialReference* proj;
+    bool forward;
+
+    if ( from->isGeographic() && to->isProjected() )
+    {
+        geo = from, proj = to, forward = true;
+    }
+    else if ( from->isProjected() && to->isGeographic() )
+    {
+        geo = to, proj = from, forward = false;
+    }
+    else
+    {
+        return 0L;
+    }
+
+    if ( proj->isECEF() || proj->isCube() || proj->isLTP() || geo->isCube() || geo->isLTP() )
+        return 0L;
+
+    const osg::EllipsoidModel* em = proj->getEllipsoid();
+    if ( !em )
+        return 0L;
+
+    GDAL_SCOPED_LOCK;
+
+    void* ph = proj->getHandle();
+    void* gh = geo->getHandle();
+
+    // meters, degrees and Greenwich only
+    if ( !osg::equivalent(OSRGetLinearUnits(ph, 0L), 1.0) ||
+         !osg::equivalent(OSRGetAngularUnits(gh, 0L), D2R, 1e-12) ||
+         OSRGetPrimeMeridian(gh, 0L) != 0.0 ||
+         OSRGetPrimeMeridian(ph, 0L) != 0.0 )
+    {
+        return 0L;
+    }
+
+    // Spherical mercator (e.g. EPSG:3857) takes geographic coordinates as-is
+    // onto a sphere, which is what its +nadgrids=@null means.
+    if ( proj->isSphericalMercator() )
+    {
+        Ellipsoid sphere( em->getRadiusEquator(), em->getRadiusEquator() );
+        double lon0 = getParam(ph, "central_meridian", 0.0);
+        double x0   = getParam(ph, "false_easting", 0.0);
+        double y0   = getParam(ph, "false_northing", 0.0);
+        return new Mercator(sphere, lon0, 1.0, x0, y0, forward);
+    }
+
+    // A PROJ4 EXTENSION overrides the WKT parameters read below,
+    // and a datum shift needs OGR.
+    if ( hasProj4Extension(proj) || hasProj4Extension(geo) || hasDatumShift(ph) || hasDatumShift(gh) )
+        return 0L;
+
+    // no datum shift allowed:
+    if ( !proj->getGeographicSRS()->isHorizEquivalentTo(geo) )
+        return 0L;
+
+    Ellipsoid ell( em->getRadiusEquator(), em->getRadiusPolar() );
+
+    const char* projection = OSRGetAttrValue(ph, "PROJECTION", 0);
+    if ( !projection )
+        return 0L;
+
+    std::string name(projection);
+
+    double lon0 = getParam(ph, "central_meridian", 0.0);
+    double lat0 = getParam(ph, "latitude_of_origin", 0.0);
+    double x0   = getParam(ph, "false_easting", 0.0);
+    double y0   = getParam(ph, "false_northing", 0.0);
+
+    if ( name == "Transverse_Mercator" )
+    {
+        double k0 = getParam(ph, "scale_factor", 1.0);
+        return new TransverseMercator(ell, lon0, lat0, k0, x0, y0, forward);
+    }
+
+    else if ( name == "Mercator_1SP" && lat0 == 0.0 )
+    {
+        double k0 = getParam(ph, "scale_factor", 1.0);
+        return new Mercator(ell, lon0, k0, x0, y0, forward);
+    }
+
+    else if ( name == "Mercator_2SP" )
+    {
+        double phi1 = getParam(ph, "standard_parallel_1", 0.0) * D2R;
+        double s = sin(phi1);
+        double k0 = cos(phi1) / sqrt(1.0 - ell._e2*s*s);
+        return new Mercator(ell, lon0, k0, x0, y0, forward);
+    }
+
+    else if ( name == "Equirectangular" || name == "Plate_Carree" )
+    {
+        double latTS = getParam(ph, "standard_parallel_1", 0.0);
+        return new Equirectangular(ell._a, lon0, lat0, latTS, x0, y0, forward);
+    }
+
+    return 0L;
+}
+
+void
+AnalyticTransform::geodeticToECEF(double* x, double* y, double* z, unsigned count,
+                                  const osg::EllipsoidModel* em)
+{
+    double a = em->getRadiusEquator(), e2 = eccentricitySquared(em);
+    for (unsigned i = 0; i < count; ++i)
+        geodeticToECEFPoint(x[i], y[i], z[i], a, e2);
+}
+
+void
+AnalyticTransform::geodeticToECEF(std::vector<osg::Vec3d>& points,
+                                  const osg::EllipsoidModel* em)
+{
+    double a = em->getRadiusEquator(), e2 = eccentricitySquared(em);
+    for (unsigned i = 0; i < points.size(); ++i)
+        geodeticToECEFPoint(points[i].x(), points[i].y(), points[i].z(), a, e2);
+}
+
+void
+AnalyticTransform::ECEFToGeodetic(double* x, double* y, double* z, unsigned count,
+                                  const osg::EllipsoidModel* em)
+{
+    double a = em->getRadiusEquator(), b = em->getRadiusPolar(), e2 = eccentricitySquared(em);
+    for (unsigned i = 0; i < count; ++i)
+        ECEFToGeodeticPoint(x[i], y[i], z[i], a, b, e2);
+}
+
+void
+AnalyticTransform::ECEFToGeodetic(std::vector<osg::Vec3d>& points,
+                                  const osg::EllipsoidModel* em)
+{
+    double a = em->getRadiusEquator(), b = em->getRadiusPolar(), e2 = eccentricitySquared(em);
+    for (unsigned i = 0; i < points.size(); ++i)
+        ECEFToGeodeticPoint(points[i].x(), points[i].y(), points[i].z(), a, b, e2);
+}
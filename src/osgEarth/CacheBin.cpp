@@ -320,6 +320,40 @@ CacheBin::writeNode(const std::string&    key,
     return true;
 }
 
+// metadata key holding the mime type of an encoded image record
+#define ENCODED_MIME_TYPE "encoded_mime_type"
+
+bool
+CacheBin::writeEncodedImage(const std::string&  key,
+                            const EncodedImage* image,
+                            const Config&       metadata)
+{
+    if ( !image || !image->valid() )
+        return false;
+
+    Config meta(metadata);
+    meta.set( ENCODED_MIME_TYPE, image->getMimeType() );
+
+    osg::ref_ptr<StringObject> data = new StringObject( image->getData() );
+    return write(key, data.get(), meta, 0L);
+}
+
+ReadResult
+CacheBin::readEncodedImage(const std::string&          key,
+                           osg::ref_ptr<EncodedImage>& image)
+{
+    ReadResult r = readString(key, 0L);
+    if ( !r.succeeded() )
+        return r;
+
+    std::string mimeType = r.metadata().value( ENCODED_MIME_TYPE );
+    if ( mimeType.empty() )
+        return ReadResult(ReadResult::RESULT_NOT_FOUND);
+
+    image = new EncodedImage( r.getString(), mimeType );
+    return r;
+}
+
 
 #undef  LC
 #define LC "[ReadImageFromCachePseudoLoader] "
@@ -0,0 +1,501 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/CacheRecordCodec>
+#include <osgEarth/ImageUtils>
+#include <osgEarth/Notify>
+#include <osg/Image>
+#include <osg/Shape>
+#include <osg/UserDataContainer>
+#include <osgDB/Registry>
+#include <sstream>
+#include <cstring>
+#include <algorithm>
+
+#ifdef OSGEARTH_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#define LC "[CacheRecordCodec] "
+
+using namespace osgEarth;
+
+namespace
+{
+    // record layout:
+    //   char[4]  magic
+    //   u8       version
+    //   u8       payload type
+    //   u8       payload compression
+    //   u8       reserved
+    //   u32      metadata size
+    //   char[]   metadata (JSON)
+    //   ...      payload
+    const char     MAGIC[4]    = { 'o', 'e', 'c', 'r' };
+    const unsigned char VERSION = 1;
+    const unsigned HEADER_SIZE = 12;
+
+    enum PayloadType
+    {
+        PAYLOAD_RAW_IMAGE       = 1,
+        PAYLOAD_RAW_HEIGHTFIELD = 2,
+        PAYLOAD_OSGB_IMAGE      = 3,
+        PAYLOAD_OSGB_NODE       = 4,
+        PAYLOAD_OSGB_OBJECT     = 5
+    };
+
+    const char* UNNORMALIZED = "osgEarth.unnormalized";
+
+    // appends fixed-size values to a string
+    struct Writer
+    {
+        Writer(std::string& out) : _out(out) { }
+        template<typename T> void put(const T& value) { _out.append(reinterpret_cast<const char*>(&value), sizeof(T)); }
+        void putBytes(const void* data, std::size_t size) { _out.append(static_cast<const char*>(data), size); }
+        std::string& _out;
+    };
+
+    // reads fixed-size values from a buffer, failing (instead of overrunning) at the end
+    struct Reader
+    {
+        Reader(const std::string& in, std::size_t pos) : _in(in), _pos(pos), _ok(true) { }
+        template<typename T> T get() {
+            T value = T();
+            if (_ok && _pos + sizeof(T) <= _in.size()) {
+                ::memcpy(&value, _in.data() + _pos, sizeof(T));
+                _pos += sizeof(T);
+            }
+            else _ok = false;
+            return value;
+        }
+        const char* getBytes(std::size_t size) {
+            if (!_ok || _pos + size > _in.size()) { _ok = false; return 0L; }
+            const char* ptr = _in.data() + _pos;
+            _pos += size;
+            return ptr;
+        }
+        const std::string& _in;
+        std::size_t _pos;
+        bool _ok;
+    };
+
+    // Compresses "data" into "out" if that helps; returns the compression used.
+    unsigned char compress(CacheRecordCodec::Compression compression, const void* data, std::size_t size, std::string& out)
+    {
+#ifdef OSGEARTH_HAVE_ZLIB
+        if (compression == CacheRecordCodec::COMPRESSION_ZLIB && size > 0)
+        {
+            uLongf stored = compressBound((uLong)size);
+            out.resize(stored);
+            if (compress2((Bytef*)&out[0], &stored, (const Bytef*)data, (uLong)size, Z_BEST_SPEED) == Z_OK && stored < size)
+            {
+                out.resize(stored);
+                return CacheRecordCodec::COMPRESSION_ZLIB;
+            }
+        }
+#endif
+        out.assign(static_cast<const char*>(data), size);
+        return CacheRecordCodec::COMPRESSION_NONE;
+    }
+
+    // zlib never compresses better than about 1032:1, so a larger claim is corrupt
+    const unsigned long long MAX_ZLIB_RATIO = 1032ull;
+
+    // Whether a payload that claims to decode to "size" bytes could really come
+    // from "storedSize" stored bytes, checked before allocating anything.
+    bool plausibleSize(unsigned char compression, unsigned long long size, unsigned long long storedSize)
+    {
+        if (size > (unsigned long long)(~(std::size_t)0))
+            return false;
+        if (compression == CacheRecordCodec::COMPRESSION_NONE)
+            return size == storedSize;
+        if (compression == CacheRecordCodec::COMPRESSION_ZLIB)
+            return size <= storedSize * MAX_ZLIB_RATIO;
+        return false;
+    }
+
+    // Decodes a stored payload into "dest", which holds exactly "size" bytes.
+    bool decompress(unsigned char compression, const char* stored, std::size_t storedSize, void* dest, std::size_t size)
+    {
+        if (compression == CacheRecordCodec::COMPRESSION_NONE)
+        {
+            if (storedSize != size)
+                return false;
+            ::memcpy(dest, stored, size);
+            return true;
+        }
+#ifdef OSGEARTH_HAVE_ZLIB
+        if (compression == CacheRecordCodec::COMPRESSION_ZLIB)
+        {
+            uLongf destSize = (uLongf)size;
+            return
+                uncompress((Bytef*)dest, &destSize, (const Bytef*)stored, (uLong)storedSize) == Z_OK &&
+                destSize == size;
+        }
+#endif
+        return false;
+    }
+
+    // The raw format keeps only the pixels and the unnormalized flag.
+    bool canStoreRaw(const osg::Image* image, bool& unnormalized)
+    {
+        unnormalized = false;
+
+        if (!image->data() || !image->isDataContiguous())
+            return false;
+
+        const osg::UserDataContainer* udc = image->getUserDataContainer();
+        if (!udc)
+            return true;
+
+        if (udc->getUserData() || udc->getNumDescriptions() > 0)
+            return false;
+
+        for (unsigned i = 0; i < udc->getNumUserObjects(); ++i)
+        {
+            const osg::Object* obj = udc->getUserObject(i);
+            if (!obj || obj->getName() != UNNORMALIZED)
+                return false;
+        }
+        unnormalized = ImageUtils::isUnNormalized(image);
+        return true;
+    }
+
+    bool canStoreRaw(const osg::HeightField* hf)
+    {
+        return
+            hf->getFloatArray() &&
+            hf->getFloatArray()->size() == hf->getNumColumns() * hf->getNumRows() &&
+            hf->getRotation().zeroRotation() &&
+            hf->getUserDataContainer() == 0L;
+    }
+
+    // image header, payload compression, compressed data
+    unsigned char encodeImage(const osg::Image* image, bool unnormalized, CacheRecordCodec::Compression compression, std::string& payload)
+    {
+        Writer w(payload);
+        w.put<unsigned>(image->s());
+        w.put<unsigned>(image->t());
+        w.put<unsigned>(image->r());
+        w.put<int>(image->getInternalTextureFormat());
+        w.put<unsigned>(image->getPixelFormat());
+        w.put<unsigned>(image->getDataType());
+        w.put<unsigned>(image->getPacking());
+        w.put<unsigned>(image->getOrigin());
+        w.put<unsigned>(unnormalized ? 1u : 0u);
+
+        const osg::Image::MipmapDataType& mipmaps = image->getMipmapLevels();
+        w.put<unsigned>(mipmaps.size());
+        for (unsigned i = 0; i < mipmaps.size(); ++i)
+            w.put<unsigned>(mipmaps[i]);
+
+        std::string stored;
+        std::size_t size = image->getTotalSizeInBytesIncludingMipmaps();
+        unsigned char used = compress(compression, image->data(), size, stored);
+        w.put<unsigned long long>(size);
+        w.put<unsigned long long>(stored.size());
+        w.putBytes(stored.data(), stored.size());
+        return used;
+    }
+
+    osg::Image* decodeImage(Reader& r, unsigned char compression)
+    {
+        unsigned s = r.get<unsigned>();
+        unsigned t = r.get<unsigned>();
+        unsigned depth = r.get<unsigned>();
+        int internalFormat = r.get<int>();
+        GLenum pixelFormat = r.get<unsigned>();
+        GLenum dataType = r.get<unsigned>();
+        unsigned packing = r.get<unsigned>();
+        unsigned origin = r.get<unsigned>();
+        unsigned flags = r.get<unsigned>();
+
+        unsigned numMipmaps = r.get<unsigned>();
+        osg::Image::MipmapDataType mipmaps;
+        for (unsigned i = 0; i < numMipmaps && r._ok; ++i)
+            mipmaps.push_back(r.get<unsigned>());
+
+        unsigned long long size = r.get<unsigned long long>();
+        unsigned long long storedSize = r.get<unsigned long long>();
+        const char* stored = r.getBytes(storedSize);
+        if (!r._ok)
+            return 0L;
+
+        // The size must cover the image it describes, plus at most its mipmap
+        // levels, each half the size of the last (as osg::Image lays them out).
+        unsigned long long minSize = osg::Image::computeImageSizeInBytes(s, t, depth, pixelFormat, dataType, packing);
+        unsigned long long maxSize = minSize;
+        unsigned ms = s, mt = t, mr = depth;
+        for (unsigned i = 0; i < mipmaps.size(); ++i)
+        {
+            ms = std::max(ms >> 1, 1u);
+            mt = std::max(mt >> 1, 1u);
+            mr = std::max(mr >> 1, 1u);
+            maxSize += osg::Image::computeImageSizeInBytes(ms, mt, mr, pixelFormat, dataType, packing);
+        }
+
+        if (size < minSize || size > maxSize || !plausibleSize(compression, size, storedSize))
+            return 0L;
+
+        unsigned char* data = new unsigned char[size];
+        if (!decompress(compression, stored, storedSize, data, size))
+        {
+            delete [] data;
+            return 0L;
+        }
+
+        osg::Image* image = new osg::Image();
+        image->setImage(s, t, depth, internalFormat, pixelFormat, dataType, data, osg::Image::USE_NEW_DELETE, packing);
+        image->setOrigin((osg::Image::Origin)origin);
+        if (!mipmaps.empty())
+            image->setMipmapLevels(mipmaps);
+        if (flags & 1u)
+            ImageUtils::markAsUnNormalized(image, true);
+        return image;
+    }
+
+    unsigned char encodeHeightField(const osg::HeightField* hf, CacheRecordCodec::Compression compression, std::string& payload)
+    {
+        Writer w(payload);
+        w.put<unsigned>(hf->getNumColumns());
+        w.put<unsigned>(hf->getNumRows());
+        w.put<unsigned>(hf->getBorderWidth());
+        w.put<float>(hf->getSkirtHeight());
+        w.put<float>(hf->getOrigin().x());
+        w.put<float>(hf->getOrigin().y());
+        w.put<float>(hf->getOrigin().z());
+        w.put<float>(hf->getXInterval());
+        w.put<float>(hf->getYInterval());
+
+        std::string stored;
+        std::size_t size = hf->getFloatArray()->size() * sizeof(float);
+        unsigned char used = compress(compression, &hf->getFloatArray()->front(), size, stored);
+        w.put<unsigned long long>(size);
+        w.put<unsigned long long>(stored.size());
+        w.putBytes(stored.data(), stored.size());
+        return used;
+    }
+
+    osg::HeightField* decodeHeightField(Reader& r, unsigned char compression)
+    {
+        unsigned cols = r.get<unsigned>();
+        unsigned rows = r.get<unsigned>();
+        unsigned border = r.get<unsigned>();
+        float skirt = r.get<float>();
+        osg::Vec3 origin;
+        origin.x() = r.get<float>();
+        origin.y() = r.get<float>();
+        origin.z() = r.get<float>();
+        float xInterval = r.get<float>();
+        float yInterval = r.get<float>();
+
+        unsigned long long size = r.get<unsigned long long>();
+        unsigned long long storedSize = r.get<unsigned long long>();
+        const char* stored = r.getBytes(storedSize);
+        if (!r._ok || size != (unsigned long long)cols * rows * sizeof(float) || size == 0 ||
+            !plausibleSize(compression, size, storedSize))
+            return 0L;
+
+        osg::ref_ptr<osg::HeightField> hf = new osg::HeightField();
+        hf->allocate(cols, rows);
+        if (!decompress(compression, stored, storedSize, &hf->getFloatArray()->front(), size))
+            return 0L;
+
+        hf->setBorderWidth(border);
+        hf->setSkirtHeight(skirt);
+        hf->setOrigin(origin);
+        hf->setXInterval(xInterval);
+        hf->setYInterval(yInterval);
+        return hf.release();
+    }
+}
+
+CacheRecordCodec::CacheRecordCodec(Compression compression) :
+_compression( compression )
+{
+#ifndef OSGEARTH_HAVE_ZLIB
+    if (_compression == COMPRESSION_ZLIB)
+    {
+        OE_WARN << LC << "zlib compression is not available in this build; records will not be compressed\n";
+        _compression = COMPRESSION_NONE;
+    }
+#endif
+
+    _rw = osgDB::Registry::instance()->getReaderWriterForExtension("osgb");
+}
+
+CacheRecordCodec::Compression
+CacheRecordCodec::parseCompression(const std::string& name)
+{
+    return name == "zlib" ? COMPRESSION_ZLIB : COMPRESSION_NONE;
+}
+
+bool
+CacheRecordCodec::isRecord(const std::string& data)
+{
+    return
+        data.size() >= HEADER_SIZE &&
+        ::memcmp(data.data(), MAGIC, 4) == 0 &&
+        (unsigned char)data[4] == VERSION;
+}
+
+bool
+CacheRecordCodec::encode(const osg::Object* object, const Config& meta, std::string& out, const osgDB::Options* writeOptions) const
+{
+    if (!object)
+        return false;
+
+    std::string payload;
+    unsigned char type = 0;
+    unsigned char compression = COMPRESSION_NONE;
+
+    const osg::Image* image = dynamic_cast<const osg::Image*>(object);
+    const osg::HeightField* hf = dynamic_cast<const osg::HeightField*>(object);
+    bool unnormalized;
+
+    if (image && canStoreRaw(image, unnormalized))
+    {
+        type = PAYLOAD_RAW_IMAGE;
+        compression = encodeImage(image, unnormalized, _compression, payload);
+    }
+    else if (hf && canStoreRaw(hf))
+    {
+        type = PAYLOAD_RAW_HEIGHTFIELD;
+        compression = encodeHeightField(hf, _compression, payload);
+    }
+    else
+    {
+        if (!_rw.valid())
+            return false;
+
+        std::stringstream buf;
+        osgDB::ReaderWriter::WriteResult r;
+        if (image)
+        {
+            type = PAYLOAD_OSGB_IMAGE;
+            r = _rw->writeImage(*image, buf, writeOptions);
+        }
+        else if (dynamic_cast<const osg::Node*>(object))
+        {
+            type = PAYLOAD_OSGB_NODE;
+            r = _rw->writeNode(*static_cast<const osg::Node*>(object), buf, writeOptions);
+        }
+        else
+        {
+            type = PAYLOAD_OSGB_OBJECT;
+            r = _rw->writeObject(*object, buf, writeOptions);
+        }
+
+        if (!r.success())
+        {
+            OE_WARN << LC << "Failed to encode " << object->className() << ": " << r.message() << "\n";
+            return false;
+        }
+        payload = buf.str();
+    }
+
+    std::string json = meta.toJSON(false);
+
+    out.clear();
+    out.reserve(HEADER_SIZE + json.size() + payload.size());
+    Writer w(out);
+    w.putBytes(MAGIC, 4);
+    w.put<unsigned char>(VERSION);
+    w.put<unsigned char>(type);
+    w.put<unsigned char>(compression);
+    w.put<unsigned char>(0);
+    w.put<unsigned>(json.size());
+    w.putBytes(json.data(), json.size());
+    w.putBytes(payload.data(), payload.size());
+    return true;
+}
+
+bool
+CacheRecordCodec::decodeMeta(const std::string& data, Config& meta) const
+{
+    if (!isRecord(data))
+        return false;
+
+    Reader r(data, 8);
+    unsigned metaSize = r.get<unsigned>();
+    const char* json = r.getBytes(metaSize);
+    if (!r._ok)
+        return false;
+
+    meta.fromJSON(std::string(json, metaSize));
+    return true;
+}
+
+bool
+CacheRecordCodec::decode(const std::string& data, Config& meta, osg::ref_ptr<osg::Object>& object, const osgDB::Options* readOptions) const
+{
+    if (!decodeMeta(data, meta))
+        return false;
+
+    unsigned char type = data[5];
+    unsigned char compression = data[6];
+
+    Reader r(data, 8);
+    unsigned metaSize = r.get<unsigned>();
+    r.getBytes(metaSize);
+
+    if (type == PAYLOAD_RAW_IMAGE)
+    {
+        object = decodeImage(r, compression);
+    }
+    else if (type == PAYLOAD_RAW_HEIGHTFIELD)
+    {
+        object = decodeHeightField(r, compression);
+    }
+    else if (_rw.valid())
+    {
+        std::istringstream buf(data.substr(r._pos));
+        osgDB::ReaderWriter::ReadResult rr =
+            type == PAYLOAD_OSGB_IMAGE ? _rw->readImage(buf, readOptions) :
+            type == PAYLOAD_OSGB_NODE  ? _rw->readNode(buf, readOptions) :
+                                         _rw->readObject(buf, readOptions);
+        if (rr.success())
+            object = rr.getObject();
+    }
+
+    return object.valid();
+}
+
+bool
+CacheRecordCodec::replaceMeta(const std::string& data, const Config& meta, std::string& out) const
+{
+    if (!isRecord(data))
+        return false;
+
+    Reader r(data, 8);
+    unsigned metaSize = r.get<unsigned>();
+    r.getBytes(metaSize);
+    if (!r._ok)
+        return false;
+
+    std::string json = meta.toJSON(false);
+
+    out.clear();
+    out.reserve(HEADER_SIZE + json.size() + data.size() - r._pos);
+    Writer w(out);
+    w.putBytes(data.data(), 8);
+    w.put<unsigned>(json.size());
+    w.putBytes(json.data(), json.size());
+    w.putBytes(data.data() + r._pos, data.size() - r._pos);
+    return true;
+}
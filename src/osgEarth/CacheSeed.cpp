@@ -100,6 +100,16 @@ std::string CacheTileHandler::getProcessString() const
     return buf.str();
 }
 
+bool CacheTileHandler::getReadStats(TileSource::ReadStats& out) const
+{
+    TileSource* source = _layer->getTileSource();
+    if (!source)
+        return false;
+
+    out = source->getReadStats();
+    return true;
+}
+
 
 
 /***************************************************************************************/
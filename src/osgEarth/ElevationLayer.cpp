@@ -442,10 +442,15 @@ ElevationLayer::createHeightField(const TileKey&    key,
     std::string cacheKey = Stringify() << key.str() << "_" << key.getProfile()->getFullSignature();
     const CachePolicy& policy = getCacheSettings()->cachePolicy().get();
 
+    // NODATA_MSL post-processing modifies the heightfield in place, so it
+    // needs a private copy if the mem cache is sharing its objects.
+    const osgDB::Options* memCacheOptions =
+        _memCache.valid() && options().noDataPolicy() == NODATA_MSL ? _memCache->getCopyOptions() : 0L;
+
     if ( _memCache.valid() )
     {
         CacheBin* bin = _memCache->getOrCreateDefaultBin();
-        ReadResult cacheResult = bin->readObject(cacheKey, 0L);
+        ReadResult cacheResult = bin->readObject(cacheKey, memCacheOptions);
         if ( cacheResult.succeeded() )
         {
             result = GeoHeightField(
@@ -586,7 +591,7 @@ ElevationLayer::createHeightField(const TileKey&    key,
     if ( result.valid() && !fromMemCache && _memCache.valid() )
     {
         CacheBin* bin = _memCache->getOrCreateDefaultBin();
-        bin->write(cacheKey, result.getHeightField(), 0L);
+        bin->write(cacheKey, result.getHeightField(), memCacheOptions);
     }
 
     // post-processing:
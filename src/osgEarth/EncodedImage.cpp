@@ -0,0 +1,109 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/EncodedImage>
+#include <osgEarth/StringUtils>
+#include <osgEarth/Notify>
+#include <osgDB/Registry>
+#include <sstream>
+
+#define LC "[EncodedImage] "
+
+using namespace osgEarth;
+
+namespace
+{
+    // Reduces a mime type or extension to a canonical extension so that
+    // "image/jpeg", "jpeg" and "JPG" all compare equal.
+    std::string normalizeFormat(const std::string& format)
+    {
+        std::string f = toLower(trim(format));
+
+        std::string::size_type semi = f.find(';');
+        if (semi != std::string::npos)
+            f = trim(f.substr(0, semi));
+
+        std::string::size_type slash = f.find('/');
+        if (slash != std::string::npos)
+            f = f.substr(slash+1);
+
+        if (startsWith(f, "x-"))
+            f = f.substr(2);
+
+        if (f == "jpeg") return "jpg";
+        if (f == "tiff") return "tif";
+        return f;
+    }
+
+    bool hasPrefix(const std::string& data, const char* prefix, unsigned len)
+    {
+        return data.size() >= len && data.compare(0, len, prefix, len) == 0;
+    }
+}
+
+EncodedImage::EncodedImage(const std::string& data, const std::string& mimeType) :
+_data    ( data ),
+_mimeType( mimeType )
+{
+    if (_mimeType.empty())
+        _mimeType = detectMimeType(_data);
+}
+
+bool
+EncodedImage::isFormat(const std::string& format) const
+{
+    return !_mimeType.empty() && normalizeFormat(format) == normalizeFormat(_mimeType);
+}
+
+osg::Image*
+EncodedImage::decode(const osgDB::Options* readOptions) const
+{
+    if (!valid())
+        return 0L;
+
+    osgDB::ReaderWriter* rw = osgDB::Registry::instance()->getReaderWriterForMimeType(_mimeType);
+    if (!rw)
+        rw = osgDB::Registry::instance()->getReaderWriterForExtension(normalizeFormat(_mimeType));
+    if (!rw)
+    {
+        OE_WARN << LC << "No plugin to decode \"" << _mimeType << "\"" << std::endl;
+        return 0L;
+    }
+
+    std::istringstream in(_data);
+    osgDB::ReaderWriter::ReadResult rr = rw->readImage(in, readOptions);
+    return rr.validImage() ? rr.takeImage() : 0L;
+}
+
+std::string
+EncodedImage::detectMimeType(const std::string& data)
+{
+    if (hasPrefix(data, "\x89PNG\r\n\x1a\n", 8))
+        return "image/png";
+    if (hasPrefix(data, "\xff\xd8\xff", 3))
+        return "image/jpeg";
+    if (hasPrefix(data, "GIF8", 4))
+        return "image/gif";
+    if (hasPrefix(data, "II*\0", 4) || hasPrefix(data, "MM\0*", 4))
+        return "image/tiff";
+    if (hasPrefix(data, "RIFF", 4) && data.size() >= 12 && data.compare(8, 4, "WEBP") == 0)
+        return "image/webp";
+    if (hasPrefix(data, "DDS ", 4))
+        return "image/dds";
+    return std::string();
+}
@@ -25,6 +25,8 @@
 #include <osgEarth/Cube>
 #include <osgEarth/VerticalDatum>
 #include <osgEarth/Terrain>
+#include <osgEarth/Containers>
+#include <osgEarth/ThreadingUtils>
 
 #include <osg/Notify>
 #include <osg/Timer>
@@ -37,6 +39,7 @@
 #include <sstream>
 #include <iomanip>
 #include <cmath>
+#include <limits>
 
 #define LC "[GeoData] "
 
@@ -1818,6 +1821,370 @@ namespace
     }    
 
 
+    // Transforms points in place. If the batch fails, retries them one at a
+    // time and marks the ones that still fail with NaN, so a single bad point
+    // (e.g. beyond mercator's latitude limit) does not spoil the rest.
+    void transformOrInvalidate(std::vector<osg::Vec3d>& points, const SpatialReference* from, const SpatialReference* to)
+    {
+        std::vector<osg::Vec3d> input(points);
+        if ( from->transform(points, to) )
+            return;
+
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        for(unsigned i=0; i<input.size(); ++i)
+        {
+            if ( !from->transform(input[i], to, points[i]) )
+                points[i].set(nan, nan, nan);
+        }
+    }
+
+    /**
+     * Source-SRS coordinates of every destination pixel center, for warping an
+     * image from one extent to another. Only a sparse grid of control pixels
+     * is transformed exactly and the pixels in between are interpolated.
+     * Each grid cell is checked at its center pixel; a cell whose error there
+     * exceeds the bound is transformed exactly, pixel by pixel.
+     */
+    class WarpGrid : public osg::Referenced
+    {
+    public:
+        WarpGrid(const GeoExtent& src, const GeoExtent& dest,
+                 unsigned width, unsigned height,
+                 unsigned srcWidth, unsigned srcHeight,
+                 const GeoImage::WarpOptions& options) :
+            _width(width), _hasExact(false)
+        {
+            unsigned spacing = std::max(options.spacing, 1u);
+            layout(width,  spacing, _colPixels, _cellOfCol, _fracOfCol);
+            layout(height, spacing, _rowPixels, _cellOfRow, _fracOfRow);
+
+            const SpatialReference* fromSRS = dest.getSRS();
+            const SpatialReference* toSRS = src.getSRS();
+            const double dx = dest.width() / (double)width;
+            const double dy = dest.height() / (double)height;
+
+            // Transform the control points.
+            unsigned gridCols = _colPixels.size(), gridRows = _rowPixels.size();
+            std::vector<osg::Vec3d> points;
+            points.reserve(gridCols * gridRows);
+            for(unsigned j=0; j<gridRows; ++j)
+                for(unsigned i=0; i<gridCols; ++i)
+                    points.push_back( pixelCenter(dest, dx, dy, _colPixels[i], _rowPixels[j]) );
+
+            transformOrInvalidate(points, fromSRS, toSRS);
+
+            _gridX.resize(points.size());
+            _gridY.resize(points.size());
+            for(unsigned k=0; k<points.size(); ++k)
+            {
+                _gridX[k] = points[k].x();
+                _gridY[k] = points[k].y();
+            }
+
+            if ( spacing == 1u )
+                return;
+
+            // Check each cell at its center pixel against the exact transform.
+            unsigned cellCols = std::max(gridCols-1, 1u), cellRows = std::max(gridRows-1, 1u);
+            std::vector<unsigned> testCols, testRows;
+            points.clear();
+            for(unsigned j=0; j<cellRows; ++j)
+            {
+                for(unsigned i=0; i<cellCols; ++i)
+                {
+                    unsigned c = (_colPixels[i] + _colPixels[std::min(i+1, gridCols-1)]) / 2;
+                    unsigned r = (_rowPixels[j] + _rowPixels[std::min(j+1, gridRows-1)]) / 2;
+                    testCols.push_back(c);
+                    testRows.push_back(r);
+                    points.push_back( pixelCenter(dest, dx, dy, c, r) );
+                }
+            }
+
+            transformOrInvalidate(points, fromSRS, toSRS);
+
+            // error bound in source units, per axis
+            const double maxErrorX = options.maxError * src.width() / (double)std::max(srcWidth, 1u);
+            const double maxErrorY = options.maxError * src.height() / (double)std::max(srcHeight, 1u);
+
+            _exactCell.assign(cellCols*cellRows, 0);
+            for(unsigned k=0; k<points.size(); ++k)
+            {
+                double x, y;
+                interpolate(testCols[k], testRows[k], x, y);
+                double errX = fabs(x - points[k].x()), errY = fabs(y - points[k].y());
+                if ( !(errX <= maxErrorX && errY <= maxErrorY) ) // NaN fails too
+                {
+                    _exactCell[k] = 1;
+                    _hasExact = true;
+                }
+            }
+
+            if ( !_hasExact )
+                return;
+
+            // Transform every pixel of the cells that failed. Only those pixels
+            // are stored, row-major, with the index of each row's first one.
+            points.clear();
+            _exactRowStart.resize(height+1);
+            for(unsigned r=0; r<height; ++r)
+            {
+                _exactRowStart[r] = points.size();
+                for(unsigned c=0; c<width; ++c)
+                {
+                    if ( _exactCell[_cellOfRow[r]*cellCols + _cellOfCol[c]] )
+                        points.push_back( pixelCenter(dest, dx, dy, c, r) );
+                }
+            }
+            _exactRowStart[height] = points.size();
+
+            transformOrInvalidate(points, fromSRS, toSRS);
+
+            _exactX.resize(points.size());
+            _exactY.resize(points.size());
+            for(unsigned k=0; k<points.size(); ++k)
+            {
+                _exactX[k] = points[k].x();
+                _exactY[k] = points[k].y();
+            }
+        }
+
+        /** Number of control columns, which is the scratch space getRow needs per axis. */
+        unsigned getNumControlColumns() const { return _colPixels.size(); }
+
+        /**
+         * Source coordinates of the pixel centers in destination row "row".
+         * rowX and rowY are scratch space of getNumControlColumns() each, so
+         * the caller can reuse them from row to row.
+         */
+        void getRow(unsigned row, double* x, double* y, double* rowX, double* rowY) const
+        {
+            unsigned gridCols = _colPixels.size();
+            unsigned j0 = _cellOfRow[row], j1 = std::min(j0+1, (unsigned)_rowPixels.size()-1);
+            double ty = _fracOfRow[row];
+
+            // interpolate the control columns down to this row first...
+            for(unsigned i=0; i<gridCols; ++i)
+            {
+                rowX[i] = mix(_gridX[j0*gridCols+i], _gridX[j1*gridCols+i], ty);
+                rowY[i] = mix(_gridY[j0*gridCols+i], _gridY[j1*gridCols+i], ty);
+            }
+
+            // ...then across it.
+            for(unsigned c=0; c<_width; ++c)
+            {
+                unsigned i0 = _cellOfCol[c], i1 = std::min(i0+1, gridCols-1);
+                x[c] = mix(rowX[i0], rowX[i1], _fracOfCol[c]);
+                y[c] = mix(rowY[i0], rowY[i1], _fracOfCol[c]);
+            }
+
+            if ( _hasExact )
+            {
+                unsigned cellCols = std::max(gridCols-1, 1u);
+                const char* exact = &_exactCell[j0*cellCols];
+                unsigned k = _exactRowStart[row];
+                for(unsigned c=0; c<_width && k<_exactRowStart[row+1]; ++c)
+                {
+                    if ( exact[_cellOfCol[c]] )
+                    {
+                        x[c] = _exactX[k];
+                        y[c] = _exactY[k];
+                        ++k;
+                    }
+                }
+            }
+        }
+
+    private:
+        // exact at t=0 and t=1, so control pixels come out untouched
+        static double mix(double a, double b, double t) { return (1.0-t)*a + t*b; }
+
+        static osg::Vec3d pixelCenter(const GeoExtent& ex, double dx, double dy, unsigned c, unsigned r)
+        {
+            return osg::Vec3d(ex.xMin() + ((double)c + 0.5)*dx, ex.yMin() + ((double)r + 0.5)*dy, 0.0);
+        }
+
+        // Control pixels every "spacing" pixels plus the last one; for each
+        // pixel, the cell it falls in and how far across that cell it is.
+        static void layout(unsigned size, unsigned spacing,
+                           std::vector<unsigned>& controls, std::vector<unsigned>& cellOf, std::vector<double>& fracOf)
+        {
+            for(unsigned p=0; p<size; p += spacing)
+                controls.push_back(p);
+            if ( size > 0 && controls.back() != size-1 )
+                controls.push_back(size-1);
+
+            cellOf.resize(size);
+            fracOf.resize(size);
+            unsigned cell = 0;
+            for(unsigned p=0; p<size; ++p)
+            {
+                while( cell+2 < controls.size() && p >= controls[cell+1] )
+                    ++cell;
+                unsigned next = std::min(cell+1, (unsigned)controls.size()-1);
+                unsigned span = controls[next] - controls[cell];
+                cellOf[p] = cell;
+                fracOf[p] = span > 0 ? (double)(p - controls[cell]) / (double)span : 0.0;
+            }
+        }
+
+        void interpolate(unsigned c, unsigned r, double& x, double& y) const
+        {
+            unsigned gridCols = _colPixels.size();
+            unsigned i0 = _cellOfCol[c], i1 = std::min(i0+1, gridCols-1);
+            unsigned j0 = _cellOfRow[r], j1 = std::min(j0+1, (unsigned)_rowPixels.size()-1);
+            double tx = _fracOfCol[c], ty = _fracOfRow[r];
+            x = mix(mix(_gridX[j0*gridCols+i0], _gridX[j0*gridCols+i1], tx), mix(_gridX[j1*gridCols+i0], _gridX[j1*gridCols+i1], tx), ty);
+            y = mix(mix(_gridY[j0*gridCols+i0], _gridY[j0*gridCols+i1], tx), mix(_gridY[j1*gridCols+i0], _gridY[j1*gridCols+i1], tx), ty);
+        }
+
+        unsigned _width;
+        std::vector<unsigned> _colPixels, _rowPixels;   // control pixel indexes
+        std::vector<unsigned> _cellOfCol, _cellOfRow;
+        std::vector<double>   _fracOfCol, _fracOfRow;
+        std::vector<double>   _gridX, _gridY;           // control points in source coordinates, row-major
+        bool                  _hasExact;
+        std::vector<char>     _exactCell;               // cells transformed pixel by pixel
+        std::vector<double>   _exactX, _exactY;         // their pixels' coordinates, row-major
+        std::vector<unsigned> _exactRowStart;           // index of each row's first exact pixel
+    };
+
+    // Warp grids depend only on the two extents, the sizes and the options,
+    // so tiles reprojected over and over (e.g. mercator imagery on a geodetic
+    // map) share them.
+    struct WarpGridKey
+    {
+        osg::ref_ptr<const SpatialReference> srcSRS, destSRS; // held so the pointers cannot be reused
+        double src[4], dest[4];
+        unsigned width, height, srcWidth, srcHeight, spacing;
+        double maxError;
+
+        bool operator < (const WarpGridKey& rhs) const
+        {
+            if ( srcSRS != rhs.srcSRS ) return srcSRS < rhs.srcSRS;
+            if ( destSRS != rhs.destSRS ) return destSRS < rhs.destSRS;
+            for(unsigned i=0; i<4; ++i) {
+                if ( src[i] != rhs.src[i] ) return src[i] < rhs.src[i];
+                if ( dest[i] != rhs.dest[i] ) return dest[i] < rhs.dest[i];
+            }
+            if ( width != rhs.width ) return width < rhs.width;
+            if ( height != rhs.height ) return height < rhs.height;
+            if ( srcWidth != rhs.srcWidth ) return srcWidth < rhs.srcWidth;
+            if ( srcHeight != rhs.srcHeight ) return srcHeight < rhs.srcHeight;
+            if ( spacing != rhs.spacing ) return spacing < rhs.spacing;
+            return maxError < rhs.maxError;
+        }
+    };
+
+    typedef LRUCache< WarpGridKey, osg::ref_ptr<WarpGrid> > WarpGridCache;
+
+    WarpGridCache& getWarpGridCache()
+    {
+        static WarpGridCache s_cache(true, 64);
+        return s_cache;
+    }
+
+    GeoImage::WarpOptions s_warpOptions;
+    Threading::Mutex      s_warpOptionsMutex;
+
+    osg::ref_ptr<WarpGrid> getWarpGrid(const GeoExtent& src, const GeoExtent& dest,
+                                       unsigned width, unsigned height,
+                                       unsigned srcWidth, unsigned srcHeight)
+    {
+        GeoImage::WarpOptions options = GeoImage::getWarpOptions();
+
+        WarpGridKey key;
+        key.srcSRS = src.getSRS();
+        key.destSRS = dest.getSRS();
+        key.src[0] = src.xMin(), key.src[1] = src.yMin(), key.src[2] = src.xMax(), key.src[3] = src.yMax();
+        key.dest[0] = dest.xMin(), key.dest[1] = dest.yMin(), key.dest[2] = dest.xMax(), key.dest[3] = dest.yMax();
+        key.width = width, key.height = height;
+        key.srcWidth = srcWidth, key.srcHeight = srcHeight;
+        key.spacing = std::max(options.spacing, 1u);
+        key.maxError = options.maxError;
+
+        WarpGridCache::Record record;
+        if ( getWarpGridCache().get(key, record) )
+            return record.value();
+
+        osg::ref_ptr<WarpGrid> grid = new WarpGrid(src, dest, width, height, srcWidth, srcHeight, options);
+        getWarpGridCache().insert(key, grid);
+        return grid;
+    }
+
+    // Samples one destination row of an 8-bit image with N components
+    // straight from memory. "px"/"py" are source pixel coordinates; pixels
+    // with inside[c] == 0 are left untouched.
+    template<unsigned N>
+    void sampleRowUByte(const osg::Image* image, unsigned char* out,
+                        const float* px, const float* py, const char* inside,
+                        unsigned width, bool interpolate)
+    {
+        const int s = image->s(), t = image->t();
+        for(unsigned c=0; c<width; ++c, out += N)
+        {
+            if ( !inside[c] )
+                continue;
+
+            if ( !interpolate )
+            {
+                int x = osg::clampBetween( (int)osg::round(px[c]), 0, s-1 );
+                int y = osg::clampBetween( (int)osg::round(py[c]), 0, t-1 );
+                const unsigned char* p = image->data(x, y);
+                for(unsigned k=0; k<N; ++k)
+                    out[k] = p[k];
+            }
+            else
+            {
+                int x0 = osg::clampBetween( (int)floor(px[c]), 0, s-1 ), x1 = std::min(x0+1, s-1);
+                int y0 = osg::clampBetween( (int)floor(py[c]), 0, t-1 ), y1 = std::min(y0+1, t-1);
+                float fx = osg::clampBetween( px[c] - (float)x0, 0.0f, 1.0f );
+                float fy = osg::clampBetween( py[c] - (float)y0, 0.0f, 1.0f );
+
+                const unsigned char* ll = image->data(x0, y0);
+                const unsigned char* lr = image->data(x1, y0);
+                const unsigned char* ul = image->data(x0, y1);
+                const unsigned char* ur = image->data(x1, y1);
+
+                float w00 = (1.0f-fx)*(1.0f-fy), w10 = fx*(1.0f-fy), w01 = (1.0f-fx)*fy, w11 = fx*fy;
+                for(unsigned k=0; k<N; ++k)
+                    out[k] = (unsigned char)(w00*ll[k] + w10*lr[k] + w01*ul[k] + w11*ur[k] + 0.5f);
+            }
+        }
+    }
+
+    // Same as sampleRowUByte, for any format, through PixelReader/PixelWriter.
+    void sampleRowGeneric(ImageUtils::PixelReader& ia, ImageUtils::PixelWriter& writer, const osg::Image* image,
+                          unsigned row, const float* px, const float* py, const char* inside,
+                          unsigned width, bool interpolate)
+    {
+        const int s = image->s(), t = image->t();
+        for(unsigned c=0; c<width; ++c)
+        {
+            if ( !inside[c] )
+                continue;
+
+            osg::Vec4 color;
+            if ( !interpolate )
+            {
+                int x = osg::clampBetween( (int)osg::round(px[c]), 0, s-1 );
+                int y = osg::clampBetween( (int)osg::round(py[c]), 0, t-1 );
+                color = ia(x, y);
+            }
+            else
+            {
+                int x0 = osg::clampBetween( (int)floor(px[c]), 0, s-1 ), x1 = std::min(x0+1, s-1);
+                int y0 = osg::clampBetween( (int)floor(py[c]), 0, t-1 ), y1 = std::min(y0+1, t-1);
+                float fx = osg::clampBetween( px[c] - (float)x0, 0.0f, 1.0f );
+                float fy = osg::clampBetween( py[c] - (float)y0, 0.0f, 1.0f );
+
+                osg::Vec4 ll = ia(x0, y0), lr = ia(x1, y0), ul = ia(x0, y1), ur = ia(x1, y1);
+                color = (ll*(1.0f-fx) + lr*fx)*(1.0f-fy) + (ul*(1.0f-fx) + ur*fx)*fy;
+            }
+
+            writer(color, c, row);
+        }
+    }
+
     osg::Image* manualReproject(
         const osg::Image* image, 
         const GeoExtent&  src_extent, 
@@ -1834,171 +2201,90 @@ namespace
             height = osg::minimum(image->s(), image->t());
         }
 
-        // need to know this in order to choose the right interpolation algorithm
-        const bool isSrcContiguous = src_extent.getSRS()->isContiguous();
-
         osg::Image *result = new osg::Image();
-        //result->allocateImage(width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE);
-        result->allocateImage(width, height, 1, image->getPixelFormat(), image->getDataType()); //GL_UNSIGNED_BYTE);
+        result->allocateImage(width, height, 1, image->getPixelFormat(), image->getDataType());
         result->setInternalTextureFormat(image->getInternalTextureFormat());
         ImageUtils::markAsUnNormalized(result, ImageUtils::isUnNormalized(image));
 
         //Initialize the image to be completely transparent/black
         memset(result->data(), 0, result->getImageSizeInBytes());
 
-        //ImageUtils::PixelReader ra(result);
-        ImageUtils::PixelWriter writer(result);
-        const double dx = dest_extent.width() / (double)width;
-        const double dy = dest_extent.height() / (double)height;
-
-        // offset the sample points by 1/2 a pixel so we are sampling "pixel center".
-        // (This is especially useful in the UnifiedCubeProfile since it nullifes the chances for
-        // edge ambiguity.)
-
-        unsigned int numPixels = width * height;
-
-        // Start by creating a sample grid over the destination
-        // extent. These will be the source coordinates. Then, reproject
-        // the sample grid into the source coordinate system.
-        double *srcPointsX = new double[numPixels * 2];
-        double *srcPointsY = srcPointsX + numPixels;
-        dest_extent.getSRS()->transformExtentPoints(
-            src_extent.getSRS(),
-            dest_extent.xMin() + .5 * dx, dest_extent.yMin() + .5 * dy,
-            dest_extent.xMax() - .5 * dx, dest_extent.yMax() - .5 * dy,
-            srcPointsX, srcPointsY, width, height);
-
-        // Next, go through the source-SRS sample grid, read the color at each point from the source image,
-        // and write it to the corresponding pixel in the destination image.
-        int pixel = 0;
+        // Source coordinates of each destination pixel center. (Sampling pixel
+        // centers is especially useful in the UnifiedCubeProfile since it
+        // nullifies the chances for edge ambiguity.)
+        osg::ref_ptr<WarpGrid> grid = getWarpGrid(src_extent, dest_extent, width, height, image->s(), image->t());
+
+        // 8-bit images are sampled straight from memory; everything else
+        // goes through the pixel reader and writer.
+        unsigned numComponents = osg::Image::computeNumComponents(image->getPixelFormat());
+        bool fastPath =
+            image->getDataType() == GL_UNSIGNED_BYTE &&
+            numComponents >= 1 && numComponents <= 4 &&
+            osg::Image::computePixelSizeInBits(image->getPixelFormat(), image->getDataType()) == 8*numComponents;
+
         ImageUtils::PixelReader ia(image);
+        ImageUtils::PixelWriter writer(result);
+
         double xfac = (image->s() - 1) / src_extent.width();
         double yfac = (image->t() - 1) / src_extent.height();
-        for (unsigned int c = 0; c < width; ++c)
-        {
-            for (unsigned int r = 0; r < height; ++r)
-            {   
-                double src_x = srcPointsX[pixel];
-                double src_y = srcPointsY[pixel];
-
-                if ( src_x < src_extent.xMin() || src_x > src_extent.xMax() || src_y < src_extent.yMin() || src_y > src_extent.yMax() )
-                {
-                    //If the sample point is outside of the bound of the source extent, increment the pixel and keep looping through.
-                    //OE_WARN << LC << "ERROR: sample point out of bounds: " << src_x << ", " << src_y << std::endl;
-                    pixel++;
-                    continue;
-                }
 
-                float px = (src_x - src_extent.xMin()) * xfac;
-                float py = (src_y - src_extent.yMin()) * yfac;
+        std::vector<double> srcX(width), srcY(width);
+        std::vector<double> rowX(grid->getNumControlColumns()), rowY(grid->getNumControlColumns());
+        std::vector<float>  px(width), py(width);
+        std::vector<char>   inside(width);
 
-                int px_i = osg::clampBetween( (int)osg::round(px), 0, image->s()-1 );
-                int py_i = osg::clampBetween( (int)osg::round(py), 0, image->t()-1 );
-
-                osg::Vec4 color(0,0,0,0);
+        // Walk the destination row-major so reads and writes follow memory.
+        for (unsigned int r = 0; r < height; ++r)
+        {
+            grid->getRow(r, &srcX[0], &srcY[0], &rowX[0], &rowY[0]);
 
-                // TODO: consider this again later. Causes blockiness.
-                if ( !interpolate ) //! isSrcContiguous ) // non-contiguous space- use nearest neighbot
-                {
-                    color = ia(px_i, py_i);
-                }
+            for (unsigned int c = 0; c < width; ++c)
+            {
+                // sample points outside the source extent (or that failed to
+                // transform) stay transparent.
+                inside[c] =
+                    srcX[c] >= src_extent.xMin() && srcX[c] <= src_extent.xMax() &&
+                    srcY[c] >= src_extent.yMin() && srcY[c] <= src_extent.yMax();
+
+                px[c] = (srcX[c] - src_extent.xMin()) * xfac;
+                py[c] = (srcY[c] - src_extent.yMin()) * yfac;
+            }
 
-                else // contiguous space - use bilinear sampling
+            if ( fastPath )
+            {
+                unsigned char* out = result->data(0, r);
+                switch( numComponents )
                 {
-                    int rowMin = osg::maximum((int)floor(py), 0);
-                    int rowMax = osg::maximum(osg::minimum((int)ceil(py), (int)(image->t()-1)), 0);
-                    int colMin = osg::maximum((int)floor(px), 0);
-                    int colMax = osg::maximum(osg::minimum((int)ceil(px), (int)(image->s()-1)), 0);
-
-                    if (rowMin > rowMax) rowMin = rowMax;
-                    if (colMin > colMax) colMin = colMax;
-
-                    osg::Vec4 urColor = ia(colMax, rowMax);
-                    osg::Vec4 llColor = ia(colMin, rowMin);
-                    osg::Vec4 ulColor = ia(colMin, rowMax);
-                    osg::Vec4 lrColor = ia(colMax, rowMin);
-
-                    /*Average Interpolation*/
-                    /*double x_rem = px - (int)px;
-                    double y_rem = py - (int)py;
-
-                    double w00 = (1.0 - y_rem) * (1.0 - x_rem);
-                    double w01 = (1.0 - y_rem) * x_rem;
-                    double w10 = y_rem * (1.0 - x_rem);
-                    double w11 = y_rem * x_rem;
-                    double wsum = w00 + w01 + w10 + w11;
-                    wsum = 1.0/wsum;
-
-                    color.r() = (w00 * llColor.r() + w01 * lrColor.r() + w10 * ulColor.r() + w11 * urColor.r()) * wsum;
-                    color.g() = (w00 * llColor.g() + w01 * lrColor.g() + w10 * ulColor.g() + w11 * urColor.g()) * wsum;
-                    color.b() = (w00 * llColor.b() + w01 * lrColor.b() + w10 * ulColor.b() + w11 * urColor.b()) * wsum;
-                    color.a() = (w00 * llColor.a() + w01 * lrColor.a() + w10 * ulColor.a() + w11 * urColor.a()) * wsum;*/
-
-                    /*Nearest Neighbor Interpolation*/
-                    /*if (px_i >= 0 && px_i < image->s() &&
-                    py_i >= 0 && py_i < image->t())
-                    {
-                    //OE_NOTICE << "[osgEarth::GeoData] Sampling pixel " << px << "," << py << std::endl;
-                    color = ImageUtils::getColor(image, px_i, py_i);
-                    }
-                    else
-                    {
-                    OE_NOTICE << "[osgEarth::GeoData] Pixel out of range " << px_i << "," << py_i << "  image is " << image->s() << "x" << image->t() << std::endl;
-                    }*/
-
-                    /*Bilinear interpolation*/
-                    //Check for exact value
-                    if ((colMax == colMin) && (rowMax == rowMin))
-                    {
-                        //OE_NOTICE << "[osgEarth::GeoData] Exact value" << std::endl;
-                        color = ia(px_i, py_i);
-                    }
-                    else if (colMax == colMin)
-                    {
-                        //OE_NOTICE << "[osgEarth::GeoData] Vertically" << std::endl;
-                        //Linear interpolate vertically
-                        for (unsigned int i = 0; i < 4; ++i)
-                        {
-                            color[i] = ((float)rowMax - py) * llColor[i] + (py - (float)rowMin) * ulColor[i];
-                        }
-                    }
-                    else if (rowMax == rowMin)
-                    {
-                        //OE_NOTICE << "[osgEarth::GeoData] Horizontally" << std::endl;
-                        //Linear interpolate horizontally
-                        for (unsigned int i = 0; i < 4; ++i)
-                        {
-                            color[i] = ((float)colMax - px) * llColor[i] + (px - (float)colMin) * lrColor[i];
-                        }
-                    }
-                    else
-                    {
-                        //OE_NOTICE << "[osgEarth::GeoData] Bilinear" << std::endl;
-                        //Bilinear interpolate
-                        float col1 = colMax - px, col2 = px - colMin;
-                        float row1 = rowMax - py, row2 = py - rowMin;
-                        for (unsigned int i = 0; i < 4; ++i)
-                        {
-                            float r1 = col1 * llColor[i] + col2 * lrColor[i];
-                            float r2 = col1 * ulColor[i] + col2 * urColor[i];
-
-                            //OE_INFO << "r1, r2 = " << r1 << " , " << r2 << std::endl;
-                            color[i] = row1 * r1 + row2 * r2;
-                        }
-                    }
+                case 1: sampleRowUByte<1>(image, out, &px[0], &py[0], &inside[0], width, interpolate); break;
+                case 2: sampleRowUByte<2>(image, out, &px[0], &py[0], &inside[0], width, interpolate); break;
+                case 3: sampleRowUByte<3>(image, out, &px[0], &py[0], &inside[0], width, interpolate); break;
+                case 4: sampleRowUByte<4>(image, out, &px[0], &py[0], &inside[0], width, interpolate); break;
                 }
-
-                writer(color, c, r);
-                pixel++;
+            }
+            else
+            {
+                sampleRowGeneric(ia, writer, image, r, &px[0], &py[0], &inside[0], width, interpolate);
             }
         }
 
-        delete[] srcPointsX;
-
         return result;
     }
 }
 
+void
+GeoImage::setWarpOptions(const WarpOptions& options)
+{
+    Threading::ScopedMutexLock lock(s_warpOptionsMutex);
+    s_warpOptions = options;
+}
+
+GeoImage::WarpOptions
+GeoImage::getWarpOptions()
+{
+    Threading::ScopedMutexLock lock(s_warpOptionsMutex);
+    return s_warpOptions;
+}
+
 GeoImage
 GeoImage::reproject(const SpatialReference* to_srs, const GeoExtent* to_extent, unsigned int width, unsigned int height, bool useBilinearInterpolation) const
 {  
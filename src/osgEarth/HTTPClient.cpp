@@ -574,6 +574,67 @@ HTTPClient::readOptions(const osgDB::Options* options, std::string& proxy_host,
     }
 }
 
+void
+HTTPClient::getProxySettings(const osgDB::Options* options, std::string& proxy_addr, std::string& proxy_auth) const
+{
+    std::string proxy_host;
+    std::string proxy_port = "8080";
+
+    //Try to get the proxy settings from the global settings
+    if (s_proxySettings.isSet())
+    {
+        proxy_host = s_proxySettings.get().hostName();
+        std::stringstream buf;
+        buf << s_proxySettings.get().port();
+        proxy_port = buf.str();
+
+        std::string proxy_username = s_proxySettings.get().userName();
+        std::string proxy_password = s_proxySettings.get().password();
+        if (!proxy_username.empty() && !proxy_password.empty())
+        {
+            proxy_auth = proxy_username + std::string(":") + proxy_password;
+        }
+    }
+
+    //Try to get the proxy settings from the local options that are passed in.
+    readOptions( options, proxy_host, proxy_port );
+
+    optional< ProxySettings > proxySettings;
+    ProxySettings::fromOptions( options, proxySettings );
+    if (proxySettings.isSet())
+    {
+        proxy_host = proxySettings.get().hostName();
+        proxy_port = toString<int>(proxySettings.get().port());
+        OE_DEBUG << LC << "Read proxy settings from options " << proxy_host << " " << proxy_port << std::endl;
+    }
+
+    //Try to get the proxy settings from the environment variable
+    const char* proxyEnvAddress = getenv("OSG_CURL_PROXY");
+    if (proxyEnvAddress) //Env Proxy Settings
+    {
+        proxy_host = std::string(proxyEnvAddress);
+
+        const char* proxyEnvPort = getenv("OSG_CURL_PROXYPORT"); //Searching Proxy Port on Env
+        if (proxyEnvPort)
+        {
+            proxy_port = std::string( proxyEnvPort );
+        }
+    }
+
+    const char* proxyEnvAuth = getenv("OSGEARTH_CURL_PROXYAUTH");
+    if (proxyEnvAuth)
+    {
+        proxy_auth = std::string(proxyEnvAuth);
+    }
+
+    if ( !proxy_host.empty() )
+    {
+        std::stringstream buf;
+        buf << proxy_host << ":" << proxy_port;
+        proxy_addr = buf.str();
+    }
+}
+
 bool
 HTTPClient::decodeMultipartStream(const std::string&   boundary,
                                   HTTPResponse::Part*  input,
@@ -983,70 +1044,13 @@ HTTPClient::doGet(const HTTPRequest&    request,
             options->getAuthenticationMap() :
             osgDB::Registry::instance()->getAuthenticationMap();
 
-    std::string proxy_host;
-    std::string proxy_port = "8080";
-
-    std::string proxy_auth;
-
-    //TODO: don't do all this proxy setup on every GET. Just do it once per client, or only when
-    // the proxy information changes.
-
-    //Try to get the proxy settings from the global settings
-    if (s_proxySettings.isSet())
-    {
-        proxy_host = s_proxySettings.get().hostName();
-        std::stringstream buf;
-        buf << s_proxySettings.get().port();
-        proxy_port = buf.str();
-
-        std::string proxy_username = s_proxySettings.get().userName();
-        std::string proxy_password = s_proxySettings.get().password();
-        if (!proxy_username.empty() && !proxy_password.empty())
-        {
-            proxy_auth = proxy_username + std::string(":") + proxy_password;
-        }
-    }
-
-    //Try to get the proxy settings from the local options that are passed in.
-    readOptions( options, proxy_host, proxy_port );
-
-    optional< ProxySettings > proxySettings;
-    ProxySettings::fromOptions( options, proxySettings );
-    if (proxySettings.isSet())
-    {
-        proxy_host = proxySettings.get().hostName();
-        proxy_port = toString<int>(proxySettings.get().port());
-        OE_DEBUG << LC << "Read proxy settings from options " << proxy_host << " " << proxy_port << std::endl;
-    }
-
-    //Try to get the proxy settings from the environment variable
-    const char* proxyEnvAddress = getenv("OSG_CURL_PROXY");
-    if (proxyEnvAddress) //Env Proxy Settings
-    {
-        proxy_host = std::string(proxyEnvAddress);
-
-        const char* proxyEnvPort = getenv("OSG_CURL_PROXYPORT"); //Searching Proxy Port on Env
-        if (proxyEnvPort)
-        {
-            proxy_port = std::string( proxyEnvPort );
-        }
-    }
-
-    const char* proxyEnvAuth = getenv("OSGEARTH_CURL_PROXYAUTH");
-    if (proxyEnvAuth)
-    {
-        proxy_auth = std::string(proxyEnvAuth);
-    }
-
     // Set up proxy server:
     std::string proxy_addr;
-    if ( !proxy_host.empty() )
+    std::string proxy_auth;
+    getProxySettings( options, proxy_addr, proxy_auth );
+
+    if ( !proxy_addr.empty() )
     {
-        std::stringstream buf;
-        buf << proxy_host << ":" << proxy_port;
-        std::string bufStr;
-        bufStr = buf.str();
-        proxy_addr = bufStr;
 
         if ( s_HTTP_DEBUG )
         {
@@ -1325,6 +1329,654 @@ HTTPClient::doGet(const HTTPRequest&    request,
 
 #endif // USE_WININET
 
+/****************************************************************************/
+
+namespace
+{
+    static unsigned s_maxConnectionsPerHost = 8u;
+}
+
+void
+HTTPClient::setMaxConnectionsPerHost(unsigned value)
+{
+    s_maxConnectionsPerHost = osg::maximum(value, 1u);
+}
+
+unsigned
+HTTPClient::getMaxConnectionsPerHost()
+{
+    return s_maxConnectionsPerHost;
+}
+
+#ifdef OSGEARTH_USE_WININET_FOR_HTTP
+
+// WinInet has no multi interface; resolve the request synchronously.
+Threading::Future<HTTPResponse>
+HTTPClient::getAsync(const HTTPRequest&    request,
+                     const osgDB::Options* options,
+                     ProgressCallback*     progress)
+{
+    Threading::Promise<HTTPResponse> promise;
+    promise.resolve( new HTTPResponse(get(request, options, progress)) );
+    return promise.getFuture();
+}
+
+void
+HTTPClient::globalShutdown()
+{
+    //nop
+}
+
+#else // OSGEARTH_USE_WININET_FOR_HTTP
+
+namespace osgEarth
+{
+    /**
+     * Services asynchronous HTTP requests on a single CURL multi handle.
+     * Requests with identical URLs and headers that are in flight at the
+     * same time share one transfer.
+     */
+    class HTTPAsyncEngine : public OpenThreads::Thread
+    {
+    public:
+        HTTPAsyncEngine();
+
+        virtual ~HTTPAsyncEngine();
+
+        /** Stops the worker and cancels outstanding requests. */
+        void shutdown();
+
+        Threading::Future<HTTPResponse> submit(
+            const HTTPRequest&    request,
+            const osgDB::Options* options,
+            ProgressCallback*     progress);
+
+    public: // OpenThreads::Thread
+        virtual void run();
+
+    private:
+        struct Waiter
+        {
+            Threading::Promise<HTTPResponse> _promise;
+            osg::ref_ptr<ProgressCallback>   _progress;
+        };
+        typedef std::vector<Waiter> Waiters;
+
+        // One in-flight download, shared by all waiters
+        struct Transfer
+        {
+            Transfer() : _handle(0L), _headers(0L), _httpAuth(0L), _stream(0L), _engine(0L) { _errorBuf[0] = 0; }
+            std::string         _key;
+            std::string         _url;
+            std::string         _proxyAddr;
+            std::string         _proxyAuth;
+            std::string         _userPassword;
+            long                _httpAuth;
+            CURL*               _handle;
+            struct curl_slist*  _headers;
+            osg::ref_ptr<HTTPResponse::Part> _part;
+            StreamObject        _stream;
+            Waiters             _waiters;
+            osg::Timer_t        _start;
+            HTTPAsyncEngine*    _engine;
+            char                _errorBuf[CURL_ERROR_SIZE];
+        };
+        typedef std::map<std::string, Transfer*> TransferMap;
+
+        void startThread();
+        void wakeup();
+        void setupTransfer(Transfer* t);
+        void finishTransfer(Transfer* t, CURLcode result);
+        bool reportProgress(Transfer* t, double dltotal, double dlnow);
+        CURL* acquireHandle();
+        void releaseHandle(CURL* handle);
+        HTTPResponse* clone(const HTTPResponse& rhs) const;
+
+        static int progressCallback(void* clientp, double dltotal, double dlnow, double ultotal, double ulnow);
+
+        CURLM*                   _multi;
+        std::vector<CURL*>       _freeHandles;
+        TransferMap              _inFlight;
+        std::vector<Transfer*>   _pending;
+        unsigned                 _numActive;
+        unsigned                 _maxPerHost;
+        long                     _simResponseCode;
+        std::string              _userAgent;
+        long                     _timeout;
+        long                     _connectTimeout;
+        bool                     _started;
+        bool                     _done;
+        Threading::Mutex         _mutex;
+        OpenThreads::Condition   _cond;
+    };
+}
+
+namespace
+{
+    // shared by all threads. Never destroyed, since static destruction may
+    // run after CURL is gone; HTTPClient::globalShutdown() stops the worker.
+    static HTTPAsyncEngine* s_asyncEngine = new HTTPAsyncEngine();
+}
+
+HTTPAsyncEngine::HTTPAsyncEngine() :
+_multi          ( 0L ),
+_numActive      ( 0u ),
+_maxPerHost     ( 0u ),
+_simResponseCode( -1L ),
+_timeout        ( 0L ),
+_connectTimeout ( 0L ),
+_started        ( false ),
+_done           ( false )
+{
+    //nop - no CURL calls here, curl_global_init may not have run yet.
+}
+
+HTTPAsyncEngine::~HTTPAsyncEngine()
+{
+    //nop - see shutdown()
+}
+
+void
+HTTPAsyncEngine::shutdown()
+{
+    bool started;
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+        started = _started;
+        _done = true;
+        wakeup();
+    }
+    if ( started )
+        join();
+}
+
+void
+HTTPAsyncEngine::wakeup()
+{
+    // called with _mutex held.
+    _cond.signal();
+#if LIBCURL_VERSION_NUM >= 0x074400
+    // interrupt curl_multi_poll so the worker sees the change right away.
+    if ( _multi )
+        curl_multi_wakeup( _multi );
+#endif
+}
+
+void
+HTTPAsyncEngine::startThread()
+{
+    // called with _mutex held.
+    _userAgent = s_userAgent;
+    const char* userAgentEnv = getenv("OSGEARTH_USERAGENT");
+    if (userAgentEnv)
+        _userAgent = std::string(userAgentEnv);
+
+    const char* simCode = getenv("OSGEARTH_SIMULATE_HTTP_RESPONSE_CODE");
+    if ( simCode )
+        _simResponseCode = osgEarth::as<long>(std::string(simCode), 404L);
+
+    if ( getenv("OSGEARTH_HTTP_DISABLE") )
+        _simResponseCode = 503L; // SERVICE UNAVAILABLE
+
+    _timeout = s_timeout;
+    const char* timeoutEnv = getenv("OSGEARTH_HTTP_TIMEOUT");
+    if (timeoutEnv)
+        _timeout = osgEarth::as<long>(std::string(timeoutEnv), 0);
+
+    _connectTimeout = s_connectTimeout;
+    const char* connectTimeoutEnv = getenv("OSGEARTH_HTTP_CONNECTTIMEOUT");
+    if (connectTimeoutEnv)
+        _connectTimeout = osgEarth::as<long>(std::string(connectTimeoutEnv), 0);
+
+    _multi = curl_multi_init();
+
+    _started = true;
+    start();
+}
+
+Threading::Future<HTTPResponse>
+HTTPAsyncEngine::submit(const HTTPRequest&    request,
+                        const osgDB::Options* options,
+                        ProgressCallback*     progress)
+{
+    Waiter waiter;
+    waiter._progress = progress;
+    Threading::Future<HTTPResponse> future = waiter._promise.getFuture();
+
+    std::string url = request.getURL();
+
+    osg::ref_ptr< URLRewriter > rewriter = HTTPClient::getURLRewriter();
+    if ( rewriter.valid() )
+    {
+        std::string oldURL = url;
+        url = rewriter->rewrite( oldURL );
+        OE_DEBUG << LC << "Rewrote URL " << oldURL << " to " << url << std::endl;
+    }
+
+    // Requests only coalesce if the headers match too.
+    std::stringstream buf;
+    buf << url;
+    for (Headers::const_iterator i = request.getHeaders().begin(); i != request.getHeaders().end(); ++i)
+        buf << '\n' << i->first << ": " << i->second;
+    std::string key = buf.str();
+
+    Threading::ScopedMutexLock lock(_mutex);
+
+    if ( _done )
+    {
+        // engine was shut down.
+        HTTPResponse* response = new HTTPResponse(0L);
+        response->_cancelled = true;
+        waiter._promise.resolve( response );
+        return future;
+    }
+
+    if ( !_started )
+        startThread();
+
+    if ( _simResponseCode >= 0L )
+    {
+        // simulate failure with a custom response code
+        HTTPResponse* response = new HTTPResponse(_simResponseCode);
+        if ( _simResponseCode == 408L )
+            response->_cancelled = true;
+        else
+            response->_parts.push_back( new HTTPResponse::Part() );
+        waiter._promise.resolve( response );
+        return future;
+    }
+
+    TransferMap::iterator i = _inFlight.find(key);
+    if ( i != _inFlight.end() )
+    {
+        i->second->_waiters.push_back( waiter );
+        return future;
+    }
+
+    Transfer* t = new Transfer();
+    t->_key = key;
+    t->_url = url;
+    t->_engine = this;
+    t->_waiters.push_back( waiter );
+
+    HTTPClient::getClient().getProxySettings( options, t->_proxyAddr, t->_proxyAuth );
+
+    const osgDB::AuthenticationMap* authenticationMap = (options && options->getAuthenticationMap()) ?
+        options->getAuthenticationMap() :
+        osgDB::Registry::instance()->getAuthenticationMap();
+
+    const osgDB::AuthenticationDetails* details = authenticationMap ?
+        authenticationMap->getAuthenticationDetails( url ) :
+        0L;
+
+    if ( details )
+    {
+        t->_userPassword = details->username + ":" + details->password;
+        t->_httpAuth = details->httpAuthentication;
+    }
+
+    for (Headers::const_iterator h = request.getHeaders().begin(); h != request.getHeaders().end(); ++h)
+    {
+        std::string header = h->first + ": " + h->second;
+        t->_headers = curl_slist_append(t->_headers, header.c_str());
+    }
+
+    // Disable the default Pragma: no-cache that curl adds by default.
+    t->_headers = curl_slist_append(t->_headers, "Pragma: ");
+
+    _inFlight[key] = t;
+    _pending.push_back( t );
+    wakeup();
+
+    return future;
+}
+
+CURL*
+HTTPAsyncEngine::acquireHandle()
+{
+    CURL* handle;
+    if ( !_freeHandles.empty() )
+    {
+        handle = _freeHandles.back();
+        _freeHandles.pop_back();
+        // keeps live connections and the DNS cache:
+        curl_easy_reset( handle );
+    }
+    else
+    {
+        handle = curl_easy_init();
+    }
+
+    curl_easy_setopt( handle, CURLOPT_USERAGENT, _userAgent.c_str() );
+    curl_easy_setopt( handle, CURLOPT_WRITEFUNCTION, osgEarth::StreamObjectReadCallback );
+    curl_easy_setopt( handle, CURLOPT_HEADERFUNCTION, osgEarth::StreamObjectHeaderCallback );
+    curl_easy_setopt( handle, CURLOPT_FOLLOWLOCATION, (void*)1 );
+    curl_easy_setopt( handle, CURLOPT_MAXREDIRS, (void*)5 );
+    curl_easy_setopt( handle, CURLOPT_PROGRESSFUNCTION, &HTTPAsyncEngine::progressCallback );
+    curl_easy_setopt( handle, CURLOPT_NOPROGRESS, (void*)0 ); //0=enable.
+    curl_easy_setopt( handle, CURLOPT_FILETIME, true );
+    curl_easy_setopt( handle, CURLOPT_ENCODING, "" );
+    curl_easy_setopt( handle, CURLOPT_NOSIGNAL, 1L );
+    curl_easy_setopt( handle, CURLOPT_TIMEOUT, _timeout );
+    curl_easy_setopt( handle, CURLOPT_CONNECTTIMEOUT, _connectTimeout );
+
+    //Disable peer certificate verification to allow us to access in https servers where the peer certificate cannot be verified.
+    curl_easy_setopt( handle, CURLOPT_SSL_VERIFYPEER, (void*)0 );
+
+    osg::ref_ptr< CurlConfigHandler > curlConfigHandler = HTTPClient::getCurlConfigHandler();
+    if (curlConfigHandler.valid()) {
+        curlConfigHandler->onInitialize(handle);
+    }
+
+    return handle;
+}
+
+void
+HTTPAsyncEngine::releaseHandle(CURL* handle)
+{
+    _freeHandles.push_back( handle );
+}
+
+void
+HTTPAsyncEngine::setupTransfer(Transfer* t)
+{
+    t->_handle = acquireHandle();
+    t->_part = new HTTPResponse::Part();
+    t->_stream._stream = &t->_part->_stream;
+
+    CURL* handle = t->_handle;
+    curl_easy_setopt( handle, CURLOPT_URL, t->_url.c_str() );
+    curl_easy_setopt( handle, CURLOPT_HTTPHEADER, t->_headers );
+    curl_easy_setopt( handle, CURLOPT_WRITEDATA, (void*)&t->_stream );
+    curl_easy_setopt( handle, CURLOPT_HEADERDATA, (void*)&t->_stream );
+    curl_easy_setopt( handle, CURLOPT_PROGRESSDATA, (void*)t );
+    curl_easy_setopt( handle, CURLOPT_PRIVATE, (void*)t );
+    curl_easy_setopt( handle, CURLOPT_ERRORBUFFER, (void*)t->_errorBuf );
+
+    if ( !t->_proxyAddr.empty() )
+    {
+        curl_easy_setopt( handle, CURLOPT_PROXY, t->_proxyAddr.c_str() );
+        if ( !t->_proxyAuth.empty() )
+            curl_easy_setopt( handle, CURLOPT_PROXYUSERPWD, t->_proxyAuth.c_str() );
+    }
+
+    if ( !t->_userPassword.empty() )
+    {
+        curl_easy_setopt( handle, CURLOPT_USERPWD, t->_userPassword.c_str() );
+#if LIBCURL_VERSION_NUM >= 0x070a07
+        if ( t->_httpAuth != 0L )
+            curl_easy_setopt( handle, CURLOPT_HTTPAUTH, t->_httpAuth );
+#endif
+    }
+
+    osg::ref_ptr< CurlConfigHandler > curlConfigHandler = HTTPClient::getCurlConfigHandler();
+    if (curlConfigHandler.valid()) {
+        curlConfigHandler->onGet(handle);
+    }
+
+    t->_start = osg::Timer::instance()->tick();
+
+    curl_multi_add_handle( _multi, handle );
+}
+
+bool
+HTTPAsyncEngine::reportProgress(Transfer* t, double dltotal, double dlnow)
+{
+    // Returns true to abort the transfer, which happens only when
+    // every waiter has cancelled or walked away. Callbacks run outside
+    // the lock in case they make requests of their own.
+    bool keepGoing = false;
+    std::vector< osg::ref_ptr<ProgressCallback> > callbacks;
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+        for (Waiters::iterator w = t->_waiters.begin(); w != t->_waiters.end(); ++w)
+        {
+            if ( w->_promise.isAbandoned() )
+                continue;
+            else if ( w->_progress.valid() )
+                callbacks.push_back( w->_progress.get() );
+            else
+                keepGoing = true;
+        }
+    }
+
+    for (unsigned i = 0; i < callbacks.size(); ++i)
+    {
+        if ( !callbacks[i]->isCanceled() && !callbacks[i]->reportProgress(dlnow, dltotal) )
+            keepGoing = true;
+    }
+
+    return !keepGoing;
+}
+
+int
+HTTPAsyncEngine::progressCallback(void* clientp, double dltotal, double dlnow, double ultotal, double ulnow)
+{
+    Transfer* t = static_cast<Transfer*>(clientp);
+    return t->_engine->reportProgress(t, dltotal, dlnow) ? 1 : 0;
+}
+
+HTTPResponse*
+HTTPAsyncEngine::clone(const HTTPResponse& rhs) const
+{
+    // Deep copy, so that each waiter can read its part streams independently.
+    HTTPResponse* response = new HTTPResponse( rhs._response_code );
+    response->_mimeType     = rhs._mimeType;
+    response->_cancelled    = rhs._cancelled;
+    response->_duration_s   = rhs._duration_s;
+    response->_lastModified = rhs._lastModified;
+    response->_message      = rhs._message;
+
+    for (HTTPResponse::Parts::const_iterator i = rhs._parts.begin(); i != rhs._parts.end(); ++i)
+    {
+        HTTPResponse::Part* part = new HTTPResponse::Part();
+        part->_headers = (*i)->_headers;
+        part->_size    = (*i)->_size;
+        part->_stream << (*i)->_stream.str();
+        response->_parts.push_back( part );
+    }
+    return response;
+}
+
+void
+HTTPAsyncEngine::finishTransfer(Transfer* t, CURLcode res)
+{
+    long response_code = 0L;
+    curl_easy_getinfo( t->_handle, CURLINFO_RESPONSE_CODE, &response_code );
+
+    HTTPResponse response( response_code );
+
+    char* content_type_cp = 0L;
+    curl_easy_getinfo( t->_handle, CURLINFO_CONTENT_TYPE, &content_type_cp );
+    if ( content_type_cp != NULL )
+    {
+        response._mimeType = content_type_cp;
+    }
+
+    response._lastModified = getCurlFileTime( t->_handle );
+
+    if ( res != CURLE_OK )
+    {
+        response._message = t->_errorBuf[0] ? std::string(t->_errorBuf) : std::string(curl_easy_strerror(res));
+    }
+
+    if ( res != CURLE_ABORTED_BY_CALLBACK && res != CURLE_OPERATION_TIMEDOUT )
+    {
+        if (response._mimeType.length() > 9 &&
+            ::strstr( response._mimeType.c_str(), "multipart" ) == response._mimeType.c_str() )
+        {
+            //TODO: parse out the "wcs" -- this is WCS-specific
+            HTTPClient::getClient().decodeMultipartStream( "wcs", t->_part.get(), response._parts );
+        }
+        else
+        {
+            for (Headers::iterator itr = t->_stream._headers.begin(); itr != t->_stream._headers.end(); ++itr)
+            {
+                t->_part->_headers[itr->first] = itr->second;
+            }
+            response._parts.push_back( t->_part.get() );
+        }
+    }
+    else
+    {
+        response._cancelled = true;
+    }
+
+    response._duration_s = osg::Timer::instance()->delta_s( t->_start, osg::Timer::instance()->tick() );
+
+    if ( s_HTTP_DEBUG )
+    {
+        OE_NOTICE << LC
+            << "ASYNC GET(" << response_code << ", " << response._mimeType << ") : \""
+            << t->_url << "\" waiters=" << t->_waiters.size() << " t="
+            << std::setprecision(4) << response.getDuration() << "s" << std::endl;
+    }
+
+    curl_multi_remove_handle( _multi, t->_handle );
+    releaseHandle( t->_handle );
+    t->_handle = 0L;
+
+    // Detach from the in-flight table first so that a new request for
+    // the same URL made from a completion handler starts a new transfer.
+    Waiters waiters;
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+        _inFlight.erase( t->_key );
+        waiters.swap( t->_waiters );
+        --_numActive;
+    }
+
+    for (Waiters::iterator w = waiters.begin(); w != waiters.end(); ++w)
+    {
+        HTTPResponse* copy = clone(response);
+        // a waiter that cancelled gets a cancelled response even if others did not
+        if ( !copy->_cancelled && w->_progress.valid() && w->_progress->isCanceled() )
+            copy->_cancelled = true;
+        w->_promise.resolve( copy );
+    }
+
+    if ( t->_headers )
+        curl_slist_free_all( t->_headers );
+
+    delete t;
+}
+
+void
+HTTPAsyncEngine::run()
+{
+    while ( true )
+    {
+        std::vector<Transfer*> incoming;
+        {
+            Threading::ScopedMutexLock lock(_mutex);
+            while ( !_done && _pending.empty() && _numActive == 0u )
+            {
+                _cond.wait( &_mutex );
+            }
+            if ( _done )
+                break;
+            incoming.swap( _pending );
+            _numActive += incoming.size();
+        }
+
+#if LIBCURL_VERSION_NUM >= 0x071e00
+        if ( _maxPerHost != s_maxConnectionsPerHost )
+        {
+            _maxPerHost = s_maxConnectionsPerHost;
+            curl_multi_setopt( _multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)_maxPerHost );
+        }
+#endif
+
+        for (std::vector<Transfer*>::iterator i = incoming.begin(); i != incoming.end(); ++i)
+        {
+            setupTransfer( *i );
+        }
+
+        int running = 0;
+        curl_multi_perform( _multi, &running );
+
+        CURLMsg* msg;
+        int msgsLeft = 0;
+        while ( (msg = curl_multi_info_read(_multi, &msgsLeft)) != 0L )
+        {
+            if ( msg->msg == CURLMSG_DONE )
+            {
+                Transfer* t = 0L;
+                curl_easy_getinfo( msg->easy_handle, CURLINFO_PRIVATE, (char**)&t );
+                if ( t )
+                {
+                    finishTransfer( t, msg->data.result );
+                }
+            }
+        }
+
+        if ( running > 0 )
+        {
+#if LIBCURL_VERSION_NUM >= 0x074400
+            // submit() and shutdown() interrupt the poll via wakeup()
+            int numfds = 0;
+            curl_multi_poll( _multi, 0L, 0, 1000, &numfds );
+#elif LIBCURL_VERSION_NUM >= 0x071c00
+            // no curl_multi_wakeup; short timeout so new submissions are picked up promptly
+            int numfds = 0;
+            curl_multi_wait( _multi, 0L, 0, 10, &numfds );
+#else
+            OpenThreads::Thread::microSleep( 1000 );
+#endif
+        }
+    }
+
+    // shut down: abandon anything still in flight.
+    for (TransferMap::iterator i = _inFlight.begin(); i != _inFlight.end(); ++i)
+    {
+        Transfer* t = i->second;
+        if ( t->_handle )
+        {
+            curl_multi_remove_handle( _multi, t->_handle );
+            curl_easy_cleanup( t->_handle );
+        }
+        if ( t->_headers )
+            curl_slist_free_all( t->_headers );
+        for (Waiters::iterator w = t->_waiters.begin(); w != t->_waiters.end(); ++w)
+        {
+            HTTPResponse* response = new HTTPResponse(0L);
+            response->_cancelled = true;
+            w->_promise.resolve( response );
+        }
+        delete t;
+    }
+    _inFlight.clear();
+    _pending.clear();
+
+    for (std::vector<CURL*>::iterator i = _freeHandles.begin(); i != _freeHandles.end(); ++i)
+        curl_easy_cleanup( *i );
+    _freeHandles.clear();
+
+    CURLM* multi;
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+        multi = _multi;
+        _multi = 0L;
+    }
+    curl_multi_cleanup( multi );
+}
+
+Threading::Future<HTTPResponse>
+HTTPClient::getAsync(const HTTPRequest&    request,
+                     const osgDB::Options* options,
+                     ProgressCallback*     progress)
+{
+    return s_asyncEngine->submit( request, options, progress );
+}
+
+void
+HTTPClient::globalShutdown()
+{
+    s_asyncEngine->shutdown();
+}
+
+#endif // OSGEARTH_USE_WININET_FOR_HTTP
+
 bool
 HTTPClient::doDownload(const std::string& url, const std::string& filename)
 {
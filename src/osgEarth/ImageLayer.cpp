@@ -84,6 +84,7 @@ ImageLayerOptions::setDefaults()
     _minRange.init( 0.0 );
     _maxRange.init( FLT_MAX );
     _featherPixels.init( false );
+    _cachePassthrough.init( false );
     _minFilter.init( osg::Texture::LINEAR_MIPMAP_LINEAR );
     _magFilter.init( osg::Texture::LINEAR );
     _texcomp.init( osg::Texture::USE_IMAGE_DATA_FORMAT ); // none
@@ -107,6 +108,7 @@ ImageLayerOptions::fromConfig(const Config& conf)
     conf.getIfSet( "shared",         _shared );
     conf.getIfSet( "coverage",       _coverage );
     conf.getIfSet( "feather_pixels", _featherPixels);
+    conf.getIfSet( "cache_passthrough", _cachePassthrough );
 
     if ( conf.hasValue( "transparent_color" ) )
         _transparentColor = stringToColor( conf.value( "transparent_color" ), osg::Vec4ub(0,0,0,0));
@@ -152,6 +154,7 @@ ImageLayerOptions::getConfig() const
     conf.set( "shared",         _shared );
     conf.set( "coverage",       _coverage );
     conf.set( "feather_pixels", _featherPixels );
+    conf.set( "cache_passthrough", _cachePassthrough );
 
     if (_transparentColor.isSet())
         conf.set("transparent_color", colorToString( _transparentColor.value()));
@@ -476,9 +479,9 @@ GeoImage
 ImageLayer::createImage(const TileKey&    key,
                         ProgressCallback* progress)
 {
-    ScopedMetric m("ImageLayer::createImage", 2,
-                    "key", key.str().c_str(),
-                    "name", getName().c_str());
+    METRIC_SCOPED_EX("ImageLayer::createImage", 2,
+                     "key", key.str().c_str(),
+                     "name", getName().c_str());
 
     if (getStatus().isError())
     {
@@ -593,11 +596,13 @@ ImageLayer::createImageInKeyProfile(const TileKey&    key,
     std::string cacheKey = Stringify() << key.str() << "_" << key.getProfile()->getHorizSignature();
     const CachePolicy& policy = getCacheSettings()->cachePolicy().get();
     
-    // Check the layer L2 cache first
+    // Check the layer L2 cache first. Always take a private copy, even when the
+    // cache shares its objects, since callers compress, mipmap and reproject
+    // the image in place.
     if ( _memCache.valid() )
     {
         CacheBin* bin = _memCache->getOrCreateDefaultBin();
-        ReadResult result = bin->readObject(cacheKey, 0L);
+        ReadResult result = bin->readObject(cacheKey, _memCache->getCopyOptions());
         if ( result.succeeded() )
             return GeoImage(static_cast<osg::Image*>(result.releaseObject()), key.getExtent());
     }
@@ -629,6 +634,30 @@ ImageLayer::createImageInKeyProfile(const TileKey&    key,
         return GeoImage::INVALID;
     }
 
+    // In passthrough mode the cache holds the tile source's own encoding,
+    // and this is the one place the pixels are needed.
+    if ( options().cachePassthrough() == true && canCreateEncodedImage(key) )
+    {
+        osg::ref_ptr<EncodedImage> encoded = createEncodedImage(key, progress);
+        osg::ref_ptr<osg::Image> image = encoded.valid() ? encoded->decode( getReadOptions() ) : 0L;
+        if ( image.valid() )
+        {
+            ImageUtils::fixInternalFormat( image.get() );
+
+            if ( _memCache.valid() )
+            {
+                _memCache->getOrCreateDefaultBin()->write(cacheKey, image.get(), _memCache->getCopyOptions());
+            }
+
+            return GeoImage( image.get(), key.getExtent() );
+        }
+
+        // A cache-only layer may still hold tiles cached before passthrough
+        // was turned on; otherwise the tile source had nothing to give.
+        if ( !policy.isCacheOnly() )
+            return GeoImage::INVALID;
+    }
+
     osg::ref_ptr< osg::Image > cachedImage;
 
     // First, attempt to read from the cache. Since the cached data is stored in the
@@ -687,7 +716,7 @@ ImageLayer::createImageInKeyProfile(const TileKey&    key,
     if ( result.valid() && _memCache.valid() )
     {
         CacheBin* bin = _memCache->getOrCreateDefaultBin();
-        bin->write(cacheKey, result.getImage(), 0L);
+        bin->write(cacheKey, result.getImage(), _memCache->getCopyOptions());
     }
 
     // If we got a result, the cache is valid and we are caching in the map profile,
@@ -724,6 +753,80 @@ ImageLayer::createImageInKeyProfile(const TileKey&    key,
 
 
 
+bool
+ImageLayer::canCreateEncodedImage(const TileKey& key) const
+{
+    const CachePolicy& policy = getCacheSettings()->cachePolicy().get();
+
+    // in cache-only mode there may be no tile source, only the cache:
+    TileSource* source = getTileSource();
+    if ( !policy.isCacheOnly() && (!source || !source->supportsEncodedImages()) )
+        return false;
+
+    // anything that touches the pixels rules out passing the bytes through:
+    return
+        getProfile() &&
+        key.getProfile()->isHorizEquivalentTo( getProfile() ) &&
+        !options().transparentColor().isSet() &&
+        !(options().noDataImageFilename().isSet() && !options().noDataImageFilename()->empty()) &&
+        options().featherPixels() != true &&
+        options().coverage() != true;
+}
+
+EncodedImage*
+ImageLayer::createEncodedImage(const TileKey&    key,
+                               ProgressCallback* progress)
+{
+    if ( getStatus().isError() || !isKeyInLegalRange(key) || !canCreateEncodedImage(key) )
+        return 0L;
+
+    // Encoded records are StringObjects, not images, so they get their own key;
+    // otherwise createImage would find one where it expects decoded pixels.
+    std::string cacheKey = Stringify() << key.str() << "_" << key.getProfile()->getHorizSignature() << "_encoded";
+    const CachePolicy& policy = getCacheSettings()->cachePolicy().get();
+    CacheBin* cacheBin = getCacheBin( key.getProfile() );
+
+    osg::ref_ptr<EncodedImage> cached;
+    if ( cacheBin && policy.isCacheReadable() )
+    {
+        ReadResult r = cacheBin->readEncodedImage(cacheKey, cached);
+        if ( r.succeeded() && !policy.isExpired(r.lastModifiedTime()) )
+        {
+            OE_DEBUG << LC << "Got cached encoded image for " << key.str() << std::endl;
+            return cached.release();
+        }
+    }
+
+    // If it's cache only, an expired record is as good as it gets.
+    if ( policy.isCacheOnly() )
+        return cached.release();
+
+    TileSource* source = getTileSource();
+
+    if ( source->getBlacklist()->contains(key) || !mayHaveData(key) )
+        return cached.release();
+
+    osg::ref_ptr<EncodedImage> result = source->createEncodedImage(key, progress);
+
+    if ( result.valid() && result->valid() )
+    {
+        if ( cacheBin && policy.isCacheWriteable() )
+        {
+            cacheBin->writeEncodedImage(cacheKey, result.get(), Config());
+        }
+        return result.release();
+    }
+
+    // Blacklist the tile unless the request was canceled or may be retried,
+    // just as createImageFromTileSource does.
+    if ( progress == 0L || (!progress->isCanceled() && !progress->needsRetry()) )
+    {
+        source->getBlacklist()->add( key );
+    }
+
+    return cached.release();
+}
+
 GeoImage
 ImageLayer::createImageFromTileSource(const TileKey&    key,
                                       ProgressCallback* progress)
@@ -20,6 +20,9 @@
 #include <osgEarth/StringUtils>
 #include <osgEarth/ThreadingUtils>
 #include <osgEarth/Containers>
+#include <osg/Image>
+#include <osg/Shape>
+#include <climits>
 
 using namespace osgEarth;
 
@@ -29,29 +32,56 @@ using namespace osgEarth;
 
 namespace
 {
+    // plugin-string key that requests a private copy from a shared bin
+    const char* COPY_HINT = "osgEarth::MemCache::copy";
+
     typedef std::pair<osg::ref_ptr<const osg::Object>, Config> MemCacheEntry;
-    typedef LRUCache<std::string, MemCacheEntry> MemCacheLRU;
+    typedef ConcurrentLRUCache<std::string, MemCacheEntry> MemCacheLRU;
+
+    bool wantsCopy(const osgDB::Options* dbo)
+    {
+        return dbo && !dbo->getPluginStringData(COPY_HINT).empty();
+    }
 
     struct MemCacheBin : public CacheBin
     {
-        MemCacheBin( const std::string& id, unsigned maxSize )
+        MemCacheBin( const std::string& id, unsigned maxSize, unsigned long long maxBytes, bool share )
             : CacheBin( id ),
-              _lru    ( true /* MT-safe */, maxSize )
+              _lru    ( maxBytes > 0 ? INT_MAX : maxSize, numShards(maxBytes) ),
+              _share  ( share ),
+              _bytes  ( maxBytes > 0 )
+        {
+            if ( _bytes )
+                _lru.setMaxCost( maxBytes );
+        }
+
+        // A byte budget is split evenly across shards, so keep each
+        // shard large enough to hold a few big tiles.
+        static unsigned numShards(unsigned long long maxBytes)
         {
-            //nop
+            if ( maxBytes == 0 )
+                return 16u;
+            return (unsigned)osg::clampBetween(maxBytes / (4ULL*1024ULL*1024ULL), 1ULL, 16ULL);
         }
 
-        ReadResult readObject(const std::string& key, const osgDB::Options*)
+        ReadResult readObject(const std::string& key, const osgDB::Options* readOptions)
         {
             MemCacheLRU::Record rec;
             _lru.get(key, rec);
 
-            // clone required since the cache is in memory
-
             if ( rec.valid() )
             {
                 //OE_INFO << LC << "hits: " << _lru.getStats()._hitRatio*100.0f << "%" << std::endl;
 
+                // shared mode: every reader gets the same (immutable) object.
+                if ( _share && !wantsCopy(readOptions) )
+                {
+                    return ReadResult(
+                        const_cast<osg::Object*>(rec.value().first.get()),
+                        rec.value().second );
+                }
+
+                // clone required since the cache is in memory
                 return ReadResult( 
                    osg::clone(rec.value().first.get(), osg::CopyOp::DEEP_COPY_ALL),
                    rec.value().second );
@@ -77,8 +107,12 @@ namespace
         {
             if ( object ) 
             {
-                osg::ref_ptr<const osg::Object> cloned = osg::clone(object, osg::CopyOp::DEEP_COPY_ALL);
-                _lru.insert( key, std::make_pair(cloned.get(), meta) );
+                osg::ref_ptr<const osg::Object> stored = object;
+                if ( !_share || wantsCopy(writeOptions) )
+                    stored = osg::clone(object, osg::CopyOp::DEEP_COPY_ALL);
+
+                unsigned long long cost = _bytes ? MemCache::getSizeInBytes(object) + key.size() : 1u;
+                _lru.insert( key, std::make_pair(stored.get(), meta), cost );
                 return true;
             }
             else
@@ -116,6 +150,8 @@ namespace
         }
 
         MemCacheLRU _lru;
+        bool        _share;
+        bool        _bytes;
     };
     
 
@@ -126,6 +162,22 @@ namespace
 
 MemCache::MemCache( unsigned maxBinSize ) :
 _maxBinSize( std::max(maxBinSize, 1u) ),
+_maxBinBytes( 0 ),
+_shareObjects( false ),
+_reads(0),
+_writes(0),
+_hits(0)
+{
+    _copyOptions = new osgDB::Options();
+    _copyOptions->setPluginStringData( COPY_HINT, "true" );
+}
+
+MemCache::MemCache( const MemCache& rhs, const osg::CopyOp& op ) :
+Cache( rhs, op ),
+_maxBinSize( rhs._maxBinSize ),
+_maxBinBytes( rhs._maxBinBytes ),
+_shareObjects( rhs._shareObjects ),
+_copyOptions( rhs._copyOptions.get() ),
 _reads(0),
 _writes(0),
 _hits(0)
@@ -133,10 +185,16 @@ _hits(0)
     //nop
 }
 
+CacheBin*
+MemCache::createBin( const std::string& binID ) const
+{
+    return new MemCacheBin(binID, _maxBinSize, _maxBinBytes, _shareObjects);
+}
+
 CacheBin*
 MemCache::addBin( const std::string& binID )
 {
-    return _bins.getOrCreate( binID, new MemCacheBin(binID, _maxBinSize) );
+    return _bins.getOrCreate( binID, createBin(binID) );
 }
 
 CacheBin*
@@ -157,18 +215,41 @@ MemCache::getOrCreateDefaultBin()
         // double check
         if ( !_defaultBin.valid() )
         {
-            _defaultBin = new MemCacheBin("__default", _maxBinSize);
+            _defaultBin = createBin("__default");
         }
     }
 
     return _defaultBin.get();
 }
 
+unsigned long long
+MemCache::getSizeInBytes(const osg::Object* object)
+{
+    if ( !object )
+        return 0u;
+
+    const osg::Image* image = dynamic_cast<const osg::Image*>(object);
+    if ( image )
+        return sizeof(osg::Image) + image->getTotalSizeInBytesIncludingMipmaps();
+
+    const osg::HeightField* hf = dynamic_cast<const osg::HeightField*>(object);
+    if ( hf )
+        return sizeof(osg::HeightField) + hf->getFloatArray()->getTotalDataSize();
+
+    const StringObject* str = dynamic_cast<const StringObject*>(object);
+    if ( str )
+        return sizeof(StringObject) + str->getString().size();
+
+    // unknown type; assume something small.
+    return 1024u;
+}
 
 void
 MemCache::dumpStats(const std::string& binID)
 {
     MemCacheBin* bin = static_cast<MemCacheBin*>(getBin(binID));
     CacheStats stats = bin->_lru.getStats();
-    OE_INFO << LC << "hit ratio = " << stats._hitRatio << std::endl;
+    OE_INFO << LC << "hit ratio = " << stats._hitRatio
+        << ", entries = " << stats._entries
+        << ", bytes = " << (bin->_bytes ? bin->_lru.getTotalCost() : 0ULL) << std::endl;
 }
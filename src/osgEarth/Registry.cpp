@@ -169,6 +169,9 @@ _threadPoolSize(2u)
 
 Registry::~Registry()
 {
+    // stop the async HTTP worker while CURL is still around
+    HTTPClient::globalShutdown();
+
     // pop the custom error handler
     CPLPopErrorHandler();
 }
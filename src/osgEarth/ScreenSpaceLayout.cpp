@@ -31,6 +31,7 @@
 #include <osgText/Text>
 #include <osg/UserDataContainer>
 #include <osg/ValueObject>
+#include <osg/Math>
 #include <set>
 #include <algorithm>
 
@@ -128,8 +129,6 @@ namespace
     };
 
     typedef std::map<const osg::Drawable*, DrawableInfo> DrawableMemory;
-    
-    typedef std::pair<const osg::Node*, osg::BoundingBox> RenderLeafBox;
 
     // Data structure stored one-per-View.
     struct PerCamInfo
@@ -142,7 +141,7 @@ namespace
         // re-usable structures (to avoid unnecessary re-allocation)
         osgUtil::RenderBin::RenderLeafList _passed;
         osgUtil::RenderBin::RenderLeafList _failed;
-        std::vector<RenderLeafBox>         _used;
+        ScreenSpaceOccupancyGrid           _used;
 
         // time stamp of the previous pass, for calculating animation speed
         osg::Timer_t _lastTimeStamp;
@@ -195,6 +194,130 @@ ScreenSpaceLayoutOptions::getConfig() const
 
 //----------------------------------------------------------------------------
 
+ScreenSpaceOccupancyGrid::ScreenSpaceOccupancyGrid() :
+_x0         ( 0.0f ),
+_y0         ( 0.0f ),
+_invCellSize( 1.0f ),
+_cols       ( 1 ),
+_rows       ( 1 )
+{
+    _cells.resize(1);
+}
+
+void
+ScreenSpaceOccupancyGrid::reset(float xmin, float ymin, float xmax, float ymax, float cellSize)
+{
+    // cap the cell count so a huge viewport doesn't cost more to clear than it saves.
+    const int maxCells = 256;
+
+    cellSize = osg::maximum(cellSize, 1.0f);
+    _x0 = xmin;
+    _y0 = ymin;
+    _invCellSize = 1.0f / cellSize;
+    _cols = osg::clampBetween( (int)ceil((xmax - xmin) * _invCellSize), 1, maxCells );
+    _rows = osg::clampBetween( (int)ceil((ymax - ymin) * _invCellSize), 1, maxCells );
+
+    // clear (but keep the capacity of) the existing cells:
+    _cells.resize( _cols * _rows );
+    for(unsigned i=0; i<_cells.size(); ++i)
+        _cells[i].clear();
+
+    _entries.clear();
+    _unbounded.clear();
+}
+
+void
+ScreenSpaceOccupancyGrid::getCellRange(const osg::BoundingBox& box, int& c0, int& r0, int& c1, int& r1) const
+{
+    // Clamping is monotonic, so any two boxes that overlap are guaranteed to
+    // share at least one cell even if they fall outside the grid.
+    c0 = osg::clampBetween( (int)floor(osg::clampBetween((box.xMin() - _x0) * _invCellSize, -1.0f, (float)_cols)), 0, _cols-1 );
+    c1 = osg::clampBetween( (int)floor(osg::clampBetween((box.xMax() - _x0) * _invCellSize, -1.0f, (float)_cols)), 0, _cols-1 );
+    r0 = osg::clampBetween( (int)floor(osg::clampBetween((box.yMin() - _y0) * _invCellSize, -1.0f, (float)_rows)), 0, _rows-1 );
+    r1 = osg::clampBetween( (int)floor(osg::clampBetween((box.yMax() - _y0) * _invCellSize, -1.0f, (float)_rows)), 0, _rows-1 );
+}
+
+bool
+ScreenSpaceOccupancyGrid::conflicts(const Entry& entry, const osg::BoundingBox& box, const void* owner) const
+{
+    // only need a 2D test since we're in window space
+    bool isClear =
+        box.xMin() > entry._box.xMax() ||
+        box.xMax() < entry._box.xMin() ||
+        box.yMin() > entry._box.yMax() ||
+        box.yMax() < entry._box.yMin();
+
+    return !isClear && owner != entry._owner;
+}
+
+namespace
+{
+    inline bool hasNaN(const osg::BoundingBox& box)
+    {
+        return
+            osg::isNaN(box.xMin()) || osg::isNaN(box.xMax()) ||
+            osg::isNaN(box.yMin()) || osg::isNaN(box.yMax());
+    }
+}
+
+bool
+ScreenSpaceOccupancyGrid::overlaps(const osg::BoundingBox& box, const void* owner) const
+{
+    // NaN compares as overlapping, so such a box conflicts with every other owner.
+    if ( hasNaN(box) )
+    {
+        for(unsigned i=0; i<_entries.size(); ++i)
+            if ( conflicts(_entries[i], box, owner) )
+                return true;
+        return false;
+    }
+
+    for(unsigned i=0; i<_unbounded.size(); ++i)
+        if ( conflicts(_entries[_unbounded[i]], box, owner) )
+            return true;
+
+    int c0, r0, c1, r1;
+    getCellRange(box, c0, r0, c1, r1);
+
+    for(int r=r0; r<=r1; ++r)
+    {
+        for(int c=c0; c<=c1; ++c)
+        {
+            const std::vector<unsigned>& cell = _cells[r*_cols + c];
+            for(unsigned i=0; i<cell.size(); ++i)
+            {
+                if ( conflicts(_entries[cell[i]], box, owner) )
+                    return true;
+            }
+        }
+    }
+    return false;
+}
+
+void
+ScreenSpaceOccupancyGrid::insert(const osg::BoundingBox& box, const void* owner)
+{
+    unsigned index = _entries.size();
+    _entries.push_back( Entry() );
+    _entries.back()._box = box;
+    _entries.back()._owner = owner;
+
+    if ( hasNaN(box) )
+    {
+        _unbounded.push_back( index );
+        return;
+    }
+
+    int c0, r0, c1, r1;
+    getCellRange(box, c0, r0, c1, r1);
+
+    for(int r=r0; r<=r1; ++r)
+        for(int c=c0; c<=c1; ++c)
+            _cells[r*_cols + c].push_back( index );
+}
+
+//----------------------------------------------------------------------------
+
 /**
  * A custom RenderLeaf sorting algorithm for decluttering objects.
  *
@@ -275,7 +398,6 @@ struct /*internal*/ DeclutterSort : public osgUtil::RenderBin::SortCallback
         // Reset the local re-usable containers
         local._passed.clear();          // drawables that pass occlusion test
         local._failed.clear();          // drawables that fail occlusion test
-        local._used.clear();            // list of occupied bounding boxes in screen space
 
         // compute a window matrix so we can do window-space culling. If this is an RTT camera
         // with a reference camera attachment, we actually want to declutter in the window-space
@@ -287,6 +409,7 @@ struct /*internal*/ DeclutterSort : public osgUtil::RenderBin::SortCallback
         osg::Vec3f  refCamScale(1.0f, 1.0f, 1.0f);
         osg::Matrix refCamScaleMat;
         osg::Matrix refWindowMatrix = windowMatrix;
+        const osg::Viewport* declutterVP = vp;
 
         if ( cam->isRenderToTextureCamera() )
         {
@@ -297,9 +420,15 @@ struct /*internal*/ DeclutterSort : public osgUtil::RenderBin::SortCallback
                 refCamScale.set( vp->width() / refVP->width(), vp->height() / refVP->height(), 1.0 );
                 refCamScaleMat.makeScale( refCamScale );
                 refWindowMatrix = refVP->computeWindowMatrix();
+                declutterVP = refVP;
             }
         }
 
+        // occupied bounding boxes in screen space
+        local._used.reset(
+            declutterVP->x(), declutterVP->y(),
+            declutterVP->x() + declutterVP->width(), declutterVP->y() + declutterVP->height() );
+
         // Track the parent nodes of drawables that are obscured (and culled). Drawables
         // with the same parent node (typically a Geode) are considered to be grouped and
         // will be culled as a group.
@@ -440,24 +569,10 @@ struct /*internal*/ DeclutterSort : public osgUtil::RenderBin::SortCallback
                 else
                 {
                     // weed out any drawables that are obscured by closer drawables.
-                    // TODO: think about a more efficient algorithm - right now we are just using
-                    // brute force to compare all bbox's
-                    for( std::vector<RenderLeafBox>::const_iterator j = local._used.begin(); j != local._used.end(); ++j )
+                    // A conflict with the same drawable parent is acceptable.
+                    if ( local._used.overlaps(box, drawableParent) )
                     {
-                        // only need a 2D test since we're in clip space
-                        bool isClear =
-                            box.xMin() > j->second.xMax() ||
-                            box.xMax() < j->second.xMin() ||
-                            box.yMin() > j->second.yMax() ||
-                            box.yMax() < j->second.yMin();
-
-                        // if there's an overlap (and the conflict isn't from the same drawable
-                        // parent, which is acceptable), then the leaf is culled.
-                        if ( !isClear && drawableParent != j->first )
-                        {
-                            visible = false;
-                            break;
-                        }
+                        visible = false;
                     }
                 }
             }
@@ -466,7 +581,7 @@ struct /*internal*/ DeclutterSort : public osgUtil::RenderBin::SortCallback
             {
                 // passed the test, so add the leaf's bbox to the "used" list, and add the leaf
                 // to the final draw list.
-                local._used.push_back( std::make_pair(drawableParent, box) );
+                local._used.insert( box, drawableParent );
                 local._passed.push_back( leaf );
             }
 
@@ -18,11 +18,14 @@
  */
 
 #include <osgEarth/SpatialReference>
+#include <osgEarth/AnalyticTransform>
 #include <osgEarth/Registry>
 #include <osgEarth/Cube>
 #include <osgEarth/LocalTangentPlane>
 #include <osgEarth/ECEF>
 #include <osgEarth/ThreadingUtils>
+#include <osgEarth/Containers>
+#include <OpenThreads/Atomic>
 #include <osg/Notify>
 #include <ogr_api.h>
 #include <ogr_spatialref.h>
@@ -53,64 +56,195 @@ namespace
     }    
 
     // http://en.wikipedia.org/wiki/Mercator_projection#Mathematics_of_the_projection
+    inline void sphericalMercatorToGeographic( osg::Vec3d& point )
+    {
+        double x = osg::clampBetween(point.x(), MERC_MINX, MERC_MAXX);
+        double y = osg::clampBetween(point.y(), MERC_MINY, MERC_MAXY);
+        double xr = -osg::PI + ((x-MERC_MINX)/MERC_WIDTH)*2.0*osg::PI;
+        double yr = -osg::PI + ((y-MERC_MINY)/MERC_HEIGHT)*2.0*osg::PI;
+        point.x() = osg::RadiansToDegrees( xr );
+        point.y() = osg::RadiansToDegrees( 2.0 * atan( exp(yr) ) - osg::PI_2 );
+        // z doesn't change here.
+    }
+
     bool sphericalMercatorToGeographic( std::vector<osg::Vec3d>& points )
     {
         for( unsigned i=0; i<points.size(); ++i )
         {
-            double x = osg::clampBetween(points[i].x(), MERC_MINX, MERC_MAXX);
-            double y = osg::clampBetween(points[i].y(), MERC_MINY, MERC_MAXY);
-            double xr = -osg::PI + ((x-MERC_MINX)/MERC_WIDTH)*2.0*osg::PI;
-            double yr = -osg::PI + ((y-MERC_MINY)/MERC_HEIGHT)*2.0*osg::PI;
-            points[i].x() = osg::RadiansToDegrees( xr );
-            points[i].y() = osg::RadiansToDegrees( 2.0 * atan( exp(yr) ) - osg::PI_2 );
-            // z doesn't change here.
+            sphericalMercatorToGeographic( points[i] );
         }
         return true;
     }
 
     // http://en.wikipedia.org/wiki/Mercator_projection#Mathematics_of_the_projection
+    inline void geographicToSphericalMercator( osg::Vec3d& point )
+    {
+        double lon = osg::clampBetween(point.x(), -180.0, 180.0);
+        double lat = osg::clampBetween(point.y(), -90.0, 90.0);
+        double xr = (osg::DegreesToRadians(lon) - (-osg::PI)) / (2.0*osg::PI);
+        double sinLat = sin(osg::DegreesToRadians(lat));
+        double oneMinusSinLat = 1-sinLat;
+        if ( oneMinusSinLat != 0.0 )
+        {
+            double yr = ((0.5 * log( (1+sinLat)/oneMinusSinLat )) - (-osg::PI)) / (2.0*osg::PI);
+            point.x() = osg::clampBetween(MERC_MINX + (xr * MERC_WIDTH), MERC_MINX, MERC_MAXX);
+            point.y() = osg::clampBetween(MERC_MINY + (yr * MERC_HEIGHT), MERC_MINY, MERC_MAXY);
+            // z doesn't change here.
+        }
+    }
+
     bool geographicToSphericalMercator( std::vector<osg::Vec3d>& points )
     {
         for( unsigned i=0; i<points.size(); ++i )
         {
-            double lon = osg::clampBetween(points[i].x(), -180.0, 180.0);
-            double lat = osg::clampBetween(points[i].y(), -90.0, 90.0);
-            double xr = (osg::DegreesToRadians(lon) - (-osg::PI)) / (2.0*osg::PI);
-            double sinLat = sin(osg::DegreesToRadians(lat));
-            double oneMinusSinLat = 1-sinLat;
-            if ( oneMinusSinLat != 0.0 )
-            {
-                double yr = ((0.5 * log( (1+sinLat)/oneMinusSinLat )) - (-osg::PI)) / (2.0*osg::PI);
-                points[i].x() = osg::clampBetween(MERC_MINX + (xr * MERC_WIDTH), MERC_MINX, MERC_MAXX);
-                points[i].y() = osg::clampBetween(MERC_MINY + (yr * MERC_HEIGHT), MERC_MINY, MERC_MAXY);
-                // z doesn't change here.
-            }
+            geographicToSphericalMercator( points[i] );
         }
         return true;
     }
 
+    inline void geodeticToECEF(osg::Vec3d& point, const osg::EllipsoidModel* em)
+    {
+        double x, y, z;
+        em->convertLatLongHeightToXYZ(
+            osg::DegreesToRadians( point.y() ), osg::DegreesToRadians( point.x() ), point.z(),
+            x, y, z );
+        point.set( x, y, z );
+    }
+
     void geodeticToECEF(std::vector<osg::Vec3d>& points, const osg::EllipsoidModel* em)
     {
+        if ( AnalyticTransform::isEnabled() )
+        {
+            AnalyticTransform::geodeticToECEF( points, em );
+            return;
+        }
+
         for( unsigned i=0; i<points.size(); ++i )
         {
-            double x, y, z;
-            em->convertLatLongHeightToXYZ(
-                osg::DegreesToRadians( points[i].y() ), osg::DegreesToRadians( points[i].x() ), points[i].z(),
-                x, y, z );
-            points[i].set( x, y, z );
+            geodeticToECEF( points[i], em );
         }
     }
 
+    inline void ECEFtoGeodetic(osg::Vec3d& point, const osg::EllipsoidModel* em)
+    {
+        double lat, lon, alt;
+        em->convertXYZToLatLongHeight(
+            point.x(), point.y(), point.z(),
+            lat, lon, alt );
+        point.set( osg::RadiansToDegrees(lon), osg::RadiansToDegrees(lat), alt );
+    }
+
     void ECEFtoGeodetic(std::vector<osg::Vec3d>& points, const osg::EllipsoidModel* em)
     {
+        if ( AnalyticTransform::isEnabled() )
+        {
+            AnalyticTransform::ECEFToGeodetic( points, em );
+            return;
+        }
+
         for( unsigned i=0; i<points.size(); ++i )
         {
-            double lat, lon, alt;
-            em->convertXYZToLatLongHeight(
-                points[i].x(), points[i].y(), points[i].z(),
-                lat, lon, alt );
-            points[i].set( osg::RadiansToDegrees(lon), osg::RadiansToDegrees(lat), alt );
+            ECEFtoGeodetic( points[i], em );
+        }
+    }
+
+    // Unique IDs for SpatialReference instances.
+    OpenThreads::Atomic s_srsUIDGenerator;
+
+    // OGR coordinate transformation handles are not thread-safe, so each thread
+    // keeps its own set, keyed by the unique IDs of the source and destination
+    // SRS. That lets OCTTransform run without the global GDAL lock. A handle
+    // holds its own copies of both SRS definitions, so a stale entry (whose SRS
+    // has since been deleted) is merely unused; the cache is flushed when it
+    // grows too large.
+    struct ThreadTransformCache
+    {
+        // Both handles are created on first use.
+        struct Entry
+        {
+            Entry() : _ogr(0L), _ogrCreated(false), _analyticChecked(false) { }
+
+            void* getOGR(const SpatialReference* from, const SpatialReference* to)
+            {
+                if ( !_ogrCreated )
+                {
+                    OE_DEBUG << LC << "allocating new OCT Transform" << std::endl;
+                    GDAL_SCOPED_LOCK;
+                    _ogr = OCTNewCoordinateTransformation( from->getHandle(), to->getHandle() );
+                    _ogrCreated = true;
+                }
+                return _ogr;
+            }
+
+            AnalyticTransform* getAnalytic(const SpatialReference* from, const SpatialReference* to)
+            {
+                if ( !_analyticChecked )
+                {
+                    _analytic = AnalyticTransform::create( from, to );
+                    _analyticChecked = true;
+                }
+                return _analytic.get();
+            }
+
+            void*                             _ogr;
+            bool                              _ogrCreated;
+            osg::ref_ptr<AnalyticTransform>   _analytic;
+            bool                              _analyticChecked;
+        };
+
+        typedef std::pair<unsigned, unsigned> Key;
+        typedef std::map<Key, Entry> Entries;
+        Entries _entries;
+
+        enum { MAX_ENTRIES = 256 };
+
+        Entry& get(unsigned fromUID, unsigned toUID)
+        {
+            Key key(fromUID, toUID);
+            Entries::iterator i = _entries.find(key);
+            if ( i != _entries.end() )
+                return i->second;
+
+            if ( _entries.size() >= MAX_ENTRIES )
+                clear();
+
+            return _entries[key];
+        }
+
+        void clear()
+        {
+            GDAL_SCOPED_LOCK;
+            destroyAll();
+        }
+
+        void destroyAll()
+        {
+            for (Entries::iterator i = _entries.begin(); i != _entries.end(); ++i)
+            {
+                if ( i->second._ogr )
+                    OCTDestroyCoordinateTransformation( i->second._ogr );
+            }
+            _entries.clear();
+        }
+
+        ~ThreadTransformCache()
+        {
+            // runs at exit, possibly after the GDAL mutex is gone; no lock.
+            destroyAll();
         }
+    };
+
+    // Owns every thread's cache. Only consulted the first time a thread
+    // transforms a point; after that the thread-local pointer is used.
+    PerThread<ThreadTransformCache> s_threadTransformCaches;
+
+    OE_THREAD_LOCAL ThreadTransformCache* s_threadTransformCache = 0L;
+
+    inline ThreadTransformCache& getThreadTransformCache()
+    {
+        if ( !s_threadTransformCache )
+            s_threadTransformCache = &s_threadTransformCaches.get();
+        return *s_threadTransformCache;
     }
 }
 
@@ -434,7 +568,7 @@ _is_plate_carre ( false ),
 _is_spherical_mercator( false ),
 _ellipsoidId(0u)
 {
-    // nop
+    _uid = ++s_srsUIDGenerator;
 }
 
 SpatialReference::SpatialReference(void* handle, bool ownsHandle) :
@@ -446,7 +580,7 @@ _is_ltp        ( false ),
 _is_plate_carre( false ),
 _is_ecef       ( false )
 {
-    //nop
+    _uid = ++s_srsUIDGenerator;
 }
 
 SpatialReference::~SpatialReference()
@@ -455,11 +589,6 @@ SpatialReference::~SpatialReference()
     {
         GDAL_SCOPED_LOCK;
 
-        for (TransformHandleCache::iterator itr = _transformHandleCache.begin(); itr != _transformHandleCache.end(); ++itr)
-        {
-            OCTDestroyCoordinateTransformation(itr->second);
-        }
-
         if ( _owns_handle )
         {
             OSRDestroySpatialReference( _handle );
@@ -1010,14 +1139,75 @@ SpatialReference::transform(const osg::Vec3d&       input,
     if ( !outputSRS )
         return false;
 
-    std::vector<osg::Vec3d> v(1, input);
+    if ( !_initialized )
+        const_cast<SpatialReference*>(this)->init();
+
+    // Custom projections and vertical datum shifts work on point vectors;
+    // use the general path for those.
+    if ( isCube() || isLTP() || outputSRS->isCube() || outputSRS->isLTP() ||
+         _vdatum.get() != outputSRS->getVerticalDatum() )
+    {
+        std::vector<osg::Vec3d> v(1, input);
+
+        if ( transform(v, outputSRS) )
+        {
+            output = v[0];
+            return true;
+        }
+        return false;
+    }
+
+    // trivial equivalency:
+    if ( isEquivalentTo(outputSRS) )
+    {
+        output = input;
+        return true;
+    }
 
-    if ( transform(v, outputSRS) )
+    // Same special cases as the vector version, one point at a time.
+    if ( isGeographic() && outputSRS->isSphericalMercator() )
     {
-        output = v[0];
+        output = input;
+        geographicToSphericalMercator( output );
         return true;
     }
-    return false;
+
+    else if ( isSphericalMercator() && outputSRS->isGeographic() )
+    {
+        output = input;
+        sphericalMercatorToGeographic( output );
+        return true;
+    }
+
+    else if ( isECEF() && !outputSRS->isECEF() )
+    {
+        const SpatialReference* outputGeoSRS = outputSRS->getGeodeticSRS();
+        osg::Vec3d geo = input;
+        ECEFtoGeodetic( geo, outputGeoSRS->getEllipsoid() );
+        return outputGeoSRS->transform( geo, outputSRS, output );
+    }
+
+    else if ( !isECEF() && outputSRS->isECEF() )
+    {
+        const SpatialReference* outputGeoSRS = outputSRS->getGeodeticSRS();
+        bool success = transform( input, outputGeoSRS, output );
+        geodeticToECEF( output, outputGeoSRS->getEllipsoid() );
+        return success;
+    }
+
+    double x = input.x(), y = input.y();
+    if ( !transformXYPointArrays( &x, &y, 1u, outputSRS ) )
+        return false;
+
+    if ( isProjected() && outputSRS->isGeographic() )
+    {
+        // see the vector version for why we clamp here.
+        x = osg::clampBetween( x, -180.0, 180.0 );
+        y = osg::clampBetween( y,  -90.0,  90.0 );
+    }
+
+    output.set( x, y, input.z() );
+    return true;
 }
 
 
@@ -1156,23 +1346,20 @@ SpatialReference::transformXYPointArrays(double*  x,
                                          unsigned count,
                                          const SpatialReference* out_srs) const
 {  
-    // Transform the X and Y values inside an exclusive GDAL/OGR lock
-    GDAL_SCOPED_LOCK;
+    ThreadTransformCache::Entry& entry = getThreadTransformCache().get( _uid, out_srs->_uid );
 
-    void* xform_handle = NULL;
-    TransformHandleCache::const_iterator itr = _transformHandleCache.find(out_srs->getWKT());
-    if (itr != _transformHandleCache.end())
-    {
-        //OE_DEBUG << LC << "using cached transform handle" << std::endl;
-        xform_handle = itr->second;
-    }
-    else
+    // Closed-form conversion when one exists for this pair:
+    if ( AnalyticTransform::isEnabled() )
     {
-        OE_DEBUG << LC << "allocating new OCT Transform" << std::endl;
-        xform_handle = OCTNewCoordinateTransformation( _handle, out_srs->_handle);
-        const_cast<SpatialReference*>(this)->_transformHandleCache[out_srs->getWKT()] = xform_handle;
+        AnalyticTransform* analytic = entry.getAnalytic( this, out_srs );
+        if ( analytic && analytic->isInDomain( x, y, count ) )
+            return analytic->transform( x, y, count );
     }
 
+    // The handle belongs to this thread alone, so no GDAL lock is needed
+    // to use it.
+    void* xform_handle = entry.getOGR( this, out_srs );
+
     if ( !xform_handle )
     {
         OE_WARN << LC
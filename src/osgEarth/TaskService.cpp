@@ -198,6 +198,203 @@ TaskRequestQueue::setDone()
 
 //------------------------------------------------------------------------
 
+WorkStealingTaskQueue::WorkStealingTaskQueue(unsigned numSlots, unsigned maxSize) :
+TaskRequestQueue( maxSize ),
+_numSlots( osg::maximum(numSlots, 1u) ),
+_maxSize ( maxSize ),
+_done    ( false ),
+_sleepers( 0 )
+{
+    _slots = new Slot[_numSlots];
+}
+
+WorkStealingTaskQueue::~WorkStealingTaskQueue()
+{
+    delete [] _slots;
+}
+
+unsigned
+WorkStealingTaskQueue::laneOf( const TaskRequest* request )
+{
+    if ( dynamic_cast<const PoisonPill*>(request) )
+        return LANE_SHUTDOWN;
+
+    float p = request->getPriority();
+    return p < 0.0f ? LANE_HIGH : p > 0.0f ? LANE_LOW : LANE_NORMAL;
+}
+
+unsigned
+WorkStealingTaskQueue::currentSlot()
+{
+    // OpenThreads numbers its threads sequentially, which spreads the
+    // workers evenly across the slots. Other threads get round-robin.
+    OpenThreads::Thread* thread = OpenThreads::Thread::CurrentThread();
+    if ( thread )
+        return (unsigned)thread->getThreadId() % _numSlots;
+    else
+        return (++_next) % _numSlots;
+}
+
+void
+WorkStealingTaskQueue::add( TaskRequest* request )
+{
+    request->setState( TaskRequest::STATE_PENDING );
+
+    // install a progress callback if one isn't already installed
+    if ( !request->getProgressCallback() )
+        request->setProgressCallback( new ProgressCallback() );
+
+    // reserve a place, waiting for room if the queue is bounded. The check
+    // and the reservation happen under one lock so adders can't overshoot.
+    {
+        ScopedLock<Mutex> lock( _sleepMutex );
+        while ( _maxSize > 0 && !_done && (unsigned)_count >= _maxSize )
+        {
+            _notFull.wait( &_sleepMutex );
+        }
+        ++_count;
+    }
+
+    unsigned lane = laneOf( request );
+    Slot& slot = _slots[currentSlot()];
+    {
+        ScopedLock<Mutex> lock( slot._mutex );
+        slot._lanes[lane].push_back( request );
+        ++slot._laneSize[lane];
+    }
+
+    // publish after the push, so a nonzero _queued means there's something to take.
+    ScopedLock<Mutex> lock( _sleepMutex );
+    ++_queued;
+    if ( _sleepers > 0 )
+        _notEmpty.signal();
+}
+
+TaskRequest*
+WorkStealingTaskQueue::take( unsigned home )
+{
+    // Higher lanes anywhere win over lower lanes at home.
+    for( unsigned lane = 0; lane < NUM_LANES; ++lane )
+    {
+        for( unsigned i = 0; i < _numSlots; ++i )
+        {
+            Slot& slot = _slots[(home + i) % _numSlots];
+            if ( (unsigned)slot._laneSize[lane] == 0 )
+                continue;
+
+            ScopedLock<Mutex> lock( slot._mutex );
+            if ( !slot._lanes[lane].empty() )
+            {
+                osg::ref_ptr<TaskRequest> next = slot._lanes[lane].front();
+                slot._lanes[lane].pop_front();
+                --slot._laneSize[lane];
+                --_queued;
+                return next.release();
+            }
+        }
+    }
+    return 0L;
+}
+
+TaskRequest*
+WorkStealingTaskQueue::get()
+{
+    unsigned home = currentSlot();
+
+    while( !_done )
+    {
+        TaskRequest* next = take( home );
+        if ( next )
+        {
+            --_count;
+            if ( _maxSize > 0 )
+            {
+                ScopedLock<Mutex> lock( _sleepMutex );
+                _notFull.signal();
+            }
+            return next;
+        }
+
+        // Nothing to take: sleep until an add() publishes a task. (If one
+        // was published since the take, the wait ends at once and we retry.)
+        ScopedLock<Mutex> lock( _sleepMutex );
+        while ( !_done && (unsigned)_queued == 0 )
+        {
+            ++_sleepers;
+            _notEmpty.wait( &_sleepMutex );
+            --_sleepers;
+        }
+    }
+
+    return 0L;
+}
+
+void
+WorkStealingTaskQueue::drain( bool cancel )
+{
+    for( unsigned i = 0; i < _numSlots; ++i )
+    {
+        Slot& slot = _slots[i];
+        ScopedLock<Mutex> lock( slot._mutex );
+        for( unsigned lane = 0; lane < NUM_LANES; ++lane )
+        {
+            while( !slot._lanes[lane].empty() )
+            {
+                if ( cancel )
+                    slot._lanes[lane].front()->cancel();
+                slot._lanes[lane].pop_front();
+                --slot._laneSize[lane];
+                --_queued;
+                --_count;
+            }
+        }
+    }
+
+    ScopedLock<Mutex> lock( _sleepMutex );
+    _notFull.broadcast();
+}
+
+void
+WorkStealingTaskQueue::clear()
+{
+    drain( false );
+}
+
+void
+WorkStealingTaskQueue::cancel()
+{
+    drain( true );
+}
+
+unsigned int
+WorkStealingTaskQueue::getNumRequests() const
+{
+    return (unsigned)_count;
+}
+
+bool
+WorkStealingTaskQueue::isFull() const
+{
+    return _maxSize > 0 && (unsigned)_count >= _maxSize;
+}
+
+bool
+WorkStealingTaskQueue::isEmpty() const
+{
+    return (unsigned)_count == 0;
+}
+
+void
+WorkStealingTaskQueue::setDone()
+{
+    ScopedLock<Mutex> lock( _sleepMutex );
+    _done = true;
+    _notEmpty.broadcast();
+    _notFull.broadcast();
+}
+
+//------------------------------------------------------------------------
+
 TaskThread::TaskThread( TaskRequestQueue* queue ) :
 _queue( queue ),
 _done( false )
@@ -283,13 +480,18 @@ TaskThread::cancel()
 
 //------------------------------------------------------------------------
 
-TaskService::TaskService( const std::string& name, int numThreads, unsigned int maxSize ):
+TaskService::TaskService( const std::string& name, int numThreads, unsigned int maxSize, Scheduler scheduler ):
 osg::Referenced( true ),
 _lastRemoveFinishedThreadsStamp(0),
 _name(name),
-_numThreads( 0 )
+_numThreads( 0 ),
+_scheduler( scheduler )
 {
-    _queue = new TaskRequestQueue( maxSize );
+    if ( scheduler == SCHEDULER_WORK_STEALING )
+        _queue = new WorkStealingTaskQueue( osg::maximum(numThreads, 1), maxSize );
+    else
+        _queue = new TaskRequestQueue( maxSize );
+
     setNumThreads( numThreads );
 }
 
@@ -444,6 +646,12 @@ TaskService::removeFinishedThreads()
     }
 }
 
+void
+TaskService::cancelPending()
+{
+    _queue->cancel();
+}
+
 void
 TaskService::cancelAll()
 {
@@ -465,6 +673,18 @@ _targetNumThreads( numThreads )
     //nop
 }
 
+TaskService*
+TaskServiceManager::getSharedService()
+{
+    ScopedLock<Mutex> lock( _taskServiceMgrMutex );
+    if ( !_sharedService.valid() )
+    {
+        int numThreads = osg::maximum( 1, OpenThreads::GetNumberOfProcessors() );
+        _sharedService = new TaskService( "osgEarth.Shared", numThreads, 0, TaskService::SCHEDULER_WORK_STEALING );
+    }
+    return _sharedService.get();
+}
+
 void
 TaskServiceManager::setNumThreads( int numThreads )
 {
@@ -291,6 +291,8 @@ TerrainLayer::open()
         // Create an L2 mem cache that sits atop the main cache, if necessary.
         // For now: use the same L2 cache size at the driver.
         int l2CacheSize = options().driver()->L2CacheSize().get();
+        int l2CacheSizeMB = options().driver()->L2CacheSizeMB().get();
+        bool l2CacheShared = options().driver()->L2CacheShared().get();
     
         // See if it was overridden with an env var.
         char const* l2env = ::getenv( "OSGEARTH_L2_CACHE_SIZE" );
@@ -300,17 +302,32 @@ TerrainLayer::open()
             OE_INFO << LC << "L2 cache size set from environment = " << l2CacheSize << "\n";
         }
 
+        char const* l2mbEnv = ::getenv( "OSGEARTH_L2_CACHE_SIZE_MB" );
+        if ( l2mbEnv )
+        {
+            l2CacheSizeMB = as<int>( std::string(l2mbEnv), 0 );
+            OE_INFO << LC << "L2 cache budget set from environment = " << l2CacheSizeMB << " MB\n";
+        }
+
+        if ( ::getenv( "OSGEARTH_L2_CACHE_SHARED" ) )
+        {
+            l2CacheShared = true;
+        }
+
         // Env cache-only mode also disables the L2 cache.
         char const* noCacheEnv = ::getenv( "OSGEARTH_MEMORY_PROFILE" );
         if ( noCacheEnv )
         {
             l2CacheSize = 0;
+            l2CacheSizeMB = 0;
         }
 
         // Initialize the l2 cache if it's size is > 0
-        if ( l2CacheSize > 0 )
+        if ( l2CacheSize > 0 || l2CacheSizeMB > 0 )
         {
             _memCache = new MemCache( l2CacheSize );
+            _memCache->setMaxBinBytes( (unsigned long long)std::max(l2CacheSizeMB, 0) * 1048576ULL );
+            _memCache->setShareObjects( l2CacheShared );
         }
 
         // create the unique cache ID for the cache bin.
@@ -336,6 +353,8 @@ TerrainLayer::open()
             hashConf.remove("cache_policy");
             hashConf.remove("visible");
             hashConf.remove("l2_cache_size");
+            hashConf.remove("l2_cache_size_mb");
+            hashConf.remove("l2_cache_shared");
 
             OE_DEBUG << "hashConfFinal = " << hashConf.toJSON(true) << std::endl;
 
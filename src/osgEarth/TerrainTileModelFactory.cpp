@@ -23,6 +23,8 @@
 #include <osgEarth/PatchLayer>
 #include <osgEarth/MapOptions>
 #include <osgEarth/MapFrame>
+#include <osgEarth/TaskService>
+#include <osgEarth/StringUtils>
 
 #include <osg/Texture2D>
 
@@ -32,6 +34,144 @@ using namespace osgEarth;
 
 //.........................................................................
 
+namespace
+{
+    /**
+     * Progress callback for one of several layer fetches running concurrently
+     * for the same tile. Cancelation reads through to the tile's callback;
+     * stats and error state stay local until merged back on the requesting
+     * thread, since a ProgressCallback isn't safe to update from many threads.
+     */
+    class LayerFetchProgress : public ProgressCallback
+    {
+    public:
+        LayerFetchProgress(ProgressCallback* tileProgress) : _tileProgress(tileProgress)
+        {
+            if (tileProgress)
+                collectStats() = tileProgress->collectStats();
+        }
+
+        bool isCanceled()
+        {
+            return _canceled || (_tileProgress.valid() && _tileProgress->isCanceled());
+        }
+
+        void merge()
+        {
+            if (!_tileProgress.valid())
+                return;
+
+            // Counts and times add up; ratios don't, so recompute them from the totals.
+            Stats& stats = _tileProgress->stats();
+            for(Stats::const_iterator i = _stats.begin(); i != _stats.end(); ++i)
+            {
+                if (!endsWith(i->first, "_rate"))
+                    stats[i->first] += i->second;
+            }
+
+            if (_stats.find("hfcache_try_count") != _stats.end() && stats["hfcache_try_count"] > 0.0)
+                stats["hfcache_hit_rate"] = stats["hfcache_hit_count"] / stats["hfcache_try_count"];
+
+            if (_needsRetry)
+                _tileProgress->setNeedsRetry(true);
+
+            if (_failed)
+                _tileProgress->reportError(_message);
+
+            if (_canceled)
+                _tileProgress->cancel();
+        }
+
+    private:
+        osg::ref_ptr<ProgressCallback> _tileProgress;
+    };
+
+    /**
+     * A layer fetch that runs on the shared task service or on the requesting
+     * thread (see JoinableTask), with its own progress that is merged back
+     * into the tile's once joined.
+     */
+    class LayerFetchJob : public JoinableTask
+    {
+    public:
+        LayerFetchJob(ProgressCallback* tileProgress) :
+            _fetchProgress( new LayerFetchProgress(tileProgress) ) { }
+
+        /** Runs the job here if no one else has, waits for it, and merges its progress. */
+        void join()
+        {
+            JoinableTask::join();
+            _fetchProgress->merge();
+        }
+
+    protected:
+        virtual void fetch(ProgressCallback* progress) =0;
+
+    private:
+        void execute()
+        {
+            if (!_fetchProgress->isCanceled())
+                fetch(_fetchProgress.get());
+        }
+
+        osg::ref_ptr<LayerFetchProgress> _fetchProgress;
+    };
+
+    TaskService* getFetchService()
+    {
+        return Registry::instance()->getTaskServiceManager()->getSharedService();
+    }
+}
+
+struct TerrainTileModelFactory::ImageLayerFetch : public LayerFetchJob
+{
+    ImageLayerFetch(TerrainTileModelFactory*         factory,
+                    ImageLayer*                      layer,
+                    const TileKey&                   key,
+                    const TerrainEngineRequirements* reqs,
+                    ProgressCallback*                progress) :
+        LayerFetchJob(progress), _factory(factory), _layer(layer), _key(key), _reqs(reqs) { }
+
+    void fetch(ProgressCallback* progress)
+    {
+        _result = _factory->createImageLayerModel(_layer.get(), _key, _reqs, progress);
+    }
+
+    TerrainTileModelFactory*                 _factory;
+    osg::ref_ptr<ImageLayer>                 _layer;
+    TileKey                                  _key;
+    const TerrainEngineRequirements*         _reqs;
+    osg::ref_ptr<TerrainTileImageLayerModel> _result;
+};
+
+struct TerrainTileModelFactory::ElevationFetch : public LayerFetchJob
+{
+    ElevationFetch(TerrainTileModelFactory*     factory,
+                   TerrainTileModel*            model,
+                   const MapFrame&              frame,
+                   const TileKey&               key,
+                   const CreateTileModelFilter& filter,
+                   unsigned                     border,
+                   ProgressCallback*            progress) :
+        LayerFetchJob(progress), _factory(factory), _model(model), _frame(frame), _key(key), _filter(filter), _border(border) { }
+
+    // only touches the model's elevation members, so it can run while
+    // the image layers are being populated.
+    void fetch(ProgressCallback* progress)
+    {
+        _factory->addElevation(_model, _frame, _key, _filter, _border, progress);
+    }
+
+    TerrainTileModelFactory*     _factory;
+    TerrainTileModel*            _model;
+    const MapFrame&              _frame;
+    TileKey                      _key;
+    const CreateTileModelFilter& _filter;
+    unsigned                     _border;
+};
+
+//.........................................................................
+
 TerrainTileModelFactory::TerrainTileModelFactory(const TerrainOptions& options) :
 _options         ( options ),
 _heightFieldCache( true, 128 )
@@ -54,15 +194,28 @@ TerrainTileModelFactory::createTileModel(const MapFrame&                  frame,
         key,
         frame.getRevision() );
 
+    bool wantElevation = requirements == 0L || requirements->elevationTexturesRequired();
+    unsigned border = wantElevation && requirements && requirements->elevationBorderRequired() ? 1u : 0u;
+
+    // in parallel mode, start the elevation fetch first so it overlaps the imagery.
+    osg::ref_ptr<ElevationFetch> elevationFetch;
+    if ( wantElevation && _options.parallelLayerFetch() == true )
+    {
+        elevationFetch = new ElevationFetch(this, model.get(), frame, key, filter, border, progress);
+        getFetchService()->add( elevationFetch.get() );
+    }
+
     // assemble all the components:
     addImageLayers(model.get(), frame, requirements, key, filter, progress);
 
     addPatchLayers(model.get(), frame, key, filter, progress);
 
-    if ( requirements == 0L || requirements->elevationTexturesRequired() )
+    if ( elevationFetch.valid() )
+    {
+        elevationFetch->join();
+    }
+    else if ( wantElevation )
     {
-        unsigned border = requirements->elevationBorderRequired() ? 1u : 0u;
-
         addElevation( model.get(), frame, key, filter, border, progress );
     }
 
@@ -87,64 +240,49 @@ TerrainTileModelFactory::addImageLayers(TerrainTileModel* model,
 {
     OE_START_TIMER(fetch_image_layers);
 
-    int order = 0;
-
     ImageLayerVector imageLayers;
     frame.getLayers(imageLayers);
 
-    for(ImageLayerVector::const_iterator i = imageLayers.begin();
-        i != imageLayers.end();
-        ++i, ++order )
+    // the layers that we will actually fetch, in order:
+    ImageLayerVector fetchLayers;
+    for(ImageLayerVector::const_iterator i = imageLayers.begin(); i != imageLayers.end(); ++i)
     {
-        ImageLayer* layer = i->get();
-
-        if (!filter.accept(layer))
-            continue;
-
-        if (!layer->getEnabled())
-            continue;
+        if (filter.accept(i->get()) && i->get()->getEnabled())
+            fetchLayers.push_back(*i);
+    }
 
-        osg::Texture* tex = 0L;
-        osg::Matrixf textureMatrix;
+    std::vector< osg::ref_ptr<TerrainTileImageLayerModel> > layerModels(fetchLayers.size());
 
-        if (layer->isKeyInLegalRange(key) && layer->mayHaveDataInExtent(key.getExtent()))
+    if (_options.parallelLayerFetch() == true && fetchLayers.size() > 1)
+    {
+        std::vector< osg::ref_ptr<ImageLayerFetch> > fetches(fetchLayers.size());
+        for(unsigned i=0; i<fetchLayers.size(); ++i)
         {
-            if (layer->createTextureSupported())
-            {
-                tex = layer->createTexture( key, progress, textureMatrix );
-            }
-
-            else
-            {
-                GeoImage geoImage = layer->createImage( key, progress );
-           
-                if ( geoImage.valid() )
-                {
-                    if ( layer->isCoverage() )
-                        tex = createCoverageTexture(geoImage.getImage(), layer);
-                    else
-                        tex = createImageTexture(geoImage.getImage(), layer);
-                }
-            }
+            fetches[i] = new ImageLayerFetch(this, fetchLayers[i].get(), key, reqs, progress);
+            getFetchService()->add( fetches[i].get() );
         }
-        
-        // if this is the first LOD, and the engine requires that the first LOD
-        // be populated, make an empty texture if we didn't get one.
-        if (tex == 0L &&
-            _options.firstLOD() == key.getLOD() &&
-            reqs && reqs->fullDataAtFirstLodRequired())
+
+        // this thread works through the list too, then collects results in layer order.
+        for(unsigned i=0; i<fetches.size(); ++i)
         {
-            tex = _emptyTexture.get();
+            fetches[i]->join();
+            layerModels[i] = fetches[i]->_result.get();
         }
-         
-        if (tex)
+    }
+    else
+    {
+        for(unsigned i=0; i<fetchLayers.size(); ++i)
         {
-            TerrainTileImageLayerModel* layerModel = new TerrainTileImageLayerModel();
-
-            layerModel->setImageLayer(layer);
+            layerModels[i] = createImageLayerModel(fetchLayers[i].get(), key, reqs, progress);
+        }
+    }
 
-            layerModel->setTexture(tex);
-            layerModel->setMatrix(new osg::RefMatrixf(textureMatrix));
+    for(unsigned i=0; i<layerModels.size(); ++i)
+    {
+        TerrainTileImageLayerModel* layerModel = layerModels[i].get();
+        if (layerModel)
+        {
+            ImageLayer* layer = fetchLayers[i].get();
 
             model->colorLayers().push_back(layerModel);
 
@@ -160,6 +298,57 @@ TerrainTileModelFactory::addImageLayers(TerrainTileModel* model,
         progress->stats()["fetch_imagery_time"] += OE_STOP_TIMER(fetch_image_layers);
 }
 
+TerrainTileImageLayerModel*
+TerrainTileModelFactory::createImageLayerModel(ImageLayer*                      layer,
+                                               const TileKey&                   key,
+                                               const TerrainEngineRequirements* reqs,
+                                               ProgressCallback*                progress)
+{
+    osg::Texture* tex = 0L;
+    osg::Matrixf textureMatrix;
+
+    if (layer->isKeyInLegalRange(key) && layer->mayHaveDataInExtent(key.getExtent()))
+    {
+        if (layer->createTextureSupported())
+        {
+            tex = layer->createTexture( key, progress, textureMatrix );
+        }
+
+        else
+        {
+            GeoImage geoImage = layer->createImage( key, progress );
+       
+            if ( geoImage.valid() )
+            {
+                if ( layer->isCoverage() )
+                    tex = createCoverageTexture(geoImage.getImage(), layer);
+                else
+                    tex = createImageTexture(geoImage.getImage(), layer);
+            }
+        }
+    }
+    
+    // if this is the first LOD, and the engine requires that the first LOD
+    // be populated, make an empty texture if we didn't get one.
+    if (tex == 0L &&
+        _options.firstLOD() == key.getLOD() &&
+        reqs && reqs->fullDataAtFirstLodRequired())
+    {
+        tex = _emptyTexture.get();
+    }
+
+    if (tex == 0L)
+        return 0L;
+
+    TerrainTileImageLayerModel* layerModel = new TerrainTileImageLayerModel();
+
+    layerModel->setImageLayer(layer);
+
+    layerModel->setTexture(tex);
+    layerModel->setMatrix(new osg::RefMatrixf(textureMatrix));
+
+    return layerModel;
+}
 
 void
 TerrainTileModelFactory::addPatchLayers(TerrainTileModel* model,
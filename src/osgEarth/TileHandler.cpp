@@ -39,3 +39,8 @@ std::string TileHandler::getProcessString() const
 {
     return "";
 }
+
+bool TileHandler::getReadStats(TileSource::ReadStats& out) const
+{
+    return false;
+}
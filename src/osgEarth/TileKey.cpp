@@ -33,6 +33,7 @@ TileKey::TileKey(unsigned int lod, unsigned int tile_x, unsigned int tile_y, con
     _x = tile_x;
     _y = tile_y;
     _lod = lod;
+    _code = encode(lod, tile_x, tile_y);
     _profile = profile;
 
     double width, height;
@@ -46,27 +47,33 @@ TileKey::TileKey(unsigned int lod, unsigned int tile_x, unsigned int tile_y, con
         double ymin = ymax - height;
 
         _extent = GeoExtent( _profile->getSRS(), xmin, ymin, xmax, ymax );
-
-        _key = Stringify() << _lod << "/" << _x << "/" << _y;
     }
     else
     {
         _extent = GeoExtent::INVALID;
-        _key = "invalid";
     }
 }
 
 TileKey::TileKey( const TileKey& rhs ) :
-_key( rhs._key ),
 _lod(rhs._lod),
 _x(rhs._x),
 _y(rhs._y),
+_code(rhs._code),
 _profile( rhs._profile.get() ),
 _extent( rhs._extent )
 {
     //NOP
 }
 
+std::string
+TileKey::str() const
+{
+    if ( !_profile.valid() )
+        return "invalid";
+
+    return Stringify() << _lod << "/" << _x << "/" << _y;
+}
+
 const Profile*
 TileKey::getProfile() const
 {
@@ -0,0 +1,355 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <osgEarth/TilePrefetcher>
+#include <osgEarth/TerrainTileModelFactory>
+#include <osgEarth/Map>
+#include <osgEarth/MapFrame>
+#include <osgEarth/Registry>
+#include <cfloat>
+
+using namespace osgEarth;
+
+#define LC "[TilePrefetcher] "
+
+namespace
+{
+    // Builds (and discards) a tile model so the layers fetch and cache its data.
+    class PrefetchTask : public TaskRequest
+    {
+    public:
+        PrefetchTask(const Map* map, TerrainTileModelFactory* factory, const TileKey& key) :
+            TaskRequest( -(float)key.getLOD() ),
+            _map(map), _factory(factory), _key(key) { }
+
+        void operator()(ProgressCallback* progress)
+        {
+            osg::ref_ptr<const Map> map;
+            if ( !_map.lock(map) || (progress && progress->isCanceled()) )
+                return;
+
+            MapFrame frame( map.get() );
+            osg::ref_ptr<TerrainTileModel> model = _factory->createTileModel(
+                frame, _key, CreateTileModelFilter(), 0L, progress );
+        }
+
+    private:
+        osg::observer_ptr<const Map>          _map;
+        osg::ref_ptr<TerrainTileModelFactory> _factory;
+        TileKey                               _key;
+    };
+
+    // ignore motion slower than this (world units per second)
+    const double MIN_SPEED = 1.0;
+
+    // forget which tiles were fetched after this many, so evicted data can be fetched again
+    const unsigned MAX_FETCHED = 4096u;
+}
+
+// Runs one prediction on the task service, keeping the key selection
+// (and its many GeoCircle computations) off the cull thread.
+struct TilePrefetcher::PredictTask : public TaskRequest
+{
+    PredictTask(TilePrefetcher* prefetcher, const osg::Vec3d& eye, const osg::Vec3d& velocity, const osg::Polytope* frustum) :
+        TaskRequest( -FLT_MAX ), // ahead of the fetches it starts
+        _prefetcher(prefetcher), _eye(eye), _velocity(velocity), _hasFrustum(frustum != 0L),
+        _generation(prefetcher->_generation)
+    {
+        if ( frustum )
+            _frustum = *frustum;
+    }
+
+    void operator()(ProgressCallback*)
+    {
+        _prefetcher->predict( _eye, _velocity, _hasFrustum ? &_frustum : 0L, _generation );
+    }
+
+    osg::ref_ptr<TilePrefetcher> _prefetcher;
+    osg::Vec3d                   _eye;
+    osg::Vec3d                   _velocity;
+    osg::Polytope                _frustum;
+    bool                         _hasFrustum;
+    unsigned                     _generation;
+};
+
+TilePrefetcher::TilePrefetcher(const Map* map, const TerrainOptions& options) :
+_map               ( map ),
+_lookAhead         ( 2.0 ),
+_interval          ( 0.25 ),
+_maxPending        ( 8u ),
+_lastTime          ( -1.0 ),
+_lastPredictionTime( -DBL_MAX ),
+_predicting        ( false ),
+_generation        ( 0u ),
+_numCompleted      ( 0u ),
+_numCanceled       ( 0u )
+{
+    _factory = new TerrainTileModelFactory( options );
+
+    if ( map )
+        _profile = map->getProfile();
+}
+
+TilePrefetcher::~TilePrefetcher()
+{
+    cancelAll();
+}
+
+void
+TilePrefetcher::update(const osg::Vec3d& eye, double time, const osg::Polytope* frustum)
+{
+    Threading::ScopedMutexLock lock( _mutex );
+
+    // only one sample per time (e.g., several cameras in the same frame)
+    if ( time == _lastTime )
+        return;
+
+    // estimate the velocity, smoothed over a few samples; a long gap
+    // means the camera jumped or stopped, so start over.
+    double dt = time - _lastTime;
+    if ( _lastTime >= 0.0 && dt > 0.0 && dt < 1.0 )
+        _velocity = _velocity*0.8 + ((eye - _lastEye)/dt)*0.2;
+    else
+        _velocity.set(0.0, 0.0, 0.0);
+
+    _lastEye = eye;
+    _lastTime = time;
+
+    schedulePrediction( eye, _velocity, time, frustum );
+}
+
+void
+TilePrefetcher::update(const osg::Vec3d& eye, const osg::Vec3d& velocity, double time, const osg::Polytope* frustum)
+{
+    Threading::ScopedMutexLock lock( _mutex );
+
+    _velocity = velocity;
+    _lastEye = eye;
+    _lastTime = time;
+
+    schedulePrediction( eye, velocity, time, frustum );
+}
+
+void
+TilePrefetcher::schedulePrediction(const osg::Vec3d& eye, const osg::Vec3d& velocity, double time, const osg::Polytope* frustum)
+{
+    if ( _predicting || time - _lastPredictionTime < _interval )
+        return;
+
+    _lastPredictionTime = time;
+    _predicting = true;
+
+    TaskService* service = Registry::instance()->getTaskServiceManager()->getSharedService();
+    service->add( new PredictTask(this, eye, velocity, frustum) );
+}
+
+void
+TilePrefetcher::predict(const osg::Vec3d& eye, const osg::Vec3d& velocity, const osg::Polytope* frustum, unsigned generation)
+{
+    // tiles in range at two points along the extrapolated path, minus the
+    // ones in range now (the terrain engine is already loading those).
+    // This is the expensive part, so it runs without the lock.
+    std::set<TileKey> ahead;
+    std::vector<TileKey> predicted;
+
+    if ( velocity.length() >= MIN_SPEED )
+    {
+        std::set<TileKey> current;
+        selectKeys( eye, frustum, current );
+
+        for(unsigned step = 1; step <= 2; ++step)
+        {
+            osg::Vec3d offset = velocity * (_lookAhead * 0.5 * (double)step);
+            if ( frustum )
+            {
+                osg::Polytope moved( *frustum );
+                moved.transform( osg::Matrix::translate(offset) );
+                selectKeys( eye + offset, &moved, ahead );
+            }
+            else
+            {
+                selectKeys( eye + offset, 0L, ahead );
+            }
+        }
+
+        // std::set<TileKey> orders by LOD, so this is coarsest first.
+        for(std::set<TileKey>::const_iterator i = ahead.begin(); i != ahead.end(); )
+        {
+            if ( current.find(*i) == current.end() )
+            {
+                predicted.push_back( *i );
+                ++i;
+            }
+            else
+            {
+                ahead.erase( i++ );
+            }
+        }
+    }
+
+    Threading::ScopedMutexLock lock( _mutex );
+
+    _predicting = false;
+
+    // cancelAll() was called while this prediction ran.
+    if ( generation != _generation )
+        return;
+
+    _predicted.swap( predicted );
+
+    osg::ref_ptr<const Map> map;
+    if ( !_map.lock(map) )
+        return;
+
+    // retire finished fetches:
+    for(Tasks::iterator i = _tasks.begin(); i != _tasks.end(); )
+    {
+        if ( i->second->isCompleted() )
+        {
+            if ( !i->second->wasCanceled() )
+                ++_numCompleted;
+            _fetched.insert( i->first );
+            _tasks.erase( i++ );
+        }
+        else ++i;
+    }
+
+    // cancel fetches for tiles we no longer expect to need:
+    for(Tasks::iterator i = _tasks.begin(); i != _tasks.end(); )
+    {
+        if ( ahead.find(i->first) == ahead.end() )
+        {
+            i->second->cancel();
+            ++_numCanceled;
+            _tasks.erase( i++ );
+        }
+        else ++i;
+    }
+
+    if ( _fetched.size() > MAX_FETCHED )
+        _fetched.clear();
+
+    // start new fetches, coarsest first:
+    TaskService* service = Registry::instance()->getTaskServiceManager()->getSharedService();
+    for(std::vector<TileKey>::const_iterator key = _predicted.begin(); key != _predicted.end() && _tasks.size() < _maxPending; ++key)
+    {
+        if ( _tasks.find(*key) == _tasks.end() && _fetched.find(*key) == _fetched.end() )
+        {
+            osg::ref_ptr<TaskRequest> task = new PrefetchTask( map.get(), _factory.get(), *key );
+            _tasks[*key] = task.get();
+            service->add( task.get() );
+        }
+    }
+}
+
+void
+TilePrefetcher::selectKeys(const osg::Vec3d& eye, const osg::Polytope* frustum, std::set<TileKey>& out) const
+{
+    if ( !_profile.valid() || _ranges.empty() )
+        return;
+
+    // Polytope::contains is not const.
+    osg::Polytope culler;
+    if ( frustum )
+        culler = *frustum;
+
+    unsigned maxLOD = _ranges.size()-1;
+
+    std::vector<TileKey> stack;
+    _profile->getAllKeysAtLOD( 0, stack );
+
+    osg::BoundingSphere bs;
+    while( !stack.empty() )
+    {
+        TileKey key = stack.back();
+        stack.pop_back();
+
+        if ( frustum )
+        {
+            getBound( key, bs );
+            if ( !culler.contains(bs) )
+                continue;
+        }
+
+        out.insert( key );
+
+        if ( key.getLOD() >= maxLOD )
+            continue;
+
+        // Subdivide when any child is within the next LOD's range, like
+        // the terrain engine does.
+        double range = _ranges[key.getLOD()+1];
+        TileKey children[4];
+        bool subdivide = false;
+        for(unsigned q = 0; q < 4; ++q)
+        {
+            children[q] = key.createChildKey(q);
+            getBound( children[q], bs );
+            if ( (bs.center() - eye).length() - bs.radius() < range )
+                subdivide = true;
+        }
+
+        if ( subdivide )
+        {
+            for(unsigned q = 0; q < 4; ++q)
+                stack.push_back( children[q] );
+        }
+    }
+}
+
+void
+TilePrefetcher::getBound(const TileKey& key, osg::BoundingSphere& out) const
+{
+    const GeoCircle& circle = key.getExtent().getBoundingGeoCircle();
+    osg::Vec3d center;
+    circle.getCenter().toWorld( center );
+    out.set( center, circle.getRadius() );
+}
+
+void
+TilePrefetcher::cancelAll()
+{
+    Threading::ScopedMutexLock lock( _mutex );
+
+    for(Tasks::iterator i = _tasks.begin(); i != _tasks.end(); ++i)
+    {
+        if ( !i->second->isCompleted() )
+        {
+            i->second->cancel();
+            ++_numCanceled;
+        }
+    }
+    _tasks.clear();
+    _predicted.clear();
+    ++_generation;
+}
+
+void
+TilePrefetcher::getPredictedKeys(std::vector<TileKey>& out) const
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    out = _predicted;
+}
+
+unsigned
+TilePrefetcher::getNumPending() const
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    return _tasks.size();
+}
@@ -41,7 +41,7 @@ using namespace osgEarth;
 //------------------------------------------------------------------------
 
 TileBlacklist::TileBlacklist() :
-_tiles(true, 1024)
+_tiles(1024)
 {
     //NOP
 }
@@ -121,7 +121,7 @@ TileBlacklist::write(const std::string &filename) const
 }
 
 namespace {
-    struct WriteFunctor : public LRUCache<TileKey,bool>::Functor {
+    struct WriteFunctor : public ConcurrentLRUCache<TileKey,bool>::Functor {
         std::ostream& _out;
         WriteFunctor(std::ostream& out) : _out(out) { }
         void operator()(const TileKey& key, const bool& value) {
@@ -144,6 +144,8 @@ TileBlacklist::write(std::ostream &output) const
 TileSourceOptions::TileSourceOptions( const ConfigOptions& options ) :
 DriverConfigOptions   ( options ),
 _L2CacheSize          ( 16 ),
+_L2CacheSizeMB        ( 0 ),
+_L2CacheShared        ( false ),
 _bilinearReprojection ( true ),
 _coverage             ( false )
 { 
@@ -157,6 +159,8 @@ TileSourceOptions::getConfig() const
     Config conf = DriverConfigOptions::getConfig();
     conf.set( "blacklist_filename", _blacklistFilename);
     conf.set( "l2_cache_size", _L2CacheSize );
+    conf.set( "l2_cache_size_mb", _L2CacheSizeMB );
+    conf.set( "l2_cache_shared", _L2CacheShared );
     conf.set( "bilinear_reprojection", _bilinearReprojection );
     conf.set( "coverage", _coverage );
     conf.set( "osg_option_string", _osgOptionString );
@@ -178,6 +182,8 @@ TileSourceOptions::fromConfig( const Config& conf )
 {
     conf.getIfSet( "blacklist_filename", _blacklistFilename);
     conf.getIfSet( "l2_cache_size", _L2CacheSize );
+    conf.getIfSet( "l2_cache_size_mb", _L2CacheSizeMB );
+    conf.getIfSet( "l2_cache_shared", _L2CacheShared );
     conf.getIfSet( "bilinear_reprojection", _bilinearReprojection );
     conf.getIfSet( "coverage", _coverage );
     conf.getIfSet( "osg_option_string", _osgOptionString );
@@ -208,6 +214,7 @@ _maxValidValue(  32000.0f )
 {
     // Initialize the l2 cache size to the options.
     int l2CacheSize = *options.L2CacheSize();
+    int l2CacheSizeMB = *options.L2CacheSizeMB();
 
     // See if it was overridden with an env var.
     char const* l2env = ::getenv( "OSGEARTH_L2_CACHE_SIZE" );
@@ -216,17 +223,27 @@ _maxValidValue(  32000.0f )
         l2CacheSize = as<int>( std::string(l2env), 0 );
     }
 
+    char const* l2mbEnv = ::getenv( "OSGEARTH_L2_CACHE_SIZE_MB" );
+    if ( l2mbEnv )
+    {
+        l2CacheSizeMB = as<int>( std::string(l2mbEnv), 0 );
+    }
+
     // Env cache-only mode also disables the L2 cache.
     char const* noCacheEnv = ::getenv( "OSGEARTH_MEMORY_PROFILE" );
     if ( noCacheEnv )
     {
         l2CacheSize = 0;
+        l2CacheSizeMB = 0;
     }
 
-    // Initialize the l2 cache if it's size is > 0
-    if ( l2CacheSize > 0 )
+    // Initialize the l2 cache if it's size is > 0. It never shares its objects
+    // (see L2CacheShared): every caller modifies what createImage and
+    // createHeightField return.
+    if ( l2CacheSize > 0 || l2CacheSizeMB > 0 )
     {
         _memCache = new MemCache( l2CacheSize );
+        _memCache->setMaxBinBytes( (unsigned long long)std::max(l2CacheSizeMB, 0) * 1048576ULL );
     }
 
     if (_options.blacklistFilename().isSet())
@@ -314,12 +331,18 @@ TileSource::createImage(const TileKey&        key,
     if (getStatus().isError())
         return 0L;
 
-    // Try to get it from the memcache fist
+    ++_reads;
+
+    // Try to get it from the memcache fist. It returns a private copy, since
+    // callers (and prepOp) modify the image in place.
     if (_memCache.valid())
     {
         ReadResult r = _memCache->getOrCreateDefaultBin()->readImage(key.str(), 0L);
         if ( r.succeeded() )
+        {
+            ++_memCacheHits;
             return r.releaseImage();
+        }
     }
 
     osg::ref_ptr<osg::Image> newImage = createImage(key, progress);
@@ -343,12 +366,16 @@ TileSource::createHeightField(const TileKey&        key,
     if (getStatus().isError())
         return 0L;
 
-    // Try to get it from the memcache first:
+    ++_reads;
+
+    // Try to get it from the memcache first. It returns a private copy, since
+    // callers modify the heightfield in place.
     if (_memCache.valid())
     {
         ReadResult r = _memCache->getOrCreateDefaultBin()->readObject(key.str(), 0L);
         if ( r.succeeded() )
         {
+            ++_memCacheHits;
             return r.release<osg::HeightField>();
         }
     }
@@ -407,6 +434,15 @@ TileSource::storeHeightField(const TileKey&     key,
     return false;
 }
 
+TileSource::ReadStats
+TileSource::getReadStats() const
+{
+    ReadStats stats;
+    stats._reads = _reads;
+    stats._memCacheHits = _memCacheHits;
+    return stats;
+}
+
 bool
 TileSource::isOK() const 
 {
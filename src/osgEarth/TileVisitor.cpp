@@ -19,14 +19,49 @@
 #include <osgEarth/TileVisitor>
 #include <osgEarth/CacheEstimator>
 #include <osgEarth/FileUtils>
+#include <osgEarth/StringUtils>
+#include <iomanip>
 
 using namespace osgEarth;
 
+namespace
+{
+    // Hilbert curve child order. For each of the four orientations of the
+    // curve: the child quadrants (as numbered by TileKey::createChildKey)
+    // in curve order, and the orientation each child's own curve takes.
+    const unsigned s_hilbertQuadrants[4][4] = {
+        { 0, 2, 3, 1 },
+        { 0, 1, 3, 2 },
+        { 3, 1, 0, 2 },
+        { 3, 2, 0, 1 } };
+
+    const unsigned s_hilbertStates[4][4] = {
+        { 1, 0, 0, 3 },
+        { 0, 1, 1, 2 },
+        { 3, 2, 2, 1 },
+        { 2, 3, 3, 0 } };
+}
+
+bool TileVisitor::parseTraversalOrder(const std::string& name, TraversalOrder& out)
+{
+    std::string value = toLower(name);
+    if (value == "depth" || value == "depth_first")
+        out = TRAVERSAL_DEPTH_FIRST;
+    else if (value == "morton" || value == "z")
+        out = TRAVERSAL_MORTON;
+    else if (value == "hilbert")
+        out = TRAVERSAL_HILBERT;
+    else
+        return false;
+    return true;
+}
+
 TileVisitor::TileVisitor():
 _total(0),
 _processed(0),
 _minLevel(0),
-_maxLevel(5)
+_maxLevel(5),
+_traversalOrder(TRAVERSAL_DEPTH_FIRST)
 {
 }
 
@@ -36,7 +71,8 @@ _tileHandler( handler ),
 _total(0),
 _processed(0),
 _minLevel(0),
-_maxLevel(5)
+_maxLevel(5),
+_traversalOrder(TRAVERSAL_DEPTH_FIRST)
 {
 }
 
@@ -79,11 +115,20 @@ void TileVisitor::setProgressCallback( ProgressCallback* progress )
 }
 
 void TileVisitor::run( const Profile* mapProfile )
+{
+    traverse( mapProfile );
+
+    reportReadStats();
+}
+
+void TileVisitor::traverse( const Profile* mapProfile )
 {
     _profile = mapProfile;
     
     // Reset the progress in case this visitor has been ran before.
     resetProgress();
+
+    resetReadStats();
     
     estimate();
 
@@ -91,9 +136,28 @@ void TileVisitor::run( const Profile* mapProfile )
     std::vector<TileKey> keys;
     mapProfile->getRootKeys(keys);
 
-    for (unsigned int i = 0; i < keys.size(); ++i)
+    if (_traversalOrder == TRAVERSAL_DEPTH_FIRST)
     {
-        processKey( keys[i] );
+        for (unsigned int i = 0; i < keys.size(); ++i)
+        {
+            processKey( keys[i] );
+        }
+    }
+    else
+    {
+        // Walk the tree again for each level, handling only that level's keys,
+        // so each level goes out in curve order. This costs some repeated
+        // hasData/intersects tests on the upper levels but needs no more
+        // memory than the depth-first walk.
+        _pruned.clear();
+        for (unsigned int lod = _minLevel; lod <= _maxLevel; ++lod)
+        {
+            for (unsigned int i = 0; i < keys.size(); ++i)
+            {
+                processKeyAtLevel( keys[i], lod, 0u );
+            }
+        }
+        _pruned.clear();
     }
 }
 
@@ -157,6 +221,121 @@ void TileVisitor::processKey( const TileKey& key )
     }       
 }
 
+void TileVisitor::processKeyAtLevel( const TileKey& key, unsigned int lod, unsigned int curveState )
+{
+    if (_progress && _progress->isCanceled())
+    {
+        return;
+    }
+
+    if (_tileHandler && !_tileHandler->hasData(key))
+    {
+        return;
+    }
+
+    if (!intersects( key.getExtent() ))
+    {
+        return;
+    }
+
+    if (key.getLevelOfDetail() == lod)
+    {
+        // Remember the keys whose children should be skipped on the deeper walks.
+        if (!handleTile( key ) && lod < _maxLevel)
+        {
+            prune( key );
+        }
+        return;
+    }
+
+    if (_pruned.find( key ) != _pruned.end())
+    {
+        return;
+    }
+
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        if (_traversalOrder == TRAVERSAL_HILBERT)
+        {
+            processKeyAtLevel(
+                key.createChildKey( s_hilbertQuadrants[curveState][i] ),
+                lod,
+                s_hilbertStates[curveState][i] );
+        }
+        else
+        {
+            processKeyAtLevel( key.createChildKey(i), lod, 0u );
+        }
+    }
+}
+
+void TileVisitor::prune( const TileKey& key )
+{
+    // Each declined key still cuts off its subtree on every deeper walk, so
+    // none can be dropped until the traversal ends. Four declined siblings
+    // do collapse into their parent though, which cuts off the same keys, so
+    // a region declined wholesale costs one entry instead of one per tile.
+    TileKey root = key;
+    while (root.getLevelOfDetail() > 0)
+    {
+        TileKey parent = root.createParentKey();
+
+        bool allPruned = true;
+        for (unsigned int i = 0; i < 4 && allPruned; i++)
+        {
+            TileKey sibling = parent.createChildKey(i);
+            allPruned = sibling == root || _pruned.find( sibling ) != _pruned.end();
+        }
+        if (!allPruned)
+        {
+            break;
+        }
+
+        for (unsigned int i = 0; i < 4; i++)
+        {
+            _pruned.erase( parent.createChildKey(i) );
+        }
+        root = parent;
+    }
+
+    _pruned.insert( root );
+}
+
+void TileVisitor::resetReadStats()
+{
+    _readStatsStart = TileSource::ReadStats();
+    if (_tileHandler.valid())
+    {
+        _tileHandler->getReadStats( _readStatsStart );
+    }
+}
+
+bool TileVisitor::getReadStats(TileSource::ReadStats& out) const
+{
+    TileSource::ReadStats stats;
+    if (!_tileHandler.valid() || !_tileHandler->getReadStats( stats ))
+    {
+        return false;
+    }
+
+    out._reads = stats._reads - _readStatsStart._reads;
+    out._memCacheHits = stats._memCacheHits - _readStatsStart._memCacheHits;
+    return true;
+}
+
+void TileVisitor::reportReadStats()
+{
+    TileSource::ReadStats stats;
+    if (getReadStats( stats ) && stats._reads > 0)
+    {
+        OE_NOTICE << "Source reads: " << stats._reads
+            << ", L2 cache hits: " << stats._memCacheHits
+            << " (" << std::fixed << std::setprecision(1)
+            << 100.0 * (double)stats._memCacheHits / (double)stats._reads << "%)"
+            << std::endl;
+    }
+}
+
 void TileVisitor::incrementProgress(unsigned int amount)
 {
     {
@@ -190,15 +369,15 @@ bool TileVisitor::handleTile( const TileKey& key )
 
 /*****************************************************************************************/
 /**
- * A TaskRequest that runs a TileHandler in a background thread.
+ * A TaskRequest that runs a TileHandler on a batch of keys in a background thread.
  */
 class HandleTileTask : public TaskRequest
 {
 public:
-    HandleTileTask( TileHandler* handler, TileVisitor* visitor, const TileKey& key ):      
+    HandleTileTask( TileHandler* handler, TileVisitor* visitor, const TileKeyList& keys ):      
       _handler( handler ),
           _visitor(visitor),
-          _key( key )
+          _keys( keys )
       {
 
       }
@@ -207,18 +386,22 @@ public:
       {         
           if (_handler.valid())
           {                           
-              _handler->handleTile( _key, *_visitor.get() );
-              _visitor->incrementProgress(1);
+              for (TileKeyList::const_iterator i = _keys.begin(); i != _keys.end(); ++i)
+              {
+                  _handler->handleTile( *i, *_visitor.get() );
+                  _visitor->incrementProgress(1);
+              }
           }
       }
 
       osg::ref_ptr<TileHandler> _handler;
-      TileKey _key;
+      TileKeyList _keys;
       osg::ref_ptr<TileVisitor> _visitor;
 };
 
 MultithreadedTileVisitor::MultithreadedTileVisitor():
-_numThreads( OpenThreads::GetNumberOfProcessors() )
+_numThreads( OpenThreads::GetNumberOfProcessors() ),
+_batchSize( 1 )
 {
     // We must do this to avoid an error message in OpenSceneGraph b/c the findWrapper method doesn't appear to be threadsafe.
     // This really isn't a big deal b/c this only effects data that is already cached.
@@ -227,7 +410,8 @@ _numThreads( OpenThreads::GetNumberOfProcessors() )
 
 MultithreadedTileVisitor::MultithreadedTileVisitor( TileHandler* handler ):
 TileVisitor( handler ),
-    _numThreads( OpenThreads::GetNumberOfProcessors() )
+    _numThreads( OpenThreads::GetNumberOfProcessors() ),
+    _batchSize( 1 )
 {
 }
 
@@ -241,14 +425,27 @@ void MultithreadedTileVisitor::setNumThreads( unsigned int numThreads)
     _numThreads = numThreads; 
 }
 
+unsigned int MultithreadedTileVisitor::getBatchSize() const
+{
+    return _batchSize;
+}
+
+void MultithreadedTileVisitor::setBatchSize( unsigned int batchSize )
+{
+    _batchSize = batchSize > 0 ? batchSize : 1;
+}
+
 void MultithreadedTileVisitor::run(const Profile* mapProfile)
 {                   
     // Start up the task service
     OE_INFO << "Starting " << _numThreads << std::endl;
-    _taskService = new TaskService( "MTTileHandler", _numThreads, 1000 );
+    _taskService = new TaskService( "MTTileHandler", _numThreads, 1000, TaskService::SCHEDULER_WORK_STEALING );
 
     // Produce the tiles
-    TileVisitor::run( mapProfile );
+    traverse( mapProfile );
+
+    // Queue any keys left in the final batch
+    processBatch();
 
     // Send a poison pill to kill all the threads
     _taskService->add( new PoisonPill() );
@@ -265,15 +462,31 @@ void MultithreadedTileVisitor::run(const Profile* mapProfile)
         }
     }
     OE_INFO << "All threads have completed" << std::endl;
+
+    reportReadStats();
 }
 
 bool MultithreadedTileVisitor::handleTile( const TileKey& key )        
 {    
-    // Add the tile to the task queue.
-    _taskService->add( new HandleTileTask(_tileHandler, this, key ) );
+    // Collect the key; full batches go to the task queue.
+    _batch.push_back( key );
+
+    if (_batch.size() >= _batchSize)
+    {
+        processBatch();
+    }
     return true;
 }
 
+void MultithreadedTileVisitor::processBatch()
+{
+    if (!_batch.empty())
+    {
+        _taskService->add( new HandleTileTask(_tileHandler, this, _batch ) );
+        _batch.clear();
+    }
+}
+
 /*****************************************************************************************/
 
 TaskList::TaskList(const Profile* profile):
@@ -366,7 +579,7 @@ void MultiprocessTileVisitor::run(const Profile* mapProfile)
     _taskService = new TaskService( "MPTileHandler", _numProcesses, 1000 );
     
     // Produce the tiles
-    TileVisitor::run( mapProfile );
+    traverse( mapProfile );
 
     // Process any remaining tasks in the final batch
     processBatch();
@@ -489,6 +702,8 @@ void TileKeyListVisitor::run(const Profile* mapProfile)
 {
     resetProgress();        
 
+    resetReadStats();
+
     for (TileKeyList::iterator itr = _keys.begin(); itr != _keys.end(); ++itr)
     {
         if (_tileHandler)
@@ -497,4 +712,6 @@ void TileKeyListVisitor::run(const Profile* mapProfile)
             incrementProgress(1);
         }
     }
+
+    reportReadStats();
 }
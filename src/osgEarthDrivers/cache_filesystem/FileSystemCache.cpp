@@ -25,9 +25,13 @@
 #include <osgEarth/FileUtils>
 #include <osgEarth/StringUtils>
 #include <osgEarth/Registry>
+#include <osgEarth/DateTime>
 #include <osgDB/FileUtils>
 #include <osgDB/FileNameUtils>
+#include <OpenThreads/Condition>
 #include <fstream>
+#include <deque>
+#include <cstring>
 #include <sys/stat.h>
 
 using namespace osgEarth;
@@ -42,6 +46,14 @@ using namespace osgEarth::Threading;
 #define OSG_EXT   ".osgb"
 #define OSG_COMPRESS
 
+// Leading bytes of a data file that carries its own metadata
+// (see FileSystemCacheOptions::packMetadata)
+#define PACKED_MAGIC     "oemeta01"
+#define PACKED_MAGIC_LEN 8
+
+// Number of per-key lock stripes in each bin
+#define NUM_KEY_STRIPES  64
+
 namespace
 {
     /** 
@@ -71,7 +83,8 @@ namespace
 
         void init();
 
-        std::string _rootPath;
+        std::string            _rootPath;
+        FileSystemCacheOptions _options;
     };
 
     /** 
@@ -81,7 +94,7 @@ namespace
     class FileSystemCacheBin : public CacheBin
     {
     public:
-        FileSystemCacheBin( const std::string& name, const std::string& rootPath );
+        FileSystemCacheBin( const std::string& name, const std::string& rootPath, const FileSystemCacheOptions& options );
 
     public: // CacheBin interface
 
@@ -110,6 +123,44 @@ namespace
         std::string getHashedKey(const std::string&) const;
 
     protected:
+        virtual ~FileSystemCacheBin();
+
+        /** A write waiting in the write-behind queue. */
+        struct PendingWrite
+        {
+            PendingWrite() : timeStamp(0), generation(0u), queued(false) { }
+            osg::ref_ptr<const osg::Object>    object;
+            Config                             meta;
+            osg::ref_ptr<const osgDB::Options> dbo;
+            TimeStamp                          timeStamp;
+            unsigned                           generation;
+            bool                               queued;
+        };
+        typedef std::map<std::string, PendingWrite> PendingWrites;
+
+        /** Background thread that services the write-behind queue. */
+        struct WriteBehindThread : public OpenThreads::Thread
+        {
+            WriteBehindThread(FileSystemCacheBin* bin) : _bin(bin) { }
+            void run() { _bin->runWriteQueue(); }
+            FileSystemCacheBin* _bin;
+        };
+
+        ReadResult readRecord(const std::string& key, const osgDB::Options* dbo, bool asImage);
+
+        // Encodes and writes a record; caller must hold the key's stripe lock.
+        bool writeRecord(const std::string& key, const osg::Object* object, const Config& meta, const osgDB::Options* dbo);
+
+        bool enqueueWrite(const std::string& key, const osg::Object* object, const Config& meta, const osgDB::Options* dbo);
+
+        bool getPendingWrite(const std::string& key, PendingWrite& output);
+
+        void runWriteQueue();
+
+        Threading::ReadWriteMutex& getKeyMutex(const std::string& key) {
+            return _keyMutexes[osgEarth::hashString(key) % NUM_KEY_STRIPES];
+        }
+
         bool purgeDirectory( const std::string& dir );
 
         bool binValidForReading(bool silent =true);
@@ -125,7 +176,25 @@ namespace
         std::string                       _compressorName;
         osg::ref_ptr<osgDB::ReaderWriter> _rw;
         osg::ref_ptr<osgDB::Options>      _zlibOptions;
+        bool                              _packMetadata;
+
+        // Bin-wide lock; taken for writing only by operations on the whole bin
+        // (clear, metadata). Record operations take it for reading and then
+        // lock the key's stripe, so writers of different keys don't block
+        // each other or readers.
         mutable Threading::ReadWriteMutex _mutex;
+        Threading::ReadWriteMutex         _keyMutexes[NUM_KEY_STRIPES];
+
+        // write-behind queue:
+        bool                              _writeBehind;
+        unsigned                          _maxPendingWrites;
+        unsigned                          _writeGeneration;
+        bool                              _writeQueueDone;
+        PendingWrites                     _pendingWrites;
+        std::deque<std::string>           _writeQueue;
+        Threading::Mutex                  _writeQueueMutex;
+        OpenThreads::Condition            _writeQueueCond;
+        WriteBehindThread*                _writeThread;
     };
 
     void writeMeta( const std::string& fullPath, const Config& meta )
@@ -152,6 +221,37 @@ namespace
             meta.fromJSON( bufStr );
         }
     }
+
+    void writePackedHeader( std::ostream& out, const Config& meta )
+    {
+        std::string json = meta.empty() ? std::string() : meta.toJSON();
+        unsigned len = json.length();
+        out.write( PACKED_MAGIC, PACKED_MAGIC_LEN );
+        out.write( reinterpret_cast<const char*>(&len), sizeof(len) );
+        if ( len > 0 )
+            out.write( json.c_str(), len );
+    }
+
+    /** Reads the packed header if present; on success the stream is left at the payload. */
+    bool readPackedHeader( std::istream& in, Config& meta )
+    {
+        char magic[PACKED_MAGIC_LEN];
+        if ( !in.read(magic, PACKED_MAGIC_LEN) || ::memcmp(magic, PACKED_MAGIC, PACKED_MAGIC_LEN) != 0 )
+            return false;
+
+        unsigned len = 0;
+        if ( !in.read(reinterpret_cast<char*>(&len), sizeof(len)) )
+            return false;
+
+        if ( len > 0 )
+        {
+            std::string json(len, '\0');
+            if ( !in.read(&json[0], len) )
+                return false;
+            meta.fromJSON( json );
+        }
+        return true;
+    }
 }
 
 
@@ -179,6 +279,7 @@ namespace
         }
 
         _rootPath = URI( *fsco.rootPath(), options.referrer() ).full();
+        _options = fsco;
         init();
     }
 
@@ -191,7 +292,7 @@ namespace
     CacheBin*
     FileSystemCache::addBin( const std::string& name )
     {
-        return _bins.getOrCreate( name, new FileSystemCacheBin( name, _rootPath ) );
+        return _bins.getOrCreate( name, new FileSystemCacheBin( name, _rootPath, _options ) );
     }
 
     CacheBin*
@@ -203,7 +304,7 @@ namespace
             Threading::ScopedMutexLock lock( s_defaultBinMutex );
             if ( !_defaultBin.valid() ) // double-check
             {
-                _defaultBin = new FileSystemCacheBin( "__default", _rootPath );
+                _defaultBin = new FileSystemCacheBin( "__default", _rootPath, _options );
             }
         }
         return _defaultBin.get();
@@ -288,11 +389,18 @@ namespace
         return _ok;
     }
 
-    FileSystemCacheBin::FileSystemCacheBin(const std::string&   binID,
-                                           const std::string&   rootPath) :
+    FileSystemCacheBin::FileSystemCacheBin(const std::string&            binID,
+                                           const std::string&            rootPath,
+                                           const FileSystemCacheOptions& options) :
     CacheBin            ( binID ),
     _binPathExists      ( false ),
-    _ok( true )
+    _ok                 ( true ),
+    _packMetadata       ( options.packMetadata().get() ),
+    _writeBehind        ( options.writeBehind().get() ),
+    _maxPendingWrites   ( osg::maximum(options.maxPendingWrites().get(), 1u) ),
+    _writeGeneration    ( 0u ),
+    _writeQueueDone     ( false ),
+    _writeThread        ( 0L )
     {
         _binPath = osgDB::concatPaths( rootPath, binID );
         _metaPath = osgDB::concatPaths( _binPath, "osgearth_cacheinfo.json" );
@@ -313,7 +421,28 @@ namespace
         if (_compressorName.length() > 0){
            _zlibOptions->setPluginStringData("Compressor", _compressorName);
         }
-     
+
+        if ( _writeBehind )
+        {
+            _writeThread = new WriteBehindThread( this );
+            _writeThread->start();
+        }
+    }
+
+    FileSystemCacheBin::~FileSystemCacheBin()
+    {
+        if ( _writeThread )
+        {
+            // the thread drains the queue before exiting.
+            {
+                Threading::ScopedMutexLock lock( _writeQueueMutex );
+                _writeQueueDone = true;
+                _writeQueueCond.broadcast();
+            }
+            _writeThread->join();
+            delete _writeThread;
+            _writeThread = 0L;
+        }
     }
 
     const osgDB::Options*
@@ -340,75 +469,79 @@ namespace
     ReadResult
     FileSystemCacheBin::readImage(const std::string& key, const osgDB::Options* readOptions)
     {
-        if ( !binValidForReading() ) 
-            return ReadResult(ReadResult::RESULT_NOT_FOUND);
-
-        // mangle "key" into a legal path name
-        URI fileURI( getHashedKey(key), _metaPath );
-        std::string path = fileURI.full() + OSG_EXT;
-
-        if ( !osgDB::fileExists(path) )
-            return ReadResult( ReadResult::RESULT_NOT_FOUND );
-
-        osgEarth::TimeStamp timeStamp = osgEarth::getLastModifiedTime(path);     
-
-        osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(readOptions);
-
-        osgDB::ReaderWriter::ReadResult r;
-        {
-            ScopedReadLock lock(_mutex);
-
-            r = _rw->readImage( path, dbo.get() );
-            if ( !r.success() )
-                return ReadResult();
-
-            // read metadata
-            Config meta;
-            std::string metafile = fileURI.full() + ".meta";
-            if ( osgDB::fileExists(metafile) )
-                readMeta( metafile, meta );
-
-            ReadResult rr( r.getImage(), meta );
-            rr.setLastModifiedTime(timeStamp);
-            return rr;            
-        }
+        return readRecord( key, readOptions, true );
     }
 
     ReadResult
     FileSystemCacheBin::readObject(const std::string& key, const osgDB::Options* readOptions)
+    {
+        return readRecord( key, readOptions, false );
+    }
+
+    ReadResult
+    FileSystemCacheBin::readRecord(const std::string& key, const osgDB::Options* readOptions, bool asImage)
     {
         if ( !binValidForReading() ) 
             return ReadResult(ReadResult::RESULT_NOT_FOUND);
 
+        // a write still in the queue supersedes whatever is on disk:
+        if ( _writeBehind )
+        {
+            PendingWrite pending;
+            if ( getPendingWrite(key, pending) )
+            {
+                if ( asImage && !dynamic_cast<const osg::Image*>(pending.object.get()) )
+                    return ReadResult();
+
+                // the queue owns its copy; hand out another so the caller can't change it.
+                ReadResult rr( osg::clone(pending.object.get(), osg::CopyOp::DEEP_COPY_ALL), pending.meta );
+                rr.setLastModifiedTime( pending.timeStamp );
+                return rr;
+            }
+        }
+
         // mangle "key" into a legal path name
         URI fileURI( getHashedKey(key), _metaPath );
         std::string path = fileURI.full() + OSG_EXT;
 
+        osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(readOptions);
+
+        ScopedReadLock binLock( _mutex );
+        ScopedReadLock keyLock( getKeyMutex(key) );
+
         if ( !osgDB::fileExists(path) )
             return ReadResult( ReadResult::RESULT_NOT_FOUND );
 
         osgEarth::TimeStamp timeStamp = osgEarth::getLastModifiedTime(path);
 
-        osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(readOptions);
-
+        Config meta;
         osgDB::ReaderWriter::ReadResult r;
+
+        std::ifstream input( path.c_str(), std::ios_base::in | std::ios_base::binary );
+        if ( input.is_open() && readPackedHeader(input, meta) )
+        {
+            // single-file record; the payload follows the metadata.
+            r = asImage ? _rw->readImage( input, dbo.get() ) : _rw->readObject( input, dbo.get() );
+            if ( !r.success() )
+                return ReadResult();
+        }
+        else
         {
-            ScopedReadLock lock(_mutex);
+            input.close();
 
-            r = _rw->readObject( path, dbo.get() );
+            r = asImage ? _rw->readImage( path, dbo.get() ) : _rw->readObject( path, dbo.get() );
             if ( !r.success() )
                 return ReadResult();
 
             // read metadata
-            Config meta;
             std::string metafile = fileURI.full() + ".meta";
             if ( osgDB::fileExists(metafile) )
                 readMeta( metafile, meta );
-
-            ReadResult rr( r.getObject(), meta );
-            rr.setLastModifiedTime(timeStamp);
-            return rr;            
         }
+
+        ReadResult rr( asImage ? r.getImage() : r.getObject(), meta );
+        rr.setLastModifiedTime(timeStamp);
+        return rr;
     }
 
     ReadResult
@@ -434,52 +567,83 @@ namespace
         if ( !binValidForWriting() || !object ) 
             return false;
 
+        if ( _writeBehind )
+            return enqueueWrite( key, object, meta, writeOptions );
+
+        ScopedReadLock  binLock( _mutex );
+        ScopedWriteLock keyLock( getKeyMutex(key) );
+        return writeRecord( key, object, meta, writeOptions );
+    }
+
+    bool
+    FileSystemCacheBin::writeRecord(const std::string& key, const osg::Object* object, const Config& meta, const osgDB::Options* writeOptions)
+    {
         // convert the key into a legal filename:
         URI fileURI( getHashedKey(key), _metaPath );
-        
-        osgDB::ReaderWriter::WriteResult r;
+        std::string filename = fileURI.full() + OSG_EXT;
 
-        bool objWriteOK = false;
-        {
-            // prevent cache contention:
-            ScopedWriteLock lock(_mutex);
+        // make a home for it..
+        if ( !osgDB::fileExists( osgDB::getFilePath(fileURI.full()) ) )
+            osgEarth::makeDirectoryForFile( fileURI.full() );
 
-            // make a home for it..
-            if ( !osgDB::fileExists( osgDB::getFilePath(fileURI.full()) ) )
-                osgEarth::makeDirectoryForFile( fileURI.full() );
+        osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(writeOptions);
 
-            osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(writeOptions);
+        const osg::Image* image = dynamic_cast<const osg::Image*>(object);
+        const osg::Node*  node  = image ? 0L : dynamic_cast<const osg::Node*>(object);
 
-            if ( dynamic_cast<const osg::Image*>(object) )
+        osgDB::ReaderWriter::WriteResult r;
+
+        if ( _packMetadata )
+        {
+            std::ofstream output( filename.c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc );
+            if ( output.is_open() )
             {
-                std::string filename = fileURI.full() + OSG_EXT;
-                r = _rw->writeImage( *static_cast<const osg::Image*>(object), filename, dbo.get() );
-                objWriteOK = r.success();
+                writePackedHeader( output, meta );
+
+                if ( image )
+                    r = _rw->writeImage( *image, output, dbo.get() );
+                else if ( node )
+                    r = _rw->writeNode( *node, output, dbo.get() );
+                else
+                    r = _rw->writeObject( *object, output, dbo.get() );
+
+                output.flush();
+                if ( r.success() && output.fail() )
+                    r = osgDB::ReaderWriter::WriteResult( osgDB::ReaderWriter::WriteResult::ERROR_IN_WRITING_FILE );
             }
-            else if ( dynamic_cast<const osg::Node*>(object) )
+
+            // a sidecar left by an unpacked write of this record is stale now.
+            if ( r.success() )
             {
-                std::string filename = fileURI.full() + OSG_EXT;
-                r = _rw->writeNode(*static_cast<const osg::Node*>(object), filename, dbo.get());
-                objWriteOK = r.success();
+                std::string metaname = fileURI.full() + ".meta";
+                if ( osgDB::fileExists(metaname) )
+                    ::unlink( metaname.c_str() );
             }
             else
             {
-                std::string filename = fileURI.full() + OSG_EXT;
-                r = _rw->writeObject(*object, filename, dbo.get());
-                objWriteOK = r.success();
+                r = osgDB::ReaderWriter::WriteResult( osgDB::ReaderWriter::WriteResult::ERROR_IN_WRITING_FILE );
             }
+        }
+        else
+        {
+            if ( image )
+                r = _rw->writeImage( *image, filename, dbo.get() );
+            else if ( node )
+                r = _rw->writeNode( *node, filename, dbo.get() );
+            else
+                r = _rw->writeObject( *object, filename, dbo.get() );
 
             // write metadata
-            if ( !meta.empty() && objWriteOK )
+            if ( !meta.empty() && r.success() )
             {
                 std::string metaname = fileURI.full() + ".meta";
                 writeMeta( metaname, meta );
             }
         }
 
-        if ( objWriteOK )
+        if ( r.success() )
         {
-            OE_DEBUG << LC << "Wrote \"" << key << "\" to cache bin [" << getID() << "] path=" << fileURI.full() << "." << OSG_EXT << std::endl;
+            OE_DEBUG << LC << "Wrote \"" << key << "\" to cache bin [" << getID() << "] path=" << filename << std::endl;
         }
         else
         {
@@ -487,7 +651,112 @@ namespace
                 << "; msg = \"" << r.message() << "\"" << std::endl;
         }
 
-        return objWriteOK;
+        return r.success();
+    }
+
+    bool
+    FileSystemCacheBin::enqueueWrite(const std::string& key, const osg::Object* object, const Config& meta, const osgDB::Options* writeOptions)
+    {
+        // The caller may keep changing its object after write() returns, so
+        // queue a private copy. Done before locking since it can be costly.
+        osg::ref_ptr<const osg::Object> copy = osg::clone(object, osg::CopyOp::DEEP_COPY_ALL);
+        if ( !copy.valid() )
+            return false;
+
+        Threading::ScopedMutexLock lock( _writeQueueMutex );
+
+        PendingWrites::iterator i = _pendingWrites.find(key);
+
+        // apply back-pressure when the queue is full; replacing a pending
+        // record doesn't grow the queue so it never waits.
+        while ( i == _pendingWrites.end() && _pendingWrites.size() >= _maxPendingWrites && !_writeQueueDone )
+        {
+            _writeQueueCond.wait( &_writeQueueMutex );
+            i = _pendingWrites.find(key);
+        }
+
+        if ( _writeQueueDone )
+            return false;
+
+        PendingWrite& pending = (i != _pendingWrites.end()) ? i->second : _pendingWrites[key];
+        pending.object     = copy.get();
+        pending.meta       = meta;
+        pending.dbo        = writeOptions;
+        pending.timeStamp  = DateTime().asTimeStamp();
+        pending.generation = ++_writeGeneration;
+
+        if ( i == _pendingWrites.end() || !pending.queued )
+        {
+            pending.queued = true;
+            _writeQueue.push_back( key );
+            _writeQueueCond.broadcast();
+        }
+
+        return true;
+    }
+
+    bool
+    FileSystemCacheBin::getPendingWrite(const std::string& key, PendingWrite& output)
+    {
+        Threading::ScopedMutexLock lock( _writeQueueMutex );
+        PendingWrites::const_iterator i = _pendingWrites.find(key);
+        if ( i == _pendingWrites.end() )
+            return false;
+        output = i->second;
+        return true;
+    }
+
+    void
+    FileSystemCacheBin::runWriteQueue()
+    {
+        for(;;)
+        {
+            std::string  key;
+            PendingWrite pending;
+            {
+                Threading::ScopedMutexLock lock( _writeQueueMutex );
+                while ( _writeQueue.empty() && !_writeQueueDone )
+                    _writeQueueCond.wait( &_writeQueueMutex );
+
+                if ( _writeQueue.empty() )
+                    return;
+
+                key = _writeQueue.front();
+                _writeQueue.pop_front();
+
+                PendingWrites::iterator i = _pendingWrites.find(key);
+                if ( i == _pendingWrites.end() )
+                    continue; // removed or cleared since it was queued
+
+                i->second.queued = false;
+                pending = i->second;
+            }
+
+            {
+                ScopedReadLock  binLock( _mutex );
+                ScopedWriteLock keyLock( getKeyMutex(key) );
+
+                // re-check under the key lock so a concurrent remove() or clear()
+                // can't be undone by a late write:
+                bool current;
+                {
+                    Threading::ScopedMutexLock lock( _writeQueueMutex );
+                    PendingWrites::const_iterator i = _pendingWrites.find(key);
+                    current = i != _pendingWrites.end() && i->second.generation == pending.generation;
+                }
+
+                if ( current )
+                    writeRecord( key, pending.object.get(), pending.meta, pending.dbo.get() );
+            }
+
+            {
+                Threading::ScopedMutexLock lock( _writeQueueMutex );
+                PendingWrites::iterator i = _pendingWrites.find(key);
+                if ( i != _pendingWrites.end() && i->second.generation == pending.generation )
+                    _pendingWrites.erase( i );
+                _writeQueueCond.broadcast();
+            }
+        }
     }
 
     CacheBin::RecordStatus
@@ -496,6 +765,13 @@ namespace
         if ( !binValidForReading() ) 
             return STATUS_NOT_FOUND;
 
+        if ( _writeBehind )
+        {
+            Threading::ScopedMutexLock lock( _writeQueueMutex );
+            if ( _pendingWrites.find(key) != _pendingWrites.end() )
+                return STATUS_OK;
+        }
+
         URI fileURI( getHashedKey(key), _metaPath );
         std::string path( fileURI.full() + OSG_EXT );
         if ( !osgDB::fileExists(path) )
@@ -511,18 +787,37 @@ namespace
         URI fileURI( getHashedKey(key), _metaPath );
         std::string path( fileURI.full() + OSG_EXT );
 
-        ScopedWriteLock lock(_mutex);
-        return ::unlink( path.c_str() ) == 0;
+        bool wasPending = false;
+        if ( _writeBehind )
+        {
+            Threading::ScopedMutexLock lock( _writeQueueMutex );
+            wasPending = _pendingWrites.erase(key) > 0;
+            _writeQueueCond.broadcast();
+        }
+
+        ScopedReadLock  binLock( _mutex );
+        ScopedWriteLock keyLock( getKeyMutex(key) );
+        return (::unlink( path.c_str() ) == 0) || wasPending;
     }
 
     bool
     FileSystemCacheBin::touch(const std::string& key)
     {
         if ( !binValidForReading() ) return false;
+
+        if ( _writeBehind )
+        {
+            // a pending record will be stamped when it's written.
+            Threading::ScopedMutexLock lock( _writeQueueMutex );
+            if ( _pendingWrites.find(key) != _pendingWrites.end() )
+                return true;
+        }
+
         URI fileURI( getHashedKey(key), _metaPath );
         std::string path( fileURI.full() + OSG_EXT );
 
-        ScopedWriteLock lock(_mutex);
+        ScopedReadLock  binLock( _mutex );
+        ScopedWriteLock keyLock( getKeyMutex(key) );
         return osgEarth::touchFile( path );
     }
 
@@ -573,6 +868,14 @@ namespace
         if ( !binValidForReading() )
             return false;
 
+        if ( _writeBehind )
+        {
+            Threading::ScopedMutexLock lock( _writeQueueMutex );
+            _pendingWrites.clear();
+            _writeQueue.clear();
+            _writeQueueCond.broadcast();
+        }
+
         ScopedWriteLock lock(_mutex);
         std::string binDir = osgDB::getFilePath( _metaPath );
         return purgeDirectory( binDir );
@@ -85,7 +85,8 @@ LevelDBCacheBin::LevelDBCacheBin(const std::string& binID,
 osgEarth::CacheBin( binID ),
 _db               ( db ),
 _tracker          ( tracker ),
-_debug            ( false )
+_debug            ( false ),
+_codec            ( CacheRecordCodec::parseCompression(tracker->options().compression().get()) )
 {
     // reader to parse data:
     _rw = osgDB::Registry::instance()->getReaderWriterForExtension( "osgb" );
@@ -257,18 +258,7 @@ LevelDBCacheBin::read(const std::string& key, const Reader& reader)
     leveldb::Status status;
     leveldb::ReadOptions ro;
 
-    // first read the metadata record.
-    std::string metavalue;
-    status = _db->Get( ro, metaKey(key), &metavalue );
-    TimeStamp lastModified = (TimeStamp)0;
-    if ( status.ok() )
-    {        
-        decodeMeta(metavalue, metadata);
-        DateTime t( metadata.value(TIME_FIELD));
-        lastModified = t.asTimeStamp();
-    }
-        
-    // next read the data record.
+    // first read the data record.
     std::string datakey = dataKey(key);
     std::string datavalue;
     status = _db->Get( ro, datakey, &datavalue );
@@ -282,18 +272,52 @@ LevelDBCacheBin::read(const std::string& key, const Reader& reader)
     if ( _tracker->seed().isSet() )
         unblend(datavalue, _tracker->seed().value());
 
-    // finally, decode the OSGB stream into an object.
-    std::istringstream datastream(datavalue);
-    osgDB::ReaderWriter::ReadResult r = reader.read(datastream);
-    if ( !r.success() )
+    osg::ref_ptr<osg::Object> object;
+    bool singleRecord = CacheRecordCodec::isRecord(datavalue);
+
+    if ( singleRecord )
     {
-        OE_WARN << LC << "Cache read failure!"
-            << "\n reader = " << reader.name()
-            << "\n error detail = " << r.message()
-            << "\n data value = " << datavalue
-            << "\n";
+        // the record carries its own metadata; decode everything at once.
+        if ( !_codec.decode(datavalue, metadata, object, reader._op) )
+        {
+            OE_WARN << LC << "Cache read failure!"
+                << "\n reader = " << reader.name()
+                << "\n error detail = failed to decode record (" << key << ")"
+                << "\n";
 
-        return ReadResult(ReadResult::RESULT_READER_ERROR);
+            return ReadResult(ReadResult::RESULT_READER_ERROR);
+        }
+    }
+    else
+    {
+        // legacy layout: the metadata lives in its own record.
+        std::string metavalue;
+        if ( _db->Get( ro, metaKey(key), &metavalue ).ok() )
+        {
+            decodeMeta(metavalue, metadata);
+        }
+
+        // decode the OSGB stream into an object.
+        std::istringstream datastream(datavalue);
+        osgDB::ReaderWriter::ReadResult r = reader.read(datastream);
+        if ( !r.success() )
+        {
+            OE_WARN << LC << "Cache read failure!"
+                << "\n reader = " << reader.name()
+                << "\n error detail = " << r.message()
+                << "\n data value = " << datavalue
+                << "\n";
+
+            return ReadResult(ReadResult::RESULT_READER_ERROR);
+        }
+        object = r.getObject();
+    }
+
+    TimeStamp lastModified = (TimeStamp)0;
+    if ( metadata.hasValue(TIME_FIELD) )
+    {
+        DateTime t( metadata.value(TIME_FIELD));
+        lastModified = t.asTimeStamp();
     }
         
     if ( _debug )
@@ -304,13 +328,11 @@ LevelDBCacheBin::read(const std::string& key, const Reader& reader)
     // if there's a size limit, we need to 'touch' the record.
     if ( _tracker->hasSizeLimit() )
     {
-        // Room for optimization here since we already have the 
-        // meta/time records around.
-        touch( key );
+        touch( key, singleRecord ? &metadata : 0L );
     }
 
     ++_tracker->hits;
-    ReadResult rr(r.getObject(), metadata);
+    ReadResult rr(object.get(), metadata);
     rr.setLastModifiedTime(lastModified);    
     return rr;
 }
@@ -337,6 +359,9 @@ LevelDBCacheBin::write(const std::string& key, const osg::Object* object, const
 {
     if ( !binValidForWriting() || !object ) 
         return false;
+
+    if ( _tracker->options().singleRecord() == true )
+        return writeRecord(key, object, meta, writeOptions);
         
     osgDB::ReaderWriter::WriteResult r;
     bool objWriteOK = false;
@@ -419,6 +444,64 @@ LevelDBCacheBin::write(const std::string& key, const osg::Object* object, const
     return objWriteOK;
 }
 
+bool
+LevelDBCacheBin::writeRecord(const std::string& key, const osg::Object* object, const Config& meta, const osgDB::Options* writeOptions)
+{
+    DateTime now;
+
+    Config metadata(meta);
+    metadata.set( TIME_FIELD, now.asCompactISO8601() );
+
+    std::string data;
+    if ( !_codec.encode(object, metadata, data, writeOptions) )
+    {
+        OE_WARN << LC << "Bin " << getID() << ": FAILED to encode (" << key << ")\n";
+        return false;
+    }
+
+    if ( _tracker->seed().isSet() )
+        blend(data, _tracker->seed().value());
+
+    leveldb::WriteBatch batch;
+
+    // the data record holds the metadata too:
+    batch.Put( dataKey(key), data );
+
+    // write the timestamp index:
+    batch.Put( timeKey(now, key), binDataKeyTuple(key) );
+
+    // drop any separate metadata left over from an earlier write or touch:
+    batch.Delete( metaKey(key) );
+
+    if ( !_db->Write( leveldb::WriteOptions(), &batch ).ok() )
+    {
+        OE_WARN << LC << "Bin " << getID() << ": FAILED to write (" << key << ")\n";
+        return false;
+    }
+
+    ++_tracker->writes;
+    postWrite();
+
+    if ( _debug )
+    {
+        OE_NOTICE << LC << "Bin " << getID() << ": wrote record (" << key << ")\n";
+    }
+    return true;
+}
+
+bool
+LevelDBCacheBin::readRecordMeta(const std::string& key, Config& meta)
+{
+    std::string datavalue;
+    if ( _db->Get(leveldb::ReadOptions(), dataKey(key), &datavalue).ok() == false )
+        return false;
+
+    if ( _tracker->seed().isSet() )
+        unblend(datavalue, _tracker->seed().value());
+
+    return _codec.decodeMeta(datavalue, meta);
+}
+
 void
 LevelDBCacheBin::postWrite()
 {
@@ -471,6 +554,13 @@ LevelDBCacheBin::getRecordStatus(const std::string& key)
     {        
         return STATUS_OK;
     }
+
+    // single records have no separate metadata until they are touched.
+    Config metadata;
+    if ( readRecordMeta(key, metadata) )
+    {
+        return STATUS_OK;
+    }
     else
     {
         return STATUS_NOT_FOUND;
@@ -483,13 +573,14 @@ LevelDBCacheBin::remove(const std::string& key)
     if ( !binValidForReading() )
         return false;
 
-    // first read in the time from the metadata record.
+    // first read in the time from the metadata record (or the single record).
+    Config metadata;
     std::string metavalue;
-    if ( _db->Get(leveldb::ReadOptions(), metaKey(key), &metavalue).ok() == false )
+    if ( _db->Get(leveldb::ReadOptions(), metaKey(key), &metavalue).ok() )
+        decodeMeta(metavalue, metadata);
+    else if ( !readRecordMeta(key, metadata) )
         return false;
 
-    Config metadata;
-    decodeMeta(metavalue, metadata);
     DateTime t(metadata.value(TIME_FIELD));
 
     leveldb::WriteBatch batch;
@@ -513,18 +604,34 @@ LevelDBCacheBin::remove(const std::string& key)
 
 bool
 LevelDBCacheBin::touch(const std::string& key)
+{
+    return touch(key, 0L);
+}
+
+bool
+LevelDBCacheBin::touch(const std::string& key, const Config* recordMeta)
 {    
     if ( !binValidForWriting() )
         return false;
 
-    // first read in the time from the metadata record.
+    // first read in the time from the metadata record. A single record
+    // only gets one once it has been touched, so fall back on the time
+    // stored in the record itself.
+    Config metadata;
     std::string metavalue;
-    if ( _db->Get(leveldb::ReadOptions(), metaKey(key), &metavalue).ok() == false )
+    bool hasMetaRecord = _db->Get(leveldb::ReadOptions(), metaKey(key), &metavalue).ok();
+    if ( hasMetaRecord )
+        decodeMeta(metavalue, metadata);
+    else if ( recordMeta )
+        metadata = *recordMeta;
+    else if ( !readRecordMeta(key, metadata) )
         return false;
 
-    Config metadata;
-    decodeMeta(metavalue, metadata);
     DateTime oldtime(metadata.value(TIME_FIELD));
+
+    // single records keep their own metadata; only the access time goes here.
+    if ( !hasMetaRecord )
+        metadata = Config();
         
     leveldb::WriteBatch batch;
 
@@ -21,6 +21,7 @@
 #include <osgEarth/NodeUtils>
 #include <osgEarthUtil/TopologyGraph>
 #include <osg/Point>
+#include <osg/Timer>
 #include <cstdlib> // for getenv
 
 using namespace osgEarth;
@@ -47,9 +48,10 @@ using namespace osgEarth::Drivers::RexTerrainEngine;
 
 
 GeometryPool::GeometryPool(const RexTerrainEngineOptions& options) :
-_options ( options ),
-_enabled ( true ),
-_debug   ( false )
+_options   ( options ),
+_generation( 0u ),
+_enabled   ( true ),
+_debug     ( false )
 {
     // sign up for the update traversal so we can prune unused pool objects.
     setNumChildrenRequiringUpdateTraversal(1u);
@@ -86,40 +88,124 @@ GeometryPool::getPooledGeometry(const TileKey&                tileKey,
     GeometryKey geomKey;
     createKeyForTileKey( tileKey, tileSize, mapInfo, geomKey );
 
-    if ( _enabled )
+    bool masking = maskSet && maskSet->hasMasks();
+
+    // Masked geometry is unique to its tile, so there is nothing to share.
+    if ( !_enabled || masking )
     {
-        // Look it up in the pool:
-        Threading::ScopedMutexLock exclusive( _geometryMapMutex );
+        out = createGeometry( tileKey, mapInfo, tileSize, maskSet );
+        return;
+    }
+
+    Threading::Promise<SharedGeometry> promise;
+    Threading::Future<SharedGeometry>  future;
+    bool     building = false;
+    unsigned generation;
 
-        bool masking = maskSet && maskSet->hasMasks();
+    // Look it up in the pool, or in the set of geometries under construction:
+    {
+        Threading::ScopedMutexLock exclusive( _geometryMapMutex );
 
         GeometryMap::iterator i = _geometryMap.find( geomKey );
-        if ( !masking && i != _geometryMap.end() )
+        if ( i != _geometryMap.end() )
         {
             // Found. return it.
             out = i->second.get();
+            return;
+        }
+
+        PendingMap::iterator p = _pendingMap.find( geomKey );
+        if ( p != _pendingMap.end() )
+        {
+            future = p->second.getFuture();
         }
         else
         {
-            // Not found. Create it.
+            _pendingMap[geomKey] = promise;
+            building = true;
+        }
+
+        generation = _generation;
+    }
+
+    if ( !building )
+    {
+        // Another thread is building this one; wait for it.
+        out = future.get();
+        if ( !out.valid() )
+        {
             out = createGeometry( tileKey, mapInfo, tileSize, maskSet );
+        }
+        return;
+    }
+
+    // Not found. Create it without holding the pool lock.
+    out = createGeometry( tileKey, mapInfo, tileSize, maskSet );
+
+    {
+        Threading::ScopedMutexLock exclusive( _geometryMapMutex );
 
-            if (!masking && out.valid())
+        // Don't repopulate the pool if someone cleared it while we were working.
+        if ( generation == _generation )
+        {
+            if ( out.valid() )
             {
                 _geometryMap[ geomKey ] = out.get();
             }
+            _pendingMap.erase( geomKey );
+        }
 
-            if ( _debug )
-            {
-                OE_NOTICE << LC << "Geometry pool size = " << _geometryMap.size() << "\n";
-            }
+        if ( _debug )
+        {
+            OE_NOTICE << LC << "Geometry pool size = " << _geometryMap.size() << "\n";
         }
     }
 
-    else
+    promise.resolve( out.get() );
+}
+
+void
+GeometryPool::precompute(const Profile* profile,
+                         const MapInfo& mapInfo,
+                         unsigned       tileSize,
+                         unsigned       maxLOD)
+{
+    if ( !_enabled || !profile )
+        return;
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    unsigned count = 0u;
+
+    for(unsigned lod = 0; lod <= maxLOD; ++lod)
     {
-        out = createGeometry( tileKey, mapInfo, tileSize, maskSet );
+        // Only the tile row matters in a geocentric map; in a projected map
+        // every tile at a given LOD shares one geometry.
+        unsigned tilesWide, tilesHigh;
+        profile->getNumTiles( lod, tilesWide, tilesHigh );
+        unsigned rows = mapInfo.isGeocentric() ? tilesHigh : 1u;
+
+        for(unsigned row = 0; row < rows; ++row)
+        {
+            TileKey tileKey( lod, 0, row, profile );
+
+            GeometryKey geomKey;
+            createKeyForTileKey( tileKey, tileSize, mapInfo, geomKey );
+
+            osg::ref_ptr<SharedGeometry> geom;
+            getPooledGeometry( tileKey, mapInfo, tileSize, 0L, geom );
+
+            if ( geom.valid() )
+            {
+                Threading::ScopedMutexLock exclusive( _geometryMapMutex );
+                _geometryMap[ geomKey ] = geom.get();
+                _persistentKeys.insert( geomKey );
+                ++count;
+            }
+        }
     }
+
+    OE_INFO << LC << "Precomputed " << count << " geometries through LOD " << maxLOD
+        << " in " << osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()) << " ms" << std::endl;
 }
 
 void
@@ -492,7 +578,7 @@ GeometryPool::traverse(osg::NodeVisitor& nv)
 
             for (GeometryMap::iterator i = _geometryMap.begin(); i != _geometryMap.end(); ++i)
             {
-                if (i->second.get()->referenceCount() == 1)
+                if (i->second.get()->referenceCount() == 1 && _persistentKeys.find(i->first) == _persistentKeys.end())
                 {
                     keys.push_back(i->first);
                     objects.push_back(i->second.get());
@@ -542,6 +628,11 @@ GeometryPool::clear()
         }
 
         _geometryMap.clear();
+        _persistentKeys.clear();
+
+        // builds already underway will not be added to the pool.
+        _pendingMap.clear();
+        ++_generation;
 
         if (!objects.empty())
         {
@@ -22,6 +22,7 @@
 #include <osgEarth/Registry>
 #include <osgEarth/Utils>
 #include <osgEarth/NodeUtils>
+#include <osgEarth/Metrics>
 
 #include <osgDB/FileNameUtils>
 #include <osgDB/FileUtils>
@@ -29,6 +30,8 @@
 #include <osgDB/ReaderWriter>
 
 #include <string>
+#include <limits>
+#include <algorithm>
 
 #define REPORT_ACTIVITY true
 
@@ -42,7 +45,9 @@ Loader::Request::Request()
     _loadCount = 0;
     _priority = 0;
     _lastFrameSubmitted = 0;
+    _lastFrameRequested = 0;
     _lastTick = 0;
+    _mergeTick = 0;
 }
 
 osg::StateSet*
@@ -179,11 +184,70 @@ namespace
 }
 
 
+LoaderHistogram::LoaderHistogram(double firstBound) :
+_firstBound( firstBound )
+{
+    reset();
+}
+
+void
+LoaderHistogram::add(double value)
+{
+    unsigned b = 0;
+    for(double bound = _firstBound; b < NUM_BUCKETS-1 && value >= bound; bound *= 2.0)
+        ++b;
+    _counts[b]++;
+    _total++;
+    _sum += value;
+}
+
+void
+LoaderHistogram::reset()
+{
+    for(unsigned i=0; i<NUM_BUCKETS; ++i)
+        _counts[i] = 0u;
+    _total = 0u;
+    _sum = 0.0;
+}
+
+double
+LoaderHistogram::getUpperBound(unsigned bucket) const
+{
+    if ( bucket >= NUM_BUCKETS-1 )
+        return std::numeric_limits<double>::max();
+    return _firstBound * (double)(1u << bucket);
+}
+
+//...............................................
+
+namespace
+{
+    // snapshot of a request's priority, taken once per frame for sorting.
+    struct MergeEntry
+    {
+        float                         _priority;
+        bool                          _current;
+        osg::ref_ptr<Loader::Request> _request;
+
+        // Requests the culler still wants come first, highest priority first.
+        bool operator < (const MergeEntry& rhs) const
+        {
+            if ( _current != rhs._current ) return _current;
+            return _priority > rhs._priority;
+        }
+    };
+}
+
 PagerLoader::PagerLoader(TerrainEngineNode* engine) :
 _checkpoint    ( (osg::Timer_t)0 ),
 _mergesPerFrame( 0 ),
+_mergeBudget   ( 0.0f ),
+_avgMergeTime  ( 0.0 ),
 _frameNumber   ( 0 ),
-_numLODs       ( 20u )
+_numLODs       ( 20u ),
+_queueDepthHist  ( 1.0 ),
+_mergeTimeHist   ( 0.1 ),
+_mergeLatencyHist( 1.0 )
 {
     _myNodePath.push_back( this );
 
@@ -214,6 +278,43 @@ PagerLoader::setMergesPerFrame(int value)
     
 }
 
+void
+PagerLoader::setMergeBudget(float ms)
+{
+    _mergeBudget = std::max(ms, 0.0f);
+    this->setNumChildrenRequiringUpdateTraversal( 1 );
+}
+
+LoaderHistogram
+PagerLoader::getQueueDepthHistogram() const
+{
+    Threading::ScopedMutexLock lock( _statsMutex );
+    return _queueDepthHist;
+}
+
+LoaderHistogram
+PagerLoader::getMergeTimeHistogram() const
+{
+    Threading::ScopedMutexLock lock( _statsMutex );
+    return _mergeTimeHist;
+}
+
+LoaderHistogram
+PagerLoader::getMergeLatencyHistogram() const
+{
+    Threading::ScopedMutexLock lock( _statsMutex );
+    return _mergeLatencyHist;
+}
+
+void
+PagerLoader::resetStatistics()
+{
+    Threading::ScopedMutexLock lock( _statsMutex );
+    _queueDepthHist.reset();
+    _mergeTimeHist.reset();
+    _mergeLatencyHist.reset();
+}
+
 void
 PagerLoader::setLODPriorityScale(unsigned lod, float priorityScale)
 {
@@ -228,9 +329,29 @@ PagerLoader::setLODPriorityOffset(unsigned lod, float offset)
         _priorityOffsets[lod] = offset;
 }
 
+float
+PagerLoader::getNormalizedPriority(const TileKey& key, float priority) const
+{
+    // scale and bias the priority, and then normalize it to [0..1] range.
+    unsigned lod = std::min(key.getLOD(), 63u);
+    float p = priority * _priorityScales[lod] + _priorityOffsets[lod];
+    return p / (float)(_numLODs+1);
+}
+
 bool
 PagerLoader::load(Loader::Request* request, float priority, osg::NodeVisitor& nv)
 {
+    // A request that is waiting to merge only needs its priority refreshed,
+    // so the merge scheduler sees where the tile stands this frame.
+    if ( request && request->isMerging() && nv.getFrameStamp() )
+    {
+        request->lock();
+        request->_priority = getNormalizedPriority( request->getTileKey(), priority );
+        request->_lastFrameRequested = nv.getFrameStamp()->getFrameNumber();
+        request->unlock();
+        return false;
+    }
+
     // check that the request is not already completed but unmerged:
     //if ( request && !request->isMerging() && nv.getDatabaseRequestHandler() )
     if ( request && !request->isMerging() && !request->isFinished() && nv.getDatabaseRequestHandler() )
@@ -255,12 +376,11 @@ PagerLoader::load(Loader::Request* request, float priority, osg::NodeVisitor& nv
             request->_lastTick = osg::Timer::instance()->tick();
 
             // update the priority, scale and bias it, and then normalize it to [0..1] range.
-            unsigned lod = request->getTileKey().getLOD();
-            float p = priority * _priorityScales[lod] + _priorityOffsets[lod];            
-            request->_priority = p / (float)(_numLODs+1);
+            request->_priority = getNormalizedPriority( request->getTileKey(), priority );
 
             // timestamp it
             request->setFrameNumber( fn );
+            request->_lastFrameRequested = fn;
 
             // incremenet the load count.
             request->_loadCount++;
@@ -301,10 +421,31 @@ PagerLoader::clear()
     _checkpoint = osg::Timer::instance()->tick();
 }
 
+void
+PagerLoader::sortMergeQueue(unsigned frameNumber)
+{
+    std::vector<MergeEntry> entries( _mergeQueue.size() );
+    for(unsigned i=0; i<_mergeQueue.size(); ++i)
+    {
+        Request* req = _mergeQueue[i].get();
+        req->lock();
+        entries[i]._priority = req->_priority;
+        entries[i]._current  = frameNumber - req->_lastFrameRequested <= 1u;
+        req->unlock();
+        entries[i]._request = req;
+    }
+
+    // stable, so equal priorities merge in arrival order.
+    std::stable_sort( entries.begin(), entries.end() );
+
+    for(unsigned i=0; i<entries.size(); ++i)
+        _mergeQueue[i] = entries[i]._request.get();
+}
+
 void
 PagerLoader::traverse(osg::NodeVisitor& nv)
 {
-    // only called when _mergesPerFrame > 0
+    // only called when the merge queue is enabled
     if ( nv.getVisitorType() == nv.UPDATE_VISITOR )
     {
         if ( nv.getFrameStamp() )
@@ -312,20 +453,57 @@ PagerLoader::traverse(osg::NodeVisitor& nv)
             setFrameStamp(nv.getFrameStamp());
         }
 
-        int count;
-        for(count=0; count < _mergesPerFrame && !_mergeQueue.empty(); ++count)
+        // Priorities change as the camera moves, so re-sort every frame.
+        if ( _mergeQueue.size() > 1 )
+        {
+            sortMergeQueue( getFrameStamp() ? getFrameStamp()->getFrameNumber() : 0u );
+        }
+
+        {
+            Threading::ScopedMutexLock lock( _statsMutex );
+            _queueDepthHist.add( (double)_mergeQueue.size() );
+        }
+
+        // Merge until we hit the count limit, or until the next merge (at its
+        // average cost) would overrun the time budget. Always merge at least
+        // one request so the queue keeps moving.
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        int count = 0;
+        unsigned next;
+        for(next = 0; next < _mergeQueue.size(); ++next)
         {
-            Request* req = _mergeQueue.begin()->get();
+            if ( _mergesPerFrame > 0 && count >= _mergesPerFrame )
+                break;
+
+            if ( _mergeBudget > 0.0f && count > 0 &&
+                 osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()) + _avgMergeTime > _mergeBudget )
+                break;
+
+            Request* req = _mergeQueue[next].get();
             if ( req && req->_lastTick >= _checkpoint )
             {
-                OE_START_TIMER(req_apply);
+                osg::Timer_t applyStart = osg::Timer::instance()->tick();
                 req->apply( getFrameStamp() );
-                double s = OE_STOP_TIMER(req_apply);
+                osg::Timer_t applyEnd = osg::Timer::instance()->tick();
 
                 req->setState(Request::FINISHED);
+
+                double ms = osg::Timer::instance()->delta_m(applyStart, applyEnd);
+                _avgMergeTime = _avgMergeTime > 0.0 ? 0.9*_avgMergeTime + 0.1*ms : ms;
+
+                Threading::ScopedMutexLock lock( _statsMutex );
+                _mergeTimeHist.add( ms );
+                _mergeLatencyHist.add( osg::Timer::instance()->delta_m(req->_mergeTick, applyEnd) );
+
+                ++count;
             }
+        }
 
-            _mergeQueue.erase( _mergeQueue.begin() );
+        _mergeQueue.erase( _mergeQueue.begin(), _mergeQueue.begin() + next );
+
+        if ( count > 0 )
+        {
+            Metrics::counter("RexStats", "Merges", count, "Merge queue", _mergeQueue.size());
         }
 
         // cull finished requests.
@@ -397,9 +575,10 @@ PagerLoader::addChild(osg::Node* node)
         {
             if ( req->_lastTick >= _checkpoint )
             {
-                if ( _mergesPerFrame > 0 )
+                if ( isMergeQueueEnabled() )
                 {
-                    _mergeQueue.insert( req );
+                    req->_mergeTick = osg::Timer::instance()->tick();
+                    _mergeQueue.push_back( req );
                     req->setState( Request::MERGING );
                 }
                 else
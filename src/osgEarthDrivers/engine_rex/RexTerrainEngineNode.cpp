@@ -266,6 +266,7 @@ RexTerrainEngineNode::setMap(const Map* map, const TerrainOptions& options)
     PagerLoader* loader = new PagerLoader( this );
     loader->setNumLODs(_terrainOptions.maxLOD().getOrUse(DEFAULT_MAX_LOD));
     loader->setMergesPerFrame( _terrainOptions.mergesPerFrame().get() );
+    loader->setMergeBudget( _terrainOptions.mergeBudget().get() );
     for (std::vector<RexTerrainEngineOptions::LODOptions>::const_iterator i = _terrainOptions.lods().begin(); i != _terrainOptions.lods().end(); ++i) {
         if (i->_lod.isSet()) {
             loader->setLODPriorityScale(i->_lod.get(), i->_priorityScale.getOrUse(1.0f));
@@ -279,6 +280,8 @@ RexTerrainEngineNode::setMap(const Map* map, const TerrainOptions& options)
     // Make a tile unloader
     _unloader = new UnloaderGroup( _liveTiles.get() );
     _unloader->setThreshold( _terrainOptions.expirationThreshold().get() );
+    _unloader->setMaxUnloadsPerFrame( _terrainOptions.unloadsPerFrame().get() );
+    _unloader->setFrameBudget( _terrainOptions.unloadBudget().get() );
     _unloader->setReleaser(_releaser.get());
     this->addChild( _unloader.get() );
 
@@ -331,6 +334,18 @@ RexTerrainEngineNode::setMap(const Map* map, const TerrainOptions& options)
         _mapFrame.getMapInfo().getProfile(),        
         _terrainOptions.minTileRangeFactor().get() );
 
+    // Optional predictive prefetching, using the same LOD ranges:
+    if ( _terrainOptions.prefetchLookAhead().isSet() )
+    {
+        std::vector<double> ranges;
+        for(unsigned lod = 0; lod < _selectionInfo.numLods(); ++lod)
+            ranges.push_back( _selectionInfo.visParameters(lod)._visibilityRange );
+
+        _prefetcher = new TilePrefetcher( map, _terrainOptions );
+        _prefetcher->setLookAhead( _terrainOptions.prefetchLookAhead().get() );
+        _prefetcher->setRanges( ranges );
+    }
+
     // set up the initial graph
     refresh();
 
@@ -450,6 +465,16 @@ RexTerrainEngineNode::dirtyTerrain()
     // scrub the geometry pool:
     _geometryPool->clear();
 
+    // and optionally pre-build the commonly shared geometries:
+    if ( _terrainOptions.precomputeGeometryLOD().isSet() && _geometryPool->isEnabled() )
+    {
+        _geometryPool->precompute(
+            _mapFrame.getProfile(),
+            _mapFrame.getMapInfo(),
+            _terrainOptions.tileSize().get(),
+            _terrainOptions.precomputeGeometryLOD().get() );
+    }
+
     // New terrain
     _terrain = new osg::Group();
     this->addChild( _terrain );
@@ -643,6 +668,11 @@ RexTerrainEngineNode::traverse(osg::NodeVisitor& nv)
 
         this->getEngineContext()->endCull( cv );
 
+        if ( _prefetcher.valid() )
+        {
+            prefetch( cv );
+        }
+
         // If the culler found any orphaned data, we need to update the render model
         // during the next update cycle.
         if (culler._orphanedPassesDetected > 0u)
@@ -668,6 +698,42 @@ RexTerrainEngineNode::traverse(osg::NodeVisitor& nv)
     }
 }
 
+void
+RexTerrainEngineNode::prefetch(osgUtil::CullVisitor* cv)
+{
+    // Follow one camera; samples from several would ruin the velocity estimate.
+    osg::Camera* camera = cv->getCurrentCamera();
+    if ( !_prefetchCamera.valid() )
+        _prefetchCamera = camera;
+
+    if ( camera != _prefetchCamera.get() || !cv->getFrameStamp() )
+        return;
+
+    const osg::Matrixd& modelView = *cv->getModelViewMatrix();
+    osg::Vec3d eye = osg::Vec3d(0,0,0) * osg::Matrixd::inverse(modelView);
+
+    // world-space view frustum, minus the far plane:
+    osg::Polytope frustum;
+    frustum.setToUnitFrustum( true, false );
+    frustum.transformProvidingInverse( modelView * (*cv->getProjectionMatrix()) );
+
+    _prefetcher->update( eye, cv->getFrameStamp()->getReferenceTime(), &frustum );
+
+    // Predicted tiles that already have nodes (their parent subdivided but they
+    // are not visible yet) can load through the regular loader, behind every-
+    // thing that is visible. The loader drops them once we stop asking.
+    std::vector<TileKey> keys;
+    _prefetcher->getPredictedKeys( keys );
+    for(std::vector<TileKey>::const_iterator key = keys.begin(); key != keys.end(); ++key)
+    {
+        osg::ref_ptr<TileNode> tile;
+        if ( _liveTiles->get(*key, tile) && tile->isDirty() )
+        {
+            tile->prefetch( *cv, -1.0f );
+        }
+    }
+}
+
 unsigned int
 RexTerrainEngineNode::computeSampleSize(unsigned int levelOfDetail)
 {    
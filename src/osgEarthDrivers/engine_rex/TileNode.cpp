@@ -893,6 +893,25 @@ TileNode::load(TerrainCuller* culler)
     _context->getLoader()->load( _loadRequest.get(), priority, *culler );
 }
 
+void
+TileNode::prefetch(osg::NodeVisitor& nv, float priority)
+{
+    // A tile the culler already asked for this frame is visible; loading it
+    // again here would replace its real priority with the prefetch one.
+    if ( nv.getFrameStamp() )
+    {
+        unsigned fn = nv.getFrameStamp()->getFrameNumber();
+        Loader::Request* request = _loadRequest.get();
+        request->lock();
+        bool current = request->getLastFrameSubmitted() == fn || request->_lastFrameRequested == fn;
+        request->unlock();
+        if ( current )
+            return;
+    }
+
+    _context->getLoader()->load( _loadRequest.get(), priority, nv );
+}
+
 void
 TileNode::loadSync()
 {
@@ -21,6 +21,7 @@
 #include "TileNodeRegistry"
 
 #include <osgEarth/Metrics>
+#include <osg/Timer>
 
 using namespace osgEarth::Drivers::RexTerrainEngine;
 
@@ -69,7 +70,11 @@ namespace
 
 UnloaderGroup::UnloaderGroup(TileNodeRegistry* tiles) :
 _tiles(tiles),
-_threshold( INT_MAX )
+_threshold( INT_MAX ),
+_maxUnloadsPerFrame( 0u ),
+_frameBudget( 0.0 ),
+_draining( false ),
+_totalUnloaded( 0u )
 {
     this->setNumChildrenRequiringUpdateTraversal( 1u );
 }
@@ -77,27 +82,63 @@ _threshold( INT_MAX )
 void
 UnloaderGroup::unloadChildren(const std::vector<TileKey>& keys)
 {
+    // The scanner reports the same dormant tiles every frame, so only queue
+    // new ones; queue order is then the order in which tiles went dormant.
     _mutex.lock();
     for(std::vector<TileKey>::const_iterator i = keys.begin(); i != keys.end(); ++i)
-        _parentKeys.insert(*i);
+    {
+        if ( _parentKeys.insert(*i).second )
+            _queue.push_back(*i);
+    }
     _mutex.unlock();
 }
 
+unsigned
+UnloaderGroup::getNumPending() const
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    return _queue.size();
+}
+
 void
 UnloaderGroup::traverse(osg::NodeVisitor& nv)
 {
     if ( nv.getVisitorType() == nv.UPDATE_VISITOR )
-    {        
-        if ( _parentKeys.size() > _threshold )
+    {
+        _mutex.lock();
+        if ( !_draining && _queue.size() > _threshold )
+            _draining = true;
+        bool draining = _draining;
+        _mutex.unlock();
+
+        if ( draining )
         {
             ScopedMetric m("Unloader expire");
 
-            unsigned unloaded=0, notFound=0, notDormant=0;
-            Threading::ScopedMutexLock lock( _mutex );
-            for(std::set<TileKey>::const_iterator parentKey = _parentKeys.begin(); parentKey != _parentKeys.end(); ++parentKey)
+            osg::Timer_t start = osg::Timer::instance()->tick();
+            unsigned processed=0, unloaded=0, notFound=0, notDormant=0, pending=0;
+
+            while( true )
             {
+                // Take the oldest key; the lock is not held while unloading.
+                TileKey parentKey;
+                {
+                    Threading::ScopedMutexLock lock( _mutex );
+                    if ( _queue.empty() )
+                    {
+                        _draining = false;
+                        break;
+                    }
+                    parentKey = _queue.front();
+                    _queue.pop_front();
+                    _parentKeys.erase( parentKey );
+                    pending = _queue.size();
+                }
+
+                ++processed;
+
                 osg::ref_ptr<TileNode> parentNode;
-                if ( _tiles->get(*parentKey, parentNode) )
+                if ( _tiles->get(parentKey, parentNode) )
                 {
                     // re-check for dormancy in case something has changed
                     if ( parentNode->areSubTilesDormant(nv.getFrameStamp()) )
@@ -117,10 +158,18 @@ UnloaderGroup::traverse(osg::NodeVisitor& nv)
                     else notDormant++;
                 }
                 else notFound++;
+
+                if ( _maxUnloadsPerFrame > 0u && processed >= _maxUnloadsPerFrame )
+                    break;
+
+                if ( _frameBudget > 0.0 && osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()) >= _frameBudget )
+                    break;
             }
 
-            OE_DEBUG << LC << "Total=" << _parentKeys.size() << "; threshold=" << _threshold << "; unloaded=" << unloaded << "; notDormant=" << notDormant << "; notFound=" << notFound << "\n";
-            _parentKeys.clear();
+            _totalUnloaded += unloaded;
+
+            OE_DEBUG << LC << "Processed=" << processed << "; pending=" << pending << "; threshold=" << _threshold << "; unloaded=" << unloaded << "; notDormant=" << notDormant << "; notFound=" << notFound << "\n";
+            Metrics::counter("RexStats", "Unloaded", unloaded, "Unload pending", pending);
         }
     }
     osg::Group::traverse( nv );
@@ -176,6 +176,15 @@ _filters          ( filters )
         if ( _resultSetHandle )
         {
             OGR_L_ResetReading( _resultSetHandle );
+
+            // Share the source's attribute schema if the result set has the same
+            // fields (it may not, with a custom SELECT); otherwise make one.
+            osg::ref_ptr<AttributeSchema> schema = OgrUtils::createAttributeSchema( OGR_L_GetLayerDefn(_resultSetHandle) );
+            const AttributeSchema* shared = source ? source->getAttributeSchema() : 0L;
+            if ( schema.valid() && shared && schema->isEquivalentTo(*shared) )
+                _attributeSchema = shared;
+            else
+                _attributeSchema = schema.get();
         }
     }
 
@@ -241,7 +250,7 @@ FeatureCursorOGR::readChunk()
             OGRFeatureH handle = OGR_L_GetNextFeature( _resultSetHandle );
             if ( handle )
             {
-                osg::ref_ptr<Feature> feature = OgrUtils::createFeature( handle, _profile.get() );
+                osg::ref_ptr<Feature> feature = OgrUtils::createFeature( handle, _profile.get(), _attributeSchema.get() );
 
                 if (feature.valid() &&
                     !_source->isBlacklisted( feature->getFID() ) &&
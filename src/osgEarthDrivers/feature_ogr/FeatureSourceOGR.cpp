@@ -401,7 +401,7 @@ public:
             OGRFeatureH handle = OGR_L_GetFeature( _layerHandle, fid);
             if (handle)
             {
-                result = OgrUtils::createFeature( handle, getFeatureProfile() );
+                result = OgrUtils::createFeature( handle, getFeatureProfile(), getAttributeSchema() );
                 OGR_F_Destroy( handle );
             }
         }
@@ -523,6 +523,9 @@ protected:
             OGRFieldType ogrType = OGR_Fld_GetType( fieldDef );
             _schema[ name ] = OgrUtils::getAttributeType( ogrType );
         }
+
+        // features from this layer share one schema and store attributes by ordinal:
+        setAttributeSchema( OgrUtils::createAttributeSchema(layerDef) );
     }
 
 
@@ -1553,6 +1553,15 @@ public:
             }
             else
             {
+                // Read each band's covering block once, if possible:
+                RasterWindow wRed, wGreen, wBlue, wAlpha;
+                bool windowed =
+                    _options.windowedReads() == true &&
+                    readWindow(bandRed,   xmin, ymin, xmax, ymax, wRed) &&
+                    readWindow(bandGreen, xmin, ymin, xmax, ymax, wGreen) &&
+                    readWindow(bandBlue,  xmin, ymin, xmax, ymax, wBlue) &&
+                    (bandAlpha == NULL || readWindow(bandAlpha, xmin, ymin, xmax, ymax, wAlpha));
+
                 //Sample each point exactly
                 for (unsigned int c = 0; c < (unsigned int)tileSize; ++c)
                 {
@@ -1560,13 +1569,26 @@ public:
                     for (unsigned int r = 0; r < (unsigned int)tileSize; ++r)
                     {
                         double geoY = ymin + (dy * (double)r);
-                        *(image->data(c,r) + 0) = (unsigned char)getInterpolatedValue(bandRed,  geoX,geoY,false);
-                        *(image->data(c,r) + 1) = (unsigned char)getInterpolatedValue(bandGreen,geoX,geoY,false);
-                        *(image->data(c,r) + 2) = (unsigned char)getInterpolatedValue(bandBlue, geoX,geoY,false);
-                        if (bandAlpha != NULL)
-                            *(image->data(c,r) + 3) = (unsigned char)getInterpolatedValue(bandAlpha,geoX, geoY, false);
+                        if (windowed)
+                        {
+                            *(image->data(c,r) + 0) = (unsigned char)getInterpolatedValue(wRed,  geoX,geoY,false);
+                            *(image->data(c,r) + 1) = (unsigned char)getInterpolatedValue(wGreen,geoX,geoY,false);
+                            *(image->data(c,r) + 2) = (unsigned char)getInterpolatedValue(wBlue, geoX,geoY,false);
+                            if (bandAlpha != NULL)
+                                *(image->data(c,r) + 3) = (unsigned char)getInterpolatedValue(wAlpha,geoX, geoY, false);
+                            else
+                                *(image->data(c,r) + 3) = 255;
+                        }
                         else
-                            *(image->data(c,r) + 3) = 255;
+                        {
+                            *(image->data(c,r) + 0) = (unsigned char)getInterpolatedValue(bandRed,  geoX,geoY,false);
+                            *(image->data(c,r) + 1) = (unsigned char)getInterpolatedValue(bandGreen,geoX,geoY,false);
+                            *(image->data(c,r) + 2) = (unsigned char)getInterpolatedValue(bandBlue, geoX,geoY,false);
+                            if (bandAlpha != NULL)
+                                *(image->data(c,r) + 3) = (unsigned char)getInterpolatedValue(bandAlpha,geoX, geoY, false);
+                            else
+                                *(image->data(c,r) + 3) = 255;
+                        }
                     }
                 }
             }
@@ -1719,6 +1741,13 @@ public:
                 }
                 else
                 {
+                    // Read each band's covering block once, if possible:
+                    RasterWindow wGray, wAlpha;
+                    bool windowed =
+                        _options.windowedReads() == true &&
+                        readWindow(bandGray, xmin, ymin, xmax, ymax, wGray) &&
+                        (bandAlpha == NULL || readWindow(bandAlpha, xmin, ymin, xmax, ymax, wAlpha));
+
                     for (int r = 0; r < tileSize; ++r)
                     {
                         double geoY   = ymin + (dy * (double)r);
@@ -1726,13 +1755,17 @@ public:
                         for (int c = 0; c < tileSize; ++c)
                         {
                             double geoX = xmin + (dx * (double)c);
-                            float  color = getInterpolatedValue(bandGray,geoX,geoY,false);
+                            float  color = windowed ?
+                                getInterpolatedValue(wGray,geoX,geoY,false) :
+                                getInterpolatedValue(bandGray,geoX,geoY,false);
 
                             *(image->data(c,r) + 0) = (unsigned char)color;
                             *(image->data(c,r) + 1) = (unsigned char)color;
                             *(image->data(c,r) + 2) = (unsigned char)color;
                             if (bandAlpha != NULL)
-                                *(image->data(c,r) + 3) = (unsigned char)getInterpolatedValue(bandAlpha,geoX,geoY,false);
+                                *(image->data(c,r) + 3) = (unsigned char)(windowed ?
+                                    getInterpolatedValue(wAlpha,geoX,geoY,false) :
+                                    getInterpolatedValue(bandAlpha,geoX,geoY,false));
                             else
                                 *(image->data(c,r) + 3) = 255;
                         }
@@ -1833,6 +1866,17 @@ public:
     }
 
     bool isValidValue_noLock(float v, GDALRasterBand* band)
+    {
+        return isValidValue( v, getBandNoDataValue(band) );
+    }
+
+    bool isValidValue(float v, GDALRasterBand* band)
+    {
+        GDAL_SCOPED_LOCK;
+        return isValidValue_noLock( v, band );
+    }
+
+    float getBandNoDataValue(GDALRasterBand* band)
     {
         float bandNoData = -32767.0f;
         int success;
@@ -1841,7 +1885,11 @@ public:
         {
             bandNoData = value;
         }
+        return bandNoData;
+    }
 
+    bool isValidValue(float v, float bandNoData)
+    {
         //Check to see if the value is equal to the bands specified no data
         if (bandNoData == v) return false;
         //Check to see if the value is equal to the user specified nodata value
@@ -1854,14 +1902,112 @@ public:
         return true;
     }
 
-    bool isValidValue(float v, GDALRasterBand* band)
+    /**
+     * Block of one raster band, read with a single RasterIO call, that
+     * getInterpolatedValue can sample without going back to GDAL.
+     */
+    struct RasterWindow
     {
-        GDAL_SCOPED_LOCK;
-        return isValidValue_noLock( v, band );
-    }
+        RasterWindow() : _col0(0), _row0(0), _cols(0), _rows(0), _bandNoData(-32767.0f) { }
+        int _col0, _row0, _cols, _rows;
+        std::vector<float> _data;
+        float _bandNoData;
+    };
+
+    // Reads samples directly from a GDAL band, one pixel per call.
+    struct BandReader
+    {
+        BandReader(GDALTileSource* source, GDALRasterBand* band) : _source(source), _band(band) { }
+
+        float operator()(int col, int row) const
+        {
+            float value = 0.0f;
+            _band->RasterIO(GF_Read, col, row, 1, 1, &value, 1, 1, GDT_Float32, 0, 0);
+            return value;
+        }
+
+        bool isValid(float v) const { return _source->isValidValue(v, _band); }
 
+        GDALTileSource* _source;
+        GDALRasterBand* _band;
+    };
+
+    // Reads samples from a RasterWindow in memory.
+    struct WindowReader
+    {
+        WindowReader(GDALTileSource* source, const RasterWindow& window) : _source(source), _window(window) { }
+
+        float operator()(int col, int row) const
+        {
+            return _window._data[(row - _window._row0) * _window._cols + (col - _window._col0)];
+        }
+
+        bool isValid(float v) const { return _source->isValidValue(v, _window._bandNoData); }
+
+        GDALTileSource*     _source;
+        const RasterWindow& _window;
+    };
+
+    /**
+     * Reads the block of "band" that covers the given extent, plus a
+     * one-pixel margin for interpolation, into "window". Call with the GDAL
+     * lock held. Returns false (and reads nothing) if the read fails or the
+     * block would be much larger than the tile, in which case the caller
+     * should fall back on per-sample reads.
+     */
+    bool readWindow(GDALRasterBand* band, double xmin, double ymin, double xmax, double ymax, RasterWindow& window)
+    {
+        double c[4], r[4];
+        geoToPixel( xmin, ymin, c[0], r[0] );
+        geoToPixel( xmax, ymin, c[1], r[1] );
+        geoToPixel( xmin, ymax, c[2], r[2] );
+        geoToPixel( xmax, ymax, c[3], r[3] );
+
+        double cmin = osg::minimum(osg::minimum(c[0], c[1]), osg::minimum(c[2], c[3]));
+        double cmax = osg::maximum(osg::maximum(c[0], c[1]), osg::maximum(c[2], c[3]));
+        double rmin = osg::minimum(osg::minimum(r[0], r[1]), osg::minimum(r[2], r[3]));
+        double rmax = osg::maximum(osg::maximum(r[0], r[1]), osg::maximum(r[2], r[3]));
+
+        int sizeX = _warpedDS->GetRasterXSize();
+        int sizeY = _warpedDS->GetRasterYSize();
+
+        int colMin = osg::clampBetween((int)floor(cmin) - 1, 0, sizeX - 1);
+        int colMax = osg::clampBetween((int)ceil(cmax) + 1, 0, sizeX - 1);
+        int rowMin = osg::clampBetween((int)floor(rmin) - 1, 0, sizeY - 1);
+        int rowMax = osg::clampBetween((int)ceil(rmax) + 1, 0, sizeY - 1);
+
+        int cols = colMax - colMin + 1;
+        int rows = rowMax - rowMin + 1;
+
+        // Low LODs over a high resolution source would read far more than
+        // they sample; per-sample reads are cheaper there.
+        int tileSize = getPixelsPerTile();
+        if ( (double)cols * (double)rows > 16.0 * (double)tileSize * (double)tileSize )
+            return false;
+
+        window._col0 = colMin;
+        window._row0 = rowMin;
+        window._cols = cols;
+        window._rows = rows;
+        window._data.resize( cols * rows );
+        window._bandNoData = getBandNoDataValue( band );
+
+        CPLErr err = band->RasterIO(GF_Read, colMin, rowMin, cols, rows, &window._data[0], cols, rows, GDT_Float32, 0, 0);
+        return err == CE_None;
+    }
 
     float getInterpolatedValue(GDALRasterBand *band, double x, double y, bool applyOffset=true)
+    {
+        return getInterpolatedValue( BandReader(this, band), x, y, applyOffset );
+    }
+
+    float getInterpolatedValue(const RasterWindow& window, double x, double y, bool applyOffset=true)
+    {
+        return getInterpolatedValue( WindowReader(this, window), x, y, applyOffset );
+    }
+
+    template<typename READER>
+    float getInterpolatedValue(const READER& read, double x, double y, bool applyOffset)
     {
         double r, c;
         geoToPixel( x, y, c, r );
@@ -1903,8 +2049,8 @@ public:
 
         if ( _options.interpolation() == INTERP_NEAREST )
         {
-            band->RasterIO(GF_Read, (int)osg::round(c), (int)osg::round(r), 1, 1, &result, 1, 1, GDT_Float32, 0, 0);
-            if (!isValidValue( result, band))
+            result = read((int)osg::round(c), (int)osg::round(r));
+            if (!read.isValid(result))
             {
                 return NO_DATA_VALUE;
             }
@@ -1919,20 +2065,12 @@ public:
             if (rowMin > rowMax) rowMin = rowMax;
             if (colMin > colMax) colMin = colMax;
 
-            float urHeight, llHeight, ulHeight, lrHeight;
+            float llHeight = read(colMin, rowMin);
+            float ulHeight = read(colMin, rowMax);
+            float lrHeight = read(colMax, rowMin);
+            float urHeight = read(colMax, rowMax);
 
-            band->RasterIO(GF_Read, colMin, rowMin, 1, 1, &llHeight, 1, 1, GDT_Float32, 0, 0);
-            band->RasterIO(GF_Read, colMin, rowMax, 1, 1, &ulHeight, 1, 1, GDT_Float32, 0, 0);
-            band->RasterIO(GF_Read, colMax, rowMin, 1, 1, &lrHeight, 1, 1, GDT_Float32, 0, 0);
-            band->RasterIO(GF_Read, colMax, rowMax, 1, 1, &urHeight, 1, 1, GDT_Float32, 0, 0);
-
-            /*
-            if (!isValidValue(urHeight, band)) urHeight = 0.0f;
-            if (!isValidValue(llHeight, band)) llHeight = 0.0f;
-            if (!isValidValue(ulHeight, band)) ulHeight = 0.0f;
-            if (!isValidValue(lrHeight, band)) lrHeight = 0.0f;
-            */
-            if ((!isValidValue(urHeight, band)) || (!isValidValue(llHeight, band)) ||(!isValidValue(ulHeight, band)) || (!isValidValue(lrHeight, band)))
+            if ((!read.isValid(urHeight)) || (!read.isValid(llHeight)) ||(!read.isValid(ulHeight)) || (!read.isValid(lrHeight)))
             {
                 return NO_DATA_VALUE;
             }
@@ -1954,29 +2092,23 @@ public:
                 //Check for exact value
                 if ((colMax == colMin) && (rowMax == rowMin))
                 {
-                    //OE_NOTICE << "Exact value" << std::endl;
                     result = llHeight;
                 }
                 else if (colMax == colMin)
                 {
-                    //OE_NOTICE << "Vertically" << std::endl;
                     //Linear interpolate vertically
                     result = ((float)rowMax - r) * llHeight + (r - (float)rowMin) * ulHeight;
                 }
                 else if (rowMax == rowMin)
                 {
-                    //OE_NOTICE << "Horizontally" << std::endl;
                     //Linear interpolate horizontally
                     result = ((float)colMax - c) * llHeight + (c - (float)colMin) * lrHeight;
                 }
                 else
                 {
-                    //OE_NOTICE << "Bilinear" << std::endl;
                     //Bilinear interpolate
                     float r1 = ((float)colMax - c) * llHeight + (c - (float)colMin) * lrHeight;
                     float r2 = ((float)colMax - c) * ulHeight + (c - (float)colMin) * urHeight;
-
-                    //OE_INFO << "r1, r2 = " << r1 << " , " << r2 << std::endl;
                     result = ((float)rowMax - r) * r1 + (r - (float)rowMin) * r2;
                 }
             }
@@ -1996,8 +2128,6 @@ public:
             return NULL;
         }
 
-        GDAL_SCOPED_LOCK;
-
         int tileSize = getPixelsPerTile();
 
         //Allocate the heightfield
@@ -2015,11 +2145,24 @@ public:
             if (band == NULL)
             {
                 // Just get first band
+                GDAL_SCOPED_LOCK;
                 band = _warpedDS->GetRasterBand(1);
             }
 
+            // When interpolating, read the whole covering block at once and
+            // sample it in memory, outside the GDAL lock.
+            RasterWindow window;
+            bool windowed = false;
+            if (_options.interpolation() != INTERP_NEAREST && _options.windowedReads() == true)
+            {
+                GDAL_SCOPED_LOCK;
+                windowed = readWindow(band, xmin, ymin, xmax, ymax, window);
+            }
+
             if (_options.interpolation() == INTERP_NEAREST)
             {
+                GDAL_SCOPED_LOCK;
+
                 double colMin, colMax;
                 double rowMin, rowMax;
                 geoToPixel( xmin, ymin, colMin, rowMax );
@@ -2060,8 +2203,25 @@ public:
                     }
                 }
             }
+            else if (windowed)
+            {
+                double dx = (xmax - xmin) / (tileSize-1);
+                double dy = (ymax - ymin) / (tileSize-1);
+                for (int r = 0; r < tileSize; ++r)
+                {
+                    double geoY = ymin + (dy * (double)r);
+                    for (int c = 0; c < tileSize; ++c)
+                    {
+                        double geoX = xmin + (dx * (double)c);
+                        float h = getInterpolatedValue(window, geoX, geoY);
+                        hf->setHeight(c, r, h);
+                    }
+                }
+            }
             else
             {
+                GDAL_SCOPED_LOCK;
+
                 double dx = (xmax - xmin) / (tileSize-1);
                 double dy = (ymax - ymin) / (tileSize-1);
                 for (int r = 0; r < tileSize; ++r)
@@ -25,6 +25,8 @@
 #include <osgEarth/Registry>
 #include <osgEarth/ImageUtils>
 #include <osgDB/FileUtils>
+#include <osg/Timer>
+#include <osg/Math>
 
 #include <sstream>
 #include <iomanip>
@@ -63,11 +65,76 @@ _options  ( options ),
 _database ( NULL ),
 _minLevel ( 0 ),
 _maxLevel ( 20 ),
-_forceRGB ( false )
+_forceRGB ( false ),
+_selectTile( 0L ),
+_insertTile( 0L ),
+_walMode  ( false ),
+_inTransaction( false ),
+_uncommittedWrites( 0u ),
+_failedWrites( 0u ),
+_transactionStart( 0 ),
+_commitTimer( 0L ),
+_commitTimerDone( false ),
+_numReadConnections( 0u ),
+_maxReadConnections( 0u )
 {
     //nop
 }
 
+MBTilesTileSource::~MBTilesTileSource()
+{
+    if ( _commitTimer )
+    {
+        {
+            Threading::ScopedMutexLock exclusiveLock(_mutex);
+            _commitTimerDone = true;
+            _commitTimerCond.signal();
+        }
+        _commitTimer->join();
+        delete _commitTimer;
+        _commitTimer = 0L;
+    }
+
+    {
+        Threading::ScopedMutexLock exclusiveLock(_mutex);
+
+        commitWrites();
+
+        if ( _failedWrites > 0u )
+        {
+            OE_WARN << LC << _failedWrites << " tile(s) were lost to failed commits in \"" << _fullFilename << "\"" << std::endl;
+        }
+
+        if ( _selectTile )
+            sqlite3_finalize( _selectTile );
+        if ( _insertTile )
+            sqlite3_finalize( _insertTile );
+
+        if ( _database )
+        {
+            // fold the log back into the main file so the output is self-contained.
+            if ( _walMode )
+            {
+                sqlite3_exec( _database, "PRAGMA wal_checkpoint(TRUNCATE)", 0L, 0L, 0L );
+                sqlite3_exec( _database, "PRAGMA journal_mode=DELETE", 0L, 0L, 0L );
+            }
+            sqlite3_close( _database );
+            _database = 0L;
+        }
+    }
+
+    // all reads have completed by the time the source is destroyed.
+    Threading::ScopedMutexLock lock(_readPoolMutex);
+    for(std::vector<ReadConnection*>::iterator i = _idleReadConnections.begin(); i != _idleReadConnections.end(); ++i)
+    {
+        if ( (*i)->_selectTile )
+            sqlite3_finalize( (*i)->_selectTile );
+        sqlite3_close( (*i)->_database );
+        delete *i;
+    }
+    _idleReadConnections.clear();
+}
+
 Status
 MBTilesTileSource::initialize(const osgDB::Options* dbOptions)
 {
@@ -85,6 +152,8 @@ MBTilesTileSource::initialize(const osgDB::Options* dbOptions)
 
     bool isNewDatabase = readWrite && !osgDB::fileExists(fullFilename);
 
+    _fullFilename = fullFilename;
+
     if ( isNewDatabase )
     {
         // For a NEW database, the profile MUST be set prior to initialization.
@@ -120,6 +189,30 @@ MBTilesTileSource::initialize(const osgDB::Options* dbOptions)
             << "Database \"" << fullFilename << "\": " << sqlite3_errmsg(_database) );
     }
 
+    if ( readWrite )
+    {
+        // Write-ahead logging lets writes proceed without blocking readers
+        // and makes each commit much cheaper.
+        if ( _options.walMode() == true )
+        {
+            char* errorMsg = 0L;
+            if ( SQLITE_OK == sqlite3_exec(_database, "PRAGMA journal_mode=WAL; PRAGMA synchronous=NORMAL", 0L, 0L, &errorMsg) )
+            {
+                _walMode = true;
+            }
+            else
+            {
+                OE_WARN << LC << "Failed to enable WAL mode: " << (errorMsg ? errorMsg : "") << std::endl;
+                sqlite3_free( errorMsg );
+            }
+        }
+    }
+    else
+    {
+        // Tile reads go through a pool of connections so they can run in parallel.
+        _maxReadConnections = _options.readConnections().get();
+    }
+
     // New database setup:
     if ( isNewDatabase )
     {
@@ -303,94 +396,204 @@ MBTilesTileSource::getCachePolicyHint(const Profile* targetProfile) const
 }
 
 
-osg::Image*
-MBTilesTileSource::createImage(const TileKey&    key,
-                               ProgressCallback* progress)
+MBTilesTileSource::ReadConnection*
+MBTilesTileSource::acquireReadConnection()
 {
-    Threading::ScopedMutexLock exclusiveLock(_mutex);
+    Threading::ScopedMutexLock lock(_readPoolMutex);
 
-    int z = key.getLevelOfDetail();
-    int x = key.getTileX();
-    int y = key.getTileY();
+    while ( _idleReadConnections.empty() && _numReadConnections >= _maxReadConnections )
+        _readPoolCond.wait( &_readPoolMutex );
 
-    if (z < (int)_minLevel)
+    if ( !_idleReadConnections.empty() )
     {
-        return _emptyImage.get();
+        ReadConnection* conn = _idleReadConnections.back();
+        _idleReadConnections.pop_back();
+        return conn;
     }
 
-    if (z > (int)_maxLevel)
+    // open a new connection, counting it before we release the lock.
+    ++_numReadConnections;
+
+    sqlite3* database = 0L;
+    int rc = sqlite3_open_v2( _fullFilename.c_str(), &database, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, 0L );
+    if ( rc != SQLITE_OK )
     {
-        //If we're at the max level, just return NULL
-        return NULL;
+        OE_WARN << LC << "Failed to open read connection to \"" << _fullFilename << "\": " << sqlite3_errmsg(database) << std::endl;
+        sqlite3_close( database );
+        --_numReadConnections;
+        _readPoolCond.signal();
+        return 0L;
     }
 
-    unsigned int numRows, numCols;
-    key.getProfile()->getNumTiles(key.getLevelOfDetail(), numCols, numRows);
-    y  = numRows - y - 1;
+    ReadConnection* conn = new ReadConnection();
+    conn->_database   = database;
+    conn->_selectTile = 0L;
+    return conn;
+}
 
-    //Get the image
-    sqlite3_stmt* select = NULL;
-    std::string query = "SELECT tile_data from tiles where zoom_level = ? AND tile_column = ? AND tile_row = ?";
-    int rc = sqlite3_prepare_v2( _database, query.c_str(), -1, &select, 0L );
-    if ( rc != SQLITE_OK )
+void
+MBTilesTileSource::releaseReadConnection(ReadConnection* conn)
+{
+    Threading::ScopedMutexLock lock(_readPoolMutex);
+    _idleReadConnections.push_back( conn );
+    _readPoolCond.signal();
+}
+
+bool
+MBTilesTileSource::readTileData(sqlite3* database, sqlite3_stmt*& select, int z, int x, int y, std::string& output)
+{
+    if ( select == 0L )
     {
-        OE_WARN << LC << "Failed to prepare SQL: " << query << "; " << sqlite3_errmsg(_database) << std::endl;
-        return NULL;
+        std::string query = "SELECT tile_data from tiles where zoom_level = ? AND tile_column = ? AND tile_row = ?";
+        int rc = sqlite3_prepare_v2( database, query.c_str(), -1, &select, 0L );
+        if ( rc != SQLITE_OK )
+        {
+            OE_WARN << LC << "Failed to prepare SQL: " << query << "; " << sqlite3_errmsg(database) << std::endl;
+            select = 0L;
+            return false;
+        }
     }
 
-    bool valid = true;
-
     sqlite3_bind_int( select, 1, z );
     sqlite3_bind_int( select, 2, x );
     sqlite3_bind_int( select, 3, y );
 
-    osg::Image* result = NULL;
-    rc = sqlite3_step( select );
+    bool found = false;
+    int rc = sqlite3_step( select );
     if ( rc == SQLITE_ROW)
     {
         // the pointer returned from _blob gets freed internally by sqlite, supposedly
         const char* data = (const char*)sqlite3_column_blob( select, 0 );
         int dataLen = sqlite3_column_bytes( select, 0 );
+        output.assign( data, dataLen );
+        found = true;
+    }
+    else
+    {
+        OE_DEBUG << LC << "SQL QUERY failed for tile " << z << "/" << x << "/" << y << std::endl;
+    }
 
-        std::string dataBuffer( data, dataLen );
+    // ready the cached statement for its next use.
+    sqlite3_reset( select );
+    sqlite3_clear_bindings( select );
+    return found;
+}
 
-        // decompress if necessary:
-        if ( _compressor.valid() )
-        {
-            std::istringstream inputStream(dataBuffer);
-            std::string value;
-            if ( !_compressor->decompress(inputStream, value) )
-            {
-                OE_WARN << LC << "Decompression failed" << std::endl;
-                valid = false;
-            }
-            else
-            {
-                dataBuffer = value;
-            }
-        }
+bool
+MBTilesTileSource::readTile(const TileKey& key, std::string& output)
+{
+    int z = key.getLevelOfDetail();
+    int x = key.getTileX();
+    int y = key.getTileY();
+
+    if (z < (int)_minLevel || z > (int)_maxLevel)
+    {
+        return false;
+    }
+
+    unsigned int numRows, numCols;
+    key.getProfile()->getNumTiles(key.getLevelOfDetail(), numCols, numRows);
+    y  = numRows - y - 1;
 
-        // decode the raw image data:
-        if ( valid )
+    bool valid;
+
+    if ( _maxReadConnections > 0u )
+    {
+        ReadConnection* conn = acquireReadConnection();
+        if ( !conn )
+            return false;
+
+        valid = readTileData( conn->_database, conn->_selectTile, z, x, y, output );
+        releaseReadConnection( conn );
+    }
+    else
+    {
+        // writable source: read through the writer so we see uncommitted tiles.
+        Threading::ScopedMutexLock exclusiveLock(_mutex);
+        valid = readTileData( _database, _selectTile, z, x, y, output );
+    }
+
+    if ( !valid )
+        return false;
+
+    // decompress if necessary:
+    if ( _compressor.valid() )
+    {
+        std::istringstream inputStream(output);
+        std::string value;
+        if ( !_compressor->decompress(inputStream, value) )
         {
-            std::istringstream inputStream(dataBuffer);
-            osgDB::ReaderWriter::ReadResult rr = _rw->readImage( inputStream, _dbOptions.get() );
-            if (rr.validImage())
-            {
-                result = rr.takeImage();
-            }
+            OE_WARN << LC << "Decompression failed" << std::endl;
+            return false;
         }
+        output.swap( value );
     }
-    else
+
+    return true;
+}
+
+osg::Image*
+MBTilesTileSource::createImage(const TileKey&    key,
+                               ProgressCallback* progress)
+{
+    if (key.getLevelOfDetail() < _minLevel)
     {
-        OE_DEBUG << LC << "SQL QUERY failed for " << query << ": " << std::endl;
-        valid = false;
+        return _emptyImage.get();
+    }
+
+    std::string dataBuffer;
+    if ( !readTile(key, dataBuffer) )
+        return NULL;
+
+    // decode the raw image data:
+    osg::Image* result = NULL;
+    std::istringstream inputStream(dataBuffer);
+    osgDB::ReaderWriter::ReadResult rr = _rw->readImage( inputStream, _dbOptions.get() );
+    if (rr.validImage())
+    {
+        result = rr.takeImage();
     }
 
-    sqlite3_finalize( select );
     return result;
 }
 
+bool
+MBTilesTileSource::supportsEncodedImages() const
+{
+    return true;
+}
+
+EncodedImage*
+MBTilesTileSource::createEncodedImage(const TileKey&    key,
+                                      ProgressCallback* progress)
+{
+    std::string dataBuffer;
+    if ( !readTile(key, dataBuffer) || dataBuffer.empty() )
+        return NULL;
+
+    std::string mimeType = EncodedImage::detectMimeType( dataBuffer );
+    if ( mimeType.empty() )
+        mimeType = _tileFormat.find('/') != std::string::npos ? _tileFormat :
+                   Registry::instance()->getMimeTypeForExtension( _tileFormat );
+
+    return new EncodedImage( dataBuffer, mimeType );
+}
+
+bool
+MBTilesTileSource::storeEncodedImage(const TileKey&      key,
+                                     const EncodedImage* image,
+                                     ProgressCallback*   progress)
+{
+    if ( (getMode() & MODE_WRITE) == 0 || !image || !image->valid() )
+        return false;
+
+    // only an image in the database's own format can be stored as is.
+    if ( !image->isFormat(_tileFormat) )
+        return false;
+
+    return storeTile( key, image->getData() );
+}
+
 bool
 MBTilesTileSource::storeImage(const TileKey&    key,
                               osg::Image*       image,
@@ -399,8 +602,6 @@ MBTilesTileSource::storeImage(const TileKey&    key,
     if ( (getMode() & MODE_WRITE) == 0 )
         return false;
 
-    Threading::ScopedMutexLock exclusiveLock(_mutex);
-
     // encode the data stream:
     std::stringstream buf;
     osgDB::ReaderWriter::WriteResult wr;
@@ -420,7 +621,13 @@ MBTilesTileSource::storeImage(const TileKey&    key,
         return false;
     }
 
-    std::string value = buf.str();
+    return storeTile( key, buf.str() );
+}
+
+bool
+MBTilesTileSource::storeTile(const TileKey& key, const std::string& data)
+{
+    std::string value = data;
 
     // compress if necessary:
     if ( _compressor.valid() )
@@ -443,29 +650,59 @@ MBTilesTileSource::storeImage(const TileKey&    key,
     key.getProfile()->getNumTiles(key.getLevelOfDetail(), numCols, numRows);
     y  = numRows - y - 1;
 
+    // Encoding is done; only the insert itself needs the database.
+    Threading::ScopedMutexLock exclusiveLock(_mutex);
+
     // Prep the insert statement:
-    sqlite3_stmt* insert = NULL;
     std::string query = "INSERT OR REPLACE INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (?, ?, ?, ?)";
-    int rc = sqlite3_prepare_v2( _database, query.c_str(), -1, &insert, 0L );
-    if ( rc != SQLITE_OK )
+    if ( _insertTile == 0L )
     {
-        OE_WARN << LC << "Failed to prepare SQL: " << query << "; " << sqlite3_errmsg(_database) << std::endl;
-        return false;
+        int rc = sqlite3_prepare_v2( _database, query.c_str(), -1, &_insertTile, 0L );
+        if ( rc != SQLITE_OK )
+        {
+            OE_WARN << LC << "Failed to prepare SQL: " << query << "; " << sqlite3_errmsg(_database) << std::endl;
+            _insertTile = 0L;
+            return false;
+        }
+    }
+
+    // open a new batch if necessary:
+    unsigned batchSize = _options.writeBatchSize().get();
+    if ( batchSize > 1u && !_inTransaction )
+    {
+        if ( SQLITE_OK == sqlite3_exec(_database, "BEGIN", 0L, 0L, 0L) )
+        {
+            _inTransaction = true;
+            _transactionStart = osg::Timer::instance()->tick();
+
+            // make sure the batch gets committed even if no more writes arrive.
+            if ( !_commitTimer )
+            {
+                _commitTimer = new CommitTimerThread(this);
+                _commitTimer->start();
+            }
+            _commitTimerCond.signal();
+        }
+        else
+        {
+            OE_WARN << LC << "Failed to begin transaction; " << sqlite3_errmsg(_database) << std::endl;
+        }
     }
 
     // bind parameters:
-    sqlite3_bind_int( insert, 1, z );
-    sqlite3_bind_int( insert, 2, x );
-    sqlite3_bind_int( insert, 3, y );
+    sqlite3_bind_int( _insertTile, 1, z );
+    sqlite3_bind_int( _insertTile, 2, x );
+    sqlite3_bind_int( _insertTile, 3, y );
 
     // bind the data blob:
-    sqlite3_bind_blob( insert, 4, value.c_str(), value.length(), SQLITE_STATIC );
+    sqlite3_bind_blob( _insertTile, 4, value.c_str(), value.length(), SQLITE_STATIC );
 
     // run the sql.
     bool ok = true;
     int tries = 0;
+    int rc;
     do {
-        rc = sqlite3_step(insert);
+        rc = sqlite3_step(_insertTile);
     }
     while (++tries < 100 && (rc == SQLITE_BUSY || rc == SQLITE_LOCKED));
 
@@ -479,11 +716,85 @@ MBTilesTileSource::storeImage(const TileKey&    key,
         ok = false;
     }
 
-    sqlite3_finalize( insert );
+    sqlite3_reset( _insertTile );
+    sqlite3_clear_bindings( _insertTile );
+
+    // commit the batch when it's full or old enough:
+    if ( _inTransaction )
+    {
+        ++_uncommittedWrites;
+
+        double ageMS = osg::Timer::instance()->delta_m( _transactionStart, osg::Timer::instance()->tick() );
+
+        if ( _uncommittedWrites >= batchSize || ageMS >= (double)_options.writeBatchInterval().get() )
+        {
+            if ( !commitWrites() )
+                ok = false;
+        }
+    }
 
     return ok;
 }
 
+bool
+MBTilesTileSource::flush()
+{
+    Threading::ScopedMutexLock exclusiveLock(_mutex);
+    return commitWrites();
+}
+
+bool
+MBTilesTileSource::commitWrites()
+{
+    if ( !_inTransaction )
+        return true;
+
+    unsigned numWrites = _uncommittedWrites;
+    _inTransaction = false;
+    _uncommittedWrites = 0u;
+
+    int rc;
+    int tries = 0;
+    do {
+        rc = sqlite3_exec( _database, "COMMIT", 0L, 0L, 0L );
+    }
+    while (++tries < 100 && (rc == SQLITE_BUSY || rc == SQLITE_LOCKED));
+
+    if ( rc != SQLITE_OK )
+    {
+        _failedWrites += numWrites;
+        OE_WARN << LC << "Failed to commit " << numWrites << " tile(s), "
+            << _failedWrites << " lost so far; " << sqlite3_errmsg(_database) << std::endl;
+        sqlite3_exec( _database, "ROLLBACK", 0L, 0L, 0L );
+        return false;
+    }
+    return true;
+}
+
+void
+MBTilesTileSource::runCommitTimer()
+{
+    Threading::ScopedMutexLock exclusiveLock(_mutex);
+
+    while ( !_commitTimerDone )
+    {
+        if ( !_inTransaction )
+        {
+            // sleep until storeTile() opens a batch (or we're done)
+            _commitTimerCond.wait( &_mutex );
+            continue;
+        }
+
+        double intervalMS = (double)osg::maximum(_options.writeBatchInterval().get(), 1u);
+        double ageMS = osg::Timer::instance()->delta_m( _transactionStart, osg::Timer::instance()->tick() );
+
+        if ( ageMS >= intervalMS )
+            commitWrites();
+        else
+            _commitTimerCond.wait( &_mutex, (unsigned long)(intervalMS - ageMS) + 1ul );
+    }
+}
+
 bool
 MBTilesTileSource::getMetaData(const std::string& key, std::string& value)
 {
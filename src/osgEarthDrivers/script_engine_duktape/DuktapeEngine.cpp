@@ -54,80 +54,190 @@ namespace
         return 0;
     }
 
-    static duk_ret_t oe_duk_save_feature(duk_context* ctx)
+    // Pushes one attribute value; NULL attributes become null.
+    void pushValue(duk_context* ctx, const AttributeValue& a)
     {
-        // stack: [ptr]
+        if ( !a.second.set )
+        {
+            duk_push_null(ctx);
+            return;
+        }
+        switch(a.first) {
+        case ATTRTYPE_DOUBLE: duk_push_number (ctx, a.getDouble()); break;
+        case ATTRTYPE_INT:    duk_push_int    (ctx, a.getInt()); break;
+        case ATTRTYPE_BOOL:   duk_push_boolean(ctx, a.getBool()); break;
+        case ATTRTYPE_STRING:
+        default:              duk_push_string (ctx, a.getString().c_str()); break;
+        }
+    }
 
-        // pull the feature ptr from argument #0
-        Feature* feature = reinterpret_cast<Feature*>(duk_require_pointer(ctx, 0));
+    // The Feature behind a script "feature" object (at index), or NULL.
+    Feature* getFeature(duk_context* ctx, duk_idx_t index)
+    {
+        duk_get_prop_string(ctx, index, "__ptr");
+        Feature* feature = reinterpret_cast<Feature*>(duk_get_pointer(ctx, -1));
+        duk_pop(ctx);
+        return feature;
+    }
 
-        // Fetch the feature data:
-        duk_push_global_object(ctx);                    
-        // [ptr, global]
+    // Properties of the "feature" object that are built natively on first
+    // access (selected by the function's magic value).
+    enum LazyProperty { LAZY_PROPERTIES =0, LAZY_GEOMETRY =1 };
+    const char* s_lazyNames[] = { "properties", "geometry" };
+    const char* s_lazyFlags[] = { "__hasProperties", "__hasGeometry" };
 
-        if ( !duk_get_prop_string(ctx, -1, "feature") || !duk_is_object(ctx, -1))
-            return 0;
+    // stack: [this, key, value] -> [this]; replaces the accessor with a plain value
+    void settle(duk_context* ctx, int which)
+    {
+        duk_def_prop(ctx, -3,
+            DUK_DEFPROP_HAVE_VALUE |
+            DUK_DEFPROP_HAVE_WRITABLE | DUK_DEFPROP_WRITABLE |
+            DUK_DEFPROP_HAVE_ENUMERABLE | DUK_DEFPROP_ENUMERABLE |
+            DUK_DEFPROP_HAVE_CONFIGURABLE | DUK_DEFPROP_CONFIGURABLE);
+
+        duk_push_true(ctx);
+        duk_put_prop_string(ctx, -2, s_lazyFlags[which]);
+    }
 
-         // [ptr, global, feature]
+    // getter for feature.properties and feature.geometry
+    static duk_ret_t oe_duk_lazy_get(duk_context* ctx)
+    {
+        int which = duk_get_current_magic(ctx);
+
+        duk_push_this(ctx);                                  // [this]
+        Feature* feature = getFeature(ctx, -1);
+        duk_push_string(ctx, s_lazyNames[which]);            // [this, key]
 
-        if ( duk_get_prop_string(ctx, -1, "properties") && duk_is_object(ctx, -1) )
+        if ( which == LAZY_PROPERTIES )
         {
-            // [ptr, global, feature, props]
-            duk_enum(ctx, -1, 0);                       
-        
-            // [ptr, global, feature, props, enum]
-            while( duk_next(ctx, -1, 1/*get_value=true*/) )
+            duk_idx_t props_i = duk_push_object(ctx);        // [this, key, props]
+            if ( feature )
             {
-                std::string key( duk_get_string(ctx, -2) );
-                if (duk_is_string(ctx, -1))
-                {
-                    feature->set( key, std::string(duk_get_string(ctx, -1)) );
-                }
-                else if (duk_is_number(ctx, -1))
+                const AttributeTable& attrs = feature->getAttrs();
+                for(AttributeTable::const_iterator a = attrs.begin(); a != attrs.end(); ++a)
                 {
-                    feature->set( key, (double)duk_get_number(ctx, -1) );
+                    pushValue(ctx, a->second);
+                    duk_put_prop_string(ctx, props_i, a->first.c_str());
                 }
-                else if (duk_is_boolean(ctx, -1))
-                {
-                    feature->set( key, duk_get_boolean(ctx, -1) );
-                }
-                else if( duk_is_null_or_undefined( ctx, -1 ) )
-                {
-                    feature->setNull( key );
-                }
-                 duk_pop_2(ctx);
             }
-
-            duk_pop_2(ctx);
-            // [ptr, global, feature]
         }
         else
-        {   // [ptr, global, feature, undefined]
-            duk_pop(ctx);
-            // [ptr, global, feature]
+        {
+            GeometryAPI::push(ctx, feature ? feature->getGeometry() : 0L); // [this, key, geom]
+
+            // attach the geometry functions (buffer, etc.)
+            if ( duk_get_global_string(ctx, "oe_duk_bind_geometry_api") && duk_is_callable(ctx, -1) )
+            {
+                duk_dup(ctx, -2);                            // [this, key, geom, func, geom]
+                duk_pcall(ctx, 1);                           // [this, key, geom, result]
+            }
+            duk_pop(ctx);                                    // [this, key, geom]
         }
 
-        // save the geometry, if set:
-        if ( duk_get_prop_string(ctx, -1, "geometry")&& duk_is_object(ctx, -1) )
+        settle(ctx, which);                                  // [this]
+        duk_get_prop_string(ctx, -1, s_lazyNames[which]);    // [this, value]
+        return 1;
+    }
+
+    // setter for feature.properties and feature.geometry
+    static duk_ret_t oe_duk_lazy_set(duk_context* ctx)
+    {
+        int which = duk_get_current_magic(ctx);
+        duk_push_this(ctx);                                  // [value, this]
+        duk_push_string(ctx, s_lazyNames[which]);            // [value, this, key]
+        duk_dup(ctx, 0);                                     // [value, this, key, value]
+        settle(ctx, which);                                  // [value, this]
+        return 0;
+    }
+
+    // getter for feature.attributes, an alias of feature.properties
+    static duk_ret_t oe_duk_get_attributes(duk_context* ctx)
+    {
+        duk_push_this(ctx);
+        duk_get_prop_string(ctx, -1, "properties");
+        return 1;
+    }
+
+    void defineLazy(duk_context* ctx, duk_idx_t obj_i, int which)
+    {
+        duk_push_string(ctx, s_lazyNames[which]);
+        duk_push_c_function(ctx, oe_duk_lazy_get, 0);
+        duk_set_magic(ctx, -1, which);
+        duk_push_c_function(ctx, oe_duk_lazy_set, 1);
+        duk_set_magic(ctx, -1, which);
+        duk_def_prop(ctx, obj_i,
+            DUK_DEFPROP_HAVE_GETTER | DUK_DEFPROP_HAVE_SETTER |
+            DUK_DEFPROP_HAVE_ENUMERABLE | DUK_DEFPROP_ENUMERABLE |
+            DUK_DEFPROP_HAVE_CONFIGURABLE | DUK_DEFPROP_CONFIGURABLE);
+    }
+
+    // feature.save(): writes the properties and geometry back to the Feature,
+    // but only the ones the script actually touched.
+    static duk_ret_t oe_duk_save_feature(duk_context* ctx)
+    {
+        // every step below returns the stack to this depth, whatever it pushed
+        duk_idx_t top = duk_get_top(ctx);
+
+        duk_push_this(ctx);                                  // [this]
+        Feature* feature = getFeature(ctx, -1);
+        if ( !feature )
+            return 0;
+
+        duk_get_prop_string(ctx, -1, "__hasProperties");     // [this, flag]
+        bool hasProperties = duk_to_boolean(ctx, -1) != 0;
+        duk_pop(ctx);                                        // [this]
+
+        if ( hasProperties )
         {
-            // [ptr, global, feature, geometry]
-            std::string json( duk_json_encode(ctx, -1) ); // [ptr, global, feature, json]
-            Geometry* newGeom = GeometryUtils::geometryFromGeoJSON(json);
-            if ( newGeom )
+            // pushes undefined if there is no such property
+            duk_get_prop_string(ctx, -1, "properties");      // [this, props]
+            if ( duk_is_object(ctx, -1) )
             {
-                feature->setGeometry( newGeom );
+                duk_enum(ctx, -1, 0);                        // [this, props, enum]
+                while( duk_next(ctx, -1, 1/*get_value=true*/) )
+                {
+                    std::string key( duk_get_string(ctx, -2) );
+                    if (duk_is_string(ctx, -1))
+                    {
+                        feature->set( key, std::string(duk_get_string(ctx, -1)) );
+                    }
+                    else if (duk_is_number(ctx, -1))
+                    {
+                        feature->set( key, (double)duk_get_number(ctx, -1) );
+                    }
+                    else if (duk_is_boolean(ctx, -1))
+                    {
+                        feature->set( key, duk_get_boolean(ctx, -1) != 0 );
+                    }
+                    else if( duk_is_null_or_undefined( ctx, -1 ) )
+                    {
+                        feature->setNull( key );
+                    }
+                    duk_pop_2(ctx);
+                }
             }
-            duk_pop(ctx);
-            // [ptr, global, feature]
+            duk_set_top(ctx, top+1);                         // [this]
         }
-        else
+
+        duk_get_prop_string(ctx, -1, "__hasGeometry");       // [this, flag]
+        bool hasGeometry = duk_to_boolean(ctx, -1) != 0;
+        duk_pop(ctx);                                        // [this]
+
+        if ( hasGeometry )
         {
-            // [ptr, global, feature, undefined]
+            duk_get_prop_string(ctx, -1, "geometry");        // [this, geometry]
+            if ( duk_is_object(ctx, -1) )
+            {
+                Geometry* newGeom = GeometryAPI::get(ctx, -1);
+                if ( newGeom )
+                {
+                    feature->setGeometry( newGeom );
+                }
+            }
         }
-        
-        // [ptr, global, feature]
-        duk_pop_2(ctx);     // [ptr] (as we found it)
-        return 0;           // no return values.
+
+        duk_set_top(ctx, top);                               // []
+        return 0;                                            // no return values.
     }
 }
 
@@ -135,65 +245,172 @@ namespace
 
 namespace
 {
-    // Create a "feature" object in the global namespace.
+    // Create a "feature" object in the global namespace. Properties and geometry
+    // are bound natively and only converted if and when the script reads them.
     void setFeature(duk_context* ctx, Feature const* feature, bool complete)
     {
         duk_push_global_object(ctx);                             // [global]
 
-        // Complete profile: properties, geometry, and API bindings.
-        if ( complete )
+        duk_idx_t feature_i = duk_push_object(ctx);              // [global, feature]
         {
-            std::string geojson = feature->getGeoJSON();
-            duk_push_string(ctx, geojson.c_str());               // [global, json]
-            duk_json_decode(ctx, -1);                            // [global, feature]
-            duk_push_pointer(ctx, (void*)feature);               // [global, feature, ptr]
-            duk_put_prop_string(ctx, -2, "__ptr");               // [global, feature]
-            duk_put_prop_string(ctx, -2, "feature");             // [global]
-
-            // add the save() function and the "attributes" alias.
-            duk_eval_string_noresult(ctx,
-                "feature.save = function() {"
-                "    oe_duk_save_feature(this.__ptr);"
-                "} ");
-
-            duk_eval_string_noresult(ctx,
-                "Object.defineProperty(feature, 'attributes', {get:function() {return feature.properties;}});");
-
-            GeometryAPI::bindToFeature(ctx);
-        }
+            duk_push_int(ctx, feature->getFID());
+            duk_put_prop_string(ctx, feature_i, "id");
 
-        // Minimal profile: ID and properties only. MUCH faster!
-        else
-        {
-            duk_idx_t feature_i = duk_push_object(ctx);
+            duk_push_pointer(ctx, (void*)feature);
+            duk_put_prop_string(ctx, feature_i, "__ptr");
+
+            defineLazy(ctx, feature_i, LAZY_PROPERTIES);
+
+            // Complete profile: geometry and API bindings as well.
+            if ( complete )
             {
-                duk_push_int(ctx, feature->getFID());
-                duk_put_prop_string(ctx, feature_i, "id");
+                defineLazy(ctx, feature_i, LAZY_GEOMETRY);
 
-                duk_idx_t props_i = duk_push_object(ctx);
-                {
-                    const AttributeTable& attrs = feature->getAttrs();
-                    for(AttributeTable::const_iterator a = attrs.begin(); a != attrs.end(); ++a)
-                    {
-                        AttributeType type = a->second.first;
-                        switch(type) {
-                        case ATTRTYPE_DOUBLE: duk_push_number (ctx, a->second.getDouble()); break;
-                        case ATTRTYPE_INT:    duk_push_int    (ctx, a->second.getInt()); break;
-                        case ATTRTYPE_BOOL:   duk_push_boolean(ctx, a->second.getBool()); break;
-                        case ATTRTYPE_STRING:
-                        default:              duk_push_string (ctx, a->second.getString().c_str()); break;
-                        }
-                        duk_put_prop_string(ctx, props_i, a->first.c_str());
-                    }
-                }
-                duk_put_prop_string(ctx, feature_i, "properties");
+                duk_push_string(ctx, "attributes");
+                duk_push_c_function(ctx, oe_duk_get_attributes, 0);
+                duk_def_prop(ctx, feature_i, DUK_DEFPROP_HAVE_GETTER);
+
+                duk_push_c_function(ctx, oe_duk_save_feature, 0);
+                duk_put_prop_string(ctx, feature_i, "save");
             }
-            duk_put_prop_string(ctx, -2, "feature");
         }
+        duk_put_prop_string(ctx, -2, "feature");                 // [global]
 
         duk_pop(ctx); 
     }
-    
+
+    // Detaches the global "feature" object from its native Feature. The script
+    // may have kept a reference to it, and the Feature does not outlive the run.
+    void clearFeature(duk_context* ctx)
+    {
+        duk_push_global_object(ctx);                             // [global]
+        if ( duk_get_prop_string(ctx, -1, "feature") && duk_is_object(ctx, -1) )
+        {
+            duk_push_pointer(ctx, 0L);                           // [global, feature, 0]
+            duk_put_prop_string(ctx, -2, "__ptr");
+        }
+        duk_pop_2(ctx);                                          // []
+    }
+
+    // Pushes the function compiled from "code", compiling it on first use and
+    // caching it in the heap's global stash. Returns false, with the error
+    // on the stack instead, if the code does not compile.
+    bool pushCompiled(duk_context* ctx, const std::string& code)
+    {
+        // bounds the number of distinct snippets kept per heap
+        const int MAX_COMPILED = 256;
+
+        duk_push_global_stash(ctx);                              // [stash]
+        if ( !duk_get_prop_string(ctx, -1, "oe_compiled") )      // [stash, cache]
+        {
+            duk_pop(ctx);                                        // [stash]
+            duk_push_object(ctx);                                // [stash, cache]
+            duk_dup_top(ctx);
+            duk_put_prop_string(ctx, -3, "oe_compiled");
+        }
+        duk_remove(ctx, -2);                                     // [cache]
+
+        if ( duk_get_prop_string(ctx, -1, code.c_str()) )        // [cache, func]
+        {
+            duk_remove(ctx, -2);                                 // [func]
+            return true;
+        }
+        duk_pop(ctx);                                            // [cache]
+
+        if ( duk_pcompile_string(ctx, DUK_COMPILE_EVAL, code.c_str()) != 0 )
+        {
+            duk_remove(ctx, -2);                                 // [error]
+            return false;
+        }
+        // [cache, func]
+
+        duk_get_prop_string(ctx, -2, "__count");                 // [cache, func, count]
+        int count = duk_get_int(ctx, -1);
+        duk_pop(ctx);                                            // [cache, func]
+        if ( count >= MAX_COMPILED )
+        {
+            // start over with an empty cache:
+            duk_push_global_stash(ctx);                          // [cache, func, stash]
+            duk_push_object(ctx);                                // [cache, func, stash, newcache]
+            duk_put_prop_string(ctx, -2, "oe_compiled");         // [cache, func, stash]
+            duk_pop(ctx);                                        // [cache, func]
+        }
+        else
+        {
+            duk_dup_top(ctx);                                    // [cache, func, func]
+            duk_put_prop_string(ctx, -3, code.c_str());          // [cache, func]
+            duk_push_int(ctx, count+1);
+            duk_put_prop_string(ctx, -3, "__count");
+        }
+
+        duk_remove(ctx, -2);                                     // [func]
+        return true;
+    }
+
+    // Runs the function on top of the stack, leaving it there. Returns the
+    // result (or the error message) as a string.
+    bool callCompiled(duk_context* ctx, std::string& out)
+    {
+        duk_dup_top(ctx);                                        // [func, func]
+        bool ok = (duk_pcall(ctx, 0) == DUK_EXEC_SUCCESS);       // [func, "result"]
+        const char* resultVal = duk_safe_to_string(ctx, -1);
+        out = resultVal ? resultVal : "";
+        duk_pop(ctx);                                            // [func]
+        return ok;
+    }
+
+    //........................................................................
+
+    // Duktape heaps that have been created and initialized, but that are not
+    // in use, keyed by the profile and startup script they were initialized
+    // with. A new engine (or a new thread) takes one of these instead of
+    // building a new heap and running the startup script all over again.
+    class HeapPool
+    {
+    public:
+        HeapPool() { }
+
+        duk_context* take(const std::string& key)
+        {
+            Threading::ScopedMutexLock lock(_mutex);
+            Heaps::iterator i = _heaps.find(key);
+            if ( i == _heaps.end() || i->second.empty() )
+                return 0L;
+            duk_context* ctx = i->second.back();
+            i->second.pop_back();
+            return ctx;
+        }
+
+        // returns false if the pool is full, in which case the caller destroys the heap
+        bool give(const std::string& key, duk_context* ctx)
+        {
+            // enough for a full set of pager threads
+            const unsigned MAX_POOLED = 16u;
+
+            Threading::ScopedMutexLock lock(_mutex);
+            std::vector<duk_context*>& heaps = _heaps[key];
+            if ( heaps.size() >= MAX_POOLED )
+                return false;
+            heaps.push_back(ctx);
+            return true;
+        }
+
+    private:
+        typedef std::map<std::string, std::vector<duk_context*> > Heaps;
+        Heaps            _heaps;
+        Threading::Mutex _mutex;
+    };
+
+    // Leaked on purpose: per-thread Contexts hand their heaps back from
+    // thread-exit and static destructors, in no particular order relative
+    // to this pool, so it must never be destroyed. Created at load time so
+    // that the first two threads cannot race to construct it.
+    HeapPool* s_heapPool = new HeapPool();
+
+    HeapPool& getHeapPool()
+    {
+        return *s_heapPool;
+    }
 }
 
 //............................................................................
@@ -208,6 +425,16 @@ DuktapeEngine::Context::initialize(const ScriptEngineOptions& options, bool comp
 {
     if ( _ctx == 0L )
     {
+        _poolKey = std::string(complete ? "full:" : "minimal:") +
+            (options.script().isSet() ? options.script()->getCode() : "");
+
+#ifndef MAXIMUM_ISOLATION
+        // reuse a warm heap if there is one:
+        _ctx = getHeapPool().take( _poolKey );
+        if ( _ctx )
+            return;
+#endif
+
         // new heap + context.
         _ctx = duk_create_heap_default();
 
@@ -232,10 +459,6 @@ DuktapeEngine::Context::initialize(const ScriptEngineOptions& options, bool comp
 
         if ( complete )
         {
-            // feature.save() callback
-            duk_push_c_function(_ctx, oe_duk_save_feature, 1/*numargs*/); // [global, function]
-            duk_put_prop_string(_ctx, -2, "oe_duk_save_feature");         // [global]
-
             GeometryAPI::install(_ctx);
         }
 
@@ -247,7 +470,17 @@ DuktapeEngine::Context::~Context()
 {
     if ( _ctx )
     {
-        duk_destroy_heap(_ctx);
+        // drop the feature object, whose native pointer is about to go stale
+        duk_push_global_object(_ctx);
+        duk_del_prop_string(_ctx, -1, "feature");
+        duk_pop(_ctx);
+
+#ifndef MAXIMUM_ISOLATION
+        if ( !getHeapPool().give(_poolKey, _ctx) )
+#endif
+        {
+            duk_destroy_heap(_ctx);
+        }
         _ctx = 0L;
     }
 }
@@ -266,6 +499,17 @@ DuktapeEngine::~DuktapeEngine()
     //nop
 }
 
+DuktapeEngine::Context&
+DuktapeEngine::getContext()
+{
+    bool complete = (getProfile() == "full");
+
+    // cache the Context on a per-thread basis
+    Context& c = _contexts.get();
+    c.initialize( _options, complete );
+    return c;
+}
+
 ScriptResult
 DuktapeEngine::run(const std::string&   code,
                    Feature const*       feature,
@@ -280,41 +524,81 @@ DuktapeEngine::run(const std::string&   code,
     // brand new context every time
     Context c;
     c.initialize( _options, complete );
-    duk_context* ctx = c._ctx;
 #else
-    // cache the Context on a per-thread basis
-    Context& c = _contexts.get();
-    c.initialize( _options, complete );
-    duk_context* ctx = c._ctx;
+    Context& c = getContext();
 #endif
+    duk_context* ctx = c._ctx;
 
-	if ( feature && feature != c._feature.get() )
-    {
-		// encode the feature in the global object and push a native pointer:
-		setFeature(ctx, feature, complete);
-	}
-
-    // remember the feature so we don't re-create it if not necessary
-    c._feature = feature;
+    // bind the feature to the global object. Always rebind, since the last
+    // run detached its feature and this one may share its address.
+    if ( feature )
+        setFeature(ctx, feature, complete);
 
-    // run the script. On error, the top of stack will hold the error
-    // message instead of the return value.
+    // run the script. On error, the result holds the error message
+    // instead of the return value.
     std::string resultString;
-
-    bool ok = (duk_peval_string(ctx, code.c_str()) == 0); // [ "result" ]
-    const char* resultVal = duk_to_string(ctx, -1);
-    if ( resultVal )
-        resultString = resultVal;
+    bool ok = pushCompiled(ctx, code);                   // [func] or [error]
+    if ( ok )
+        ok = callCompiled(ctx, resultString);            // [func]
+    else
+        resultString = duk_safe_to_string(ctx, -1);
 
     if ( !ok )
     {
         OE_DEBUG << LC << "Error: source =" << std::endl << code << std::endl;
     }
 
-    // pop the return value:
+    clearFeature(ctx);
+
     duk_pop(ctx); // []
 
     return ok ?
         ScriptResult(resultString, true) :
         ScriptResult("", false, resultString);
 }
+
+void
+DuktapeEngine::run(const std::string&        code,
+                   const FeatureList&        features,
+                   std::vector<ScriptResult>& results,
+                   FilterContext const*      context)
+{
+    results.clear();
+    results.reserve( features.size() );
+
+    if (code.empty())
+    {
+        results.resize( features.size(), ScriptResult(EMPTY_STRING, false, "Script is empty.") );
+        return;
+    }
+
+    bool complete = (getProfile() == "full");
+    Context& c = getContext();
+    duk_context* ctx = c._ctx;
+
+    // compile once for the whole list:
+    if ( !pushCompiled(ctx, code) )                      // [func] or [error]
+    {
+        std::string error = duk_safe_to_string(ctx, -1);
+        duk_pop(ctx);
+        OE_DEBUG << LC << "Error: source =" << std::endl << code << std::endl;
+        results.resize( features.size(), ScriptResult("", false, error) );
+        return;
+    }
+
+    std::string resultString;
+    for(FeatureList::const_iterator i = features.begin(); i != features.end(); ++i)
+    {
+        const Feature* feature = i->get();
+        if ( feature )
+            setFeature(ctx, feature, complete);
+
+        bool ok = callCompiled(ctx, resultString);       // [func]
+        clearFeature(ctx);
+        results.push_back( ok ?
+            ScriptResult(resultString, true) :
+            ScriptResult("", false, resultString) );
+    }
+
+    duk_pop(ctx); // []
+}
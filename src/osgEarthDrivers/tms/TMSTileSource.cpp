@@ -24,6 +24,7 @@
 #include <osgEarth/FileUtils>
 #include <osgDB/FileUtils>
 #include <osgDB/FileNameUtils>
+#include <fstream>
 
 using namespace osgEarth;
 using namespace osgEarth::Util;
@@ -245,6 +246,67 @@ TMSTileSource::createImage(const TileKey&    key,
     return 0;
 }
 
+bool
+TMSTileSource::supportsEncodedImages() const
+{
+    // coverage tiles need marking after decoding, so they can't pass through.
+    return _tileMap.valid() && _options.coverage() != true;
+}
+
+EncodedImage*
+TMSTileSource::createEncodedImage(const TileKey&    key,
+                                  ProgressCallback* progress)
+{
+    if (_tileMap.valid() && key.getLevelOfDetail() <= _tileMap->getMaxLevel() )
+    {
+        std::string image_url = _tileMap->getURL( key, _invertY );
+        if ( image_url.empty() )
+            return 0L;
+
+        ReadResult r = URI(image_url).readString( _dbOptions.get(), progress );
+        if ( !r.succeeded() || r.getString().empty() )
+            return 0L;
+
+        std::string mimeType = EncodedImage::detectMimeType( r.getString() );
+        if ( mimeType.empty() )
+            mimeType = _tileMap->getFormat().getMimeType();
+
+        return new EncodedImage( r.getString(), mimeType );
+    }
+    return 0L;
+}
+
+bool
+TMSTileSource::storeEncodedImage(const TileKey&      key,
+                                 const EncodedImage* image,
+                                 ProgressCallback*   progress)
+{
+    if ( !_writer.valid() || !_tileMap.valid() || !image || !image->valid() )
+        return false;
+
+    // only an image in the repo's own format can be stored as is.
+    if ( !image->isFormat(_tileMap->getFormat().getExtension()) )
+        return false;
+
+    std::string image_url = _tileMap->getURL(key, _invertY);
+
+    if ( !osgEarth::makeDirectoryForFile(image_url) )
+    {
+        OE_WARN << LC << "Failed to make directory for " << image_url << std::endl;
+        return false;
+    }
+
+    std::ofstream out( image_url.c_str(), std::ios::out | std::ios::binary );
+    out.write( image->getData().data(), image->getData().size() );
+    if ( !out.good() )
+    {
+        OE_WARN << LC << "store failed; url=[" << image_url << "]" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
 bool
 TMSTileSource::storeImage(const TileKey& key,
                           osg::Image*    image,
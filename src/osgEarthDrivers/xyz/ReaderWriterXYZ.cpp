@@ -90,8 +90,8 @@ public:
       }
 
 
-      osg::Image* createImage(const TileKey&     key,
-          ProgressCallback*  progress )
+      // URI of the tile for a key, per the url template
+      URI createURI(const TileKey& key)
       {
           unsigned x, y;
           key.getTileXY( x, y );
@@ -131,7 +131,33 @@ public:
 
           OE_TEST << LC << "URI: " << uri.full() << ", key: " << uri.cacheKey() << std::endl;
 
-          return uri.getImage( _dbOptions.get(), progress );
+          return uri;
+      }
+
+      osg::Image* createImage(const TileKey&     key,
+                              ProgressCallback*  progress )
+      {
+          return createURI(key).getImage( _dbOptions.get(), progress );
+      }
+
+      bool supportsEncodedImages() const
+      {
+          return true;
+      }
+
+      EncodedImage* createEncodedImage(const TileKey&    key,
+                                       ProgressCallback* progress )
+      {
+          ReadResult r = createURI(key).readString( _dbOptions.get(), progress );
+          if ( !r.succeeded() || r.getString().empty() )
+              return 0L;
+
+          // trust the data over the url template's extension:
+          std::string mimeType = EncodedImage::detectMimeType( r.getString() );
+          if ( mimeType.empty() )
+              mimeType = Registry::instance()->getMimeTypeForExtension( _format );
+
+          return new EncodedImage( r.getString(), mimeType );
       }
 
       virtual std::string getExtension() const 
@@ -939,7 +939,16 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
     Random wallSkinPRNG( _wallSkinSymbol.valid()? *_wallSkinSymbol->randomSeed() : 0, Random::METHOD_FAST );
     Random roofSkinPRNG( _roofSkinSymbol.valid()? *_roofSkinSymbol->randomSeed() : 0, Random::METHOD_FAST );
 
-    for( FeatureList::iterator f = features.begin(); f != features.end(); ++f )
+    // evaluate the height expression for all the features at once, unless
+    // a symbol script might change their attributes along the way.
+    std::vector<double> heights;
+    if ( !_heightCallback.valid() && _heightExpr.isSet() && !_extrusionSymbol->script().isSet() )
+    {
+        Feature::evalAll( _heightExpr.mutable_value(), features, heights, &context );
+    }
+
+    unsigned featureIndex = 0;
+    for( FeatureList::iterator f = features.begin(); f != features.end(); ++f, ++featureIndex )
     {
         Feature* input = f->get();
 
@@ -989,6 +998,10 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
             {
                 height = _heightCallback->operator()(input, context);
             }
+            else if ( !heights.empty() )
+            {
+                height = heights[featureIndex];
+            }
             else if ( _heightExpr.isSet() )
             {
                 height = input->eval( _heightExpr.mutable_value(), &context );
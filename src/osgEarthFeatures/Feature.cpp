@@ -21,6 +21,8 @@
 #include <osgEarthFeatures/GeometryUtils>
 #include <osgEarth/StringUtils>
 #include <osgEarth/JsonUtils>
+#include <osgEarth/ThreadingUtils>
+#include <OpenThreads/Atomic>
 #include <algorithm>
 
 using namespace osgEarth;
@@ -29,6 +31,13 @@ using namespace osgEarth::Symbology;
 
 #define LC "[Feature] "
 
+namespace
+{
+    // One lock for every feature's getAttrs() cache; a mutex per feature
+    // costs an OS object for each of the (many) features in memory.
+    Threading::Mutex s_allAttrsMutex;
+}
+
 //----------------------------------------------------------------------------
 
 FeatureProfile::FeatureProfile( const GeoExtent& extent ) :
@@ -144,9 +153,57 @@ AttributeValue::getBool( bool defaultValue ) const
 
 //----------------------------------------------------------------------------
 
+namespace
+{
+    // Unique IDs for AttributeSchema instances.
+    OpenThreads::Atomic s_attributeSchemaIDGenerator;
+}
+
+AttributeSchema::AttributeSchema()
+{
+    _id = ++s_attributeSchemaIDGenerator;
+}
+
+AttributeSchema::AttributeSchema( const FeatureSchema& fields )
+{
+    _id = ++s_attributeSchemaIDGenerator;
+    for(FeatureSchema::const_iterator i = fields.begin(); i != fields.end(); ++i)
+        add( i->first, i->second );
+}
+
+unsigned
+AttributeSchema::add( const std::string& name, AttributeType type )
+{
+    Index::const_iterator i = _index.find(name);
+    if ( i != _index.end() )
+        return i->second;
+
+    unsigned ordinal = _names.size();
+    _names.push_back( name );
+    _types.push_back( type );
+    _index[name] = ordinal;
+    return ordinal;
+}
+
+int
+AttributeSchema::getOrdinal( const std::string& name ) const
+{
+    Index::const_iterator i = _index.find(name);
+    return i != _index.end() ? (int)i->second : -1;
+}
+
+bool
+AttributeSchema::isEquivalentTo( const AttributeSchema& rhs ) const
+{
+    return _names == rhs._names && _types == rhs._types;
+}
+
+//----------------------------------------------------------------------------
+
 Feature::Feature( FeatureID fid ) :
 _fid( fid ),
-_srs( 0L )
+_srs( 0L ),
+_allAttrsDirty( true )
 //_cachedBoundingPolytopeValid( false )
 {
     //NOP
@@ -155,7 +212,8 @@ _srs( 0L )
 Feature::Feature( Geometry* geom, const SpatialReference* srs, const Style& style, FeatureID fid ) :
 _geom ( geom ),
 _srs  ( srs ),
-_fid  ( fid )
+_fid  ( fid ),
+_allAttrsDirty( true )
 {
     if ( !style.empty() )
         _style = style;
@@ -166,9 +224,12 @@ _fid  ( fid )
 Feature::Feature( const Feature& rhs, const osg::CopyOp& copyOp ) :
 _fid      ( rhs._fid ),
 _attrs    ( rhs._attrs ),
+_schema   ( rhs._schema.get() ),
+_values   ( rhs._values ),
 _style    ( rhs._style ),
 _geoInterp( rhs._geoInterp ),
-_srs      ( rhs._srs.get() )
+_srs      ( rhs._srs.get() ),
+_allAttrsDirty( true )
 {
     if ( rhs._geom.valid() )
         _geom = rhs._geom->clone();
@@ -213,7 +274,7 @@ Feature::dirty()
 void
 Feature::set( const std::string& name, const std::string& value )
 {
-    AttributeValue& a = _attrs[name];
+    AttributeValue& a = edit(name);
     a.first = ATTRTYPE_STRING;
     a.second.stringValue = value;
     a.second.set = true;
@@ -222,7 +283,7 @@ Feature::set( const std::string& name, const std::string& value )
 void
 Feature::set( const std::string& name, double value )
 {
-    AttributeValue& a = _attrs[name];
+    AttributeValue& a = edit(name);
     a.first = ATTRTYPE_DOUBLE;
     a.second.doubleValue = value;
     a.second.set = true;
@@ -231,7 +292,7 @@ Feature::set( const std::string& name, double value )
 void
 Feature::set( const std::string& name, int value )
 {
-    AttributeValue& a = _attrs[name];
+    AttributeValue& a = edit(name);
     a.first = ATTRTYPE_INT;
     a.second.intValue = value;
     a.second.set = true;
@@ -240,13 +301,13 @@ Feature::set( const std::string& name, int value )
 void
 Feature::set( const std::string& name, const AttributeValue& value)
 {
-    _attrs[ name ] = value;
+    edit(name) = value;
 }
 
 void
 Feature::set( const std::string& name, bool value )
 {
-    AttributeValue& a = _attrs[name];
+    AttributeValue& a = edit(name);
     a.first = ATTRTYPE_BOOL;
     a.second.boolValue = value;
     a.second.set = true;
@@ -255,201 +316,415 @@ Feature::set( const std::string& name, bool value )
 void
 Feature::setNull( const std::string& name)
 {
-    AttributeValue& a = _attrs[name];    
+    // a schema field takes the schema's type, so it still counts as present.
+    if ( _schema.valid() )
+    {
+        int ordinal = _schema->getOrdinal(name);
+        if ( ordinal >= 0 )
+        {
+            setNullValue( (unsigned)ordinal );
+            return;
+        }
+    }
+
+    AttributeValue& a = edit(name);
     a.second.set = false;
 }
 
 void
 Feature::setNull( const std::string& name, AttributeType type)
 {
-    AttributeValue& a = _attrs[name];
+    AttributeValue& a = edit(name);
     a.first = type;    
     a.second.set = false;
 }
 
+void
+Feature::setValue( unsigned ordinal, const std::string& value )
+{
+    AttributeValue& a = edit(ordinal);
+    a.first = ATTRTYPE_STRING;
+    a.second.stringValue = value;
+    a.second.set = true;
+}
+
+void
+Feature::setValue( unsigned ordinal, double value )
+{
+    AttributeValue& a = edit(ordinal);
+    a.first = ATTRTYPE_DOUBLE;
+    a.second.doubleValue = value;
+    a.second.set = true;
+}
+
+void
+Feature::setValue( unsigned ordinal, int value )
+{
+    AttributeValue& a = edit(ordinal);
+    a.first = ATTRTYPE_INT;
+    a.second.intValue = value;
+    a.second.set = true;
+}
+
+void
+Feature::setValue( unsigned ordinal, bool value )
+{
+    AttributeValue& a = edit(ordinal);
+    a.first = ATTRTYPE_BOOL;
+    a.second.boolValue = value;
+    a.second.set = true;
+}
+
+void
+Feature::setValue( unsigned ordinal, const AttributeValue& value )
+{
+    edit(ordinal) = value;
+}
+
+void
+Feature::setNullValue( unsigned ordinal )
+{
+    AttributeValue& a = edit(ordinal);
+    a.first = _schema->getType(ordinal);
+    a.second.set = false;
+}
+
+const AttributeValue*
+Feature::getValue( unsigned ordinal ) const
+{
+    if ( ordinal >= _values.size() )
+        return 0L;
+
+    // a value that was never assigned has no type and is not set:
+    const AttributeValue& a = _values[ordinal];
+    return a.first != ATTRTYPE_UNSPECIFIED || a.second.set ? &a : 0L;
+}
+
+void
+Feature::setSchema( const AttributeSchema* schema )
+{
+    if ( schema == _schema.get() )
+        return;
+
+    // return the ordinal values to the name table, then redistribute:
+    for(unsigned i=0; i<_values.size(); ++i)
+    {
+        const AttributeValue* a = getValue(i);
+        if ( a )
+            _attrs[_schema->getName(i)] = *a;
+    }
+    _values.clear();
+
+    _schema = schema;
+
+    if ( _schema.valid() )
+    {
+        _values.resize( _schema->size() );
+        for(AttributeTable::iterator i = _attrs.begin(); i != _attrs.end(); )
+        {
+            int ordinal = _schema->getOrdinal(i->first);
+            if ( ordinal >= 0 )
+            {
+                _values[ordinal] = i->second;
+                _attrs.erase( i++ );
+            }
+            else ++i;
+        }
+    }
+
+    _allAttrs.clear();
+    _allAttrsDirty = true;
+}
+
+const AttributeTable&
+Feature::getAttrs() const
+{
+    if ( !_schema.valid() )
+        return _attrs;
+
+    // concurrent readers would otherwise rebuild the cache under each other.
+    Threading::ScopedMutexLock lock( s_allAttrsMutex );
+    if ( _allAttrsDirty )
+    {
+        _allAttrs = _attrs;
+        for(unsigned i=0; i<_values.size(); ++i)
+        {
+            const AttributeValue* a = getValue(i);
+            if ( a )
+                _allAttrs[_schema->getName(i)] = *a;
+        }
+        _allAttrsDirty = false;
+    }
+    return _allAttrs;
+}
+
+AttributeValue&
+Feature::edit( const std::string& name )
+{
+    if ( _schema.valid() )
+    {
+        int ordinal = _schema->getOrdinal(name);
+        if ( ordinal >= 0 )
+            return edit( (unsigned)ordinal );
+        _allAttrsDirty = true;
+    }
+    return _attrs[name];
+}
+
+AttributeValue&
+Feature::edit( unsigned ordinal )
+{
+    if ( _values.size() < _schema->size() )
+        _values.resize( _schema->size() );
+    _allAttrsDirty = true;
+    return _values[ordinal];
+}
+
+const AttributeValue*
+Feature::find( const std::string& name ) const
+{
+    if ( _schema.valid() )
+    {
+        int ordinal = _schema->getOrdinal(name);
+        if ( ordinal >= 0 )
+            return getValue( (unsigned)ordinal );
+    }
+
+    if ( _attrs.empty() )
+        return 0L;
+
+    AttributeTable::const_iterator i = _attrs.find(name);
+    return i != _attrs.end() ? &i->second : 0L;
+}
+
+const AttributeValue*
+Feature::find( const std::string& name, int ordinal ) const
+{
+    if ( ordinal >= 0 )
+        return getValue( (unsigned)ordinal );
+
+    if ( _attrs.empty() )
+        return 0L;
+
+    AttributeTable::const_iterator i = _attrs.find(name);
+    return i != _attrs.end() ? &i->second : 0L;
+}
 
+const std::vector<int>*
+Feature::bind( const NumericExpression::Variables& vars, ExpressionBinding& binding ) const
+{
+    if ( !_schema.valid() )
+        return 0L;
 
+    // resolve the variable names once per schema, not once per feature:
+    if ( binding.schemaID != _schema->getID() || binding.ordinals.size() != vars.size() )
+    {
+        binding.ordinals.resize( vars.size() );
+        for(unsigned i=0; i<vars.size(); ++i)
+            binding.ordinals[i] = _schema->getOrdinal( vars[i].first );
+        binding.schemaID = _schema->getID();
+    }
+    return &binding.ordinals;
+}
 
 bool
 Feature::hasAttr( const std::string& name ) const
 {
-    return _attrs.find(toLower(name)) != _attrs.end();
+    return find(name) != 0L;
 }
 
 std::string
 Feature::getString( const std::string& name ) const
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
-    return i != _attrs.end()? i->second.getString() : EMPTY_STRING;
+    const AttributeValue* a = find(name);
+    return a ? a->getString() : EMPTY_STRING;
 }
 
 double
 Feature::getDouble( const std::string& name, double defaultValue ) const 
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
-    return i != _attrs.end()? i->second.getDouble(defaultValue) : defaultValue;
+    const AttributeValue* a = find(name);
+    return a ? a->getDouble(defaultValue) : defaultValue;
 }
 
 int
 Feature::getInt( const std::string& name, int defaultValue ) const 
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
-    return i != _attrs.end()? i->second.getInt(defaultValue) : defaultValue;
+    const AttributeValue* a = find(name);
+    return a ? a->getInt(defaultValue) : defaultValue;
 }
 
 bool
 Feature::getBool( const std::string& name, bool defaultValue ) const 
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
-    return i != _attrs.end()? i->second.getBool(defaultValue) : defaultValue;
+    const AttributeValue* a = find(name);
+    return a ? a->getBool(defaultValue) : defaultValue;
 }
 
 bool
 Feature::isSet( const std::string& name) const
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
-    return i != _attrs.end()? i->second.second.set : false;
+    const AttributeValue* a = find(name);
+    return a ? a->second.set : false;
 }
 
 double
-Feature::eval( NumericExpression& expr, FilterContext const* context ) const
+Feature::evalVariable( const NumericExpression& expr, unsigned v, const std::vector<int>* ordinals, Session* session, FilterContext const* context ) const
 {
-    const NumericExpression::Variables& vars = expr.variables();
-    for( NumericExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
+    const std::string& name = expr.variables()[v].first;
+    const AttributeValue* a = ordinals ? find(name, (*ordinals)[v]) : find(name);
+    if ( a )
+        return a->getDouble(0.0);
+
+    //No attr found, look for script
+    ScriptEngine* engine = session ? session->getScriptEngine() : 0L;
+    if ( engine )
+    {
+        ScriptResult result = engine->run(name, this, context);
+        if (result.success())
+            return result.asDouble();
+
+        OE_WARN << LC << "Feature Script error on '" << expr.expr() << "': " << result.message() << std::endl;
+    }
+    return 0.0;
+}
+
+std::string
+Feature::evalVariable( const StringExpression& expr, unsigned v, const std::vector<int>* ordinals, Session* session, FilterContext const* context ) const
+{
+    const std::string& name = expr.variables()[v].first;
+    const AttributeValue* a = ordinals ? find(name, (*ordinals)[v]) : find(name);
+    if ( a )
+        return a->getString();
+
+    //No attr found, look for script
+    ScriptEngine* engine = session ? session->getScriptEngine() : 0L;
+    if ( engine )
     {
-      double val = 0.0;
-      AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-      if (ai != _attrs.end())
-      {
-        val = ai->second.getDouble(0.0);
-      }
-      else if (context && context->getSession())
-      {
-        //No attr found, look for script
-        ScriptEngine* engine = context->getSession()->getScriptEngine();
-        if (engine)
+        ScriptResult result = engine->run(name, this, context);
+        if (result.success())
+            return result.asString();
+
+        // Couldn't execute it as code, just take it as a string literal.
+        OE_DEBUG << LC << "Feature Script error on '" << expr.expr() << "': " << result.message() << std::endl;
+        return name;
+    }
+    return EMPTY_STRING;
+}
+
+namespace
+{
+    // variable values for one evaluation; on the stack for typical expressions
+    template<typename T, unsigned N>
+    struct ValueBuffer
+    {
+        ValueBuffer(unsigned size) : _ptr(_fixed)
         {
-          ScriptResult result = engine->run(i->first, this, context);
-          if (result.success())
-            val = result.asDouble();
-          else {
-              OE_WARN << LC << "Feature Script error on '" << expr.expr() << "': " << result.message() << std::endl;
-          }
+            if (size > N) { _dynamic.resize(size); _ptr = &_dynamic[0]; }
         }
-      }
+        T& operator[](unsigned i) { return _ptr[i]; }
+        const T* get() const { return _ptr; }
 
-      expr.set( *i, val); //osgEarth::as<double>(getAttr(i->first),0.0) );
-    }
+        T              _fixed[N];
+        std::vector<T> _dynamic;
+        T*             _ptr;
+    };
+}
 
-    return expr.eval();
+double
+Feature::eval( NumericExpression& expr, FilterContext const* context ) const
+{
+    Session* session = context ? context->getSession() : 0L;
+    const NumericExpression::Variables& vars = expr.variables();
+    const std::vector<int>* ordinals = bind( vars, expr.binding() );
+
+    ValueBuffer<double, 16> values( vars.size() );
+    for( unsigned v = 0; v < vars.size(); ++v )
+        values[v] = evalVariable( expr, v, ordinals, session, context );
+
+    return expr.eval( values.get() );
 }
 
 double
 Feature::eval(NumericExpression& expr, Session* session) const
 {
     const NumericExpression::Variables& vars = expr.variables();
-    for( NumericExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
-    {
-        double val = 0.0;
-        AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-        if (ai != _attrs.end())
-        {
-            val = ai->second.getDouble(0.0);
-        }
-        else if (session)
-        {
-            //No attr found, look for script
-            ScriptEngine* engine = session->getScriptEngine();
-            if (engine)
-            {
-                ScriptResult result = engine->run(i->first, this);
-                if (result.success())
-                {
-                    val = result.asDouble();
-                }
-                else
-                {
-                    OE_WARN << LC << "Feature Script error on '" << expr.expr() << "': " << result.message() << std::endl;
-                }
-            }
-        }
+    const std::vector<int>* ordinals = bind( vars, expr.binding() );
 
-        expr.set( *i, val );
-    }
+    ValueBuffer<double, 16> values( vars.size() );
+    for( unsigned v = 0; v < vars.size(); ++v )
+        values[v] = evalVariable( expr, v, ordinals, session, 0L );
 
-    return expr.eval();
+    return expr.eval( values.get() );
 }
 
 const std::string&
 Feature::eval( StringExpression& expr, FilterContext const* context ) const
 {
+    Session* session = context ? context->getSession() : 0L;
     const StringExpression::Variables& vars = expr.variables();
-    for( StringExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
-    {
-      std::string val = "";
-      AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-      if (ai != _attrs.end())
-      {
-        val = ai->second.getString();
-      }
-      else if (context && context->getSession())
-      {
-        //No attr found, look for script
-        ScriptEngine* engine = context->getSession()->getScriptEngine();
-        if (engine)
-        {
-          ScriptResult result = engine->run(i->first, this, context);
-          if (result.success())
-            val = result.asString();
-          else
-          {
-            // Couldn't execute it as code, just take it as a string literal.
-            val = i->first;
-            OE_DEBUG << LC << "Feature Script error on '" << expr.expr() << "': " << result.message() << std::endl;
-          }
-        }
-      }
+    const std::vector<int>* ordinals = bind( vars, expr.binding() );
 
-      expr.set( *i, val );
-    }
+    ValueBuffer<std::string, 4> values( vars.size() );
+    for( unsigned v = 0; v < vars.size(); ++v )
+        values[v] = evalVariable( expr, v, ordinals, session, context );
 
-    return expr.eval();
+    return expr.eval( values.get() );
 }
 
 const std::string&
 Feature::eval(StringExpression& expr, Session* session) const
 {
     const StringExpression::Variables& vars = expr.variables();
-    for( StringExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
+    const std::vector<int>* ordinals = bind( vars, expr.binding() );
+
+    ValueBuffer<std::string, 4> values( vars.size() );
+    for( unsigned v = 0; v < vars.size(); ++v )
+        values[v] = evalVariable( expr, v, ordinals, session, 0L );
+
+    return expr.eval( values.get() );
+}
+
+void
+Feature::evalAll( NumericExpression& expr, const FeatureList& features, std::vector<double>& out, FilterContext const* context )
+{
+    Session* session = context ? context->getSession() : 0L;
+    const NumericExpression::Variables& vars = expr.variables();
+    std::vector<double> values( vars.size() );
+
+    out.resize( features.size() );
+    double* result = out.empty() ? 0L : &out[0];
+
+    for( FeatureList::const_iterator f = features.begin(); f != features.end(); ++f, ++result )
     {
-        std::string val = "";
-        AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-        if (ai != _attrs.end())
-        {
-            val = ai->second.getString();
-        }
-        else if (session)
-        {
-            //No attr found, look for script
-            ScriptEngine* engine = session->getScriptEngine();
-            if (engine)
-            {
-                ScriptResult result = engine->run(i->first, this);
-                if (result.success())
-                    val = result.asString();
-                else
-                {
-                    // Couldn't execute it as code, just take it as a string literal.
-                    val = i->first;
-                    OE_DEBUG << LC << "Feature Script error on '" << expr.expr() << "': " << result.message() << std::endl;
-                }
-            }
-        }
+        const Feature* feature = f->get();
+        const std::vector<int>* ordinals = feature->bind( vars, expr.binding() );
+        for( unsigned v = 0; v < vars.size(); ++v )
+            values[v] = feature->evalVariable( expr, v, ordinals, session, context );
 
-        expr.set( *i, val );
+        *result = expr.eval( values.empty() ? 0L : &values[0] );
     }
+}
 
-    return expr.eval();
+void
+Feature::evalAll( StringExpression& expr, const FeatureList& features, std::vector<std::string>& out, FilterContext const* context )
+{
+    Session* session = context ? context->getSession() : 0L;
+    const StringExpression::Variables& vars = expr.variables();
+    std::vector<std::string> values( vars.size() );
+
+    out.resize( features.size() );
+    std::vector<std::string>::iterator result = out.begin();
+
+    for( FeatureList::const_iterator f = features.begin(); f != features.end(); ++f, ++result )
+    {
+        const Feature* feature = f->get();
+        const std::vector<int>* ordinals = feature->bind( vars, expr.binding() );
+        for( unsigned v = 0; v < vars.size(); ++v )
+            values[v] = feature->evalVariable( expr, v, ordinals, session, context );
+
+        *result = expr.eval( values.empty() ? 0L : &values[0] );
+    }
 }
 
 
@@ -268,23 +268,55 @@ OgrUtils::createOgrGeometry(const osgEarth::Symbology::Geometry* geometry, OGRwk
 
 Feature*
 OgrUtils::createFeature(OGRFeatureH handle, const FeatureProfile* profile)
+{
+    return createFeature( handle, profile, 0L );
+}
+
+Feature*
+OgrUtils::createFeature(OGRFeatureH handle, const FeatureProfile* profile, const AttributeSchema* schema)
 {
     Feature* f = 0L;
     if ( profile )
     {
-        f = createFeature( handle, profile->getSRS() );
+        f = createFeature( handle, profile->getSRS(), schema );
         if ( f && profile->geoInterp().isSet() )
             f->geoInterp() = profile->geoInterp().get();
     }
     else
     {
-        f = createFeature( handle, (const SpatialReference*)0L );
+        f = createFeature( handle, (const SpatialReference*)0L, schema );
     }
     return f;
 }            
 
+AttributeSchema*
+OgrUtils::createAttributeSchema( OGRFeatureDefnH handle )
+{
+    osg::ref_ptr<AttributeSchema> schema = new AttributeSchema();
+    int numFields = OGR_FD_GetFieldCount( handle );
+    for (int i = 0; i < numFields; ++i)
+    {
+        OGRFieldDefnH field_handle_ref = OGR_FD_GetFieldDefn( handle, i );
+        std::string name = osgEarth::toLower( std::string(OGR_Fld_GetNameRef(field_handle_ref)) );
+
+        // same type mapping as createFeature: anything not int or real is a string
+        AttributeType type;
+        switch( OGR_Fld_GetType(field_handle_ref) )
+        {
+        case OFTInteger: type = ATTRTYPE_INT;    break;
+        case OFTReal:    type = ATTRTYPE_DOUBLE; break;
+        default:         type = ATTRTYPE_STRING;
+        }
+
+        // duplicate names (case-insensitive) would break the ordinal mapping
+        if ( schema->add(name, type) != (unsigned)i )
+            return 0L;
+    }
+    return schema.release();
+}
+
 Feature*
-OgrUtils::createFeature( OGRFeatureH handle, const SpatialReference* srs )
+OgrUtils::createFeature( OGRFeatureH handle, const SpatialReference* srs, const AttributeSchema* schema )
 {
     long fid = OGR_F_GetFID( handle );
 
@@ -300,6 +332,36 @@ OgrUtils::createFeature( OGRFeatureH handle, const SpatialReference* srs )
     Feature* feature = new Feature( geom, srs, Style(), fid );
 
     int numAttrs = OGR_F_GetFieldCount(handle); 
+
+    // with a schema, OGR field index == attribute ordinal; no names needed.
+    if ( schema && schema->size() == (unsigned)numAttrs )
+    {
+        feature->setSchema( schema );
+
+        for (int i = 0; i < numAttrs; ++i)
+        {
+            if ( !OGR_F_IsFieldSet(handle, i) )
+            {
+                feature->setNullValue( i );
+                continue;
+            }
+
+            switch( schema->getType(i) )
+            {
+            case ATTRTYPE_INT:
+                feature->setValue( i, (int)OGR_F_GetFieldAsInteger(handle, i) );
+                break;
+            case ATTRTYPE_DOUBLE:
+                feature->setValue( i, (double)OGR_F_GetFieldAsDouble(handle, i) );
+                break;
+            default:
+                feature->setValue( i, std::string(OGR_F_GetFieldAsString(handle, i)) );
+            }
+        }
+
+        return feature;
+    }
+
     for (int i = 0; i < numAttrs; ++i) 
     { 
         OGRFieldDefnH field_handle_ref = OGR_F_GetFieldDefnRef( handle, i ); 
@@ -87,17 +87,27 @@ ScriptFilter::push( FeatureList& input, FilterContext& context )
         return context;
     }
 
-    bool ok = true;
+    // features without geometry never pass:
     for( FeatureList::iterator i = input.begin(); i != input.end(); )
     {
-        if ( push( i->get(), context ) )
-        {
+        if ( i->valid() && i->get()->getGeometry() )
+            ++i;
+        else
+            i = input.erase(i);
+    }
+
+    // run the script over the whole list in one go, and keep the features
+    // for which it returned true.
+    std::vector<ScriptResult> results;
+    _engine->run(_expression.get(), input, results, &context);
+
+    unsigned r = 0;
+    for( FeatureList::iterator i = input.begin(); i != input.end(); ++r )
+    {
+        if ( r < results.size() && results[r].asBool() )
             ++i;
-        }
         else
-        {
             i = input.erase(i);
-        }
     }
 
     return context;
@@ -30,7 +30,8 @@ using namespace osgEarth::Symbology;
 
 NumericExpression::NumericExpression() :
 _value(0.0),
-_dirty(true)
+_dirty(true),
+_stackSize(0u)
 {
     //nop
 }
@@ -38,7 +39,8 @@ _dirty(true)
 NumericExpression::NumericExpression( const std::string& expr ) : 
 _src  ( expr ),
 _value( 0.0 ),
-_dirty( true )
+_dirty( true ),
+_stackSize( 0u )
 {
     init();
 }
@@ -48,14 +50,18 @@ _src  ( rhs._src ),
 _rpn  ( rhs._rpn ),
 _vars ( rhs._vars ),
 _value( rhs._value ),
-_dirty( rhs._dirty )
+_dirty( rhs._dirty ),
+_binding( rhs._binding ),
+_program( rhs._program ),
+_stackSize( rhs._stackSize )
 {
     //nop
 }
 
 NumericExpression::NumericExpression( double staticValue ) :
 _value( staticValue ),
-_dirty( false )
+_dirty( false ),
+_stackSize( 0u )
 {
     _src = Stringify() << staticValue;
     init();
@@ -63,7 +69,8 @@ _dirty( false )
 
 NumericExpression::NumericExpression( const Config& conf ) :
 _value( 0.0 ),
-_dirty( true )
+_dirty( true ),
+_stackSize( 0u )
 {
     mergeConfig( conf );
     init();
@@ -99,6 +106,7 @@ NumericExpression::init()
 {
     _vars.clear();
     _rpn.clear();
+    _binding = ExpressionBinding();
 
     StringTokenizer variablesTokenizer( "", "" );
     variablesTokenizer.addDelims( "[]", true );
@@ -264,6 +272,44 @@ NumericExpression::init()
         _rpn.push_back( s.top() );
         s.pop();
     }
+
+    compile();
+}
+
+void
+NumericExpression::compile()
+{
+    _program.clear();
+    _program.reserve( _rpn.size() );
+
+    // The stack depth at each step is known in advance, so operators without
+    // two operands (which eval skips) can be dropped here once and for all.
+    unsigned depth = 0, var_i = 0;
+    _stackSize = 0;
+
+    for( unsigned i=0; i<_rpn.size(); ++i )
+    {
+        const Atom& a = _rpn[i];
+        if ( IS_OPERATOR(a) || a.first == MIN || a.first == MAX )
+        {
+            if ( depth >= 2 )
+            {
+                _program.push_back( a );
+                --depth;
+            }
+        }
+        else if ( a.first == VARIABLE )
+        {
+            _program.push_back( Atom(VARIABLE, (double)var_i++) );
+            ++depth;
+        }
+        else // OPERAND (or a stray paren, which pushes its value as well)
+        {
+            _program.push_back( Atom(OPERAND, a.second) );
+            ++depth;
+        }
+        _stackSize = std::max( _stackSize, depth );
+    }
 }
 
 void 
@@ -277,93 +323,73 @@ NumericExpression::set( const Variable& var, double value )
     }
 }
 
+namespace
+{
+    // expressions up to this size evaluate without touching the heap
+    const unsigned FIXED_SIZE = 16u;
+}
+
 double
 NumericExpression::eval() const
 {
     if ( _dirty )
     {
-        std::stack<double> s;
-
-        for( unsigned i=0; i<_rpn.size(); ++i )
+        // gather the values last passed to set():
+        double fixed[FIXED_SIZE];
+        std::vector<double> dynamic;
+        double* values = fixed;
+        if ( _vars.size() > FIXED_SIZE )
         {
-            const Atom& a = _rpn[i];
-
-            if ( a.first == ADD )
-            {
-                if ( s.size() >= 2 )
-                {
-                    double op2 = s.top(); s.pop();
-                    double op1 = s.top(); s.pop();
-                    s.push( op1 + op2 );
-                }
-            }
-            else if ( a.first == SUB )
-            {
-                if ( s.size() >= 2 )
-                {
-                    double op2 = s.top(); s.pop();
-                    double op1 = s.top(); s.pop();
-                    s.push( op1 - op2 );
-                }
-            }
-            else if ( a.first == MULT )
-            {
-                if ( s.size() >= 2 )
-                {
-                    double op2 = s.top(); s.pop();
-                    double op1 = s.top(); s.pop();
-                    s.push( op1 * op2 );
-                }
-            }
-            else if ( a.first == DIV )
-            {
-                if ( s.size() >= 2 )
-                {
-                    double op2 = s.top(); s.pop();
-                    double op1 = s.top(); s.pop();
-                    s.push( op1 / op2 );
-                }
-            }
-            else if ( a.first == MOD )
-            {
-                if ( s.size() >= 2 )
-                {
-                    double op2 = s.top(); s.pop();
-                    double op1 = s.top(); s.pop();
-                    s.push( fmod(op1, op2) );
-                }
-            }
-            else if ( a.first == MIN )
-            {
-                if ( s.size() >= 2 )
-                {
-                    double op2 = s.top(); s.pop();
-                    double op1 = s.top(); s.pop();
-                    s.push( std::min(op1, op2) );
-                }
-            }
-            else if ( a.first == MAX )
-            {
-                if ( s.size() >= 2 )
-                {
-                    double op2 = s.top(); s.pop();
-                    double op1 = s.top(); s.pop();
-                    s.push( std::max(op1, op2) );
-                }
-            }
-            else // OPERAND or VARIABLE
-            {
-                s.push( a.second );
-            }
+            dynamic.resize( _vars.size() );
+            values = &dynamic[0];
         }
 
-        const_cast<NumericExpression*>(this)->_value = s.size() > 0 ? s.top() : 0.0;
+        for( unsigned i=0; i<_vars.size(); ++i )
+            values[i] = _rpn[_vars[i].second].second;
+
+        const_cast<NumericExpression*>(this)->_value = eval( values );
         const_cast<NumericExpression*>(this)->_dirty = false;
     }
 
     return !osg::isNaN( _value ) ? _value : 0.0;
 }
 
+double
+NumericExpression::eval( const double* values ) const
+{
+    double fixed[FIXED_SIZE];
+    std::vector<double> dynamic;
+    double* s = fixed;
+    if ( _stackSize > FIXED_SIZE )
+    {
+        dynamic.resize( _stackSize );
+        s = &dynamic[0];
+    }
+
+    // n = stack size; compile() guarantees n >= 2 at every operator.
+    unsigned n = 0;
+
+    for( AtomVector::const_iterator i = _program.begin(); i != _program.end(); ++i )
+    {
+        switch( i->first )
+        {
+        case OPERAND:  s[n++] = i->second; break;
+        case VARIABLE: s[n++] = values[(unsigned)i->second]; break;
+        case ADD:      --n; s[n-1] = s[n-1] + s[n]; break;
+        case SUB:      --n; s[n-1] = s[n-1] - s[n]; break;
+        case MULT:     --n; s[n-1] = s[n-1] * s[n]; break;
+        case DIV:      --n; s[n-1] = s[n-1] / s[n]; break;
+        case MOD:      --n; s[n-1] = fmod(s[n-1], s[n]); break;
+        case MIN:      --n; s[n-1] = std::min(s[n-1], s[n]); break;
+        case MAX:      --n; s[n-1] = std::max(s[n-1], s[n]); break;
+        default: break;
+        }
+    }
+
+    double result = n > 0 ? s[n-1] : 0.0;
+    return !osg::isNaN( result ) ? result : 0.0;
+}
+
 //------------------------------------------------------------------------
 
 StringExpression::StringExpression() :
@@ -394,7 +420,8 @@ _vars( rhs._vars ),
 _value( rhs._value ),
 _infix( rhs._infix ),
 _dirty( rhs._dirty ),
-_uriContext( rhs._uriContext )
+_uriContext( rhs._uriContext ),
+_binding( rhs._binding )
 {
     //nop
 }
@@ -440,6 +467,8 @@ StringExpression::getConfig() const
 void
 StringExpression::init()
 {
+    _binding = ExpressionBinding();
+
     bool inQuotes = false;
     int inVar = 0;
     int startPos = 0;
@@ -561,6 +590,27 @@ StringExpression::eval() const
     return _value;
 }
 
+const std::string&
+StringExpression::eval( const std::string* values ) const
+{
+    if ( _vars.empty() )
+        return eval();
+
+    std::string& result = _boundValue;
+    result.clear();
+
+    unsigned var_i = 0;
+    for( AtomVector::const_iterator i = _infix.begin(); i != _infix.end(); ++i )
+    {
+        if ( i->first == VARIABLE )
+            result += values[var_i++];
+        else
+            result += i->second;
+    }
+
+    return result;
+}
+
 URI
 StringExpression::evalURI() const
 {
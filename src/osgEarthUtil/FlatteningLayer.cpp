@@ -17,10 +17,12 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include <osgEarthUtil/FlatteningLayer>
+#include <osgEarthUtil/GridIndex>
 #include <osgEarth/Registry>
 #include <osgEarth/HeightFieldUtils>
 #include <osgEarth/Map>
 #include <osgEarth/Progress>
+#include <osgEarth/TaskService>
 #include <osgEarth/Utils>
 #include <osgEarthFeatures/FeatureCursor>
 #include <osgEarthFeatures/GeometryUtils>
@@ -192,117 +194,133 @@ namespace
     };
 
     typedef std::vector<Widths> WidthsList;
+
+    // A line segment to flatten along, with the radii of the feature it came from.
+    struct LineSegment {
+        osg::Vec3d A, B;
+        double innerRadius;
+        double outerRadius;
+        double outerRadius2;
+    };
+
+    // A polygon to flatten, with its buffer width and the point whose
+    // elevation the flattened area takes.
+    struct PolygonEntry {
+        const Polygon* polygon;
+        double bufferWidth;
+        POINT internalP;
+    };
+
+    /**
+     * Everything the row jobs share while flattening one heightfield. Built once
+     * per tile query; read-only while the rows run, except for the heightfield
+     * cells, which each job only writes in its own rows.
+     */
+    struct Flattening
+    {
+        osg::HeightField* hf;
+        std::vector<POINT> points;      // sample points in the working SRS, row-major
+        std::vector<LineSegment> segments;
+        std::vector<PolygonEntry> polygons;
+        unsigned numPolygons;           // polygons in the tile, indexed or not
+        osg::ref_ptr<ElevationPool> pool;
+        osg::ref_ptr<const SpatialReference> srs;
+        unsigned lod;
+        bool fillAllPixels;
+        osg::ref_ptr<ProgressCallback> progress;
+        GridIndex index;
+    };
+
+    // Elevation of each polygon's internal point, looked up on first use.
+    struct InternalElevations
+    {
+        std::vector<float> elev;
+        std::vector<bool>  valid;
+    };
     
-    // Creates a heightfield that flattens an area intersecting the input polygon geometry.
+    // Flattens the sample P against the polygons near it.
     // The height of the area is found by sampling a point internal to the polygon.
     // bufferWidth = width of transition from flat area to natural terrain.
-    bool integratePolygons(const TileKey& key, osg::HeightField* hf, const MultiGeometry* geom, const SpatialReference* geomSRS,
-                           WidthsList& widths, ElevationEnvelope* envelope, 
-                           bool fillAllPixels, ProgressCallback* progress)
+    bool flattenPolygonSample(const Flattening& f, const POINT& P, unsigned col, unsigned row,
+                              ElevationEnvelope* envelope, InternalElevations& internal)
     {
-        bool wroteChanges = false;
-
-        const GeoExtent& ex = key.getExtent();
+        double minD2 = DBL_MAX; // minimum distance(squared) to closest polygon edge
+        double bufferWidth = 0.0;
+        int best = -1;
 
-        double col_interval = ex.width() / (double)(hf->getNumColumns()-1);
-        double row_interval = ex.height() / (double)(hf->getNumRows()-1);
-
-        POINT Pex, P, internalP;
-
-        bool needsTransform = ex.getSRS() != geomSRS;
-        
-        for (unsigned col = 0; col < hf->getNumColumns(); ++col)
+        const std::vector<unsigned>& candidates = f.index.query(P.x(), P.y());
+        for (unsigned i = 0; i < candidates.size(); ++i)
         {
-            Pex.x() = ex.xMin() + (double)col * col_interval;
+            const PolygonEntry& entry = f.polygons[candidates[i]];
 
-            for (unsigned row = 0; row < hf->getNumRows(); ++row)
+            // Does the point P fall within the polygon?
+            if (entry.polygon->contains2D(P.x(), P.y()))
             {
-                // check for cancelation periodically
-                //if (progress && progress->isCanceled())
-                //    return false;
-
-                Pex.y() = ex.yMin() + (double)row * row_interval;
-
-                if (needsTransform)
-                    ex.getSRS()->transform(Pex, geomSRS, P);
-                else
-                    P = Pex;
-                
-                bool done = false;
-                double minD2 = DBL_MAX;//bufferWidth * bufferWidth; // minimum distance(squared) to closest polygon edge
-                double bufferWidth = 0.0;
-
-                const Polygon* bestPoly = 0L;
+                // yes, flatten it to the polygon's centroid elevation;
+                // and we're dont with this point.
+                best = candidates[i];
+                minD2 = -1.0;
+                bufferWidth = entry.bufferWidth;
+                break;
+            }
 
-                for (unsigned int geomIndex = 0; geomIndex < geom->getNumComponents(); geomIndex++)
+            // If not in the polygon, how far to the closest edge?
+            else
+            {
+                double D2 = getDistanceSquaredToClosestEdge(P, entry.polygon);
+                if (D2 < minD2)
                 {
-                    Geometry* component = geom->getComponents()[geomIndex];
-                    Widths width = widths[geomIndex];
-                    ConstGeometryIterator giter(component, false);
-                    while (giter.hasMore() && !done)
-                    {
-                        const Polygon* polygon = dynamic_cast<const Polygon*>(giter.next());
-                        if (polygon)
-                        {
-                            // Does the point P fall within the polygon?
-                            if (polygon->contains2D(P.x(), P.y()))
-                            {
-                                // yes, flatten it to the polygon's centroid elevation;
-                                // and we're dont with this point.
-                                done = true;
-                                bestPoly = polygon;
-                                minD2 = -1.0;
-                                bufferWidth = width.bufferWidth;
-                            }
-
-                            // If not in the polygon, how far to the closest edge?
-                            else
-                            {
-                                double D2 = getDistanceSquaredToClosestEdge(P, polygon);
-                                if (D2 < minD2)
-                                {
-                                    minD2 = D2;
-                                    bestPoly = polygon;
-                                    bufferWidth = width.bufferWidth;
-                                }
-                            }
-                        }                    
-                    }
+                    minD2 = D2;
+                    best = candidates[i];
+                    bufferWidth = entry.bufferWidth;
                 }
+            }
+        }
 
-                if (bestPoly && minD2 != 0.0)
-                {
-                    float h;
-                    POINT internalP = getInternalPoint(bestPoly);
-                    float elevInternal = envelope->getElevation(internalP.x(), internalP.y());
-
-                    if (minD2 < 0.0)
-                    {
-                        h = elevInternal;
-                    }
-                    else
-                    {
-                        float elevNatural = envelope->getElevation(P.x(), P.y());
-                        double blend = clamp(sqrt(minD2)/bufferWidth, 0.0, 1.0); // [0..1] 0=internal, 1=natural
-                        h = smootherstep(elevInternal, elevNatural, blend);
-                    }
+        if (best >= 0 && minD2 != 0.0)
+        {
+            if (!internal.valid[best])
+            {
+                const POINT& internalP = f.polygons[best].internalP;
+                internal.elev[best] = envelope->getElevation(internalP.x(), internalP.y());
+                internal.valid[best] = true;
+            }
 
-                    hf->setHeight(col, row, h);
-                    wroteChanges = true;
-                }
+            float h;
+            float elevInternal = internal.elev[best];
 
-                else if (fillAllPixels)
-                {
-                    float h = envelope->getElevation(P.x(), P.y());
-                    hf->setHeight(col, row, h);
-                    // do not set wroteChanges
-                }
+            if (minD2 < 0.0)
+            {
+                h = elevInternal;
+            }
+            else
+            {
+                float elevNatural = envelope->getElevation(P.x(), P.y());
+                double blend = clamp(sqrt(minD2)/bufferWidth, 0.0, 1.0); // [0..1] 0=internal, 1=natural
+                h = smootherstep(elevInternal, elevNatural, blend);
             }
+
+            f.hf->setHeight(col, row, h);
+            return true;
         }
 
-        return wroteChanges;
-    }
+        else if (best < 0 && f.numPolygons > 0)
+        {
+            // Farther than any buffer from every polygon (which is why none
+            // of them are indexed here), so the natural terrain wins.
+            f.hf->setHeight(col, row, envelope->getElevation(P.x(), P.y()));
+            return true;
+        }
+
+        else if (f.fillAllPixels)
+        {
+            float h = envelope->getElevation(P.x(), P.y());
+            f.hf->setHeight(col, row, h);
+            // do not set wroteChanges
+        }
 
+        return false;
+    }
 
 
     struct Sample {
@@ -391,229 +409,377 @@ namespace
      * source elevation into the heightfield as a starting point, and then sample that
      * modifiable heightfield as we go along.
      */
-    bool integrateLines(const TileKey& key, osg::HeightField* hf, const MultiGeometry* geom, const SpatialReference* geomSRS,
-                        WidthsList& widths, ElevationEnvelope* envelope,
-                        bool fillAllPixels, ProgressCallback* progress)
+    bool flattenLineSample(const Flattening& f, const POINT& P, unsigned col, unsigned row,
+                           ElevationEnvelope* envelope, Samples& samples)
     {
-        bool wroteChanges = false;
-
-        const GeoExtent& ex = key.getExtent();
+        osg::Vec3d PROJ;
+
+        // For each point, we need to find the closest line segments to that point
+        // because the elevation values on these line segments will be the flattening
+        // value. There may be more than one line segment that falls within the search
+        // radius; we will collect up to MaxSamples of these for each heightfield point.
+        static const unsigned Maxsamples = 4;
+        samples.clear();
+
+        // Search the line segments near P.
+        const std::vector<unsigned>& candidates = f.index.query(P.x(), P.y());
+        for (unsigned c = 0; c < candidates.size(); ++c)
+        {
+            // AB is a candidate line segment:
+            const LineSegment& segment = f.segments[candidates[c]];
+            const osg::Vec3d& A = segment.A;
+            const osg::Vec3d& B = segment.B;
 
-        double col_interval = ex.width() / (double)(hf->getNumColumns()-1);
-        double row_interval = ex.height() / (double)(hf->getNumRows()-1);
+            osg::Vec3d AB = B - A;    // current segment AB
 
-        osg::Vec3d Pex, P, PROJ;
+            double t;                 // parameter [0..1] on segment AB
+            double D2;                // shortest distance from point P to segment AB, squared
+            double L2 = AB.length2(); // length (squared) of segment AB
+            osg::Vec3d AP = P - A;    // vector from endpoint A to point P
 
-        bool needsTransform = ex.getSRS() != geomSRS;
-        
-        // Loop over the new heightfield.
-        for (unsigned col = 0; col < hf->getNumColumns(); ++col)
-        {
-            Pex.x() = ex.xMin() + (double)col * col_interval;
-
-            for (unsigned row = 0; row < hf->getNumRows(); ++row)
+            if (L2 == 0.0)
             {
-                // check for cancelation periodically
-                //if (progress && progress->isCanceled())
-                //    return false;
+                // trivial case: zero-length segment
+                t = 0.0;
+                D2 = AP.length2();
+            }
+            else
+            {
+                // Calculate parameter "t" [0..1] which will yield the closest point on AB to P.
+                // Clamping it means the closest point won't be beyond the endpoints of the segment.
+                t = clamp((AP * AB)/L2, 0.0, 1.0);
 
-                Pex.y() = ex.yMin() + (double)row * row_interval;
+                // project our point P onto segment AB:
+                PROJ.set( A + AB*t );
 
-                // Move the point into the working SRS if necessary
-                if (needsTransform)
-                    ex.getSRS()->transform(Pex, geomSRS, P);
+                // measure the distance (squared) from P to the projected point on AB:
+                D2 = (P - PROJ).length2();
+            }
+
+            // If the distance from our point to the line segment falls within
+            // the maximum flattening distance, store it.
+            if (D2 <= segment.outerRadius2)
+            {
+                // see if P is a new sample.
+                Sample* b;
+                if (samples.size() < Maxsamples)
+                {
+                    // If we haven't collected the maximum number of samples yet,
+                    // just add this to the list:
+                    samples.push_back(Sample());
+                    b = &samples.back();
+                }
                 else
-                    P = Pex;
+                {
+                    // If we are maxed out on samples, find the farthest one we have so far
+                    // and replace it if the new point is closer:
+                    unsigned max_i = 0;
+                    for (unsigned i=1; i<samples.size(); ++i)
+                        if (samples[i].D2 > samples[max_i].D2)
+                            max_i = i;
+
+                    b = &samples[max_i];
 
-                // For each point, we need to find the closest line segments to that point
-                // because the elevation values on these line segments will be the flattening
-                // value. There may be more than one line segment that falls within the search
-                // radius; we will collect up to MaxSamples of these for each heightfield point.
-                static const unsigned Maxsamples = 4;
-                Samples samples;
+                    if (b->D2 < D2)
+                        b = 0L;
+                }
 
-                for (unsigned int geomIndex = 0; geomIndex < geom->getNumComponents(); geomIndex++)
+                if (b)
                 {
-                    Widths w = widths[geomIndex];
-                    double innerRadius = w.lineWidth * 0.5;
-                    double outerRadius = innerRadius + w.bufferWidth;
-                    double outerRadius2 = outerRadius * outerRadius;
-
-                    Geometry* component = geom->getComponents()[geomIndex];
-                    // Search for line segments.
-                    ConstGeometryIterator giter(component);
-                    while (giter.hasMore())
-                    {
-                        const Geometry* part = giter.next();                        
+                    b->D2 = D2;
+                    b->A = A;
+                    b->B = B;
+                    b->T = t;
+                    b->innerRadius = segment.innerRadius;
+                    b->outerRadius = segment.outerRadius;
+                }
+            }
+        }
+        // Remove unnecessary sample points that lie on the endpoint of a segment
+        // that abuts another segment in our list.
+        for (unsigned i = 0; i < samples.size();) {
+            if (!isSampleValid(&samples[i], samples)) {
+                samples[i] = samples[samples.size() - 1];
+                samples.resize(samples.size() - 1);
+            }
+            else ++i;
+        }
 
-                        for (int i = 0; i < part->size()-1; ++i)
-                        {
-                            // AB is a candidate line segment:
-                            const osg::Vec3d& A = (*part)[i];
-                            const osg::Vec3d& B = (*part)[i+1];
-
-                            osg::Vec3d AB = B - A;    // current segment AB
-
-                            double t;                 // parameter [0..1] on segment AB
-                            double D2;                // shortest distance from point P to segment AB, squared
-                            double L2 = AB.length2(); // length (squared) of segment AB
-                            osg::Vec3d AP = P - A;    // vector from endpoint A to point P
-
-                            if (L2 == 0.0)
-                            {
-                                // trivial case: zero-length segment
-                                t = 0.0;
-                                D2 = AP.length2();
-                            }
-                            else
-                            {
-                                // Calculate parameter "t" [0..1] which will yield the closest point on AB to P.
-                                // Clamping it means the closest point won't be beyond the endpoints of the segment.
-                                t = clamp((AP * AB)/L2, 0.0, 1.0);
-
-                                // project our point P onto segment AB:
-                                PROJ.set( A + AB*t );
-
-                                // measure the distance (squared) from P to the projected point on AB:
-                                D2 = (P - PROJ).length2();
-                            }
-
-                            // If the distance from our point to the line segment falls within
-                            // the maximum flattening distance, store it.
-                            if (D2 <= outerRadius2)
-                            {
-                                // see if P is a new sample.
-                                Sample* b;
-                                if (samples.size() < Maxsamples)
-                                {
-                                    // If we haven't collected the maximum number of samples yet,
-                                    // just add this to the list:
-                                    samples.push_back(Sample());
-                                    b = &samples.back();
-                                }
-                                else
-                                {
-                                    // If we are maxed out on samples, find the farthest one we have so far
-                                    // and replace it if the new point is closer:
-                                    unsigned max_i = 0;
-                                    for (unsigned i=1; i<samples.size(); ++i)
-                                        if (samples[i].D2 > samples[max_i].D2)
-                                            max_i = i;
-
-                                    b = &samples[max_i];
-
-                                    if (b->D2 < D2)
-                                        b = 0L;
-                                }
-
-                                if (b)
-                                {
-                                    b->D2 = D2;
-                                    b->A = A;
-                                    b->B = B;
-                                    b->T = t;
-                                    b->innerRadius = innerRadius;
-                                    b->outerRadius = outerRadius;
-                                }
-                            }
-                        }
-                    }
+        // Now that we are done searching for line segments close to our point,
+        // we will collect the elevations at our sample points and use them to 
+        // create a new elevation value for our point.
+        if (samples.size() > 0)
+        {
+            // The original elevation at our point:
+            float elevP = envelope->getElevation(P.x(), P.y());
+            
+            for (unsigned i = 0; i < samples.size(); ++i)
+            {
+                Sample& sample = samples[i];
+
+                sample.D = sqrt(sample.D2);
+
+                // Blend factor. 0 = distance is less than or equal to the inner radius;
+                //               1 = distance is greater than or equal to the outer radius.
+                double blend = clamp(
+                    (sample.D - sample.innerRadius) / (sample.outerRadius - sample.innerRadius),
+                    0.0, 1.0);
+                
+                if (sample.T == 0.0)
+                {
+                    sample.elevPROJ = envelope->getElevation(sample.A.x(), sample.A.y());
+                    if (sample.elevPROJ == NO_DATA_VALUE)
+                        sample.elevPROJ = elevP;
+                }
+                else if (sample.T == 1.0)
+                {
+                    sample.elevPROJ = envelope->getElevation(sample.B.x(), sample.B.y());
+                    if (sample.elevPROJ == NO_DATA_VALUE)
+                        sample.elevPROJ = elevP;
                 }
+                else
+                {
+                    float elevA = envelope->getElevation(sample.A.x(), sample.A.y());
+                    if (elevA == NO_DATA_VALUE)
+                        elevA = elevP;
 
-                // Remove unnecessary sample points that lie on the endpoint of a segment
-                // that abuts another segment in our list.
-                for (unsigned i = 0; i < samples.size();) {
-                    if (!isSampleValid(&samples[i], samples)) {
-                        samples[i] = samples[samples.size() - 1];
-                        samples.resize(samples.size() - 1);
-                    }
-                    else ++i;
+                    float elevB = envelope->getElevation(sample.B.x(), sample.B.y());
+                    if (elevB == NO_DATA_VALUE)
+                        elevB = elevP;
+
+                    // linear interpolation of height from point A to point B on the segment:
+                    sample.elevPROJ = mix(elevA, elevB, sample.T);
                 }
 
-                // Now that we are done searching for line segments close to our point,
-                // we will collect the elevations at our sample points and use them to 
-                // create a new elevation value for our point.
-                if (samples.size() > 0)
-                {
-                    // The original elevation at our point:
-                    float elevP = envelope->getElevation(P.x(), P.y());
-                    
-                    for (unsigned i = 0; i < samples.size(); ++i)
-                    {
-                        Sample& sample = samples[i];
+                // smoothstep interpolation of along the buffer (perpendicular to the segment)
+                // will gently integrate the new value into the existing terrain.
+                sample.elev = smootherstep(sample.elevPROJ, elevP, blend);
+            }
 
-                        sample.D = sqrt(sample.D2);
+            // Finally, combine our new elevation values and set the new value in the output.
+            float finalElev = interpolateSamplesIDW(samples);
+            if (finalElev < FLT_MAX)
+                f.hf->setHeight(col, row, finalElev);
+            else
+                f.hf->setHeight(col, row, elevP);
 
-                        // Blend factor. 0 = distance is less than or equal to the inner radius;
-                        //               1 = distance is greater than or equal to the outer radius.
-                        double blend = clamp(
-                            (sample.D - sample.innerRadius) / (sample.outerRadius - sample.innerRadius),
-                            0.0, 1.0);
-                        
-                        if (sample.T == 0.0)
-                        {
-                            sample.elevPROJ = envelope->getElevation(sample.A.x(), sample.A.y());
-                            if (sample.elevPROJ == NO_DATA_VALUE)
-                                sample.elevPROJ = elevP;
-                        }
-                        else if (sample.T == 1.0)
-                        {
-                            sample.elevPROJ = envelope->getElevation(sample.B.x(), sample.B.y());
-                            if (sample.elevPROJ == NO_DATA_VALUE)
-                                sample.elevPROJ = elevP;
-                        }
-                        else
-                        {
-                            float elevA = envelope->getElevation(sample.A.x(), sample.A.y());
-                            if (elevA == NO_DATA_VALUE)
-                                elevA = elevP;
+            return true;
+        }
 
-                            float elevB = envelope->getElevation(sample.B.x(), sample.B.y());
-                            if (elevB == NO_DATA_VALUE)
-                                elevB = elevP;
+        else if (f.fillAllPixels)
+        {
+            // No close segments were found, so just copy over the source data.
+            float h = envelope->getElevation(P.x(), P.y());
+            f.hf->setHeight(col, row, h);
 
-                            // linear interpolation of height from point A to point B on the segment:
-                            sample.elevPROJ = mix(elevA, elevB, sample.T);
-                        }
+            // Note: do not set wroteChanges to true.
+        }
 
-                        // smoothstep interpolation of along the buffer (perpendicular to the segment)
-                        // will gently integrate the new value into the existing terrain.
-                        sample.elev = smootherstep(sample.elevPROJ, elevP, blend);
-                    }
+        return false;
+    }
+
+    /**
+     * Flattens a band of heightfield rows, on the shared task service or on
+     * the thread that queued it (see JoinableTask).
+     */
+    class FlattenRowsJob : public JoinableTask
+    {
+    public:
+        FlattenRowsJob(const Flattening& f, unsigned firstRow, unsigned numRows) :
+            _f(f), _firstRow(firstRow), _numRows(numRows), _wroteChanges(false) { }
 
-                    // Finally, combine our new elevation values and set the new value in the output.
-                    float finalElev = interpolateSamplesIDW(samples);
-                    if (finalElev < FLT_MAX)
-                        hf->setHeight(col, row, finalElev);
-                    else
-                        hf->setHeight(col, row, elevP);
+        /** Whether the band changed anything; valid once joined. */
+        bool wroteChanges() const { return _wroteChanges; }
 
-                    wroteChanges = true;
-                }
+    private:
+        void execute()
+        {
+            // Envelopes cache the tiles they touch and are not thread-safe,
+            // so each band samples through its own.
+            osg::ref_ptr<ElevationEnvelope> envelope = _f.pool->createEnvelope(_f.srs.get(), _f.lod);
+
+            Samples samples;
+            InternalElevations internal;
+            internal.elev.resize(_f.polygons.size());
+            internal.valid.assign(_f.polygons.size(), false);
 
-                else if (fillAllPixels)
+            unsigned cols = _f.hf->getNumColumns();
+            bool linear = !_f.segments.empty();
+
+            for (unsigned row = _firstRow; row < _firstRow + _numRows; ++row)
+            {
+                // check for cancelation periodically
+                if (_f.progress.valid() && _f.progress->isCanceled())
+                    return;
+
+                for (unsigned col = 0; col < cols; ++col)
                 {
-                    // No close segments were found, so just copy over the source data.
-                    float h = envelope->getElevation(P.x(), P.y());
-                    hf->setHeight(col, row, h);
+                    const POINT& P = _f.points[row*cols + col];
+
+                    bool wrote = linear ?
+                        flattenLineSample(_f, P, col, row, envelope.get(), samples) :
+                        flattenPolygonSample(_f, P, col, row, envelope.get(), internal);
 
-                    // Note: do not set wroteChanges to true.
+                    if (wrote)
+                        _wroteChanges = true;
                 }
             }
         }
 
-        return wroteChanges;
-    }
-    
+        const Flattening&    _f;
+        unsigned             _firstRow;
+        unsigned             _numRows;
+        bool                 _wroteChanges;
+    };
 
+    /**
+     * Flattens the heightfield against the geometry. The segments (or polygons)
+     * are indexed once per tile on a grid over the sample points, so each sample
+     * only tests the geometry within reach of it, and the rows are flattened
+     * in bands in parallel on the shared task service.
+     */
     bool integrate(const TileKey& key, osg::HeightField* hf, const MultiGeometry* geom, const SpatialReference* geomSRS,
-                   WidthsList& widths, ElevationEnvelope* envelope,
+                   WidthsList& widths, ElevationPool* pool, unsigned lod,
                    bool fillAllPixels, ProgressCallback* progress)
     {
+        const GeoExtent& ex = key.getExtent();
+
+        unsigned cols = hf->getNumColumns();
+        unsigned rows = hf->getNumRows();
+
+        double col_interval = ex.width() / (double)(cols-1);
+        double row_interval = ex.height() / (double)(rows-1);
+
+        Flattening f;
+        f.hf = hf;
+        f.numPolygons = 0u;
+        f.pool = pool;
+        f.srs = geomSRS;
+        f.lod = lod;
+        f.fillAllPixels = fillAllPixels;
+        f.progress = progress;
+
+        // Sample points, moved into the working SRS if necessary.
+        f.points.resize(cols*rows);
+        for (unsigned row = 0; row < rows; ++row)
+            for (unsigned col = 0; col < cols; ++col)
+                f.points[row*cols + col].set(ex.xMin() + (double)col * col_interval, ex.yMin() + (double)row * row_interval, 0.0);
+
+        if (ex.getSRS() != geomSRS)
+            ex.getSRS()->transform(f.points, geomSRS);
+
+        double xmin = DBL_MAX, ymin = DBL_MAX, xmax = -DBL_MAX, ymax = -DBL_MAX;
+        for (unsigned i = 0; i < f.points.size(); ++i)
+        {
+            xmin = std::min(xmin, f.points[i].x()), xmax = std::max(xmax, f.points[i].x());
+            ymin = std::min(ymin, f.points[i].y()), ymax = std::max(ymax, f.points[i].y());
+        }
+
+        // About four samples on a side per cell.
+        unsigned gridSize = std::min(64u, std::max(1u, std::max(cols, rows)/4u));
+        f.index.reset(xmin, ymin, xmax, ymax, gridSize, gridSize);
+
         if (geom->isLinear())
-            return integrateLines(key, hf, geom, geomSRS, widths, envelope, fillAllPixels, progress);
+        {
+            // Each segment is indexed by its box, grown by the feature's outer radius.
+            for (unsigned int geomIndex = 0; geomIndex < geom->getNumComponents(); geomIndex++)
+            {
+                Widths w = widths[geomIndex];
+                double innerRadius = w.lineWidth * 0.5;
+                double outerRadius = innerRadius + w.bufferWidth;
+
+                ConstGeometryIterator giter(geom->getComponents()[geomIndex].get());
+                while (giter.hasMore())
+                {
+                    const Geometry* part = giter.next();
+                    for (unsigned i = 0; i+1 < part->size(); ++i)
+                    {
+                        LineSegment segment;
+                        segment.A = (*part)[i];
+                        segment.B = (*part)[i+1];
+                        segment.innerRadius = innerRadius;
+                        segment.outerRadius = outerRadius;
+                        segment.outerRadius2 = outerRadius * outerRadius;
+
+                        bool inRange = f.index.insert(
+                            f.segments.size(),
+                            std::min(segment.A.x(), segment.B.x()) - outerRadius,
+                            std::min(segment.A.y(), segment.B.y()) - outerRadius,
+                            std::max(segment.A.x(), segment.B.x()) + outerRadius,
+                            std::max(segment.A.y(), segment.B.y()) + outerRadius);
+
+                        if (inRange)
+                            f.segments.push_back(segment);
+                    }
+                }
+            }
+
+            if (f.segments.empty() && !fillAllPixels)
+                return false;
+        }
         else
-            return integratePolygons(key, hf, geom, geomSRS, widths, envelope, fillAllPixels, progress);
+        {
+            // Polygons are indexed by their bounds grown by the widest buffer in
+            // the tile. The closest polygon to a sample outside that range is
+            // beyond its own buffer, so the result there is the natural terrain
+            // whichever polygon it is.
+            double maxBufferWidth = 0.0;
+            for (unsigned i = 0; i < widths.size(); ++i)
+                maxBufferWidth = std::max(maxBufferWidth, widths[i].bufferWidth);
+
+            for (unsigned int geomIndex = 0; geomIndex < geom->getNumComponents(); geomIndex++)
+            {
+                ConstGeometryIterator giter(geom->getComponents()[geomIndex].get(), false);
+                while (giter.hasMore())
+                {
+                    const Polygon* polygon = dynamic_cast<const Polygon*>(giter.next());
+                    if (polygon)
+                    {
+                        ++f.numPolygons;
+
+                        const Bounds b = polygon->getBounds();
+                        bool inRange = f.index.insert(
+                            f.polygons.size(),
+                            b.xMin() - maxBufferWidth, b.yMin() - maxBufferWidth,
+                            b.xMax() + maxBufferWidth, b.yMax() + maxBufferWidth);
+
+                        if (inRange)
+                        {
+                            PolygonEntry entry;
+                            entry.polygon = polygon;
+                            entry.bufferWidth = widths[geomIndex].bufferWidth;
+                            entry.internalP = getInternalPoint(polygon);
+                            f.polygons.push_back(entry);
+                        }
+                    }
+                }
+            }
+
+            if (f.numPolygons == 0u && !fillAllPixels)
+                return false;
+        }
+
+        // Flatten the rows in bands, in parallel when the shared service has threads to spare.
+        const unsigned rowsPerJob = 16u;
+        TaskService* service = Registry::instance()->getTaskServiceManager()->getSharedService();
+
+        std::vector< osg::ref_ptr<FlattenRowsJob> > jobs;
+        for (unsigned row = 0; row < rows; row += rowsPerJob)
+        {
+            jobs.push_back(new FlattenRowsJob(f, row, std::min(rowsPerJob, rows - row)));
+            if (service)
+                service->add(jobs.back().get());
+        }
+
+        bool wroteChanges = false;
+        for (unsigned i = 0; i < jobs.size(); ++i)
+        {
+            jobs[i]->join();
+            if (jobs[i]->wroteChanges())
+                wroteChanges = true;
+        }
+
+        return wroteChanges;
     }
 }
 
@@ -974,11 +1140,9 @@ FlatteningLayer::createImplementation(const TileKey& key,
             hf->getFloatArray()->assign(hf->getNumColumns()*hf->getNumRows(), NO_DATA_VALUE);
         }
 
-        // Create an elevation query envelope at the LOD we are creating
-        osg::ref_ptr<ElevationEnvelope> envelope = _pool->createEnvelope(workingSRS, key.getLOD());
-
         bool fill = (options().fill() == true);     
         
-        integrate(key, hf, &geoms, workingSRS, widths, envelope, fill, progress);
+        // Elevation is queried from the pool at the LOD we are creating
+        integrate(key, hf, &geoms, workingSRS, widths, _pool.get(), key.getLOD(), fill, progress);
     }
 }
@@ -227,6 +227,16 @@ std::string WriteTMSTileHandler::getProcessString() const
     return buf.str();
 }
 
+bool WriteTMSTileHandler::getReadStats(TileSource::ReadStats& out) const
+{
+    TileSource* source = _layer->getTileSource();
+    if (!source)
+        return false;
+
+    out = source->getReadStats();
+    return true;
+}
+
 
 /*****************************************************************************************************/
 
@@ -0,0 +1,167 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/CacheRecordCodec>
+#include <osg/Image>
+#include <osg/Shape>
+#include <osg/UserDataContainer>
+#include <cstring>
+
+using namespace osgEarth;
+
+namespace
+{
+    osg::Image* makeImage()
+    {
+        osg::Image* image = new osg::Image();
+        image->allocateImage(16, 16, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+        for(unsigned i=0; i<image->getTotalSizeInBytes(); ++i)
+            image->data()[i] = (unsigned char)(i / 64);
+        return image;
+    }
+
+    osg::HeightField* makeHeightField()
+    {
+        osg::HeightField* hf = new osg::HeightField();
+        hf->allocate(8, 8);
+        for(unsigned i=0; i<hf->getFloatArray()->size(); ++i)
+            (*hf->getFloatArray())[i] = (float)(i % 5);
+        hf->setOrigin(osg::Vec3(1.0f, 2.0f, 0.0f));
+        hf->setXInterval(0.5f);
+        hf->setYInterval(0.25f);
+        return hf;
+    }
+
+    Config makeMeta()
+    {
+        Config meta;
+        meta.add("format", "test");
+        return meta;
+    }
+
+    void checkImage(const CacheRecordCodec& codec)
+    {
+        osg::ref_ptr<osg::Image> source = makeImage();
+        std::string record;
+        REQUIRE(codec.encode(source.get(), makeMeta(), record));
+        REQUIRE(CacheRecordCodec::isRecord(record));
+
+        Config meta;
+        osg::ref_ptr<osg::Object> object;
+        REQUIRE(codec.decode(record, meta, object));
+        REQUIRE(meta.value("format") == "test");
+
+        osg::Image* image = dynamic_cast<osg::Image*>(object.get());
+        REQUIRE(image != 0L);
+        REQUIRE(image->s() == source->s());
+        REQUIRE(image->t() == source->t());
+        REQUIRE(image->getPixelFormat() == source->getPixelFormat());
+        REQUIRE(image->getDataType() == source->getDataType());
+        REQUIRE(::memcmp(image->data(), source->data(), source->getTotalSizeInBytes()) == 0);
+    }
+}
+
+TEST_CASE( "CacheRecordCodec round-trips records" ) {
+
+    SECTION( "raw image" ) {
+        checkImage(CacheRecordCodec(CacheRecordCodec::COMPRESSION_NONE));
+    }
+
+    SECTION( "zlib image" ) {
+        // falls back to no compression in builds without zlib; still has to round-trip
+        checkImage(CacheRecordCodec(CacheRecordCodec::COMPRESSION_ZLIB));
+    }
+
+    SECTION( "heightfield" ) {
+        CacheRecordCodec codec(CacheRecordCodec::COMPRESSION_ZLIB);
+        osg::ref_ptr<osg::HeightField> source = makeHeightField();
+        std::string record;
+        REQUIRE(codec.encode(source.get(), makeMeta(), record));
+
+        Config meta;
+        osg::ref_ptr<osg::Object> object;
+        REQUIRE(codec.decode(record, meta, object));
+
+        osg::HeightField* hf = dynamic_cast<osg::HeightField*>(object.get());
+        REQUIRE(hf != 0L);
+        REQUIRE(hf->getNumColumns() == 8u);
+        REQUIRE(hf->getNumRows() == 8u);
+        REQUIRE(hf->getOrigin() == source->getOrigin());
+        REQUIRE(hf->getXInterval() == 0.5f);
+        REQUIRE(hf->getYInterval() == 0.25f);
+        for(unsigned i=0; i<source->getFloatArray()->size(); ++i)
+            REQUIRE((*hf->getFloatArray())[i] == (*source->getFloatArray())[i]);
+    }
+
+    SECTION( "osgb fallback" ) {
+        // a description is more than the raw format can carry
+        CacheRecordCodec codec;
+        osg::ref_ptr<osg::Image> source = makeImage();
+        source->getOrCreateUserDataContainer()->addDescription("kept");
+        std::string record;
+        REQUIRE(codec.encode(source.get(), makeMeta(), record));
+
+        Config meta;
+        osg::ref_ptr<osg::Object> object;
+        REQUIRE(codec.decode(record, meta, object));
+
+        osg::Image* image = dynamic_cast<osg::Image*>(object.get());
+        REQUIRE(image != 0L);
+        REQUIRE(image->getUserDataContainer() != 0L);
+        REQUIRE(image->getUserDataContainer()->getNumDescriptions() == 1u);
+        REQUIRE(::memcmp(image->data(), source->data(), source->getTotalSizeInBytes()) == 0);
+    }
+}
+
+TEST_CASE( "CacheRecordCodec rejects damaged records" ) {
+
+    CacheRecordCodec codec;
+    osg::ref_ptr<osg::Image> source = makeImage();
+    std::string record;
+    REQUIRE(codec.encode(source.get(), makeMeta(), record));
+
+    Config meta;
+    osg::ref_ptr<osg::Object> object;
+
+    SECTION( "truncated" ) {
+        std::string truncated = record.substr(0, record.size() - 100);
+        REQUIRE_FALSE(codec.decode(truncated, meta, object));
+        REQUIRE_FALSE(object.valid());
+    }
+
+    SECTION( "size larger than the image" ) {
+        // the decoded size follows the header, the metadata and ten image fields
+        unsigned metaSize;
+        ::memcpy(&metaSize, record.data() + 8, sizeof(metaSize));
+        std::size_t sizePos = 12 + metaSize + 10*sizeof(unsigned);
+
+        unsigned long long huge = 1ull << 40;
+        std::string corrupt = record;
+        corrupt.replace(sizePos, sizeof(huge), reinterpret_cast<const char*>(&huge), sizeof(huge));
+
+        // must fail without trying to allocate the claimed size
+        REQUIRE_FALSE(codec.decode(corrupt, meta, object));
+        REQUIRE_FALSE(object.valid());
+    }
+}
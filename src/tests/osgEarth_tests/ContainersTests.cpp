@@ -0,0 +1,124 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/Containers>
+#include <osgEarth/TileKey>
+#include <osgEarth/Registry>
+
+using namespace osgEarth;
+
+TEST_CASE( "ConcurrentLRUCache stores and retrieves values" ) {
+
+    ConcurrentLRUCache<std::string, int> cache(100);
+
+    cache.insert("one", 1);
+    cache.insert("two", 2);
+
+    ConcurrentLRUCache<std::string, int>::Record rec;
+    REQUIRE(cache.get("one", rec));
+    REQUIRE(rec.value() == 1);
+    REQUIRE(cache.has("two"));
+    REQUIRE(!cache.has("three"));
+
+    SECTION("insert replaces an existing value") {
+        cache.insert("one", 11);
+        ConcurrentLRUCache<std::string, int>::Record rec2;
+        REQUIRE(cache.get("one", rec2));
+        REQUIRE(rec2.value() == 11);
+        REQUIRE(cache.getStats()._entries == 2);
+    }
+
+    SECTION("erase removes a value") {
+        cache.erase("one");
+        REQUIRE(!cache.has("one"));
+        REQUIRE(cache.getStats()._entries == 1);
+    }
+
+    SECTION("clear removes everything") {
+        cache.clear();
+        REQUIRE(cache.getStats()._entries == 0);
+    }
+}
+
+TEST_CASE( "ConcurrentLRUCache evicts the least recently used record" ) {
+
+    // single shard, so eviction order is exact
+    ConcurrentLRUCache<int, int> cache(20, 1);
+    for(int i=0; i<20; ++i)
+        cache.insert(i, i);
+
+    // touch the oldest record so it becomes the newest
+    ConcurrentLRUCache<int, int>::Record rec;
+    REQUIRE(cache.get(0, rec));
+
+    // overflow; evicts the oldest 10%
+    cache.insert(100, 100);
+    REQUIRE(cache.has(0));
+    REQUIRE(!cache.has(1));
+    REQUIRE(!cache.has(2));
+    REQUIRE(cache.has(3));
+    REQUIRE(cache.has(100));
+}
+
+TEST_CASE( "ConcurrentLRUCache respects its capacity across shards" ) {
+
+    ConcurrentLRUCache<int, int> cache(256, 8);
+    for(int i=0; i<10000; ++i)
+        cache.insert(i, i);
+
+    REQUIRE(cache.getStats()._entries <= 256);
+    REQUIRE(cache.has(9999));
+}
+
+TEST_CASE( "ConcurrentLRUCache matches TileKeys by location like LRUCache" ) {
+
+    const Profile* profile = Registry::instance()->getGlobalGeodeticProfile();
+
+    ConcurrentLRUCache<TileKey, bool> cache(100);
+    cache.insert(TileKey(5, 10, 12, profile), true);
+
+    REQUIRE(cache.has(TileKey(5, 10, 12, profile)));
+    REQUIRE(cache.has(TileKey(5, 10, 12, 0L))); // profile is ignored, as in operator<
+    REQUIRE(!cache.has(TileKey(5, 12, 10, profile)));
+}
+
+TEST_CASE( "ConcurrentLRUCache evicts against a cost budget" ) {
+
+    ConcurrentLRUCache<int, int> cache(1000, 1);
+    cache.setMaxCost(100);
+
+    for(int i=0; i<50; ++i)
+        cache.insert(i, i, 10);
+
+    REQUIRE(cache.getTotalCost() <= 100);
+    REQUIRE(cache.has(49));
+    REQUIRE(!cache.has(0));
+
+    SECTION("an oversized record displaces everything else but is kept") {
+        cache.insert(1000, 1000, 500);
+        REQUIRE(cache.has(1000));
+        REQUIRE(cache.getStats()._entries == 1);
+        REQUIRE(cache.getTotalCost() == 500);
+    }
+}
@@ -0,0 +1,87 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/EncodedImage>
+#include <osgEarth/MemCache>
+#include <string>
+
+using namespace osgEarth;
+
+namespace
+{
+    std::string bytes(const char* data, unsigned len)
+    {
+        return std::string(data, len) + std::string(32, '\0');
+    }
+}
+
+TEST_CASE( "EncodedImage detects the mime type from the data" ) {
+    REQUIRE(EncodedImage::detectMimeType(bytes("\x89PNG\r\n\x1a\n", 8)) == "image/png");
+    REQUIRE(EncodedImage::detectMimeType(bytes("\xff\xd8\xff\xe0", 4)) == "image/jpeg");
+    REQUIRE(EncodedImage::detectMimeType(bytes("GIF89a", 6)) == "image/gif");
+    REQUIRE(EncodedImage::detectMimeType(bytes("II*\0", 4)) == "image/tiff");
+    REQUIRE(EncodedImage::detectMimeType(bytes("RIFF\0\0\0\0WEBP", 12)) == "image/webp");
+    REQUIRE(EncodedImage::detectMimeType("not an image").empty());
+    REQUIRE(EncodedImage::detectMimeType("").empty());
+}
+
+TEST_CASE( "EncodedImage compares formats by mime type or extension" ) {
+    osg::ref_ptr<EncodedImage> jpeg = new EncodedImage(bytes("\xff\xd8\xff\xe0", 4));
+    REQUIRE(jpeg->valid());
+    REQUIRE(jpeg->isFormat("jpg"));
+    REQUIRE(jpeg->isFormat("JPEG"));
+    REQUIRE(jpeg->isFormat("image/jpeg"));
+    REQUIRE(jpeg->isFormat("image/jpg"));
+    REQUIRE_FALSE(jpeg->isFormat("png"));
+    REQUIRE_FALSE(jpeg->isFormat("image/png"));
+
+    osg::ref_ptr<EncodedImage> unknown = new EncodedImage("not an image");
+    REQUIRE_FALSE(unknown->valid());
+    REQUIRE_FALSE(unknown->isFormat("png"));
+}
+
+TEST_CASE( "CacheBin stores encoded images as is" ) {
+    osg::ref_ptr<MemCache> cache = new MemCache();
+    CacheBin* bin = cache->getOrCreateDefaultBin();
+    REQUIRE(bin != 0L);
+
+    std::string data = bytes("\x89PNG\r\n\x1a\n", 8);
+    osg::ref_ptr<EncodedImage> png = new EncodedImage(data);
+    REQUIRE(bin->writeEncodedImage("tile", png.get(), Config()));
+
+    osg::ref_ptr<EncodedImage> out;
+    REQUIRE(bin->readEncodedImage("tile", out).succeeded());
+    REQUIRE(out.valid());
+    REQUIRE(out->getData() == data);
+    REQUIRE(out->getMimeType() == "image/png");
+
+    SECTION("records that are not encoded images are not found") {
+        osg::ref_ptr<StringObject> str = new StringObject("hello");
+        bin->write("string", str.get(), Config(), 0L);
+
+        osg::ref_ptr<EncodedImage> none;
+        REQUIRE_FALSE(bin->readEncodedImage("string", none).succeeded());
+        REQUIRE_FALSE(none.valid());
+    }
+}
@@ -0,0 +1,173 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarthFeatures/Feature>
+#include <osgEarthSymbology/Expression>
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+using namespace osgEarth::Symbology;
+
+TEST_CASE( "Feature attributes stored in an AttributeSchema" ) {
+
+    osg::ref_ptr<AttributeSchema> schema = new AttributeSchema();
+    REQUIRE(schema->add("height", ATTRTYPE_DOUBLE) == 0u);
+    REQUIRE(schema->add("name", ATTRTYPE_STRING) == 1u);
+    REQUIRE(schema->add("HEIGHT") == 0u);
+    REQUIRE(schema->getOrdinal("Name") == 1);
+    REQUIRE(schema->getOrdinal("missing") == -1);
+
+    osg::ref_ptr<Feature> f = new Feature(0L, 0L);
+    f->set("name", std::string("before"));
+    f->set("extra", 7);
+    f->setSchema(schema.get());
+
+    SECTION("Existing attributes move to ordinal storage") {
+        REQUIRE(f->getValue(1) != 0L);
+        REQUIRE(f->getString("NAME") == "before");
+        REQUIRE(f->getValue(0) == 0L);
+        REQUIRE(!f->hasAttr("height"));
+        REQUIRE(f->getInt("extra") == 7);
+    }
+
+    SECTION("Name and ordinal accessors agree") {
+        f->setValue(0, 12.5);
+        f->set("Name", std::string("after"));
+        REQUIRE(f->getDouble("height") == 12.5);
+        REQUIRE(f->getValue(1)->getString() == "after");
+
+        f->setNullValue(0);
+        REQUIRE(f->hasAttr("height"));
+        REQUIRE(!f->isSet("height"));
+    }
+
+    SECTION("setNull by name keeps the schema type") {
+        f->setNull("height");
+        REQUIRE(f->hasAttr("height"));
+        REQUIRE(!f->isSet("height"));
+        REQUIRE(f->getValue(0)->first == ATTRTYPE_DOUBLE);
+        REQUIRE(f->getAttrs().find("height") != f->getAttrs().end());
+    }
+
+    SECTION("getAttrs includes schema and extra attributes") {
+        f->setValue(0, 3.0);
+        const AttributeTable& attrs = f->getAttrs();
+        REQUIRE(attrs.size() == 3u);
+        REQUIRE(attrs.find("height")->second.getDouble() == 3.0);
+        REQUIRE(attrs.find("extra")->second.getInt() == 7);
+    }
+
+    SECTION("Removing the schema keeps the attributes") {
+        f->setValue(0, 4.0);
+        f->setSchema(0L);
+        REQUIRE(f->getDouble("height") == 4.0);
+        REQUIRE(f->getString("name") == "before");
+        REQUIRE(f->getAttrs().size() == 3u);
+    }
+
+    SECTION("Expressions evaluate against schema and extra attributes") {
+        f->setValue(0, 10.0);
+        NumericExpression expr("[height] * 2 + [extra]");
+        REQUIRE(f->eval(expr, (Session*)0L) == 27.0);
+
+        // the binding is cached, and refreshed for a different schema:
+        REQUIRE(expr.binding().schemaID == schema->getID());
+        osg::ref_ptr<Feature> g = new Feature(0L, 0L);
+        g->set("height", 1.0);
+        g->set("extra", 1);
+        REQUIRE(g->eval(expr, (Session*)0L) == 3.0);
+        REQUIRE(f->eval(expr, (Session*)0L) == 27.0);
+
+        StringExpression label("[name]");
+        REQUIRE(f->eval(label, (Session*)0L) == "before");
+    }
+}
+
+TEST_CASE( "Expressions evaluate with explicit variable values" ) {
+
+    NumericExpression expr("[a] * [b] + 10 % 4");
+    REQUIRE(expr.variables().size() == 2u);
+
+    double values[2] = { 3.0, 5.0 };
+    REQUIRE(expr.eval(values) == 17.0);
+
+    // set() and eval() agree with the compiled form:
+    expr.set(expr.variables()[0], 7.0);
+    expr.set(expr.variables()[1], 1.0);
+    REQUIRE(expr.eval() == 9.0);
+    REQUIRE(expr.eval(values) == 17.0);
+    REQUIRE(expr.eval() == 9.0);
+
+    NumericExpression maxExpr("max([a], [b])");
+    REQUIRE(maxExpr.eval(values) == 5.0);
+
+    // dangling operators are ignored, as before:
+    NumericExpression partial("* 4");
+    REQUIRE(partial.eval() == 4.0);
+
+    StringExpression label("\"Name: \" + [name] + \" (\" + [id] + \")\"");
+    std::string strings[2] = { "Main St", "12" };
+    REQUIRE(label.eval(strings) == "Name: Main St (12)");
+
+    // interleaving the two forms leaves the set() result alone:
+    label.set("name", std::string("Elm St"));
+    label.set("id", std::string("3"));
+    const std::string& cached = label.eval();
+    REQUIRE(cached == "Name: Elm St (3)");
+    REQUIRE(label.eval(strings) == "Name: Main St (12)");
+    REQUIRE(cached == "Name: Elm St (3)");
+    REQUIRE(label.eval() == "Name: Elm St (3)");
+    REQUIRE(label.eval(strings) == "Name: Main St (12)");
+}
+
+TEST_CASE( "Feature::evalAll evaluates an expression over a FeatureList" ) {
+
+    osg::ref_ptr<AttributeSchema> schema = new AttributeSchema();
+    schema->add("height", ATTRTYPE_DOUBLE);
+
+    FeatureList features;
+    for(int i=0; i<10; ++i)
+    {
+        Feature* f = new Feature(0L, 0L);
+        if (i % 2 == 0)
+            f->setSchema(schema.get());
+        f->set("height", (double)i);
+        features.push_back(f);
+    }
+
+    NumericExpression expr("[height] * 3");
+    std::vector<double> heights;
+    Feature::evalAll(expr, features, heights);
+    REQUIRE(heights.size() == features.size());
+    for(unsigned i=0; i<heights.size(); ++i)
+        REQUIRE(heights[i] == 3.0*(double)i);
+
+    StringExpression label("[height]");
+    std::vector<std::string> labels;
+    Feature::evalAll(label, features, labels);
+    REQUIRE(labels.size() == features.size());
+    unsigned i = 0;
+    for(FeatureList::const_iterator f = features.begin(); f != features.end(); ++f, ++i)
+        REQUIRE(labels[i] == f->get()->getString("height"));
+}
@@ -0,0 +1,76 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/Cache>
+#include <osgEarthDrivers/cache_filesystem/FileSystemCache>
+#include <osg/Shape>
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers;
+
+namespace
+{
+    osg::HeightField* makeHeightField(float value)
+    {
+        osg::HeightField* hf = new osg::HeightField();
+        hf->allocate(4, 4);
+        for(unsigned i=0; i<hf->getFloatArray()->size(); ++i)
+            (*hf->getFloatArray())[i] = value;
+        return hf;
+    }
+}
+
+TEST_CASE( "FileSystemCache write-behind keeps its own copy of each record" ) {
+
+    FileSystemCacheOptions options;
+    options.rootPath() = "osgEarth_tests_fscache";
+    options.writeBehind() = true;
+
+    osg::ref_ptr<Cache> cache = CacheFactory::create(options);
+    REQUIRE(cache.valid());
+    CacheBin* bin = cache->getOrCreateDefaultBin();
+    REQUIRE(bin != 0L);
+    bin->clear();
+
+    osg::ref_ptr<osg::HeightField> source = makeHeightField(1.0f);
+    REQUIRE(bin->write("hf", source.get(), Config(), 0L));
+
+    // changing the source after write() returns must not reach the cache,
+    // whether or not the record has been written out yet:
+    source->setHeight(0, 0, 99.0f);
+
+    osg::ref_ptr<osg::HeightField> out = bin->readObject("hf", 0L).release<osg::HeightField>();
+    REQUIRE(out.valid());
+    REQUIRE(out.get() != source.get());
+    REQUIRE(out->getHeight(0, 0) == 1.0f);
+
+    // nor does changing what a read returned:
+    out->setHeight(0, 0, 42.0f);
+
+    osg::ref_ptr<osg::HeightField> again = bin->readObject("hf", 0L).release<osg::HeightField>();
+    REQUIRE(again.valid());
+    REQUIRE(again->getHeight(0, 0) == 1.0f);
+
+    bin->clear();
+}
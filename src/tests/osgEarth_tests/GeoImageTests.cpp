@@ -0,0 +1,160 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/GeoData>
+#include <osgEarth/Registry>
+#include <osgEarth/ImageUtils>
+#include <osgEarth/TileKey>
+#include <cstdlib>
+
+using namespace osgEarth;
+
+namespace
+{
+    // A smooth gradient (one level per pixel in R and G), so a sampling
+    // error of e pixels shows up as a color error of about e.
+    osg::Image* makeGradient(unsigned size)
+    {
+        osg::Image* image = new osg::Image();
+        image->allocateImage(size, size, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+        for(unsigned t=0; t<size; ++t)
+        {
+            for(unsigned s=0; s<size; ++s)
+            {
+                unsigned char* p = image->data(s, t);
+                p[0] = s, p[1] = t, p[2] = (s+t)/2, p[3] = 255;
+            }
+        }
+        return image;
+    }
+
+    struct Difference
+    {
+        int maxColor;           // largest channel difference where both are covered
+        double meanColor;       // mean channel difference where both are covered
+        unsigned coverage;      // pixels covered in one image but not the other
+    };
+
+    Difference compare(const osg::Image* a, const osg::Image* b)
+    {
+        Difference d;
+        d.maxColor = 0, d.meanColor = 0.0, d.coverage = 0;
+        unsigned count = 0;
+        for(int t=0; t<a->t(); ++t)
+        {
+            for(int s=0; s<a->s(); ++s)
+            {
+                const unsigned char* pa = a->data(s, t);
+                const unsigned char* pb = b->data(s, t);
+                if ((pa[3] == 0) != (pb[3] == 0))
+                {
+                    ++d.coverage;
+                    continue;
+                }
+                for(unsigned k=0; k<3; ++k)
+                {
+                    int diff = abs((int)pa[k] - (int)pb[k]);
+                    d.maxColor = std::max(d.maxColor, diff);
+                    d.meanColor += diff;
+                    ++count;
+                }
+            }
+        }
+        if (count > 0)
+            d.meanColor /= (double)count;
+        return d;
+    }
+
+    osg::ref_ptr<osg::Image> reproject(const GeoImage& source, const GeoExtent& dest, const GeoImage::WarpOptions& options)
+    {
+        GeoImage::WarpOptions saved = GeoImage::getWarpOptions();
+        GeoImage::setWarpOptions(options);
+        GeoImage result = source.reproject(dest.getSRS(), &dest, 256, 256, true);
+        GeoImage::setWarpOptions(saved);
+        return result.getImage();
+    }
+}
+
+TEST_CASE( "GeoImage reprojection through a sparse warp grid stays close to the exact path" ) {
+
+    const Profile* mercator = Registry::instance()->getSphericalMercatorProfile();
+    const Profile* geodetic = Registry::instance()->getGlobalGeodeticProfile();
+
+    GeoImage::WarpOptions exact;
+    exact.spacing = 1u;
+
+    GeoImage::WarpOptions sparse;
+    sparse.spacing = 16u;
+    sparse.maxError = 0.125;
+
+    SECTION("a mid-latitude tile") {
+        TileKey key = mercator->createTileKey(10.0, 45.0, 6);
+        GeoImage source(makeGradient(256), key.getExtent());
+        GeoExtent dest = key.getExtent().transform(geodetic->getSRS());
+
+        osg::ref_ptr<osg::Image> a = reproject(source, dest, exact);
+        osg::ref_ptr<osg::Image> b = reproject(source, dest, sparse);
+        REQUIRE(a.valid());
+        REQUIRE(b.valid());
+
+        Difference d = compare(a.get(), b.get());
+        INFO("max color error " << d.maxColor << ", mean " << d.meanColor << ", coverage mismatches " << d.coverage);
+        REQUIRE(d.maxColor <= 1);
+        REQUIRE(d.meanColor < 0.1);
+        REQUIRE(d.coverage == 0u);
+    }
+
+    SECTION("the whole world, where the warp is strongest") {
+        GeoImage source(makeGradient(256), mercator->getExtent());
+        GeoExtent dest(geodetic->getSRS(), -180.0, -85.0, 180.0, 85.0);
+
+        osg::ref_ptr<osg::Image> a = reproject(source, dest, exact);
+        osg::ref_ptr<osg::Image> b = reproject(source, dest, sparse);
+        REQUIRE(a.valid());
+        REQUIRE(b.valid());
+
+        Difference d = compare(a.get(), b.get());
+        INFO("max color error " << d.maxColor << ", mean " << d.meanColor << ", coverage mismatches " << d.coverage);
+        REQUIRE(d.maxColor <= 1);
+        REQUIRE(d.meanColor < 0.1);
+        REQUIRE(d.coverage <= 256u);
+    }
+
+    SECTION("a zero error bound reproduces the exact path") {
+        GeoImage source(makeGradient(256), mercator->getExtent());
+        GeoExtent dest(geodetic->getSRS(), -180.0, -85.0, 180.0, 85.0);
+
+        GeoImage::WarpOptions strict;
+        strict.spacing = 16u;
+        strict.maxError = 0.0;
+
+        osg::ref_ptr<osg::Image> a = reproject(source, dest, exact);
+        osg::ref_ptr<osg::Image> b = reproject(source, dest, strict);
+
+        Difference d = compare(a.get(), b.get());
+        INFO("max color error " << d.maxColor << ", mean " << d.meanColor << ", coverage mismatches " << d.coverage);
+        REQUIRE(d.maxColor <= 1);
+        REQUIRE(d.coverage == 0u);
+    }
+}
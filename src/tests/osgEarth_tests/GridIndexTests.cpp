@@ -0,0 +1,108 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarthUtil/GridIndex>
+#include <osg/Vec3d>
+#include <algorithm>
+#include <vector>
+
+using namespace osgEarth::Util;
+
+namespace
+{
+    struct Segment
+    {
+        Segment(double ax, double ay, double bx, double by, double radius) :
+            A(ax, ay, 0.0), B(bx, by, 0.0), radius(radius) { }
+        osg::Vec3d A, B;
+        double radius;
+    };
+
+    // What the every-segment scan in the flattening layer tests: is P within
+    // the segment's outer radius?
+    bool inReach(const osg::Vec3d& P, const Segment& s)
+    {
+        osg::Vec3d AP = P - s.A, AB = s.B - s.A;
+        double t = AB.length2() > 0.0 ? std::min(std::max((AP*AB)/AB.length2(), 0.0), 1.0) : 0.0;
+        osg::Vec3d PROJ = s.A + AB*t;
+        return (P - PROJ).length2() <= s.radius*s.radius;
+    }
+}
+
+TEST_CASE( "GridIndex finds every segment the full scan finds, edge samples included" ) {
+
+    // Sample points of a small heightfield, laid out the way the flattening
+    // layer lays them out, with the bounds taken from the extreme samples.
+    const unsigned cols = 17, rows = 13;
+    const double xmin = 10.0, ymin = 30.0, xmax = 20.0, ymax = 37.0;
+    std::vector<osg::Vec3d> points;
+    for (unsigned r = 0; r < rows; ++r)
+        for (unsigned c = 0; c < cols; ++c)
+            points.push_back(osg::Vec3d(xmin + c*(xmax-xmin)/(cols-1), ymin + r*(ymax-ymin)/(rows-1), 0.0));
+
+    std::vector<Segment> segments;
+    segments.push_back(Segment(11.0, 31.0, 19.0, 36.0, 0.5));   // across the middle
+    segments.push_back(Segment(20.0, 30.0, 20.0, 37.0, 0.3));   // along the last column
+    segments.push_back(Segment(10.0, 37.0, 20.0, 37.0, 0.3));   // along the last row
+    segments.push_back(Segment(20.5, 37.5, 22.0, 39.0, 0.75));  // outside, reaching the far corner
+    segments.push_back(Segment(25.0, 25.0, 26.0, 26.0, 0.5));   // out of reach
+
+    GridIndex index;
+    index.reset(xmin, ymin, xmax, ymax, 4, 3);
+    for (unsigned i = 0; i < segments.size(); ++i)
+    {
+        const Segment& s = segments[i];
+        index.insert(i,
+            std::min(s.A.x(), s.B.x()) - s.radius, std::min(s.A.y(), s.B.y()) - s.radius,
+            std::max(s.A.x(), s.B.x()) + s.radius, std::max(s.A.y(), s.B.y()) + s.radius);
+    }
+
+    unsigned edgeHits = 0;
+    for (unsigned p = 0; p < points.size(); ++p)
+    {
+        const std::vector<unsigned>& candidates = index.query(points[p].x(), points[p].y());
+
+        // candidates come in insertion order, like the scan:
+        for (unsigned k = 1; k < candidates.size(); ++k)
+            REQUIRE(candidates[k-1] < candidates[k]);
+
+        for (unsigned i = 0; i < segments.size(); ++i)
+        {
+            if (inReach(points[p], segments[i]))
+            {
+                REQUIRE(std::find(candidates.begin(), candidates.end(), i) != candidates.end());
+                if (points[p].x() == xmax || points[p].y() == ymax)
+                    ++edgeHits;
+            }
+        }
+    }
+
+    // the last column and row did see segments:
+    REQUIRE(edgeHits > 0u);
+
+    // and only points outside the bounds fall outside the grid:
+    REQUIRE(index.query(xmax, ymax).size() > 0u);
+    REQUIRE(index.query(xmax + 1.0, ymax).empty());
+    REQUIRE(index.query(xmin - 1.0, ymin).empty());
+}
@@ -0,0 +1,174 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/HTTPClient>
+#include <osgEarth/Registry>
+#include <OpenThreads/Atomic>
+#include <OpenThreads/Thread>
+
+#ifndef _WIN32
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <string.h>
+
+using namespace osgEarth;
+
+namespace
+{
+    // Minimal single-threaded HTTP/1.0 server on the loopback interface.
+    // Each response body is the request path; every request is counted.
+    class LocalHTTPServer : public OpenThreads::Thread
+    {
+    public:
+        LocalHTTPServer(unsigned delayMS) : _delayMS(delayMS), _port(0), _socket(-1)
+        {
+            _socket = ::socket(AF_INET, SOCK_STREAM, 0);
+            int on = 1;
+            ::setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+            sockaddr_in addr;
+            ::memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            addr.sin_port = 0;
+            ::bind(_socket, (sockaddr*)&addr, sizeof(addr));
+            ::listen(_socket, 128);
+
+            socklen_t len = sizeof(addr);
+            ::getsockname(_socket, (sockaddr*)&addr, &len);
+            _port = ntohs(addr.sin_port);
+            start();
+        }
+
+        ~LocalHTTPServer()
+        {
+            ::shutdown(_socket, SHUT_RDWR);
+            ::close(_socket);
+            join();
+        }
+
+        std::string url(const std::string& path) const
+        {
+            std::stringstream buf;
+            buf << "http://127.0.0.1:" << _port << path;
+            return buf.str();
+        }
+
+        unsigned hits() const { return _hits; }
+
+        void run()
+        {
+            while (true)
+            {
+                int client = ::accept(_socket, 0L, 0L);
+                if (client < 0)
+                    break;
+
+                std::string request;
+                char buf[1024];
+                while (request.find("\r\n\r\n") == std::string::npos)
+                {
+                    ssize_t n = ::recv(client, buf, sizeof(buf), 0);
+                    if (n <= 0) break;
+                    request.append(buf, n);
+                }
+
+                ++_hits;
+                if (_delayMS > 0)
+                    OpenThreads::Thread::microSleep(_delayMS * 1000);
+
+                std::string path = request.substr(4, request.find(' ', 4) - 4);
+                std::stringstream out;
+                out << "HTTP/1.0 200 OK\r\n"
+                    << "Content-Type: text/plain\r\n"
+                    << "Content-Length: " << path.length() << "\r\n"
+                    << "Connection: close\r\n\r\n"
+                    << path;
+                std::string response = out.str();
+                ::send(client, response.c_str(), response.length(), 0);
+                ::close(client);
+            }
+        }
+
+    private:
+        unsigned _delayMS;
+        unsigned short _port;
+        int _socket;
+        OpenThreads::Atomic _hits;
+    };
+}
+
+TEST_CASE( "HTTPClient::getAsync coalesces identical requests" ) {
+
+    Registry::instance();
+    LocalHTTPServer server(250u);
+
+    std::vector< Threading::Future<HTTPResponse> > results;
+    for (unsigned i = 0; i < 16; ++i)
+        results.push_back(HTTPClient::getAsync(HTTPRequest(server.url("/same"))));
+
+    for (unsigned i = 0; i < results.size(); ++i)
+    {
+        HTTPResponse* response = results[i].get();
+        REQUIRE(response != 0L);
+        REQUIRE(response->isOK());
+        REQUIRE(response->getPartAsString(0) == "/same");
+    }
+
+    REQUIRE(server.hits() == 1u);
+}
+
+TEST_CASE( "HTTPClient::getAsync completes many distinct requests" ) {
+
+    Registry::instance();
+    LocalHTTPServer server(0u);
+
+    const unsigned num = 200u;
+    std::vector< Threading::Future<HTTPResponse> > results;
+    for (unsigned i = 0; i < num; ++i)
+    {
+        std::stringstream path;
+        path << "/tile/" << i;
+        results.push_back(HTTPClient::getAsync(HTTPRequest(server.url(path.str()))));
+    }
+
+    unsigned ok = 0;
+    for (unsigned i = 0; i < results.size(); ++i)
+    {
+        HTTPResponse* response = results[i].get();
+        std::stringstream path;
+        path << "/tile/" << i;
+        if (response && response->isOK() && response->getPartAsString(0) == path.str())
+            ++ok;
+    }
+
+    REQUIRE(ok == num);
+    REQUIRE(server.hits() == num);
+}
+
+#endif // _WIN32
@@ -24,12 +24,84 @@
 
 #include <osgEarth/ImageLayer>
 #include <osgEarth/Registry>
+#include <osgEarth/EncodedImage>
+#include <osgEarth/MemCache>
+#include <osgDB/ReaderWriter>
+#include <sstream>
+#include <cstring>
 
 #include <osgEarthDrivers/gdal/GDALOptions>
 
 using namespace osgEarth;
 using namespace osgEarth::Drivers;
 
+namespace
+{
+    // Serves every tile as the same PNG, decoded or encoded, and counts the requests.
+    class EncodedTileSource : public TileSource
+    {
+    public:
+        EncodedTileSource(const TileSourceOptions& options =TileSourceOptions()) :
+            TileSource(options), _imageRequests(0), _encodedRequests(0)
+        {
+            osg::ref_ptr<osg::Image> image = new osg::Image();
+            image->allocateImage(256, 256, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+            memset(image->data(), 0x80, image->getTotalSizeInBytes());
+
+            osgDB::ReaderWriter* rw = osgDB::Registry::instance()->getReaderWriterForExtension("png");
+            std::stringstream buf;
+            if ( rw && rw->writeImage(*image.get(), buf).success() )
+                _png = buf.str();
+        }
+
+        Status initialize(const osgDB::Options* readOptions)
+        {
+            setProfile( Registry::instance()->getGlobalGeodeticProfile() );
+            return _png.empty() ? Status::Error("no png plugin") : STATUS_OK;
+        }
+
+        osg::Image* createImage(const TileKey& key, ProgressCallback* progress)
+        {
+            ++_imageRequests;
+            EncodedImage encoded(_png);
+            return encoded.decode();
+        }
+
+        bool supportsEncodedImages() const { return true; }
+
+        EncodedImage* createEncodedImage(const TileKey& key, ProgressCallback* progress)
+        {
+            ++_encodedRequests;
+            return new EncodedImage(_png);
+        }
+
+        std::string _png;
+        unsigned    _imageRequests;
+        unsigned    _encodedRequests;
+    };
+
+    // An open layer over "source", caching to its own memory cache.
+    ImageLayer* openLayer(EncodedTileSource* source, bool passthrough, bool sharedL2 =false)
+    {
+        REQUIRE(source->open().isOK());
+
+        ImageLayerOptions options("encoded");
+        options.cachePassthrough() = passthrough;
+        options.driver() = TileSourceOptions();
+        options.driver()->L2CacheShared() = sharedL2;
+        ImageLayer* layer = new ImageLayer(options, source);
+
+        osg::ref_ptr<osgDB::Options> readOptions = Registry::instance()->cloneOrCreateOptions();
+        osg::ref_ptr<CacheSettings> cacheSettings = new CacheSettings();
+        cacheSettings->setCache(new MemCache());
+        cacheSettings->store(readOptions.get());
+        layer->setReadOptions(readOptions.get());
+
+        REQUIRE(layer->open().isOK());
+        return layer;
+    }
+}
+
 TEST_CASE( "ImageLayers can be created from TileSourceOptions" ) {
 
     GDALOptions opt;
@@ -57,3 +129,83 @@ TEST_CASE( "ImageLayers can be created from TileSourceOptions" ) {
         REQUIRE(image.getExtent() == key.getExtent());
     }
 }
+
+TEST_CASE( "ImageLayer::createEncodedImage reads through the cache" ) {
+
+    osg::ref_ptr<EncodedTileSource> source = new EncodedTileSource();
+    osg::ref_ptr<ImageLayer> layer = openLayer(source.get(), false);
+    TileKey key(1, 0, 0, layer->getProfile());
+    REQUIRE(layer->canCreateEncodedImage(key));
+
+    osg::ref_ptr<EncodedImage> first = layer->createEncodedImage(key);
+    REQUIRE(first.valid());
+    REQUIRE(first->getData() == source->_png);
+    REQUIRE(source->_encodedRequests == 1u);
+
+    // a decoded image for the same key has a record of its own...
+    GeoImage image = layer->createImage(key);
+    REQUIRE(image.valid());
+    REQUIRE(source->_imageRequests == 1u);
+
+    // ...and leaves the encoded record alone:
+    osg::ref_ptr<EncodedImage> second = layer->createEncodedImage(key);
+    REQUIRE(second.valid());
+    REQUIRE(second->getData() == source->_png);
+    REQUIRE(source->_encodedRequests == 1u);
+}
+
+TEST_CASE( "ImageLayer cache_passthrough decodes the cached encoding" ) {
+
+    osg::ref_ptr<EncodedTileSource> source = new EncodedTileSource();
+    osg::ref_ptr<ImageLayer> layer = openLayer(source.get(), true);
+    TileKey key(1, 1, 0, layer->getProfile());
+
+    GeoImage image = layer->createImage(key);
+    REQUIRE(image.valid());
+    REQUIRE(image.getImage()->s() == 256);
+    REQUIRE(image.getImage()->t() == 256);
+    REQUIRE(image.getExtent() == key.getExtent());
+
+    // the pixels came from the encoded tile, never from createImage:
+    REQUIRE(source->_encodedRequests == 1u);
+    REQUIRE(source->_imageRequests == 0u);
+
+    // and the second request is served by the cache:
+    REQUIRE(layer->createImage(key).valid());
+    REQUIRE(source->_encodedRequests == 1u);
+    REQUIRE(source->_imageRequests == 0u);
+}
+
+TEST_CASE( "ImageLayer L2 cache hands out private copies" ) {
+
+    TileSourceOptions sourceOptions;
+    sourceOptions.L2CacheShared() = true;
+    osg::ref_ptr<EncodedTileSource> source = new EncodedTileSource(sourceOptions);
+    osg::ref_ptr<ImageLayer> layer = openLayer(source.get(), false, true);
+    TileKey key(1, 0, 0, layer->getProfile());
+
+    SECTION("from the layer") {
+        GeoImage first = layer->createImage(key);
+        REQUIRE(first.valid());
+        memset(first.getImage()->data(), 0x00, first.getImage()->getTotalSizeInBytes());
+
+        GeoImage second = layer->createImage(key);
+        REQUIRE(second.valid());
+        REQUIRE(second.getImage() != first.getImage());
+        REQUIRE(second.getImage()->data()[0] == 0x80);
+        REQUIRE(source->_imageRequests == 1u);
+    }
+
+    SECTION("from the tile source") {
+        TileSource* tileSource = source.get();
+        osg::ref_ptr<osg::Image> first = tileSource->createImage(key, 0L, 0L);
+        REQUIRE(first.valid());
+        memset(first->data(), 0x00, first->getTotalSizeInBytes());
+
+        osg::ref_ptr<osg::Image> second = tileSource->createImage(key, 0L, 0L);
+        REQUIRE(second.valid());
+        REQUIRE(second.get() != first.get());
+        REQUIRE(second->data()[0] == 0x80);
+        REQUIRE(source->_imageRequests == 1u);
+    }
+}
@@ -0,0 +1,105 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/TileSource>
+#include <osgEarth/EncodedImage>
+#include <osgEarth/Registry>
+#include <osgEarthDrivers/mbtiles/MBTilesOptions>
+#include <OpenThreads/Thread>
+#include <cstdio>
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers;
+
+namespace
+{
+    const char* FILENAME = "osgEarth_tests_batch.mbtiles";
+
+    std::string pngBytes()
+    {
+        return std::string("\x89PNG\r\n\x1a\n", 8) + std::string(32, '\0');
+    }
+
+    TileSource* openSource(const TileSource::Mode& mode, unsigned batchSize, unsigned batchInterval)
+    {
+        MBTilesTileSourceOptions options;
+        options.filename() = FILENAME;
+        options.format() = "png";
+        options.profile() = ProfileOptions("global-geodetic");
+        options.writeBatchSize() = batchSize;
+        options.writeBatchInterval() = batchInterval;
+
+        TileSource* source = TileSourceFactory::create(options);
+        if ( source && source->open(mode).isError() )
+        {
+            osg::ref_ptr<TileSource> deleteMe = source;
+            return 0L;
+        }
+        return source;
+    }
+
+    bool readable(const TileKey& key)
+    {
+        osg::ref_ptr<TileSource> reader = openSource(TileSource::MODE_READ, 1u, 1000u);
+        if ( !reader.valid() )
+            return false;
+        osg::ref_ptr<EncodedImage> tile = reader->createEncodedImage(key, 0L);
+        return tile.valid();
+    }
+}
+
+TEST_CASE( "MBTiles commits an idle write batch on its interval" ) {
+    ::remove(FILENAME);
+
+    osg::ref_ptr<TileSource> writer = openSource(TileSource::MODE_WRITE | TileSource::MODE_CREATE, 1000u, 50u);
+    REQUIRE(writer.valid());
+
+    TileKey key(0, 0, 0, writer->getProfile());
+    osg::ref_ptr<EncodedImage> tile = new EncodedImage(pngBytes());
+    REQUIRE(writer->storeEncodedImage(key, tile.get(), 0L));
+
+    // the batch is far from full and no more writes arrive; the timer commits it:
+    OpenThreads::Thread::microSleep(500000);
+    REQUIRE(readable(key));
+
+    writer = 0L;
+    ::remove(FILENAME);
+}
+
+TEST_CASE( "MBTiles flush commits a partial write batch" ) {
+    ::remove(FILENAME);
+
+    osg::ref_ptr<TileSource> writer = openSource(TileSource::MODE_WRITE | TileSource::MODE_CREATE, 1000u, 3600000u);
+    REQUIRE(writer.valid());
+
+    TileKey key(0, 1, 0, writer->getProfile());
+    osg::ref_ptr<EncodedImage> tile = new EncodedImage(pngBytes());
+    REQUIRE(writer->storeEncodedImage(key, tile.get(), 0L));
+
+    REQUIRE(writer->flush());
+    REQUIRE(readable(key));
+
+    writer = 0L;
+    ::remove(FILENAME);
+}
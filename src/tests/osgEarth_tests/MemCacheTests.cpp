@@ -0,0 +1,90 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/MemCache>
+#include <osg/Shape>
+
+using namespace osgEarth;
+
+namespace
+{
+    osg::HeightField* makeHeightField(float value)
+    {
+        osg::HeightField* hf = new osg::HeightField();
+        hf->allocate(4, 4);
+        for(unsigned i=0; i<hf->getFloatArray()->size(); ++i)
+            (*hf->getFloatArray())[i] = value;
+        return hf;
+    }
+}
+
+TEST_CASE( "MemCache copies on every read and write by default" ) {
+
+    osg::ref_ptr<MemCache> cache = new MemCache();
+    CacheBin* bin = cache->getOrCreateDefaultBin();
+
+    osg::ref_ptr<osg::HeightField> source = makeHeightField(1.0f);
+    REQUIRE(bin->write("hf", source.get(), Config(), 0L));
+
+    // changing the source after the write does not reach the cache:
+    source->setHeight(0, 0, 99.0f);
+
+    ReadResult r = bin->readObject("hf", 0L);
+    REQUIRE(r.succeeded());
+    osg::ref_ptr<osg::HeightField> out = r.release<osg::HeightField>();
+    REQUIRE(out.get() != source.get());
+    REQUIRE(out->getHeight(0, 0) == 1.0f);
+}
+
+TEST_CASE( "MemCache shared mode keeps shared reads and private copies apart" ) {
+
+    osg::ref_ptr<MemCache> cache = new MemCache();
+    cache->setShareObjects(true);
+    CacheBin* bin = cache->getOrCreateDefaultBin();
+
+    osg::ref_ptr<osg::HeightField> source = makeHeightField(1.0f);
+    REQUIRE(bin->write("hf", source.get(), Config(), cache->getCopyOptions()));
+
+    // a copying write detaches the cached object from the source:
+    source->setHeight(0, 0, 99.0f);
+
+    osg::ref_ptr<osg::HeightField> shared1 = bin->readObject("hf", 0L).release<osg::HeightField>();
+    osg::ref_ptr<osg::HeightField> shared2 = bin->readObject("hf", 0L).release<osg::HeightField>();
+    REQUIRE(shared1.valid());
+    REQUIRE(shared1.get() == shared2.get());
+    REQUIRE(shared1->getHeight(0, 0) == 1.0f);
+
+    // a private copy can be modified without touching the shared object:
+    osg::ref_ptr<osg::HeightField> copy = bin->readObject("hf", cache->getCopyOptions()).release<osg::HeightField>();
+    REQUIRE(copy.valid());
+    REQUIRE(copy.get() != shared1.get());
+    copy->setHeight(0, 0, 42.0f);
+
+    osg::ref_ptr<osg::HeightField> shared3 = bin->readObject("hf", 0L).release<osg::HeightField>();
+    REQUIRE(shared3->getHeight(0, 0) == 1.0f);
+
+    // a sharing write keeps the caller's object itself:
+    REQUIRE(bin->write("hf2", source.get(), Config(), 0L));
+    REQUIRE(bin->readObject("hf2", 0L).release<osg::HeightField>() == source.get());
+}
@@ -0,0 +1,110 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/ScreenSpaceLayout>
+#include <osgEarth/Random>
+#include <vector>
+
+using namespace osgEarth;
+
+namespace
+{
+    struct OwnedBox
+    {
+        osg::BoundingBox box;
+        const void*      owner;
+    };
+
+    bool bruteForceOverlaps(const std::vector<OwnedBox>& used, const osg::BoundingBox& box, const void* owner)
+    {
+        for(unsigned i=0; i<used.size(); ++i)
+        {
+            bool isClear =
+                box.xMin() > used[i].box.xMax() ||
+                box.xMax() < used[i].box.xMin() ||
+                box.yMin() > used[i].box.yMax() ||
+                box.yMax() < used[i].box.yMin();
+            if (!isClear && owner != used[i].owner)
+                return true;
+        }
+        return false;
+    }
+}
+
+TEST_CASE( "ScreenSpaceOccupancyGrid" ) {
+
+    ScreenSpaceOccupancyGrid grid;
+    grid.reset(0.0f, 0.0f, 800.0f, 600.0f, 64.0f);
+
+    SECTION("Touching edges overlap") {
+        grid.insert(osg::BoundingBox(100, 100, 0, 200, 120, 0), (void*)1);
+        REQUIRE(grid.overlaps(osg::BoundingBox(200, 120, 0, 260, 140, 0), (void*)2));
+        REQUIRE(!grid.overlaps(osg::BoundingBox(201, 100, 0, 260, 120, 0), (void*)2));
+    }
+
+    SECTION("Same owner never conflicts") {
+        grid.insert(osg::BoundingBox(100, 100, 0, 200, 120, 0), (void*)1);
+        REQUIRE(!grid.overlaps(osg::BoundingBox(150, 110, 0, 250, 130, 0), (void*)1));
+    }
+
+    SECTION("Boxes outside the window") {
+        grid.insert(osg::BoundingBox(-500, -300, 0, -400, -280, 0), (void*)1);
+        grid.insert(osg::BoundingBox(900, 700, 0, 5000, 720, 0), (void*)2);
+        REQUIRE(grid.overlaps(osg::BoundingBox(-450, -290, 0, -300, -250, 0), (void*)3));
+        REQUIRE(grid.overlaps(osg::BoundingBox(4000, 719, 0, 4100, 730, 0), (void*)3));
+        REQUIRE(!grid.overlaps(osg::BoundingBox(-600, 700, 0, -550, 720, 0), (void*)3));
+    }
+
+    SECTION("Matches brute force declutter") {
+        Random prng(42);
+        std::vector<OwnedBox> used;
+        unsigned mismatches = 0;
+
+        for(unsigned i=0; i<5000; ++i)
+        {
+            float x = -100.0f + prng.next()*1000.0f;
+            float y = -100.0f + prng.next()*800.0f;
+            float w = prng.next()*150.0f;
+            float h = prng.next()*30.0f;
+            osg::BoundingBox box(floor(x), floor(y), 0, ceil(x+w), ceil(y+h), 0);
+            const void* owner = (const void*)(size_t)(1 + i/3);
+
+            bool expected = bruteForceOverlaps(used, box, owner);
+            if (grid.overlaps(box, owner) != expected)
+                ++mismatches;
+
+            if (!expected)
+            {
+                OwnedBox ob;
+                ob.box = box;
+                ob.owner = owner;
+                used.push_back(ob);
+                grid.insert(box, owner);
+            }
+        }
+
+        REQUIRE(mismatches == 0u);
+        REQUIRE(grid.size() == used.size());
+    }
+}
@@ -0,0 +1,68 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarthFeatures/Feature>
+#include <osgEarthFeatures/ScriptEngine>
+#include <osgEarthSymbology/Geometry>
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+using namespace osgEarth::Symbology;
+
+TEST_CASE( "JavaScript feature.save() writes back whatever the script touched" ) {
+
+    osg::ref_ptr<ScriptEngine> engine = ScriptEngineFactory::createWithProfile(Script("", "javascript"), "full");
+    REQUIRE(engine.valid());
+
+    LineString* line = new LineString();
+    line->push_back(osg::Vec3d(0, 0, 0));
+    line->push_back(osg::Vec3d(1, 0, 0));
+    line->push_back(osg::Vec3d(1, 1, 0));
+    osg::ref_ptr<Feature> f = new Feature(line, 0L);
+    f->set("name", std::string("before"));
+
+    SECTION("only the properties") {
+        ScriptResult r = engine->run("feature.properties.x = 1; feature.save(); 'ok'", f.get());
+        REQUIRE(r.success());
+        REQUIRE(r.asString() == "ok");
+        REQUIRE(f->getDouble("x") == 1.0);
+        REQUIRE(f->getString("name") == "before");
+    }
+
+    SECTION("only the geometry") {
+        ScriptResult r = engine->run("var g = feature.geometry; feature.save(); 'ok'", f.get());
+        REQUIRE(r.success());
+        REQUIRE(r.asString() == "ok");
+        REQUIRE(f->getGeometry() != 0L);
+        REQUIRE(f->getGeometry()->getTotalPointCount() == 3);
+    }
+
+    SECTION("neither") {
+        ScriptResult r = engine->run("feature.save(); 'ok'", f.get());
+        REQUIRE(r.success());
+        REQUIRE(r.asString() == "ok");
+        REQUIRE(f->getString("name") == "before");
+        REQUIRE(f->getGeometry() == line);
+    }
+}
@@ -23,6 +23,9 @@
 #include <osgEarth/catch.hpp>
 
 #include <osgEarth/SpatialReference>
+#include <osgEarth/AnalyticTransform>
+#include <ogr_srs_api.h>
+#include <cmath>
 
 using namespace osgEarth;
 
@@ -90,3 +93,177 @@ TEST_CASE("Plate Carre SpatialReferences can be created") {
     REQUIRE(!plateCarre->isGeodetic());
     REQUIRE(plateCarre->isProjected());
 }
+
+TEST_CASE( "Single-point transforms match vector transforms" ) {
+    osg::ref_ptr< const SpatialReference > wgs84 = SpatialReference::create("wgs84");
+    osg::ref_ptr< const SpatialReference > utm = SpatialReference::create("+proj=utm +zone=33 +datum=WGS84");
+    osg::ref_ptr< const SpatialReference > merc = SpatialReference::create("spherical-mercator");
+    REQUIRE(utm.valid());
+
+    const SpatialReference* targets[3] = { utm.get(), merc.get(), wgs84->getECEF() };
+
+    for (unsigned t = 0; t < 3; ++t)
+    {
+        osg::Vec3d input(15.25, 47.5, 120.0), output;
+        REQUIRE(wgs84->transform(input, targets[t], output));
+
+        std::vector<osg::Vec3d> points(1, input);
+        REQUIRE(wgs84->transform(points, targets[t]));
+
+        REQUIRE(output.x() == Approx(points[0].x()));
+        REQUIRE(output.y() == Approx(points[0].y()));
+        REQUIRE(output.z() == Approx(points[0].z()));
+    }
+}
+
+TEST_CASE( "Analytic transforms agree with OGR" ) {
+    osg::ref_ptr< const SpatialReference > wgs84 = SpatialReference::create("wgs84");
+
+    const char* projections[3] = {
+        "+proj=utm +zone=33 +datum=WGS84",
+        "+proj=merc +datum=WGS84",
+        "+proj=eqc +datum=WGS84" };
+
+    for (unsigned p = 0; p < 3; ++p)
+    {
+        osg::ref_ptr< const SpatialReference > proj = SpatialReference::create(projections[p]);
+        REQUIRE(proj.valid());
+
+        osg::ref_ptr<AnalyticTransform> analytic = AnalyticTransform::create(wgs84.get(), proj.get());
+        REQUIRE(analytic.valid());
+
+        std::vector<osg::Vec3d> geo;
+        for (double lat = -80.0; lat <= 80.0; lat += 10.0)
+            for (double lon = 12.0; lon <= 18.0; lon += 1.5)
+                geo.push_back(osg::Vec3d(lon, lat, 0.0));
+
+        std::vector<osg::Vec3d> ogr(geo), fast(geo);
+
+        AnalyticTransform::setEnabled(false);
+        REQUIRE(wgs84->transform(ogr, proj.get()));
+        AnalyticTransform::setEnabled(true);
+        REQUIRE(wgs84->transform(fast, proj.get()));
+
+        for (unsigned i = 0; i < geo.size(); ++i)
+        {
+            REQUIRE(std::abs(ogr[i].x() - fast[i].x()) < 0.01);
+            REQUIRE(std::abs(ogr[i].y() - fast[i].y()) < 0.01);
+        }
+
+        // and back again:
+        REQUIRE(proj->transform(fast, wgs84.get()));
+        for (unsigned i = 0; i < geo.size(); ++i)
+        {
+            REQUIRE(std::abs(geo[i].x() - fast[i].x()) < 1e-7);
+            REQUIRE(std::abs(geo[i].y() - fast[i].y()) < 1e-7);
+        }
+    }
+}
+
+namespace
+{
+    // Transforms through OGR directly, bypassing SpatialReference.
+    bool ogrTransform(void* from, void* to, std::vector<osg::Vec3d>& points)
+    {
+        void* xform = OCTNewCoordinateTransformation(from, to);
+        if ( !xform )
+            return false;
+        bool ok = true;
+        for (unsigned i = 0; i < points.size() && ok; ++i)
+            ok = OCTTransform(xform, 1, &points[i].x(), &points[i].y(), &points[i].z()) > 0;
+        OCTDestroyCoordinateTransformation(xform);
+        return ok;
+    }
+}
+
+TEST_CASE( "Analytic ECEF conversion agrees with OGR" ) {
+    osg::ref_ptr< const SpatialReference > wgs84 = SpatialReference::create("wgs84");
+
+    void* geocent = OSRNewSpatialReference(0L);
+    REQUIRE(OSRImportFromProj4(geocent, "+proj=geocent +datum=WGS84 +units=m +no_defs") == OGRERR_NONE);
+
+    std::vector<osg::Vec3d> geo;
+    for (double lat = -90.0; lat <= 90.0; lat += 15.0)
+        for (double lon = -180.0; lon < 180.0; lon += 30.0)
+            geo.push_back(osg::Vec3d(lon, lat, lat * 100.0));
+
+    std::vector<osg::Vec3d> ogr(geo), fast(geo);
+    REQUIRE(ogrTransform(wgs84->getHandle(), geocent, ogr));
+    AnalyticTransform::geodeticToECEF(fast, wgs84->getEllipsoid());
+
+    for (unsigned i = 0; i < geo.size(); ++i)
+    {
+        REQUIRE(std::abs(ogr[i].x() - fast[i].x()) < 0.001);
+        REQUIRE(std::abs(ogr[i].y() - fast[i].y()) < 0.001);
+        REQUIRE(std::abs(ogr[i].z() - fast[i].z()) < 0.001);
+    }
+
+    // and back again:
+    AnalyticTransform::ECEFToGeodetic(fast, wgs84->getEllipsoid());
+    for (unsigned i = 0; i < geo.size(); ++i)
+    {
+        if ( std::abs(geo[i].y()) < 90.0 ) // longitude is arbitrary at the poles
+            REQUIRE(std::abs(geo[i].x() - fast[i].x()) < 1e-7);
+        REQUIRE(std::abs(geo[i].y() - fast[i].y()) < 1e-7);
+        REQUIRE(std::abs(geo[i].z() - fast[i].z()) < 0.001);
+    }
+
+    OSRDestroySpatialReference(geocent);
+}
+
+TEST_CASE( "Analytic spherical mercator from WKT agrees with OGR" ) {
+    osg::ref_ptr< const SpatialReference > wgs84 = SpatialReference::create("wgs84");
+
+    // EPSG:3857 as GDAL writes it, with the PROJ4 extension:
+    osg::ref_ptr< const SpatialReference > merc = SpatialReference::create(
+        "PROJCS[\"WGS 84 / Pseudo-Mercator\",GEOGCS[\"WGS 84\",DATUM[\"WGS_1984\","
+        "SPHEROID[\"WGS 84\",6378137,298.257223563,AUTHORITY[\"EPSG\",\"7030\"]],AUTHORITY[\"EPSG\",\"6326\"]],"
+        "PRIMEM[\"Greenwich\",0,AUTHORITY[\"EPSG\",\"8901\"]],UNIT[\"degree\",0.0174532925199433,AUTHORITY[\"EPSG\",\"9122\"]],"
+        "AUTHORITY[\"EPSG\",\"4326\"]],PROJECTION[\"Mercator_1SP\"],PARAMETER[\"central_meridian\",0],"
+        "PARAMETER[\"scale_factor\",1],PARAMETER[\"false_easting\",0],PARAMETER[\"false_northing\",0],"
+        "UNIT[\"metre\",1,AUTHORITY[\"EPSG\",\"9001\"]],AXIS[\"X\",EAST],AXIS[\"Y\",NORTH],"
+        "EXTENSION[\"PROJ4\",\"+proj=merc +a=6378137 +b=6378137 +lat_ts=0.0 +lon_0=0.0 +x_0=0.0 +y_0=0 +k=1.0 "
+        "+units=m +nadgrids=@null +wktext +no_defs\"],AUTHORITY[\"EPSG\",\"3857\"]]");
+    REQUIRE(merc.valid());
+
+    osg::ref_ptr<AnalyticTransform> analytic = AnalyticTransform::create(wgs84.get(), merc.get());
+    REQUIRE(analytic.valid());
+
+    std::vector<osg::Vec3d> geo;
+    for (double lat = -80.0; lat <= 80.0; lat += 10.0)
+        for (double lon = -170.0; lon <= 170.0; lon += 20.0)
+            geo.push_back(osg::Vec3d(lon, lat, 0.0));
+
+    std::vector<osg::Vec3d> ogr(geo);
+    REQUIRE(ogrTransform(wgs84->getHandle(), merc->getHandle(), ogr));
+
+    std::vector<double> x, y;
+    for (unsigned i = 0; i < geo.size(); ++i)
+        x.push_back(geo[i].x()), y.push_back(geo[i].y());
+    REQUIRE(analytic->transform(&x[0], &y[0], x.size()));
+
+    for (unsigned i = 0; i < geo.size(); ++i)
+    {
+        REQUIRE(std::abs(ogr[i].x() - x[i]) < 0.01);
+        REQUIRE(std::abs(ogr[i].y() - y[i]) < 0.01);
+    }
+}
+
+TEST_CASE( "Analytic transforms decline datum shifts and wide Transverse Mercator" ) {
+    osg::ref_ptr< const SpatialReference > wgs84 = SpatialReference::create("wgs84");
+
+    osg::ref_ptr< const SpatialReference > shifted = SpatialReference::create(
+        "+proj=tmerc +lon_0=15 +ellps=WGS84 +towgs84=100,50,-20,0,0,0,0 +units=m");
+    REQUIRE(shifted.valid());
+    REQUIRE(AnalyticTransform::create(wgs84.get(), shifted.get()) == 0L);
+
+    osg::ref_ptr< const SpatialReference > utm = SpatialReference::create("+proj=utm +zone=33 +datum=WGS84");
+    osg::ref_ptr<AnalyticTransform> analytic = AnalyticTransform::create(wgs84.get(), utm.get());
+    REQUIRE(analytic.valid());
+
+    double x[2] = { 15.0, 24.0 }, y[2] = { 45.0, 45.0 };
+    REQUIRE(analytic->isInDomain(x, y, 2));
+
+    x[1] = 26.0;
+    REQUIRE_FALSE(analytic->isInDomain(x, y, 2));
+}
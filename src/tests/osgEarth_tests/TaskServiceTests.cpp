@@ -0,0 +1,185 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/TaskService>
+#include <OpenThreads/Thread>
+#include <set>
+
+using namespace osgEarth;
+
+namespace
+{
+    struct NumberedTask : public TaskRequest
+    {
+        NumberedTask(int number, float priority =0.0f) : TaskRequest(priority), _number(number) { }
+        void operator()(ProgressCallback* progress) { }
+        int _number;
+    };
+
+    int numberOf(TaskRequest* request)
+    {
+        osg::ref_ptr<TaskRequest> r = request;
+        NumberedTask* task = dynamic_cast<NumberedTask*>(r.get());
+        return task ? task->_number : -1;
+    }
+
+    // Adds one task to a queue from its own thread.
+    struct AddThread : public OpenThreads::Thread
+    {
+        AddThread(TaskRequestQueue* queue, TaskRequest* request) : _queue(queue), _request(request), _added(false) { }
+        void run() { _queue->add(_request.get()); _added = true; }
+        osg::ref_ptr<TaskRequestQueue> _queue;
+        osg::ref_ptr<TaskRequest>      _request;
+        volatile bool                  _added;
+    };
+
+    // Takes one task from a queue on its own thread.
+    struct GetThread : public OpenThreads::Thread
+    {
+        GetThread(TaskRequestQueue* queue) : _queue(queue), _returned(false) { }
+        void run() { _result = _queue->get(); _returned = true; }
+        osg::ref_ptr<TaskRequestQueue> _queue;
+        osg::ref_ptr<TaskRequest>      _result;
+        volatile bool                  _returned;
+    };
+
+    // Counts how many times it actually ran.
+    struct CountingJoinableTask : public JoinableTask
+    {
+        CountingJoinableTask() : _runs(0) { }
+        void execute() { ++_runs; }
+        OpenThreads::Atomic _runs;
+    };
+}
+
+TEST_CASE( "WorkStealingTaskQueue runs each lane in FIFO order, higher lanes first" ) {
+
+    osg::ref_ptr<WorkStealingTaskQueue> queue = new WorkStealingTaskQueue(1);
+
+    queue->add(new PoisonPill());
+    queue->add(new NumberedTask(1, 1.0f));   // low
+    queue->add(new NumberedTask(2));         // normal
+    queue->add(new NumberedTask(3, -1.0f));  // high
+    queue->add(new NumberedTask(4));         // normal
+    queue->add(new NumberedTask(5, -1.0f));  // high
+    REQUIRE(queue->getNumRequests() == 6u);
+
+    REQUIRE(numberOf(queue->get()) == 3);
+    REQUIRE(numberOf(queue->get()) == 5);
+    REQUIRE(numberOf(queue->get()) == 2);
+    REQUIRE(numberOf(queue->get()) == 4);
+    REQUIRE(numberOf(queue->get()) == 1);
+
+    // the poison pill goes last:
+    osg::ref_ptr<TaskRequest> pill = queue->get();
+    REQUIRE(dynamic_cast<PoisonPill*>(pill.get()) != 0L);
+    REQUIRE(queue->isEmpty());
+}
+
+TEST_CASE( "WorkStealingTaskQueue steals from the other slots" ) {
+
+    // tasks added from a non-worker thread are spread over the slots,
+    // so a single consumer has to steal most of them.
+    osg::ref_ptr<WorkStealingTaskQueue> queue = new WorkStealingTaskQueue(4);
+    for(int i=0; i<8; ++i)
+        queue->add(new NumberedTask(i));
+
+    std::set<int> taken;
+    for(int i=0; i<8; ++i)
+        taken.insert(numberOf(queue->get()));
+
+    REQUIRE(taken.size() == 8u);
+    REQUIRE(queue->getNumRequests() == 0u);
+    REQUIRE(queue->isEmpty());
+}
+
+TEST_CASE( "WorkStealingTaskQueue blocks adders at the bound" ) {
+
+    osg::ref_ptr<WorkStealingTaskQueue> queue = new WorkStealingTaskQueue(2, 2);
+    queue->add(new NumberedTask(1));
+    queue->add(new NumberedTask(2));
+    REQUIRE(queue->isFull());
+
+    AddThread adder(queue.get(), new NumberedTask(3));
+    adder.start();
+    OpenThreads::Thread::microSleep(100000);
+    REQUIRE_FALSE(adder._added);
+    REQUIRE(queue->getNumRequests() == 2u);
+
+    // taking one makes room:
+    REQUIRE(numberOf(queue->get()) > 0);
+    adder.join();
+    REQUIRE(adder._added);
+    REQUIRE(queue->getNumRequests() == 2u);
+    REQUIRE(queue->isFull());
+}
+
+TEST_CASE( "WorkStealingTaskQueue wakes sleeping workers on add and on shutdown" ) {
+
+    osg::ref_ptr<WorkStealingTaskQueue> queue = new WorkStealingTaskQueue(2);
+
+    // a sleeping worker wakes up for a new task:
+    GetThread worker1(queue.get());
+    worker1.start();
+    OpenThreads::Thread::microSleep(50000);
+    REQUIRE_FALSE(worker1._returned);
+    queue->add(new NumberedTask(7));
+    worker1.join();
+    REQUIRE(numberOf(worker1._result.release()) == 7);
+
+    // and returns NULL once the queue is done:
+    GetThread worker2(queue.get());
+    worker2.start();
+    OpenThreads::Thread::microSleep(50000);
+    REQUIRE_FALSE(worker2._returned);
+    queue->setDone();
+    worker2.join();
+    REQUIRE(worker2._returned);
+    REQUIRE_FALSE(worker2._result.valid());
+}
+
+TEST_CASE( "JoinableTask runs exactly once, on whichever thread claims it" ) {
+
+    SECTION( "joined before any thread takes it" ) {
+        osg::ref_ptr<WorkStealingTaskQueue> queue = new WorkStealingTaskQueue(1);
+        osg::ref_ptr<CountingJoinableTask> task = new CountingJoinableTask();
+        queue->add(task.get());
+
+        // the queue has no threads, so join() has to run it here:
+        task->join();
+        REQUIRE(task->_runs == 1u);
+
+        // a late worker that picks it up afterwards does nothing:
+        osg::ref_ptr<TaskRequest> taken = queue->get();
+        (*taken)(0L);
+        REQUIRE(task->_runs == 1u);
+    }
+
+    SECTION( "run by a worker, then joined" ) {
+        osg::ref_ptr<CountingJoinableTask> task = new CountingJoinableTask();
+        (*task)(0L);
+        task->join();
+        REQUIRE(task->_runs == 1u);
+    }
+}
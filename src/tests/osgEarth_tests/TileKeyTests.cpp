@@ -0,0 +1,78 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/TileKey>
+#include <osgEarth/Profile>
+#include <set>
+
+using namespace osgEarth;
+
+TEST_CASE( "TileKey codes are unique and sort by LOD, then Morton order" ) {
+
+    osg::ref_ptr<const Profile> profile = Profile::create("global-geodetic");
+
+    std::set<unsigned long long> codes;
+    for(unsigned lod=0; lod<4; ++lod)
+    {
+        unsigned tx, ty;
+        profile->getNumTiles(lod, tx, ty);
+        for(unsigned y=0; y<ty; ++y)
+            for(unsigned x=0; x<tx; ++x)
+                REQUIRE(codes.insert(TileKey(lod, x, y, profile.get()).getCode()).second);
+    }
+
+    // a parent's children are contiguous in Z order:
+    TileKey key(2, 1, 1, profile.get());
+    REQUIRE(key.createChildKey(0) < key.createChildKey(1));
+    REQUIRE(key.createChildKey(1) < key.createChildKey(2));
+    REQUIRE(key.createChildKey(2) < key.createChildKey(3));
+    REQUIRE(key.createChildKey(3) < TileKey(3, 4, 2, profile.get()));
+
+    // lower LODs sort first regardless of location:
+    REQUIRE(TileKey(1, 3, 1, profile.get()) < TileKey(2, 0, 0, profile.get()));
+}
+
+TEST_CASE( "TileKey equality and hashing use the location" ) {
+
+    osg::ref_ptr<const Profile> profile = Profile::create("global-geodetic");
+
+    TileKey a(5, 17, 9, profile.get());
+    TileKey b(5, 17, 9, profile.get());
+    TileKey c(5, 9, 17, profile.get());
+
+    REQUIRE(a == b);
+    REQUIRE(a != c);
+    REQUIRE(Hash<TileKey>()(a) == Hash<TileKey>()(b));
+    REQUIRE(EqualTo<TileKey>()(a, b));
+    REQUIRE_FALSE(EqualTo<TileKey>()(a, c));
+    REQUIRE(a.createParentKey() == TileKey(4, 8, 4, profile.get()));
+}
+
+TEST_CASE( "TileKey str() formats lod/x/y" ) {
+
+    osg::ref_ptr<const Profile> profile = Profile::create("global-geodetic");
+
+    REQUIRE(TileKey(5, 17, 9, profile.get()).str() == "5/17/9");
+    REQUIRE(TileKey::INVALID.str() == "invalid");
+}
@@ -0,0 +1,155 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/TileVisitor>
+#include <osgEarth/Profile>
+#include <set>
+#include <vector>
+
+using namespace osgEarth;
+
+namespace
+{
+    // Records the keys a visitor emits; declines the children of "_prune"
+    // and of every child of "_pruneChildren".
+    struct RecordingHandler : public TileHandler
+    {
+        bool handleTile(const TileKey& key, const TileVisitor& tv)
+        {
+            _keys.push_back(key);
+            if (key == _prune)
+                return false;
+            if (_pruneChildren.valid() && key.getLOD() == _pruneChildren.getLOD()+1 && key.createParentKey() == _pruneChildren)
+                return false;
+            return true;
+        }
+
+        std::vector<TileKey> _keys;
+        TileKey              _prune;
+        TileKey              _pruneChildren;
+    };
+
+    osg::ref_ptr<RecordingHandler> visit(const Profile* profile, TileVisitor::TraversalOrder order, unsigned maxLevel)
+    {
+        osg::ref_ptr<RecordingHandler> handler = new RecordingHandler();
+        osg::ref_ptr<TileVisitor> visitor = new TileVisitor(handler.get());
+        visitor->setTraversalOrder(order);
+        visitor->setMaxLevel(maxLevel);
+        visitor->run(profile);
+        return handler;
+    }
+}
+
+TEST_CASE( "TileVisitor curve orders emit every key once, level by level" ) {
+
+    osg::ref_ptr<const Profile> profile = Profile::create("global-geodetic");
+
+    unsigned expected = visit(profile.get(), TileVisitor::TRAVERSAL_DEPTH_FIRST, 4)->_keys.size();
+
+    TileVisitor::TraversalOrder orders[2] = { TileVisitor::TRAVERSAL_MORTON, TileVisitor::TRAVERSAL_HILBERT };
+    for(unsigned i=0; i<2; ++i)
+    {
+        osg::ref_ptr<RecordingHandler> handler = visit(profile.get(), orders[i], 4);
+        REQUIRE(handler->_keys.size() == expected);
+
+        std::set<TileKey> unique(handler->_keys.begin(), handler->_keys.end());
+        REQUIRE(unique.size() == expected);
+
+        for(unsigned k=1; k<handler->_keys.size(); ++k)
+            REQUIRE(handler->_keys[k-1].getLOD() <= handler->_keys[k].getLOD());
+    }
+}
+
+TEST_CASE( "TileVisitor Morton order follows TileKey codes within a root" ) {
+
+    osg::ref_ptr<const Profile> profile = Profile::create("spherical-mercator");
+
+    osg::ref_ptr<RecordingHandler> handler = visit(profile.get(), TileVisitor::TRAVERSAL_MORTON, 3);
+    for(unsigned k=1; k<handler->_keys.size(); ++k)
+        REQUIRE(handler->_keys[k-1].getCode() < handler->_keys[k].getCode());
+}
+
+TEST_CASE( "TileVisitor Hilbert order steps to an adjacent tile" ) {
+
+    // a single root key, so each level is one continuous curve:
+    osg::ref_ptr<const Profile> profile = Profile::create("spherical-mercator");
+
+    osg::ref_ptr<RecordingHandler> handler = visit(profile.get(), TileVisitor::TRAVERSAL_HILBERT, 4);
+    for(unsigned k=1; k<handler->_keys.size(); ++k)
+    {
+        const TileKey& a = handler->_keys[k-1];
+        const TileKey& b = handler->_keys[k];
+        if (a.getLOD() == b.getLOD())
+        {
+            int dx = (int)a.getTileX() - (int)b.getTileX();
+            int dy = (int)a.getTileY() - (int)b.getTileY();
+            REQUIRE(dx*dx + dy*dy == 1);
+        }
+    }
+}
+
+TEST_CASE( "TileVisitor curve orders skip the children of declined keys" ) {
+
+    osg::ref_ptr<const Profile> profile = Profile::create("spherical-mercator");
+
+    osg::ref_ptr<RecordingHandler> handler = new RecordingHandler();
+    handler->_prune = TileKey(1, 1, 0, profile.get());
+
+    osg::ref_ptr<TileVisitor> visitor = new TileVisitor(handler.get());
+    visitor->setTraversalOrder(TileVisitor::TRAVERSAL_HILBERT);
+    visitor->setMaxLevel(3);
+    visitor->run(profile.get());
+
+    // 1 + 4 + 3*4 + 3*16 keys; none below the declined one.
+    REQUIRE(handler->_keys.size() == 65u);
+    for(unsigned k=0; k<handler->_keys.size(); ++k)
+    {
+        const TileKey& key = handler->_keys[k];
+        if (key.getLOD() > 1)
+            REQUIRE_FALSE(key.createAncestorKey(1) == handler->_prune);
+    }
+}
+
+TEST_CASE( "TileVisitor curve orders skip a subtree declined key by key" ) {
+
+    osg::ref_ptr<const Profile> profile = Profile::create("spherical-mercator");
+
+    // all four children of (1,1,0) are declined, and collapse into it:
+    osg::ref_ptr<RecordingHandler> handler = new RecordingHandler();
+    handler->_pruneChildren = TileKey(1, 1, 0, profile.get());
+
+    osg::ref_ptr<TileVisitor> visitor = new TileVisitor(handler.get());
+    visitor->setTraversalOrder(TileVisitor::TRAVERSAL_HILBERT);
+    visitor->setMaxLevel(4);
+    visitor->run(profile.get());
+
+    // 1 + 4 + 16 + 12*4 + 12*16 keys; none below level 2 under (1,1,0).
+    REQUIRE(handler->_keys.size() == 261u);
+    for(unsigned k=0; k<handler->_keys.size(); ++k)
+    {
+        const TileKey& key = handler->_keys[k];
+        if (key.getLOD() > 2)
+            REQUIRE_FALSE(key.createAncestorKey(1) == handler->_pruneChildren);
+    }
+}